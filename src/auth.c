@@ -34,9 +34,14 @@
 #include "did.h"
 #include "db.h"
 #include "feeds.h"
+#include "reqtrace.h"
+#include "timerwheel.h"
+#include "logging.h"
 
 #define TAG_AUTH "[Feedsd.Auth]: "
 
+#define LOGIN_TTL 60
+
 typedef struct {
     UserInfo info;
     JWT *token;
@@ -53,22 +58,50 @@ typedef struct {
     char sub[ELA_MAX_DID_LEN];
     time_t expat;
     bool vc_req;
+    Timer *expiry;
 } Login;
 
 extern Carrier *carrier;
 
 static linked_hashtable_t *pending_logins;
 
+static
+void login_expire(void *context)
+{
+    Login *login = (Login *)context;
+
+    vlogI(TAG_AUTH "Login{nonce: %s, subject: %s, expiration: %" PRIu64 ", vc_required: %s} has expired.",
+          login->nonce, login->sub, (uint64_t)login->expat, login->vc_req ? "true" : "false");
+    deref(linked_hashtable_remove(pending_logins, login->nonce, strlen(login->nonce)));
+}
+
 static inline
 Login *pending_login_put(Login *login)
 {
+    login->expiry = timer_start(LOGIN_TTL * 1000ULL, login_expire, login);
+    if (!login->expiry)
+        vlogW(TAG_AUTH "Arming expiry of login{nonce: %s} failed.", login->nonce);
+
     return linked_hashtable_put(pending_logins, &login->he);
 }
 
 static inline
 Login *pending_login_remove(const char *nonce)
 {
-    return linked_hashtable_remove(pending_logins, nonce, strlen(nonce));
+    Login *login = linked_hashtable_remove(pending_logins, nonce, strlen(nonce));
+
+    if (login && login->expiry)
+        timer_stop(login->expiry);
+
+    return login;
+}
+
+static
+void login_dtor(void *obj)
+{
+    Login *login = (Login *)obj;
+
+    deref(login->expiry);
 }
 
 static
@@ -77,7 +110,7 @@ Login *login_create(const char *sub)
     uint8_t buf[NONCE_BYTES];
     Login *login;
 
-    login = rc_zalloc(sizeof(Login), NULL);
+    login = rc_zalloc(sizeof(Login), login_dtor);
     if (!login) {
         vlogE(TAG_AUTH "OOM");
         return NULL;
@@ -88,7 +121,7 @@ Login *login_create(const char *sub)
 
     strcpy(login->sub, sub);
 
-    login->expat = time(NULL) + 60;
+    login->expat = time(NULL) + LOGIN_TTL;
     login->vc_req = db_need_upsert_user(sub) ? true : false;
 
     login->he.data   = login;
@@ -162,6 +195,8 @@ void hdl_signin_req_chal_req(Carrier *c, const char *from, Req *base)
         return;
     }
 
+    did_sdk_lock();
+
     if (strlen(req->params.iss) >= ELA_MAX_DID_LEN) {
         vlogE(TAG_AUTH "Invalid iss in signin_request_challenge.");
         ErrResp resp = {
@@ -234,6 +269,7 @@ finally:
     if (vc)
         free(vc);
     deref(login);
+    did_sdk_unlock();
 }
 
 static
@@ -428,6 +464,8 @@ void hdl_signin_conf_chal_req(Carrier *c, const char *from, Req *base)
         return;
     }
 
+    did_sdk_lock();
+
     chal_resp = DefaultJWSParser_Parse(req->params.jws);
     if (!chal_resp) {
         vlogE(TAG_AUTH "Invalid jws in signin_confirm_challenge: %s", DIDError_GetLastErrorMessage());
@@ -574,6 +612,7 @@ finally:
         JWT_Destroy(chal_resp);
     deref(uinfo);
     deref(login);
+    did_sdk_unlock();
 }
 
 static
@@ -581,7 +620,9 @@ void atuinfo_dtor(void *obj)
 {
     AccessTokenUserInfo *usr = (AccessTokenUserInfo *)obj;
 
+    did_sdk_lock();
     JWT_Destroy(usr->token);
+    did_sdk_unlock();
 }
 
 static inline
@@ -635,11 +676,15 @@ finally:
 UserInfo *create_uinfo_from_access_token(const char *token_marshal)
 {
     AccessTokenUserInfo *uinfo = NULL;
+    uint64_t trace_at = reqtrace_mark();
     JWT *token = NULL;
 
+    did_sdk_lock();
     token = DefaultJWSParser_Parse(token_marshal);
     if (!token) {
         vlogE(TAG_AUTH "Parsing access token failed: %s", DIDError_GetLastErrorMessage());
+        did_sdk_unlock();
+        reqtrace_stage(TRACE_AUTH, trace_at);
         return NULL;
     }
 
@@ -666,7 +711,9 @@ UserInfo *create_uinfo_from_access_token(const char *token_marshal)
 finally:
     if (token)
         JWT_Destroy(token);
+    did_sdk_unlock();
 
+    reqtrace_stage(TRACE_AUTH, trace_at);
     return uinfo ? &uinfo->info : NULL;
 }
 
@@ -688,26 +735,3 @@ int auth_init()
 
     return 0;
 }
-
-void auth_expire_login()
-{
-    linked_hashtable_iterator_t it;
-
-    linked_hashtable_iterate(pending_logins, &it);
-    while(linked_hashtable_iterator_has_next(&it)) {
-        Login *login;
-        int rc;
-
-        rc = linked_hashtable_iterator_next(&it, NULL, NULL, (void **)&login);
-        if (rc <= 0)
-            break;
-
-        if (login->expat < time(NULL)) {
-            vlogI(TAG_AUTH "Login{nonce: %s, subject: %s, expiration: %" PRIu64 ", vc_required: %s} has expired.",
-                  login->nonce, login->sub, (uint64_t)login->expat, login->vc_req ? "true" : "false");
-            linked_hashtable_iterator_remove(&it);
-        }
-
-        deref(login);
-    }
-}
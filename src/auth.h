@@ -34,6 +34,5 @@ void auth_deinit();
 void hdl_signin_req_chal_req(Carrier *c, const char *from, Req *base);
 void hdl_signin_conf_chal_req(Carrier *c, const char *from, Req *base);
 UserInfo *create_uinfo_from_access_token(const char *token_marshal);
-void auth_expire_login();
 
 #endif // __AUTH_H__
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2020 trinity-tech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include <ctype.h>
+#include <sodium.h>
+
+#include "avatar.h"
+
+static _Thread_local int by_hash;
+
+void avatar_hash(const void *avatar, size_t len, char *hash)
+{
+    unsigned char digest[crypto_hash_sha256_BYTES];
+
+    crypto_hash_sha256(digest, (const unsigned char *)avatar, len);
+    sodium_bin2hex(hash, AVATAR_HASH_LEN + 1, digest, sizeof(digest));
+}
+
+int avatar_hash_is_valid(const char *hash)
+{
+    size_t i;
+
+    if (!hash || strlen(hash) != AVATAR_HASH_LEN)
+        return 0;
+
+    for (i = 0; i < AVATAR_HASH_LEN; i++) {
+        if (!isxdigit((unsigned char)hash[i]) || isupper((unsigned char)hash[i]))
+            return 0;
+    }
+
+    return 1;
+}
+
+void avatar_by_hash_begin(int on)
+{
+    by_hash = on;
+}
+
+void avatar_by_hash_end(void)
+{
+    by_hash = 0;
+}
+
+int avatar_by_hash(void)
+{
+    return by_hash;
+}
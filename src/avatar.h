@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2020 trinity-tech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __AVATAR_H__
+#define __AVATAR_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Avatars are stored once in the avatars table keyed by the hex encoded
+ * sha256 of their content. Channels and users only keep that hash.
+ */
+#define AVATAR_HASH_LEN 64
+#define AVATAR_NONE     "NA"
+
+void avatar_hash(const void *avatar, size_t len, char *hash);
+int avatar_hash_is_valid(const char *hash);
+
+/*
+ * Clients that fetch avatars through get_avatar say so with a top-level
+ * "avatar_hash": true in their requests and get channel avatars as
+ * avatar_hash. Everyone else keeps getting the blob under "avatar". Set
+ * by the command handler around each request on its thread.
+ */
+void avatar_by_hash_begin(int by_hash);
+void avatar_by_hash_end(void);
+int avatar_by_hash(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif //__AVATAR_H__
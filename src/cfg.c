@@ -101,6 +101,8 @@ static void qualified_path(const char *path, const char *ref, char *qualified)
 
 #define DEFAULT_LOG_LEVEL CarrierLogLevel_Info
 #define DEFAULT_DATA_DIR  "/var/lib/feedsd"
+#define DEFAULT_SLOW_REQ_THRESHOLD 1000
+#define DEFAULT_OUTBOX_TTL (24 * 60 * 60)
 FeedsConfig *load_cfg(const char *cfg_file, FeedsConfig *fc, const char *data_path)
 {
     config_setting_t *nodes_setting;
@@ -290,6 +292,21 @@ FeedsConfig *load_cfg(const char *cfg_file, FeedsConfig *fc, const char *data_pa
     sprintf(number, "%d", intopt);
     fc->http_port = strdup(number);
 
+    fc->slow_req_threshold = DEFAULT_SLOW_REQ_THRESHOLD;
+    rc = config_lookup_int(&cfg, "trace.slow-threshold", &intopt);
+    if (rc && intopt >= 0)
+        fc->slow_req_threshold = intopt;
+
+    fc->trace_sample_rate = 1;
+    rc = config_lookup_int(&cfg, "trace.sample-rate", &intopt);
+    if (rc && intopt > 0)
+        fc->trace_sample_rate = intopt;
+
+    fc->outbox_ttl = DEFAULT_OUTBOX_TTL;
+    rc = config_lookup_int(&cfg, "outbox.ttl", &intopt);
+    if (rc && intopt >= 0)
+        fc->outbox_ttl = intopt;
+
     config_destroy(&cfg);
     return fc;
 }
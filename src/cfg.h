@@ -36,6 +36,9 @@ typedef struct {
     char *didstore_passwd;
     char *http_ip;
     char *http_port;
+    int slow_req_threshold;
+    int trace_sample_rate;
+    int outbox_ttl;
 } FeedsConfig;
 
 const char *get_cfg_file(const char *config_file, const char *default_config_files[]);
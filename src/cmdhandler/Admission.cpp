@@ -0,0 +1,225 @@
+#include "Admission.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <ErrCode.hpp>
+#include <Log.hpp>
+
+extern "C" {
+#include <admission.h>
+}
+
+namespace trinity {
+
+/* =========================================== */
+/* === static variables initialize =========== */
+/* =========================================== */
+std::atomic<uint64_t> Admission::TotalAccepted {0};
+std::atomic<uint64_t> Admission::TotalThrottled {0};
+std::atomic<uint64_t> Admission::TotalShed {0};
+
+/* =========================================== */
+/* === static function implement ============= */
+/* =========================================== */
+std::shared_ptr<Admission> Admission::Create()
+{
+    struct Impl: Admission {
+        explicit Impl() = default;
+        virtual ~Impl() = default;
+    };
+
+    return std::make_shared<Impl>();
+}
+
+Admission::MethodClass Admission::Classify(const std::string& method)
+{
+    static const MethodClass Session = { 1, false };
+    static const MethodClass Write = { 2, false };
+    static const MethodClass Read = { 1, true };
+    static const MethodClass Aggregate = { 2, true };
+    static const MethodClass List = { 4, true };
+
+    static const std::unordered_map<std::string, MethodClass> methodClassMap = {
+        { "declare_owner",                      Session },
+        { "import_did",                         Session },
+        { "issue_credential",                   Session },
+        { "update_credential",                  Session },
+        { "signin_request_challenge",           Session },
+        { "signin_confirm_challenge",           Session },
+        { "enable_notification",                Session },
+        { "get_service_version",                Session },
+        { "standard_sign_in",                   Session },
+        { "standard_did_auth",                  Session },
+
+        { "create_channel",                     Write },
+        { "update_feedinfo",                    Write },
+        { "update_user_info",                   Write },
+        { "publish_post",                       Write },
+        { "declare_post",                       Write },
+        { "notify_post",                        Write },
+        { "edit_post",                          Write },
+        { "delete_post",                        Write },
+        { "post_comment",                       Write },
+        { "edit_comment",                       Write },
+        { "delete_comment",                     Write },
+        { "block_comment",                      Write },
+        { "unblock_comment",                    Write },
+        { "post_like",                          Write },
+        { "post_unlike",                        Write },
+        { "subscribe_channel",                  Write },
+        { "unsubscribe_channel",                Write },
+        { "report_illegal_comment",             Write },
+        { "set_binary",                         Write },
+
+        { "get_channel_detail",                 Read },
+        { "get_statistics",                     Read },
+        { "get_avatar",                         Read },
+        { "get_multi_likes_and_comments_count", Aggregate },
+        { "get_multi_subscribers_count",        Aggregate },
+
+        { "get_my_channels",                    List },
+        { "get_my_channels_metadata",           List },
+        { "get_channels",                       List },
+        { "get_subscribed_channels",            List },
+        { "get_posts",                          List },
+        { "get_posts_likes_and_comments",       List },
+        { "get_liked_posts",                    List },
+        { "get_liked_data",                     List },
+        { "get_comments",                       List },
+        { "get_comments_likes",                 List },
+        { "get_reported_comments",              List },
+        { "get_binary",                         List },
+        { "get_multi_comments",                 List },
+        { "get_changes_since",                  List },
+        { "search",                             List },
+        { "get_timeline",                       List },
+        { "get_comment_thread",                 List },
+    };
+
+    // unknown methods are refused by the handlers right away.
+    auto it = methodClassMap.find(method);
+    return (it != methodClassMap.end() ? it->second : Session);
+}
+
+/* =========================================== */
+/* === class public function implement  ====== */
+/* =========================================== */
+Admission::Verdict Admission::admit(const std::string& from, const Rpc::Factory::Envelope& envelope)
+{
+    auto methodClass = Classify(envelope.method);
+    int cost = methodClass.cost * (envelope.maxCount == 0 ? UnboundedFactor : 1);
+
+    auto now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Verdict verdict = Accepted;
+    int depth = pending.load();
+    if(depth >= QueueLimit || (depth >= QueueWatermark && methodClass.sheddable == true)) {
+        verdict = Shed;
+    } else if(take(from, cost, now) == false) {
+        verdict = Throttled;
+    } else {
+        pending++;
+    }
+
+    maxPending = std::max(maxPending, depth);
+    count(verdict, now);
+
+    if(verdict != Accepted) {
+        LOG_D(Log::Tag::Cmd, "Admission %s method:%s, id:%lld, from:%s, queue depth:%d",
+               verdict == Shed ? "shed" : "throttled", envelope.method.c_str(), envelope.id, from.c_str(), depth);
+    }
+
+    return verdict;
+}
+
+void Admission::done()
+{
+    pending--;
+}
+
+/* =========================================== */
+/* === class protected function implement  === */
+/* =========================================== */
+
+/* =========================================== */
+/* === class private function implement  ===== */
+/* =========================================== */
+void Admission::Refill(Bucket& bucket, Clock::time_point now)
+{
+    std::chrono::duration<double> elapsed = now - bucket.refilledAt;
+    bucket.tokens = std::min(BucketDepth, bucket.tokens + elapsed.count() * TokensPerSecond);
+    bucket.refilledAt = now;
+}
+
+bool Admission::take(const std::string& from, int cost, Clock::time_point now)
+{
+    auto it = buckets.find(from);
+    if(it == buckets.end()) {
+        if(buckets.size() >= MaxBuckets) {
+            evictIdle(now);
+        }
+        it = buckets.emplace(from, Bucket{BucketDepth, now}).first;
+    }
+
+    auto& bucket = it->second;
+    Refill(bucket, now);
+    if(bucket.tokens < cost) {
+        return false;
+    }
+    bucket.tokens -= cost;
+
+    return true;
+}
+
+void Admission::evictIdle(Clock::time_point now)
+{
+    // a full bucket holds no state worth keeping.
+    for(auto it = buckets.begin(); it != buckets.end();) {
+        Refill(it->second, now);
+        it = (it->second.tokens >= BucketDepth ? buckets.erase(it) : std::next(it));
+    }
+}
+
+void Admission::count(Verdict verdict, Clock::time_point now)
+{
+    if(verdict == Shed) {
+        shed++;
+        TotalShed++;
+    } else if(verdict == Throttled) {
+        throttled++;
+        TotalThrottled++;
+    } else {
+        accepted++;
+        TotalAccepted++;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - statsSince).count();
+    if(elapsed < StatsIntervalMS) {
+        return;
+    }
+
+    // drop the buckets of peers gone quiet, so the map follows the peers
+    // active in the last interval instead of every peer ever seen.
+    evictIdle(now);
+
+    if(shed > 0 || throttled > 0) {
+        Log::I(Log::Tag::Cmd, "Admission: accepted %llu, throttled %llu, shed %llu, max queue depth %d.",
+               accepted, throttled, shed, maxPending);
+    }
+
+    accepted = 0;
+    throttled = 0;
+    shed = 0;
+    maxPending = 0;
+    statsSince = now;
+}
+
+} // namespace trinity
+
+void admission_get_stats(AdmissionStats *stats)
+{
+    stats->accepted = trinity::Admission::TotalAccepted;
+    stats->throttled = trinity::Admission::TotalThrottled;
+    stats->shed = trinity::Admission::TotalShed;
+}
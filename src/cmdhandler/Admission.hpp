@@ -0,0 +1,103 @@
+#ifndef _FEEDS_ADMISSION_HPP_
+#define _FEEDS_ADMISSION_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <RpcFactory.hpp>
+
+namespace trinity {
+
+/*
+ * Decides, before a request is queued on the command-handler thread, whether
+ * it is worth queueing at all. Every peer owns a token bucket charged by the
+ * cost of the method it calls, and once the queue grows past a watermark the
+ * low-priority reads are shed so sign-in and writes still get through.
+ */
+class Admission {
+public:
+    /*** type define ***/
+    enum Verdict {
+        Accepted,
+        Throttled,
+        Shed,
+    };
+
+    /*** static function and variable ***/
+    static std::shared_ptr<Admission> Create();
+
+    /*** class function and variable ***/
+    Verdict admit(const std::string& from, const Rpc::Factory::Envelope& envelope);
+    void done();
+
+    static std::atomic<uint64_t> TotalAccepted;
+    static std::atomic<uint64_t> TotalThrottled;
+    static std::atomic<uint64_t> TotalShed;
+
+protected:
+    /*** type define ***/
+
+    /*** static function and variable ***/
+
+    /*** class function and variable ***/
+    explicit Admission() = default;
+    virtual ~Admission() = default;
+
+private:
+    /*** type define ***/
+    using Clock = std::chrono::steady_clock;
+
+    struct MethodClass {
+        int cost;
+        bool sheddable;
+    };
+
+    struct Bucket {
+        double tokens;
+        Clock::time_point refilledAt;
+    };
+
+    /*** static function and variable ***/
+    static MethodClass Classify(const std::string& method);
+    static void Refill(Bucket& bucket, Clock::time_point now);
+
+    static constexpr const double TokensPerSecond = 20;
+    static constexpr const double BucketDepth = 40;
+    static constexpr const int UnboundedFactor = 4;
+    static constexpr const int QueueWatermark = 64;
+    static constexpr const int QueueLimit = 512;
+    static constexpr const size_t MaxBuckets = 1024;
+    static constexpr const long StatsIntervalMS = 60 * 1000;
+
+    /*** class function and variable ***/
+    bool take(const std::string& from, int cost, Clock::time_point now);
+    void evictIdle(Clock::time_point now);
+    void count(Verdict verdict, Clock::time_point now);
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Bucket> buckets;
+    std::atomic<int> pending {0};
+
+    uint64_t accepted = 0;
+    uint64_t throttled = 0;
+    uint64_t shed = 0;
+    int maxPending = 0;
+    Clock::time_point statsSince = Clock::now();
+};
+
+/***********************************************/
+/***** class template function implement *******/
+/***********************************************/
+
+/***********************************************/
+/***** macro definition ************************/
+/***********************************************/
+
+} // namespace trinity
+
+#endif /* _FEEDS_ADMISSION_HPP_ */
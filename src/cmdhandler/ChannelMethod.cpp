@@ -1,11 +1,23 @@
 #include "ChannelMethod.hpp"
 
+#include <climits>
+#include <cstring>
 #include <sstream>
+#include <tuple>
 #include <DataBase.hpp>
 #include <ErrCode.hpp>
 #include <Log.hpp>
 #include <RpcFactory.hpp>
 #include <SafePtr.hpp>
+#include <SearchIndex.hpp>
+
+extern "C" {
+#include <crystal.h>
+#include <avatar.h>
+#include <db.h>
+#include <obj.h>
+#include <rpc.h>
+}
 
 namespace trinity {
 
@@ -16,6 +28,97 @@ namespace trinity {
 /* =========================================== */
 /* === static function implement ============= */
 /* =========================================== */
+// same keyset paging as the legacy lists in db.cpp: order by condBy and the
+// unpinned key columns, and seek strictly past the cursor as a row value.
+int ChannelMethod::AppendKeyset(std::stringstream& sql, const char* condBy, int64_t by,
+                                const std::string& cursor, const std::vector<KeyColumn>& keys)
+{
+    QryCursor after {};
+    if(cursor.empty() == false) {
+        int ret = rpc_decode_cursor(cursor.c_str(), cursor.length(), &after);
+        CHECK_ASSERT(ret == 0 && after.by == static_cast<uint64_t>(by), ErrCode::InvalidArgument);
+    }
+
+    auto order = (by == DataBase::ConditionField::Id ? " ASC" : " DESC");
+    if(after.by != 0) {
+        std::stringstream columns;
+        std::stringstream values;
+        columns << condBy;
+        values << after.val;
+        for(const auto& key: keys) {
+            if(std::strcmp(key.first, condBy) != 0) {
+                columns << ", " << key.first;
+                values << ", " << after.keys[key.second];
+            }
+        }
+        sql << " AND (" << columns.str() << ")";
+        sql << (by == DataBase::ConditionField::Id ? " > (" : " < (") << values.str() << ")";
+    }
+
+    sql << " ORDER BY " << condBy << order;
+    for(const auto& key: keys) {
+        if(std::strcmp(key.first, condBy) != 0) {
+            sql << ", " << key.first << order;
+        }
+    }
+
+    return 0;
+}
+
+std::string ChannelMethod::MakeCursor(int64_t by, int64_t val, const std::vector<int64_t>& keys)
+{
+    QryCursor next {};
+    next.by = by;
+    next.val = val;
+    for(size_t idx = 0; idx < keys.size() && idx < QRY_CURSOR_KEYS; idx++) {
+        next.keys[idx] = keys[idx];
+    }
+
+    char cursor[RPC_CURSOR_LEN];
+    int ret = rpc_encode_cursor(&next, cursor, sizeof(cursor));
+    if(ret < 0) {
+        return "";
+    }
+
+    return cursor;
+}
+
+int ChannelMethod::GetUser(int64_t userId, std::string& did, std::string& name)
+{
+    // served from the users cache in db.cpp, so comment listings need no
+    // join against users.
+    UserInfo* user = nullptr;
+    int ret = db_get_user_by_uid(userId, &user);
+    CHECK_ASSERT(ret == 0, ErrCode::DBException);
+    if(user != nullptr) {
+        did = user->did;
+        name = user->name;
+        deref(user);
+    }
+
+    return 0;
+}
+
+uint64_t ChannelMethod::OmittedFields(const std::optional<std::vector<std::string>>& fields)
+{
+    // no fields means every column, like the legacy list requests. the
+    // same rule as fields_is_valid(): an empty array means no blobs.
+    if(fields.has_value() == false) {
+        return 0;
+    }
+
+    uint64_t omit = QRY_FLDS_BLOBS;
+    for(const auto& field: *fields) {
+        if(field == "content") {
+            omit &= ~QRY_FLD_CONTENT;
+        } else if(field == "thumbnails") {
+            omit &= ~QRY_FLD_THUMBNAILS;
+        }
+    }
+
+    return omit;
+}
+
 
 /* =========================================== */
 /* === class public function implement  ====== */
@@ -27,6 +130,11 @@ ChannelMethod::ChannelMethod()
         {Rpc::Factory::Method::GetMultiComments,  {std::bind(&ChannelMethod::onGetMultiComments, this, _1, _2), Accessible::Member}},
         {Rpc::Factory::Method::GetMultiLikesAndCommentsCount,  {std::bind(&ChannelMethod::onGetMultiLikesAndCommentsCount, this, _1, _2), Accessible::Member}},
         {Rpc::Factory::Method::GetMultiSubscribersCount,  {std::bind(&ChannelMethod::onGetMultiSubscribersCount, this, _1, _2), Accessible::Member}},
+        {Rpc::Factory::Method::GetAvatar,  {std::bind(&ChannelMethod::onGetAvatar, this, _1, _2), Accessible::Member}},
+        {Rpc::Factory::Method::GetChangesSince,  {std::bind(&ChannelMethod::onGetChangesSince, this, _1, _2), Accessible::Member}},
+        {Rpc::Factory::Method::Search,  {std::bind(&ChannelMethod::onSearch, this, _1, _2), Accessible::Member}},
+        {Rpc::Factory::Method::GetTimeline,  {std::bind(&ChannelMethod::onGetTimeline, this, _1, _2), Accessible::Member}},
+        {Rpc::Factory::Method::GetCommentThread,  {std::bind(&ChannelMethod::onGetCommentThread, this, _1, _2), Accessible::Member}},
     };
 
     setHandleMap({}, advancedHandlerMap);
@@ -58,17 +166,26 @@ int ChannelMethod::onGetMultiComments(std::shared_ptr<Rpc::Request> request,
                      && (params.channel_id == 0 && params.post_id > 0) == false);
     CHECK_ASSERT(validArgus, ErrCode::InvalidArgument);
 
+    // omitted blobs are selected as NULL, which reads back as empty.
+    auto omit = OmittedFields(params.fields);
     std::vector<std::function<void()>> sqlBindArray;
     std::stringstream sql;
     sql << " SELECT channel_id, post_id, comment_id, refcomment_id,";
-    sql << " did, name,";
-    sql << " status, likes, created_at, updated_at, content,";
-    sql << " hash_id, proof, thumbnails";  //2.0
-    sql << " FROM comments JOIN users USING (user_id)";
-    params.channel_id > 0 ? (sql << " WHERE channel_id = " << params.channel_id)
-                          : (sql << " WHERE channel_id = " << "channel_id");
-    params.post_id > 0 ? (sql << " AND post_id = " << params.post_id)
-                       : (sql << " AND post_id = " << "post_id");
+    sql << " user_id,";
+    sql << " status, likes, created_at, updated_at,";
+    sql << (qry_omits(omit, QRY_FLD_CONTENT) ? " NULL," : " content,");
+    sql << " hash_id, proof,";
+    sql << (qry_omits(omit, QRY_FLD_THUMBNAILS) ? " NULL" : " thumbnails");  //2.0
+    sql << " FROM comments";
+    sql << " WHERE true";
+    // leave unset keys out instead of "channel_id = channel_id", which
+    // would hide the index from the planner.
+    if(params.channel_id > 0) {
+        sql << " AND channel_id = " << params.channel_id;
+    }
+    if(params.post_id > 0) {
+        sql << " AND post_id = " << params.post_id;
+    }
 
     auto condBy = DataBase::ConditionBy(static_cast<DataBase::ConditionField>(params.by), DataBase::ConditionIdType::Comment);
     if(condBy != nullptr) {
@@ -78,8 +195,19 @@ int ChannelMethod::onGetMultiComments(std::shared_ptr<Rpc::Request> request,
         if(params.upper_bound > 0) {
             sql << " AND " << condBy << " <= " << params.upper_bound;
         }
-        sql << " ORDER BY " << condBy << (params.by == DataBase::ConditionField::Id ? " ASC" : " DESC");
+
+        std::vector<KeyColumn> keys;
+        if(params.channel_id <= 0) {
+            keys.push_back({"channel_id", 0});
+        }
+        if(params.post_id <= 0) {
+            keys.push_back({"post_id", 1});
+        }
+        keys.push_back({"comment_id", 2});
+        int ret = AppendKeyset(sql, condBy, params.by, params.cursor, keys);
+        CHECK_ERROR(ret);
     }
+    CHECK_ASSERT(params.cursor.empty() == true || condBy != nullptr, ErrCode::InvalidArgument);
     if (params.max_count > 0) {
         sql << " LIMIT " << params.max_count;
     }
@@ -96,6 +224,9 @@ int ChannelMethod::onGetMultiComments(std::shared_ptr<Rpc::Request> request,
     };
 
     std::shared_ptr<Rpc::GetMultiCommentsResponse> response;
+    int64_t rows = 0;
+    int64_t lastVal = 0;
+    std::vector<int64_t> lastKeys;
     auto commentsSize = sizeof(Rpc::GetMultiCommentsResponse);
     DataBase::Step step = [&](SQLite::Statement& stmt) -> int {
         Rpc::GetMultiCommentsResponse::Result::Comment comment;
@@ -103,22 +234,23 @@ int ChannelMethod::onGetMultiComments(std::shared_ptr<Rpc::Request> request,
         comment.post_id = stmt.getColumn(1).getInt64();
         comment.comment_id = stmt.getColumn(2).getInt64();
         comment.refer_comment_id = stmt.getColumn(3).getInt64();
-        comment.user_did = stmt.getColumn(4).getString();
-        comment.user_name = stmt.getColumn(5).getString();
-        comment.status = stmt.getColumn(6).getInt64();
-        comment.likes = stmt.getColumn(7).getInt64();
-        comment.created_at = stmt.getColumn(8).getInt64();
-        comment.updated_at = stmt.getColumn(9).getInt64();
+        int ret = GetUser(stmt.getColumn(4).getInt64(), comment.user_did, comment.user_name);
+        CHECK_ERROR(ret);
+        comment.status = stmt.getColumn(5).getInt64();
+        comment.likes = stmt.getColumn(6).getInt64();
+        comment.created_at = stmt.getColumn(7).getInt64();
+        comment.updated_at = stmt.getColumn(8).getInt64();
         comment.content = std::move(std::vector<uint8_t> {
-            (uint8_t*)stmt.getColumn(10).getBlob(),
-            (uint8_t*)stmt.getColumn(10).getBlob() + stmt.getColumn(10).getBytes()
+            (uint8_t*)stmt.getColumn(9).getBlob(),
+            (uint8_t*)stmt.getColumn(9).getBlob() + stmt.getColumn(9).getBytes()
         });
-        comment.hash_id = stmt.getColumn(11).getString();  //2.0
-        comment.proof = stmt.getColumn(12).getString();  //2.0
+        comment.hash_id = stmt.getColumn(10).getString();  //2.0
+        comment.proof = stmt.getColumn(11).getString();  //2.0
         comment.thumbnails = std::move(std::vector<uint8_t> {  //2.0
-            (uint8_t*)stmt.getColumn(13).getBlob(),
-            (uint8_t*)stmt.getColumn(13).getBlob() + stmt.getColumn(13).getBytes()
+            (uint8_t*)stmt.getColumn(12).getBlob(),
+            (uint8_t*)stmt.getColumn(12).getBlob() + stmt.getColumn(12).getBytes()
         });
+        comment.omit_content = qry_omits(omit, QRY_FLD_CONTENT);
 
         commentsSize += sizeof(comment)
                      - sizeof(comment.user_did) + comment.user_did.length()
@@ -128,6 +260,12 @@ int ChannelMethod::onGetMultiComments(std::shared_ptr<Rpc::Request> request,
                      - sizeof(comment.proof) + comment.proof.length()  //2.0
                      - sizeof(comment.thumbnails) + comment.thumbnails.size();  //2.0
 
+        rows++;
+        lastVal = (params.by == DataBase::ConditionField::Id ? comment.comment_id
+                 : params.by == DataBase::ConditionField::UpdatedAt ? comment.updated_at
+                 : comment.created_at);
+        lastKeys = {comment.channel_id, comment.post_id, comment.comment_id};
+
         if(response == nullptr) {
             response = makeResponse();
             CHECK_ASSERT(response != nullptr, ErrCode::RpcUnimplementedError);
@@ -155,6 +293,9 @@ int ChannelMethod::onGetMultiComments(std::shared_ptr<Rpc::Request> request,
 
     // push last response or empty response
     response->result.is_last = true;
+    if(condBy != nullptr && params.max_count > 0 && rows >= params.max_count) {
+        response->result.next_cursor = MakeCursor(params.by, lastVal, lastKeys);
+    }
     responseArray.push_back(response);
 
     return 0;
@@ -176,12 +317,16 @@ int ChannelMethod::onGetMultiLikesAndCommentsCount(std::shared_ptr<Rpc::Request>
 
     std::vector<std::function<void()>> sqlBindArray;
     std::stringstream sql;
-    sql << " SELECT channel_id, post_id, next_comment_id - 1 AS comments, likes";
+    sql << " SELECT channel_id, post_id, next_comment_id - 1 AS comments, likes,";
+    sql << " created_at, updated_at";
     sql << " FROM posts";
-    params.channel_id > 0 ? (sql << " WHERE channel_id = " << params.channel_id)
-                          : (sql << " WHERE channel_id = " << "channel_id");
-    params.post_id > 0 ? (sql << " AND post_id = " << params.post_id)
-                       : (sql << " AND post_id = " << "post_id");
+    sql << " WHERE true";
+    if(params.channel_id > 0) {
+        sql << " AND channel_id = " << params.channel_id;
+    }
+    if(params.post_id > 0) {
+        sql << " AND post_id = " << params.post_id;
+    }
 
     auto condBy = DataBase::ConditionBy(static_cast<DataBase::ConditionField>(params.by), DataBase::ConditionIdType::Post);
     if(condBy != nullptr) {
@@ -191,8 +336,16 @@ int ChannelMethod::onGetMultiLikesAndCommentsCount(std::shared_ptr<Rpc::Request>
         if(params.upper_bound > 0) {
             sql << " AND " << condBy << " <= " << params.upper_bound;
         }
-        sql << " ORDER BY " << condBy << (params.by == DataBase::ConditionField::Id ? " ASC" : " DESC");
+
+        std::vector<KeyColumn> keys;
+        if(params.channel_id <= 0) {
+            keys.push_back({"channel_id", 0});
+        }
+        keys.push_back({"post_id", 1});
+        int ret = AppendKeyset(sql, condBy, params.by, params.cursor, keys);
+        CHECK_ERROR(ret);
     }
+    CHECK_ASSERT(params.cursor.empty() == true || condBy != nullptr, ErrCode::InvalidArgument);
     if (params.max_count > 0) {
         sql << " LIMIT " << params.max_count;
     }
@@ -209,6 +362,9 @@ int ChannelMethod::onGetMultiLikesAndCommentsCount(std::shared_ptr<Rpc::Request>
     };
 
     std::shared_ptr<Rpc::GetMultiLikesAndCommentsCountResponse> response;
+    int64_t rows = 0;
+    int64_t lastVal = 0;
+    std::vector<int64_t> lastKeys;
     auto postsSize = sizeof(Rpc::GetMultiLikesAndCommentsCountResponse);
     DataBase::Step step = [&](SQLite::Statement& stmt) -> int {
         Rpc::GetMultiLikesAndCommentsCountResponse::Result::Post post;
@@ -219,6 +375,12 @@ int ChannelMethod::onGetMultiLikesAndCommentsCount(std::shared_ptr<Rpc::Request>
 
         postsSize += sizeof(post);
 
+        rows++;
+        lastVal = (params.by == DataBase::ConditionField::Id ? post.post_id
+                 : params.by == DataBase::ConditionField::UpdatedAt ? stmt.getColumn(5).getInt64()
+                 : stmt.getColumn(4).getInt64());
+        lastKeys = {post.channel_id, post.post_id};
+
         if(response == nullptr) {
             response = makeResponse();
             CHECK_ASSERT(response != nullptr, ErrCode::RpcUnimplementedError);
@@ -246,6 +408,9 @@ int ChannelMethod::onGetMultiLikesAndCommentsCount(std::shared_ptr<Rpc::Request>
 
     // push last response or empty response
     response->result.is_last = true;
+    if(condBy != nullptr && params.max_count > 0 && rows >= params.max_count) {
+        response->result.next_cursor = MakeCursor(params.by, lastVal, lastKeys);
+    }
     responseArray.push_back(response);
 
     return 0;
@@ -265,10 +430,11 @@ int ChannelMethod::onGetMultiSubscribersCount(std::shared_ptr<Rpc::Request> requ
 
     std::vector<std::function<void()>> sqlBindArray;
     std::stringstream sql;
-    sql << " SELECT channel_id, subscribers";
+    sql << " SELECT channel_id";
     sql << " FROM channels";
-    params.channel_id > 0 ? (sql << " WHERE channel_id = " << params.channel_id)
-                          : (sql << " WHERE channel_id = " << "channel_id");
+    if(params.channel_id > 0) {
+        sql << " WHERE channel_id = " << params.channel_id;
+    }
     sql << ";";
 
     auto makeResponse = [&]() -> std::shared_ptr<Rpc::GetMultiSubscribersCountResponse> {
@@ -286,7 +452,11 @@ int ChannelMethod::onGetMultiSubscribersCount(std::shared_ptr<Rpc::Request> requ
     DataBase::Step step = [&](SQLite::Statement& stmt) -> int {
         Rpc::GetMultiSubscribersCountResponse::Result::Channel channel;
         channel.channel_id = stmt.getColumn(0).getInt64();
-        channel.subscribers_count = stmt.getColumn(1).getInt64();
+        // counted from the in-memory subscriber set of the channel
+        uint64_t subscribers = 0;
+        int ret = db_suber_count(channel.channel_id, &subscribers);
+        CHECK_ASSERT(ret == 0, ErrCode::DBException);
+        channel.subscribers_count = subscribers;
 
         channelsSize += sizeof(channel);
 
@@ -322,4 +492,623 @@ int ChannelMethod::onGetMultiSubscribersCount(std::shared_ptr<Rpc::Request> requ
     return 0;
 }
 
+int ChannelMethod::onGetAvatar(std::shared_ptr<Rpc::Request> request,
+                               std::vector<std::shared_ptr<Rpc::Response>> &responseArray)
+{
+    auto requestPtr = std::dynamic_pointer_cast<Rpc::GetAvatarRequest>(request);
+    CHECK_ASSERT(requestPtr != nullptr, ErrCode::InvalidArgument);
+    const auto& params = requestPtr->params;
+    responseArray.clear();
+
+    // did is embedded into sql, only accept did characters.
+    bool validDid = params.user_did.empty() == false
+                 && params.user_did.find_first_not_of("abcdefghijklmnopqrstuvwxyz"
+                                                      "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                                      "0123456789:") == std::string::npos;
+    bool validArgus = ( params.access_token.empty() == false
+                     && (params.channel_id > 0 || validDid)
+                     && (params.avatar_hash.empty() == true
+                         || avatar_hash_is_valid(params.avatar_hash.c_str())));
+    CHECK_ASSERT(validArgus, ErrCode::InvalidArgument);
+
+    // the blob is only read out when the client copy is stale.
+    std::stringstream sql;
+    sql << " SELECT hash,";
+    sql << " CASE WHEN hash = '" << params.avatar_hash << "' THEN NULL ELSE avatar END";
+    sql << " FROM avatars";
+    params.channel_id > 0 ? (sql << " WHERE hash = (SELECT avatar FROM channels WHERE channel_id = " << params.channel_id << ")")
+                          : (sql << " WHERE hash = (SELECT avatar FROM users WHERE did = '" << params.user_did << "')");
+    sql << ";";
+
+    auto responsePtr = Rpc::Factory::MakeResponse(request->method);
+    auto response = std::dynamic_pointer_cast<Rpc::GetAvatarResponse>(responsePtr);
+    CHECK_ASSERT(response != nullptr, ErrCode::RpcUnimplementedError);
+    response->version = request->version;
+    response->id = request->id;
+
+    bool found = false;
+    DataBase::Step step = [&](SQLite::Statement& stmt) -> int {
+        response->result.avatar_hash = stmt.getColumn(0).getString();
+        response->result.not_modified = stmt.getColumn(1).isNull();
+        if(response->result.not_modified == false) {
+            response->result.avatar = std::move(std::vector<uint8_t> {
+                (uint8_t*)stmt.getColumn(1).getBlob(),
+                (uint8_t*)stmt.getColumn(1).getBlob() + stmt.getColumn(1).getBytes()
+            });
+        }
+        found = true;
+
+        return 0;
+    };
+
+    int ret = DataBase::GetInstance()->executeStep(sql.str(), step);
+    CHECK_ERROR(ret);
+    CHECK_ASSERT(found, ErrCode::NotFoundError);
+
+    responseArray.push_back(response);
+
+    return 0;
+}
+
+int ChannelMethod::onGetChangesSince(std::shared_ptr<Rpc::Request> request,
+                                     std::vector<std::shared_ptr<Rpc::Response>> &responseArray)
+{
+    auto requestPtr = std::dynamic_pointer_cast<Rpc::GetChangesSinceRequest>(request);
+    CHECK_ASSERT(requestPtr != nullptr, ErrCode::InvalidArgument);
+    const auto& params = requestPtr->params;
+    responseArray.clear();
+
+    bool validArgus = ( params.access_token.empty() == false
+                     && params.cursor >= 0);
+    for(auto channelId: params.channels) {
+        validArgus = validArgus && channelId > 0;
+    }
+    CHECK_ASSERT(validArgus, ErrCode::InvalidArgument);
+
+    // the journal is trimmed as a prefix, so every seq below the oldest row
+    // - or up to the last seq handed out once it is empty - is gone, and a
+    // client whose cursor is below that has to fall back to a full resync.
+    bool reset = false;
+    std::stringstream sqlReset;
+    sqlReset << " SELECT COALESCE((SELECT MIN(seq) - 1 FROM changes),";
+    sqlReset << "   (SELECT seq FROM sqlite_sequence WHERE name = 'changes'), 0);";
+    DataBase::Step stepReset = [&](SQLite::Statement& stmt) -> int {
+        reset = (params.cursor < stmt.getColumn(0).getInt64());
+        return 0;
+    };
+    int ret = DataBase::GetInstance()->executeStep(sqlReset.str(), stepReset);
+    CHECK_ERROR(ret);
+
+    std::stringstream sql;
+    sql << " SELECT seq, kind, channel_id, post_id, comment_id, created_at";
+    sql << " FROM changes";
+    sql << " WHERE seq > " << params.cursor;
+    if(params.channels.empty() == false) {
+        // one channel is a range of (channel_id, seq), several would have to
+        // be sorted, so walk the journal in seq order and filter instead.
+        sql << (params.channels.size() > 1 ? " AND +channel_id IN (" : " AND channel_id IN (");
+        for(size_t idx = 0; idx < params.channels.size(); idx++) {
+            sql << (idx > 0 ? ", " : "") << params.channels[idx];
+        }
+        sql << ")";
+    }
+    sql << " ORDER BY seq ASC";
+    if (params.max_count > 0) {
+        sql << " LIMIT " << params.max_count;
+    }
+    sql << ";";
+
+    auto makeResponse = [&]() -> std::shared_ptr<Rpc::GetChangesSinceResponse> {
+        auto responsePtr = Rpc::Factory::MakeResponse(request->method);
+        auto response = std::dynamic_pointer_cast<Rpc::GetChangesSinceResponse>(responsePtr);
+        if(response != nullptr) {
+            response->version = request->version;
+            response->id = request->id;
+            response->result.reset = reset;
+            response->result.cursor = params.cursor;
+        }
+        return response;
+    };
+
+    std::shared_ptr<Rpc::GetChangesSinceResponse> response;
+    auto changesSize = sizeof(Rpc::GetChangesSinceResponse);
+    int64_t cursor = params.cursor;
+    DataBase::Step step = [&](SQLite::Statement& stmt) -> int {
+        Rpc::GetChangesSinceResponse::Result::Change change;
+        change.seq = stmt.getColumn(0).getInt64();
+        change.kind = stmt.getColumn(1).getInt64();
+        change.channel_id = stmt.getColumn(2).getInt64();
+        change.post_id = stmt.getColumn(3).getInt64();
+        change.comment_id = stmt.getColumn(4).getInt64();
+        change.created_at = stmt.getColumn(5).getInt64();
+        cursor = change.seq;
+
+        changesSize += sizeof(change);
+
+        if(response == nullptr) {
+            response = makeResponse();
+            CHECK_ASSERT(response != nullptr, ErrCode::RpcUnimplementedError);
+        }
+        response->result.changes.push_back(std::move(change));
+        response->result.cursor = cursor;
+        if(changesSize >= Rpc::Factory::MaxAvailableSize) {
+            responseArray.push_back(response);
+            response.reset();
+            changesSize = sizeof(Rpc::GetChangesSinceResponse);
+        }
+
+        return 0;
+    };
+
+    ret = DataBase::GetInstance()->executeStep(sql.str(), step);
+    if(ret < 0) {
+        responseArray.clear();
+    }
+    CHECK_ERROR(ret);
+
+    if(response == nullptr) {
+        response = makeResponse();
+        CHECK_ASSERT(response != nullptr, ErrCode::RpcUnimplementedError);
+        response->result.cursor = cursor;
+    }
+
+    // push last response or empty response
+    response->result.is_last = true;
+    responseArray.push_back(response);
+
+    return 0;
+}
+
+int ChannelMethod::onSearch(std::shared_ptr<Rpc::Request> request,
+                            std::vector<std::shared_ptr<Rpc::Response>> &responseArray)
+{
+    auto requestPtr = std::dynamic_pointer_cast<Rpc::SearchRequest>(request);
+    CHECK_ASSERT(requestPtr != nullptr, ErrCode::InvalidArgument);
+    const auto& params = requestPtr->params;
+    responseArray.clear();
+
+    auto query = SearchIndex::MakeQuery(params.keywords);
+    bool validArgus = ( params.access_token.empty() == false
+                     && query.empty() == false
+                     && params.channel_id >= 0);
+    CHECK_ASSERT(validArgus, ErrCode::InvalidArgument);
+
+    // keyset pagination on (rank, doc_id), the client passes back the last
+    // hit it received as after_rank/after_id.
+    std::stringstream sql;
+    sql << " SELECT channel_id, post_id, comment_id, search_index.rank, doc_id";
+    sql << " FROM search_index JOIN search_docs ON doc_id = search_index.rowid";
+    sql << " WHERE search_index MATCH :query";
+    if(params.channel_id > 0) {
+        sql << " AND channel_id = " << params.channel_id;
+    }
+    if(params.after_id > 0) {
+        sql << " AND (search_index.rank > :after_rank";
+        sql << " OR (search_index.rank = :after_rank AND doc_id > " << params.after_id << "))";
+    }
+    sql << " ORDER BY search_index.rank ASC, doc_id ASC";
+    if (params.max_count > 0) {
+        sql << " LIMIT " << params.max_count;
+    }
+    sql << ";";
+
+    DataBase::Bind bind = [&](SQLite::Statement& stmt) {
+        stmt.bind(":query", query);
+        if(params.after_id > 0) {
+            stmt.bind(":after_rank", params.after_rank);
+        }
+    };
+
+    auto makeResponse = [&]() -> std::shared_ptr<Rpc::SearchResponse> {
+        auto responsePtr = Rpc::Factory::MakeResponse(request->method);
+        auto response = std::dynamic_pointer_cast<Rpc::SearchResponse>(responsePtr);
+        if(response != nullptr) {
+            response->version = request->version;
+            response->id = request->id;
+        }
+        return response;
+    };
+
+    std::shared_ptr<Rpc::SearchResponse> response;
+    auto hitsSize = sizeof(Rpc::SearchResponse);
+    DataBase::Step step = [&](SQLite::Statement& stmt) -> int {
+        Rpc::SearchResponse::Result::Hit hit;
+        hit.channel_id = stmt.getColumn(0).getInt64();
+        hit.post_id = stmt.getColumn(1).getInt64();
+        hit.comment_id = stmt.getColumn(2).getInt64();
+        hit.rank = stmt.getColumn(3).getDouble();
+        hit.doc_id = stmt.getColumn(4).getInt64();
+
+        hitsSize += sizeof(hit);
+
+        if(response == nullptr) {
+            response = makeResponse();
+            CHECK_ASSERT(response != nullptr, ErrCode::RpcUnimplementedError);
+        }
+        response->result.hits.push_back(std::move(hit));
+        if(hitsSize >= Rpc::Factory::MaxAvailableSize) {
+            responseArray.push_back(response);
+            response.reset();
+            hitsSize = sizeof(Rpc::SearchResponse);
+        }
+
+        return 0;
+    };
+
+    int ret = DataBase::GetInstance()->executeStep(sql.str(), bind, step);
+    if(ret < 0) {
+        responseArray.clear();
+    }
+    CHECK_ERROR(ret);
+
+    if(response == nullptr) {
+        response = makeResponse();
+        CHECK_ASSERT(response != nullptr, ErrCode::RpcUnimplementedError);
+    }
+
+    // push last response or empty response
+    response->result.is_last = true;
+    responseArray.push_back(response);
+
+    return 0;
+}
+
+int ChannelMethod::onGetTimeline(std::shared_ptr<Rpc::Request> request,
+                                 std::vector<std::shared_ptr<Rpc::Response>> &responseArray)
+{
+    auto requestPtr = std::dynamic_pointer_cast<Rpc::GetTimelineRequest>(request);
+    CHECK_ASSERT(requestPtr != nullptr, ErrCode::InvalidArgument);
+    const auto& params = requestPtr->params;
+    responseArray.clear();
+
+    bool validArgus = ( params.access_token.empty() == false
+                     && params.max_count > 0);
+    CHECK_ASSERT(validArgus, ErrCode::InvalidArgument);
+
+    // the timeline is ordered by (created_at, channel_id, post_id), newest
+    // first, and the cursor holds that tuple for the last post sent.
+    QryCursor after {};
+    if(params.cursor.empty() == false) {
+        int ret = rpc_decode_cursor(params.cursor.c_str(), params.cursor.length(), &after);
+        CHECK_ASSERT(ret == 0 && after.by == DataBase::ConditionField::CreatedAt, ErrCode::InvalidArgument);
+    }
+
+    std::shared_ptr<UserInfo> userInfo;
+    int ret = getUserInfo(params.access_token, userInfo);
+    CHECK_ERROR(ret);
+
+    // channels with a materialized timeline are served from the timeline
+    // table, the others (too many subscribers, or not posted to since the
+    // table exists) are merged in from posts.
+    std::vector<int64_t> channels;
+    std::stringstream sqlChannels;
+    sqlChannels << " SELECT s.channel_id";
+    sqlChannels << " FROM subscriptions s LEFT JOIN timeline_channels t ON t.channel_id = s.channel_id";
+    sqlChannels << " WHERE s.user_id = " << userInfo->uid;
+    sqlChannels << " AND IFNULL(t.fanout, 0) = 0";
+    sqlChannels << ";";
+    DataBase::Step stepChannels = [&](SQLite::Statement& stmt) -> int {
+        channels.push_back(stmt.getColumn(0).getInt64());
+        return 0;
+    };
+    ret = DataBase::GetInstance()->executeStep(sqlChannels.str(), stepChannels);
+    CHECK_ERROR(ret);
+
+    std::stringstream columns;
+    columns << " SELECT p.channel_id, p.post_id, p.status, p.created_at, p.updated_at,";
+    columns << " p.next_comment_id - 1 AS comments, p.likes, p.hash_id, p.proof, p.origin_post_url,";
+    columns << " p.content, p.thumbnails";
+
+    // a single range read of the (user_id, created_at, channel_id, post_id)
+    // primary key.
+    std::stringstream sqlTimeline;
+    sqlTimeline << columns.str();
+    sqlTimeline << " FROM timeline t JOIN posts p ON p.channel_id = t.channel_id AND p.post_id = t.post_id";
+    sqlTimeline << " WHERE t.user_id = " << userInfo->uid;
+    sqlTimeline << " AND p.status = " << POST_AVAILABLE;
+    if(after.by != 0) {
+        sqlTimeline << " AND (t.created_at, t.channel_id, t.post_id) < (:created_at, :channel_id, :post_id)";
+    }
+    sqlTimeline << " ORDER BY t.created_at DESC, t.channel_id DESC, t.post_id DESC";
+    sqlTimeline << " LIMIT " << params.max_count;
+    sqlTimeline << ";";
+
+    // one index seek per channel on (channel_id, created_at, post_id). The
+    // cursor splits into a per-channel (created_at, post_id) bound: channels
+    // ordered before the cursor's channel still owe posts at its created_at,
+    // the ones after it do not.
+    std::stringstream sql;
+    sql << columns.str();
+    sql << " FROM posts p";
+    sql << " WHERE p.channel_id = :channel_id";
+    sql << " AND p.status = " << POST_AVAILABLE;
+    if(after.by != 0) {
+        sql << " AND (p.created_at, p.post_id) < (:created_at, :post_id)";
+    }
+    sql << " ORDER BY p.created_at DESC, p.post_id DESC";
+    sql << " LIMIT " << params.max_count;
+    sql << ";";
+
+    std::vector<DataBase::Query> queryArray;
+    queryArray.emplace_back(sqlTimeline.str(), [&after](SQLite::Statement& stmt) {
+        if(after.by == 0) {
+            return;
+        }
+        stmt.bind(":created_at", static_cast<int64_t>(after.val));
+        stmt.bind(":channel_id", static_cast<int64_t>(after.keys[0]));
+        stmt.bind(":post_id", static_cast<int64_t>(after.keys[1]));
+    });
+    for(auto channelId: channels) {
+        queryArray.emplace_back(sql.str(), [&after, channelId](SQLite::Statement& stmt) {
+            stmt.bind(":channel_id", channelId);
+            if(after.by == 0) {
+                return;
+            }
+            auto afterChannel = static_cast<int64_t>(after.keys[0]);
+            int64_t afterPost = (channelId < afterChannel ? INT64_MAX
+                                 : channelId > afterChannel ? 0
+                                 : static_cast<int64_t>(after.keys[1]));
+            stmt.bind(":created_at", static_cast<int64_t>(after.val));
+            stmt.bind(":post_id", afterPost);
+        });
+    }
+
+    DataBase::Before before = [](SQLite::Statement& lhs, SQLite::Statement& rhs) -> bool {
+        return std::make_tuple(lhs.getColumn(3).getInt64(), lhs.getColumn(0).getInt64(), lhs.getColumn(1).getInt64())
+             > std::make_tuple(rhs.getColumn(3).getInt64(), rhs.getColumn(0).getInt64(), rhs.getColumn(1).getInt64());
+    };
+
+    auto makeResponse = [&]() -> std::shared_ptr<Rpc::GetTimelineResponse> {
+        auto responsePtr = Rpc::Factory::MakeResponse(request->method);
+        auto response = std::dynamic_pointer_cast<Rpc::GetTimelineResponse>(responsePtr);
+        if(response != nullptr) {
+            response->version = request->version;
+            response->id = request->id;
+        }
+        return response;
+    };
+
+    std::shared_ptr<Rpc::GetTimelineResponse> response;
+    int64_t rows = 0;
+    QryCursor next {};
+    auto postsSize = sizeof(Rpc::GetTimelineResponse);
+    DataBase::Step step = [&](SQLite::Statement& stmt) -> int {
+        Rpc::GetTimelineResponse::Result::Post post;
+        post.channel_id = stmt.getColumn(0).getInt64();
+        post.post_id = stmt.getColumn(1).getInt64();
+        post.status = stmt.getColumn(2).getInt64();
+        post.created_at = stmt.getColumn(3).getInt64();
+        post.updated_at = stmt.getColumn(4).getInt64();
+        post.comments = stmt.getColumn(5).getInt64();
+        post.likes = stmt.getColumn(6).getInt64();
+        post.hash_id = stmt.getColumn(7).getString();
+        post.proof = stmt.getColumn(8).getString();
+        post.origin_post_url = stmt.getColumn(9).getString();
+        post.content = std::move(std::vector<uint8_t> {
+            (uint8_t*)stmt.getColumn(10).getBlob(),
+            (uint8_t*)stmt.getColumn(10).getBlob() + stmt.getColumn(10).getBytes()
+        });
+        post.thumbnails = std::move(std::vector<uint8_t> {
+            (uint8_t*)stmt.getColumn(11).getBlob(),
+            (uint8_t*)stmt.getColumn(11).getBlob() + stmt.getColumn(11).getBytes()
+        });
+
+        postsSize += sizeof(post)
+                  - sizeof(post.content) + post.content.size()
+                  - sizeof(post.thumbnails) + post.thumbnails.size()
+                  - sizeof(post.hash_id) + post.hash_id.length()
+                  - sizeof(post.proof) + post.proof.length()
+                  - sizeof(post.origin_post_url) + post.origin_post_url.length();
+
+        rows++;
+        next.by = DataBase::ConditionField::CreatedAt;
+        next.val = post.created_at;
+        next.keys[0] = post.channel_id;
+        next.keys[1] = post.post_id;
+
+        if(response == nullptr) {
+            response = makeResponse();
+            CHECK_ASSERT(response != nullptr, ErrCode::RpcUnimplementedError);
+        }
+        response->result.posts.push_back(std::move(post));
+        if(postsSize >= Rpc::Factory::MaxAvailableSize) {
+            responseArray.push_back(response);
+            response.reset();
+            postsSize = sizeof(Rpc::GetTimelineResponse);
+        }
+
+        return 0;
+    };
+
+    ret = DataBase::GetInstance()->executeMerge(queryArray, before, params.max_count, step);
+    if(ret < 0) {
+        responseArray.clear();
+    }
+    CHECK_ERROR(ret);
+
+    if(response == nullptr) {
+        response = makeResponse();
+        CHECK_ASSERT(response != nullptr, ErrCode::RpcUnimplementedError);
+    }
+
+    // push last response or empty response
+    response->result.is_last = true;
+    if(rows >= params.max_count) {
+        response->result.next_cursor = MakeCursor(next.by, next.val, {
+            static_cast<int64_t>(next.keys[0]), static_cast<int64_t>(next.keys[1])
+        });
+    }
+    responseArray.push_back(response);
+
+    return 0;
+}
+
+int ChannelMethod::onGetCommentThread(std::shared_ptr<Rpc::Request> request,
+                                      std::vector<std::shared_ptr<Rpc::Response>> &responseArray)
+{
+    auto requestPtr = std::dynamic_pointer_cast<Rpc::GetCommentThreadRequest>(request);
+    CHECK_ASSERT(requestPtr != nullptr, ErrCode::InvalidArgument);
+    const auto& params = requestPtr->params;
+    responseArray.clear();
+
+    bool validArgus = ( params.access_token.empty() == false
+                     && params.channel_id > 0
+                     && params.post_id > 0
+                     && params.comment_id >= 0);
+    CHECK_ASSERT(validArgus, ErrCode::InvalidArgument);
+
+    // direct replies of comment_id (0 for the top level), each with its reply
+    // count and, if asked, its first replies. Both levels are range reads of
+    // (channel_id, post_id, refcomment_id, comment_id), so a deep or long
+    // thread is loaded a page and a level at a time.
+    std::stringstream columns;
+    columns << " SELECT channel_id, post_id, comment_id, refcomment_id,";
+    columns << " user_id,";
+    columns << " status, likes, created_at, updated_at, content,";
+    columns << " hash_id, proof, thumbnails,";
+    columns << " (SELECT COUNT(*) FROM comments r";
+    columns << "  WHERE r.channel_id = c.channel_id AND r.post_id = c.post_id";
+    columns << "  AND r.refcomment_id = c.comment_id) AS reply_count";
+    columns << " FROM comments c";
+    columns << " WHERE channel_id = " << params.channel_id;
+    columns << " AND post_id = " << params.post_id;
+
+    std::stringstream sql;
+    sql << columns.str();
+    sql << " AND refcomment_id = " << params.comment_id;
+    int ret = AppendKeyset(sql, "comment_id", DataBase::ConditionField::Id, params.cursor, {{"comment_id", 2}});
+    CHECK_ERROR(ret);
+    if (params.max_count > 0) {
+        sql << " LIMIT " << params.max_count;
+    }
+    sql << ";";
+
+    std::stringstream sqlReplies;
+    sqlReplies << columns.str();
+    sqlReplies << " AND refcomment_id = :refcomment_id";
+    sqlReplies << " ORDER BY comment_id ASC";
+    sqlReplies << " LIMIT " << params.replies;
+    sqlReplies << ";";
+
+    std::vector<Rpc::GetCommentThreadResponse::Result::Comment> comments;
+    DataBase::Step step = [&](SQLite::Statement& stmt) -> int {
+        Rpc::GetCommentThreadResponse::Result::Comment comment;
+        comment.channel_id = stmt.getColumn(0).getInt64();
+        comment.post_id = stmt.getColumn(1).getInt64();
+        comment.comment_id = stmt.getColumn(2).getInt64();
+        comment.refer_comment_id = stmt.getColumn(3).getInt64();
+        int ret = GetUser(stmt.getColumn(4).getInt64(), comment.user_did, comment.user_name);
+        CHECK_ERROR(ret);
+        comment.status = stmt.getColumn(5).getInt64();
+        comment.likes = stmt.getColumn(6).getInt64();
+        comment.created_at = stmt.getColumn(7).getInt64();
+        comment.updated_at = stmt.getColumn(8).getInt64();
+        comment.content = std::move(std::vector<uint8_t> {
+            (uint8_t*)stmt.getColumn(9).getBlob(),
+            (uint8_t*)stmt.getColumn(9).getBlob() + stmt.getColumn(9).getBytes()
+        });
+        comment.hash_id = stmt.getColumn(10).getString();
+        comment.proof = stmt.getColumn(11).getString();
+        comment.thumbnails = std::move(std::vector<uint8_t> {
+            (uint8_t*)stmt.getColumn(12).getBlob(),
+            (uint8_t*)stmt.getColumn(12).getBlob() + stmt.getColumn(12).getBytes()
+        });
+        comment.reply_count = stmt.getColumn(13).getInt64();
+
+        comments.push_back(std::move(comment));
+        return 0;
+    };
+
+    ret = DataBase::GetInstance()->executeStep(sql.str(), step);
+    CHECK_ERROR(ret);
+    int64_t rows = comments.size();
+    int64_t lastId = (rows > 0 ? comments.back().comment_id : 0);
+
+    // replies follow their parent, clients attach them by refer_comment_id.
+    std::vector<std::vector<Rpc::GetCommentThreadResponse::Result::Comment>> repliesArray(rows);
+    for(int64_t idx = 0; idx < rows && params.replies > 0; idx++) {
+        if(comments[idx].reply_count <= 0) {
+            continue;
+        }
+
+        auto parentId = comments[idx].comment_id;
+        DataBase::Bind bind = [&](SQLite::Statement& stmt) {
+            stmt.bind(":refcomment_id", parentId);
+        };
+        auto parentEnd = comments.size();
+        ret = DataBase::GetInstance()->executeStep(sqlReplies.str(), bind, step);
+        CHECK_ERROR(ret);
+
+        repliesArray[idx].assign(std::make_move_iterator(comments.begin() + parentEnd),
+                                 std::make_move_iterator(comments.end()));
+        comments.resize(parentEnd);
+        // the count and the page are separate reads, so a reply deleted in
+        // between can leave the page empty; replies always sort after their
+        // parent, so the parent's id starts the listing from the top then.
+        if(comments[idx].reply_count > static_cast<int64_t>(repliesArray[idx].size())) {
+            auto afterId = (repliesArray[idx].empty() == false ? repliesArray[idx].back().comment_id : parentId);
+            comments[idx].replies_cursor = MakeCursor(DataBase::ConditionField::Id, afterId, {});
+        }
+    }
+
+    auto makeResponse = [&]() -> std::shared_ptr<Rpc::GetCommentThreadResponse> {
+        auto responsePtr = Rpc::Factory::MakeResponse(request->method);
+        auto response = std::dynamic_pointer_cast<Rpc::GetCommentThreadResponse>(responsePtr);
+        if(response != nullptr) {
+            response->version = request->version;
+            response->id = request->id;
+        }
+        return response;
+    };
+
+    std::shared_ptr<Rpc::GetCommentThreadResponse> response;
+    auto commentsSize = sizeof(Rpc::GetCommentThreadResponse);
+    auto pushComment = [&](Rpc::GetCommentThreadResponse::Result::Comment& comment) -> int {
+        commentsSize += sizeof(comment)
+                     - sizeof(comment.user_did) + comment.user_did.length()
+                     - sizeof(comment.user_name) + comment.user_name.length()
+                     - sizeof(comment.content) + comment.content.size()
+                     - sizeof(comment.hash_id) + comment.hash_id.length()
+                     - sizeof(comment.proof) + comment.proof.length()
+                     - sizeof(comment.thumbnails) + comment.thumbnails.size()
+                     - sizeof(comment.replies_cursor) + comment.replies_cursor.length();
+
+        if(response == nullptr) {
+            response = makeResponse();
+            CHECK_ASSERT(response != nullptr, ErrCode::RpcUnimplementedError);
+        }
+        response->result.comments.push_back(std::move(comment));
+        if(commentsSize >= Rpc::Factory::MaxAvailableSize) {
+            responseArray.push_back(response);
+            response.reset();
+            commentsSize = sizeof(Rpc::GetCommentThreadResponse);
+        }
+
+        return 0;
+    };
+
+    for(int64_t idx = 0; idx < rows; idx++) {
+        ret = pushComment(comments[idx]);
+        CHECK_ERROR(ret);
+        for(auto& reply: repliesArray[idx]) {
+            ret = pushComment(reply);
+            CHECK_ERROR(ret);
+        }
+    }
+
+    if(response == nullptr) {
+        response = makeResponse();
+        CHECK_ASSERT(response != nullptr, ErrCode::RpcUnimplementedError);
+    }
+
+    // push last response or empty response
+    response->result.is_last = true;
+    if(params.max_count > 0 && rows >= params.max_count) {
+        response->result.next_cursor = MakeCursor(DataBase::ConditionField::Id, lastId, {});
+    }
+    responseArray.push_back(response);
+
+    return 0;
+}
+
 } // namespace trinity
@@ -3,6 +3,9 @@
 
 #include <map>
 #include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
 #include <vector>
 
 #include <CommandHandler.hpp>
@@ -28,8 +31,15 @@ protected:
 
 private:
     /*** type define ***/
+    // unique key column and its slot in the cursor
+    using KeyColumn = std::pair<const char*, int>;
 
     /*** static function and variable ***/
+    static int AppendKeyset(std::stringstream& sql, const char* condBy, int64_t by,
+                            const std::string& cursor, const std::vector<KeyColumn>& keys);
+    static std::string MakeCursor(int64_t by, int64_t val, const std::vector<int64_t>& keys);
+    static int GetUser(int64_t userId, std::string& did, std::string& name);
+    static uint64_t OmittedFields(const std::optional<std::vector<std::string>>& fields);
 
     /*** class function and variable ***/
     int onGetMultiComments(std::shared_ptr<Rpc::Request> request,
@@ -38,6 +48,16 @@ private:
                                         std::vector<std::shared_ptr<Rpc::Response>> &responseArray);
     int onGetMultiSubscribersCount(std::shared_ptr<Rpc::Request> request,
                                    std::vector<std::shared_ptr<Rpc::Response>> &responseArray);
+    int onGetAvatar(std::shared_ptr<Rpc::Request> request,
+                    std::vector<std::shared_ptr<Rpc::Response>> &responseArray);
+    int onGetChangesSince(std::shared_ptr<Rpc::Request> request,
+                          std::vector<std::shared_ptr<Rpc::Response>> &responseArray);
+    int onSearch(std::shared_ptr<Rpc::Request> request,
+                 std::vector<std::shared_ptr<Rpc::Response>> &responseArray);
+    int onGetTimeline(std::shared_ptr<Rpc::Request> request,
+                      std::vector<std::shared_ptr<Rpc::Response>> &responseArray);
+    int onGetCommentThread(std::shared_ptr<Rpc::Request> request,
+                           std::vector<std::shared_ptr<Rpc::Response>> &responseArray);
 };
 
 /***********************************************/
@@ -1,6 +1,7 @@
 #include "CommandHandler.hpp"
 
 #include <cstring>
+#include <Admission.hpp>
 #include <ChannelMethod.hpp>
 #include <LegacyMethod.hpp>
 #include <MassData.hpp>
@@ -12,7 +13,11 @@
 extern "C" {
 #define new fix_cpp_keyword_new
 #include <auth.h>
+#include <avatar.h>
+#include <compress.h>
 #include <did.h>
+#include <reqepoch.h>
+#include <reqtrace.h>
 #undef new
 }
 
@@ -59,11 +64,15 @@ void CommandHandler::PrintCarrierError(const std::string& errReason)
 int CommandHandler::config(const std::filesystem::path& dataDir,
                            std::weak_ptr<Carrier> carrier)
 {
-    Log::D(Log::Tag::Cmd, "Config command handler.");
+    LOG_D(Log::Tag::Cmd, "Config command handler.");
     int ret = Listener::SetDataDir(dataDir);
     CHECK_ERROR(ret);
 
     threadPool = ThreadPool::Create("command-handler");
+    // carrier sends get their own executor so that a burst of outbound
+    // messages never delays the processing of incoming requests.
+    ioThreadPool = ThreadPool::Create("carrier-io");
+    admission = Admission::Create();
     carrierHandler = carrier;
 
     cmdListener = std::move(std::vector<std::shared_ptr<Listener>> {
@@ -81,10 +90,12 @@ void CommandHandler::cleanup()
     CmdHandlerInstance.reset();
 
     threadPool.reset();
+    ioThreadPool.reset();
+    admission.reset();
     carrierHandler.reset();
     cmdListener.clear();
 
-    Log::D(Log::Tag::Cmd, "Cleanup command handler.");
+    LOG_D(Log::Tag::Cmd, "Cleanup command handler.");
 }
 
 std::weak_ptr<Carrier> CommandHandler::getCarrierHandler()
@@ -95,48 +106,109 @@ std::weak_ptr<Carrier> CommandHandler::getCarrierHandler()
 int CommandHandler::received(const std::string& from, const std::vector<uint8_t>& data)
 {
     CHECK_ASSERT(threadPool != nullptr, ErrCode::PointerReleasedError);
+    CHECK_ASSERT(admission != nullptr, ErrCode::PointerReleasedError);
+
+    // refused before queueing, so an overloaded node answers busy at once
+    // instead of after the backlog ahead of the request.
+    Rpc::Factory::Envelope envelope;
+    std::ignore = Rpc::Factory::Peek(data, envelope);
+    auto verdict = admission->admit(from, envelope);
+    if(verdict != Admission::Accepted) {
+        return reject(from, envelope.id);
+    }
 
-    threadPool->post([this, from = std::move(from), data = std::move(data)] {
-        int ret = processAdvance(from, data);
-        if(ret != ErrCode::UnimplementedError) {
-            return;
-        }
-
-        process(from, data);
+    RequestScope scope;
+    scope.from = from;
+    scope.epoch = reqepoch_enter(from.c_str());
+    scope.acceptEncoding = std::move(envelope.acceptEncoding);
+    scope.dictionary = envelope.dictionary;
+    scope.avatarHash = envelope.avatarHash;
+    threadPool->post([this, scope = std::move(scope), data = std::move(data)] {
+        runScoped(scope, [this, &scope, &data] {
+            int ret = processAdvance(scope.from, data);
+            if(ret == ErrCode::UnimplementedError) {
+                process(scope.from, data);
+            }
+        });
     });
 
     return 0;
 }
 
-int CommandHandler::send(const std::string &to, const std::vector<uint8_t> &data,
+int CommandHandler::send(const std::string &to, Marshalled* data,
                          CarrierFriendMessageReceiptCallback* receiptCallback, void* receiptContext)
 {
-    CHECK_ASSERT(threadPool != nullptr, ErrCode::PointerReleasedError);
+    CHECK_ASSERT(ioThreadPool != nullptr, ErrCode::PointerReleasedError);
+    CHECK_ASSERT(data != nullptr, ErrCode::InvalidArgument);
 
-    threadPool->post([this, to = std::move(to), data = std::move(data), receiptCallback, receiptContext] {
+    // the io thread sends straight from the queued message, held by a ref.
+    auto deleter = [](void* ptr) -> void {
+        deref(ptr);
+    };
+    auto marshalData = std::shared_ptr<Marshalled>((Marshalled*)ref(data), deleter);
+
+    auto queuedAt = reqtrace_clock();
+    ioThreadPool->post([this, to, marshalData, receiptCallback, receiptContext, queuedAt] {
         SAFE_GET_PTR_NO_RETVAL(carrier, this->getCarrierHandler());
+        auto sendAt = reqtrace_clock();
         auto msgid = carrier_send_friend_message(carrier.get(), to.c_str(),
-                                                data.data(), data.size(),
+                                                marshalData->data, marshalData->sz,
                                                 nullptr,
                                                 receiptCallback, receiptContext);
         if(msgid < 0) {
            PrintCarrierError("Failed to send message to: [" + to + "].");
            return;
        }
+       reqtrace_send(to.c_str(), marshalData->sz, queuedAt, sendAt);
 
-       Log::D(Log::Tag::Cmd, "Success send message to [%s].", to.c_str());
+       LOG_D(Log::Tag::Cmd, "Success send message to [%s].", to.c_str());
     });
 
     return 0;
 }
 
+/*
+ * Called by an advanced handler, on the command-handler thread, that waits
+ * on something slow (e.g. DID resolution) without blocking other peers: it
+ * returns with no response, and whichever thread completes the wait passes
+ * the continuation to the returned function. The continuation then runs on
+ * the command-handler thread and its responses go to the requesting peer.
+ */
+CommandHandler::Resume CommandHandler::suspend()
+{
+    auto scope = requestScope;
+    std::weak_ptr<ThreadPool> weakPool = threadPool;
+
+    // the admission slot and the peer epoch are held until the
+    // continuation has run.
+    requestSuspended = true;
+    reqepoch_hold();
+
+    return [this, scope, weakPool](Continuation&& continuation) {
+        SAFE_GET_PTR_NO_RETVAL(pool, weakPool);
+        pool->post([this, scope, continuation = std::move(continuation)] {
+            runScoped(scope, [this, &scope, &continuation] {
+                std::vector<std::shared_ptr<Rpc::Response>> responseArray;
+                int ret = continuation(responseArray);
+                CHECK_RETVAL(ret);
+
+                ret = sendResponses(scope.from, responseArray);
+                CHECK_RETVAL(ret);
+            });
+        });
+    };
+}
+
 int CommandHandler::process(const std::string& from, const std::vector<uint8_t>& data)
 {
     std::shared_ptr<Req> req;
     std::shared_ptr<Resp> resp;
+    auto traceAt = reqtrace_mark();
     int ret = unpackRequest(data, req);
+    reqtrace_stage(TRACE_DECODE, traceAt);
     if(ret >= 0) {
-        Log::D(Log::Tag::Cmd, "Command handler dispose method:%s, tsx_id:%llu, from:%s", req->method, req->tsx_id, from.c_str());
+        reqtrace_method(req->method, req->tsx_id);
+        LOG_D(Log::Tag::Cmd, "Command handler dispose method:%s, tsx_id:%llu, from:%s", req->method, req->tsx_id, from.c_str());
         ret = ErrCode::UnimplementedError;
         for (const auto& it : cmdListener) {
             ret = it->onDispose(from, req, resp);
@@ -151,18 +223,16 @@ int CommandHandler::process(const std::string& from, const std::vector<uint8_t>&
         }
     }
 
+    if(reqepoch_cancelled() == true) {
+        return 0;
+    }
+
     auto errCode = ret;
-    std::vector<uint8_t> respData;
-    ret = packResponse(req, resp, errCode, respData);
+    std::shared_ptr<Marshalled> marshalledResp;
+    ret = packResponse(req, resp, errCode, marshalledResp);
     CHECK_ERROR(ret);
 
-    Marshalled* marshalledResp = (Marshalled*)rc_zalloc(sizeof(Marshalled) + respData.size(), NULL);
-    marshalledResp->data = marshalledResp + 1;
-    marshalledResp->sz = respData.size();
-    memcpy(marshalledResp->data, respData.data(), respData.size());
-
-    msgq_enq(from.c_str(), marshalledResp);
-    deref(marshalledResp);
+    msgq_enq(from.c_str(), marshalledResp.get());
 
     return 0;
 }
@@ -172,11 +242,14 @@ int CommandHandler::processAdvance(const std::string& from, const std::vector<ui
     std::shared_ptr<Rpc::Request> request;
     std::vector<std::shared_ptr<Rpc::Response>> responseArray;
 
+    auto traceAt = reqtrace_mark();
     int ret = Rpc::Factory::Unmarshal(data, request);
+    reqtrace_stage(TRACE_DECODE, traceAt);
     if(ret == ErrCode::UnimplementedError) {
         return ret;
     }
     CHECK_ERROR(ret);
+    reqtrace_method(request->method.c_str(), request->id);
 
     for (const auto& it : cmdListener) {
         ret = it->onDispose(request, responseArray);
@@ -185,24 +258,83 @@ int CommandHandler::processAdvance(const std::string& from, const std::vector<ui
         }
     }
 
+    ret = sendResponses(from, responseArray);
+    CHECK_ERROR(ret);
+
+    return 0;
+}
+
+int CommandHandler::sendResponses(const std::string& to, const std::vector<std::shared_ptr<Rpc::Response>>& responseArray)
+{
     for (const auto &response : responseArray) {
-        auto errCode = ret;
-        std::vector<uint8_t> respData;
-        int ret = Rpc::Factory::Marshal(response, respData);
-        CHECK_ERROR(ret);
+        if(reqepoch_cancelled() == true) {
+            break;
+        }
 
-        Marshalled* marshalledResp = (Marshalled*)rc_zalloc(sizeof(Marshalled) + respData.size(), NULL);
-        marshalledResp->data = marshalledResp + 1;
-        marshalledResp->sz = respData.size();
-        memcpy(marshalledResp->data, respData.data(), respData.size());
+        Marshalled* marshalledResp = nullptr;
+        auto traceAt = reqtrace_mark();
+        int ret = Rpc::Factory::Marshal(response, [&marshalledResp](const uint8_t* data, size_t size) -> int {
+            // packed straight from the encoder buffer into the queued message.
+            marshalledResp = (Marshalled*)rc_zalloc(sizeof(Marshalled) + size, NULL);
+            CHECK_ASSERT(marshalledResp != nullptr, ErrCode::OutOfMemoryError);
+            marshalledResp->data = marshalledResp + 1;
+            marshalledResp->sz = size;
+            memcpy(marshalledResp->data, data, size);
+            return size;
+        });
+        reqtrace_stage(TRACE_MARSHAL, traceAt);
+        CHECK_ERROR(ret);
 
-        msgq_enq(from.c_str(), marshalledResp);
+        msgq_enq(to.c_str(), marshalledResp);
         deref(marshalledResp);
     }
 
     return 0;
 }
 
+int CommandHandler::reject(const std::string& to, int64_t id)
+{
+    if(id < 0) { // nothing to address the error to.
+        return 0;
+    }
+
+    auto marshalBuf = rpc_marshal_err(id, ERR_BUSY, err_strerror(ERR_BUSY));
+    CHECK_ASSERT(marshalBuf != nullptr, ErrCode::CmdMarshalRespFailed);
+
+    msgq_enq(to.c_str(), marshalBuf);
+    deref(marshalBuf);
+
+    return 0;
+}
+
+/*
+ * Runs work on the command-handler thread inside the begin/end bracket of
+ * the request: traced, compressed, avatar capability set and cancelled per
+ * peer epoch. The request
+ * leaves admission once work returns, unless work suspended it.
+ */
+void CommandHandler::runScoped(const RequestScope& scope, const std::function<void()>& work)
+{
+    requestScope = scope;
+    requestSuspended = false;
+
+    reqtrace_begin(scope.from.c_str());
+    compress_begin(scope.acceptEncoding.c_str(), scope.dictionary);
+    avatar_by_hash_begin(scope.avatarHash);
+
+    if(reqepoch_begin(scope.from.c_str(), scope.epoch) == true) {
+        work();
+    }
+
+    avatar_by_hash_end();
+    compress_end();
+    reqepoch_end();
+    reqtrace_end();
+    if(requestSuspended == false) {
+        admission->done();
+    }
+}
+
 int CommandHandler::unpackRequest(const std::vector<uint8_t>& data,
                                   std::shared_ptr<Req>& req) const
 {
@@ -235,6 +367,21 @@ int CommandHandler::packResponse(const std::shared_ptr<Req>& req,
                                  const std::shared_ptr<Resp>& resp,
                                  int errCode,
                                  std::vector<uint8_t>& data) const
+{
+    std::shared_ptr<Marshalled> marshalData;
+    int ret = packResponse(req, resp, errCode, marshalData);
+    CHECK_ERROR(ret);
+
+    auto marshalDataPtr = reinterpret_cast<uint8_t*>(marshalData->data);
+    data = {marshalDataPtr, marshalDataPtr + marshalData->sz};
+
+    return 0;
+}
+
+int CommandHandler::packResponse(const std::shared_ptr<Req>& req,
+                                 const std::shared_ptr<Resp>& resp,
+                                 int errCode,
+                                 std::shared_ptr<Marshalled>& marshalData) const
 {
     Marshalled* marshalBuf = nullptr;
     if(errCode >= 0) {
@@ -244,19 +391,16 @@ int CommandHandler::packResponse(const std::shared_ptr<Req>& req,
         CHECK_ASSERT(req != nullptr, ErrCode::CmdUnknownReqFailed);
         auto errDesp = ErrCode::ToString(errCode);
         marshalBuf = rpc_marshal_err(req->tsx_id, errCode, errDesp.c_str());
-        Log::D(Log::Tag::Cmd, "Response error:");
-        Log::D(Log::Tag::Cmd, "    code: %d", errCode);
-        Log::D(Log::Tag::Cmd, "    message: %s", errDesp.c_str());
+        LOG_D(Log::Tag::Cmd, "Response error:");
+        LOG_D(Log::Tag::Cmd, "    code: %d", errCode);
+        LOG_D(Log::Tag::Cmd, "    message: %s", errDesp.c_str());
     }
     auto deleter = [](void* ptr) -> void {
         deref(ptr);
     };
-    auto marshalData = std::shared_ptr<Marshalled>(marshalBuf, deleter); // workaround: declare for auto release Marshalled pointer
+    marshalData = std::shared_ptr<Marshalled>(marshalBuf, deleter); // workaround: declare for auto release Marshalled pointer
     CHECK_ASSERT(marshalData != nullptr, ErrCode::CmdMarshalRespFailed);
 
-    auto marshalDataPtr = reinterpret_cast<uint8_t*>(marshalData->data);
-    data = {marshalDataPtr, marshalDataPtr + marshalData->sz};
-
     return 0;
 }
 
@@ -290,7 +434,7 @@ int CommandHandler::Listener::checkAccessible(Accessible accessible, const std::
 
 #ifdef NDEBUG
     int ret = ErrCode::UnknownError;
-    Log::D(Log::Tag::Cmd, "Checking request accessible.");
+    LOG_D(Log::Tag::Cmd, "Checking request accessible.");
     if (accessible == Accessible::Owner) {
         ret = isOwner(accessToken);
     } else if (accessible == Accessible::Member) {
@@ -337,8 +481,10 @@ int CommandHandler::Listener::onDispose(std::shared_ptr<Rpc::Request> request,
             continue;
         }
 
-        Log::D(Log::Tag::Cmd, "Request:");
-        Log::D(Log::Tag::Cmd, "  ->  %s", request->str().c_str());
+        if(Log::Debuggable()) {
+            LOG_D(Log::Tag::Cmd, "Request:");
+            LOG_D(Log::Tag::Cmd, "  ->  %s", request->str().c_str());
+        }
 
         std::string accessToken;
         auto requestTokenPtr = std::dynamic_pointer_cast<Rpc::RequestWithToken>(request);
@@ -351,9 +497,11 @@ int CommandHandler::Listener::onDispose(std::shared_ptr<Rpc::Request> request,
         ret = it.second.callback(request, responseArray);
         CHECK_ERROR(ret);
 
-        Log::D(Log::Tag::Cmd, "Response(%d):", responseArray.size());
-        for(const auto& response: responseArray) {
-            Log::D(Log::Tag::Cmd, "  ->  %s", response->str().c_str());
+        if(Log::Debuggable()) {
+            LOG_D(Log::Tag::Cmd, "Response(%d):", responseArray.size());
+            for(const auto& response: responseArray) {
+                LOG_D(Log::Tag::Cmd, "  ->  %s", response->str().c_str());
+            }
         }
         return ret;
     }
@@ -22,6 +22,7 @@ struct StreamCallbacks;
 
 namespace trinity {
 
+class Admission;
 class ThreadPool;
 
 class CommandHandler {
@@ -73,6 +74,10 @@ public:
         friend CommandHandler;
     };
 
+    // finishes a suspended advanced request on the command-handler thread.
+    using Continuation = std::function<int(std::vector<std::shared_ptr<Rpc::Response>>&)>;
+    using Resume = std::function<void(Continuation&&)>;
+
     /*** static function and variable ***/
     static std::shared_ptr<CommandHandler> GetInstance();
     static void PrintCarrierError(const std::string &errReason);
@@ -85,8 +90,9 @@ public:
     std::weak_ptr<Carrier> getCarrierHandler();
 
     int received(const std::string& from, const std::vector<uint8_t>& data);
-    int send(const std::string &to, const std::vector<uint8_t>& data,
+    int send(const std::string &to, Marshalled* data,
              CarrierFriendMessageReceiptCallback* receiptCallback = nullptr, void* receiptContext = nullptr);
+    Resume suspend();
 
     int unpackRequest(const std::vector<uint8_t>& data,
                       std::shared_ptr<Req>& req) const;
@@ -94,6 +100,10 @@ public:
                      const std::shared_ptr<Resp>& resp,
                      int errCode,
                      std::vector<uint8_t>& data) const;
+    int packResponse(const std::shared_ptr<Req>& req,
+                     const std::shared_ptr<Resp>& resp,
+                     int errCode,
+                     std::shared_ptr<Marshalled>& marshalData) const;
 
 protected:
     /*** type define ***/
@@ -104,6 +114,14 @@ protected:
 
 private:
     /*** type define ***/
+    // what brackets a request on the command-handler thread, kept by suspend().
+    struct RequestScope {
+        std::string from;
+        uint64_t epoch = 0;
+        std::string acceptEncoding;
+        int64_t dictionary = 0;
+        bool avatarHash = false;
+    };
 
     /*** static function and variable ***/
     static std::shared_ptr<CommandHandler> CmdHandlerInstance;
@@ -113,10 +131,17 @@ private:
     virtual ~CommandHandler() = default;
     int process(const std::string& from, const std::vector<uint8_t>& data);
     int processAdvance(const std::string& from, const std::vector<uint8_t>& data);
+    int sendResponses(const std::string& to, const std::vector<std::shared_ptr<Rpc::Response>>& responseArray);
+    int reject(const std::string& to, int64_t id);
+    void runScoped(const RequestScope& scope, const std::function<void()>& work);
 
     std::shared_ptr<ThreadPool> threadPool;
+    std::shared_ptr<ThreadPool> ioThreadPool;
+    std::shared_ptr<Admission> admission;
     std::weak_ptr<Carrier> carrierHandler;
     std::vector<std::shared_ptr<Listener>> cmdListener;
+    RequestScope requestScope;
+    bool requestSuspended = false;
 };
 
 /***********************************************/
@@ -7,6 +7,7 @@
 #include <ErrCode.hpp>
 #include <Log.hpp>
 #include <SafePtr.hpp>
+#include <ThreadPool.hpp>
 
 extern "C" {
 #include <ela_jwt.h>
@@ -27,14 +28,24 @@ namespace trinity {
 #define CHECK_DIDSDK(expr, errCode, errDesp) \
     if(!(expr)) { \
         Log::E(Log::Tag::Cmd, errDesp); \
-        Log::D(Log::Tag::Cmd, "Did sdk errCode:0x%x, errDesc:%s", \
+        LOG_D(Log::Tag::Cmd, "Did sdk errCode:0x%x, errDesc:%s", \
                DIDError_GetLastErrorCode(), DIDError_GetLastErrorMessage()); \
         CHECK_ERROR(errCode); \
     }
 
+// did_sdk_lock() as a BasicLockable; declare the guard before any SDK
+// object so their deleters also run under the lock.
+struct DidSdkMutex {
+    void lock() { did_sdk_lock(); }
+    void unlock() { did_sdk_unlock(); }
+};
+static DidSdkMutex didSdkMutex;
+
 /* =========================================== */
 /* === static variables initialize =========== */
 /* =========================================== */
+std::mutex StandardAuth::DocCacheMutex;
+std::unordered_map<std::string, StandardAuth::CachedDocument> StandardAuth::DocCache;
 
 /* =========================================== */
 /* === static function implement ============= */
@@ -73,7 +84,7 @@ int StandardAuth::SaveLocalDIDDocument(DID* did, DIDDocument* doc)
     CHECK_DIDSDK(docStr != nullptr, ErrCode::AuthBadDidDoc, "Failed to format did document to json.");
 
     auto docFilePath = localDocDir / DID_GetMethodSpecificId(did);
-    Log::D(Log::Tag::Cmd, "Save did document to local: %s", docFilePath.c_str());
+    LOG_D(Log::Tag::Cmd, "Save did document to local: %s", docFilePath.c_str());
     std::fstream docStream;
     docStream.open(docFilePath, std::ios::binary | std::ios::out);
     docStream.seekg(0);
@@ -81,6 +92,8 @@ int StandardAuth::SaveLocalDIDDocument(DID* did, DIDDocument* doc)
     docStream.flush();
     docStream.close();
 
+    CacheDIDDocument(DID_GetMethodSpecificId(did), docStr.get());
+
     return 0;
 }
 
@@ -97,13 +110,22 @@ DIDDocument* StandardAuth::LoadLocalDIDDocument(DID* did)
         }
     }
 
+    std::string id = DID_GetMethodSpecificId(did);
+    {
+        std::lock_guard<std::mutex> lock(DocCacheMutex);
+        auto it = DocCache.find(id);
+        if(it != DocCache.end() && it->second.expiration >= DateTime::Current()) {
+            return DIDDocument_FromJson(it->second.json.c_str());
+        }
+    }
+
     auto localDocDir = GetLocalDocDir();
     if(localDocDir.empty() == true) {
         Log::E(Log::Tag::Cmd, "Local did document directory is not set.");
         return nullptr;
     };
 
-    auto docFilePath = localDocDir / DID_GetMethodSpecificId(did);
+    auto docFilePath = localDocDir / id;
     auto fileExists = std::filesystem::exists(docFilePath);
     if(fileExists == false) {
         return nullptr;
@@ -111,15 +133,38 @@ DIDDocument* StandardAuth::LoadLocalDIDDocument(DID* did)
     // Log::D(Log::Tag::Cmd, "Load did document from local: %s", docFilePath.c_str());
 
     auto docSize = std::filesystem::file_size(docFilePath);
-    char *docStr = (char *)alloca(docSize);
+    std::string docStr(docSize, '\0');
 
     std::fstream docStream;
     docStream.open(docFilePath, std::ios::binary | std::ios::in);
     docStream.seekg(0);
-    docStream.read(docStr, docSize);
+    docStream.read(&docStr[0], docSize);
     docStream.close();
+    docStr.resize(std::strlen(docStr.c_str()));
+
+    auto doc = DIDDocument_FromJson(docStr.c_str());
+    if(doc != nullptr) {
+        CacheDIDDocument(id, docStr);
+    }
+
+    return doc;
+}
+
+void StandardAuth::CacheDIDDocument(const std::string& id, const std::string& json)
+{
+    std::lock_guard<std::mutex> lock(DocCacheMutex);
+    auto now = DateTime::Current();
+
+    if(DocCache.size() >= DOC_CACHE_SIZE && DocCache.find(id) == DocCache.end()) {
+        for(auto it = DocCache.begin(); it != DocCache.end();) {
+            it = (it->second.expiration < now ? DocCache.erase(it) : std::next(it));
+        }
+        if(DocCache.size() >= DOC_CACHE_SIZE) {
+            DocCache.erase(DocCache.begin());
+        }
+    }
 
-    return DIDDocument_FromJson(docStr);
+    DocCache[id] = CachedDocument{json, now + DOC_CACHE_TTL};
 }
 
 /* =========================================== */
@@ -134,6 +179,12 @@ StandardAuth::StandardAuth()
     };
 
     setHandleMap({}, advancedHandlerMap);
+
+    // presentation and credential checks may resolve DID documents, so
+    // they run here instead of on the command-handler thread. The SDK is
+    // not reentrant: every call into it, here or from the C handlers, is
+    // serialized by did_sdk_lock().
+    resolverPool = ThreadPool::Create("did-resolver");
 }
 
 StandardAuth::~StandardAuth()
@@ -156,6 +207,8 @@ int StandardAuth::onStandardSignIn(std::shared_ptr<Rpc::Request> request,
     const auto& params = requestPtr->params;
     responseArray.clear();
 
+    std::lock_guard<DidSdkMutex> sdkLock(didSdkMutex);
+
     auto docCreater = [](const std::string& json) -> DIDDocument* {
         return DIDDocument_FromJson(json.c_str());
     };
@@ -174,7 +227,7 @@ int StandardAuth::onStandardSignIn(std::shared_ptr<Rpc::Request> request,
     char didStrBuf[ELA_MAX_DID_LEN];
     auto didStr = DID_ToString(did, didStrBuf, sizeof(didStrBuf));
     CHECK_DIDSDK(didStr, ErrCode::AuthBadDidString, "Failed to get did string.");
-    Log::D(Log::Tag::Cmd, "Sign in Did: %s", didStr);
+    LOG_D(Log::Tag::Cmd, "Sign in Did: %s", didStr);
 
     int ret = SaveLocalDIDDocument(did, didDoc.get());
     CHECK_DIDSDK(ret >= 0, ErrCode::AuthSaveDocFailed, "Failed to save did document to local.");
@@ -211,7 +264,10 @@ int StandardAuth::onStandardSignIn(std::shared_ptr<Rpc::Request> request,
                   challenge);
     CHECK_ERROR(ret);
 
-    authSecretMap[nonceStr] = std::move(AuthSecret{didStr, expiration});
+    {
+        std::lock_guard<std::mutex> lock(authSecretMutex);
+        authSecretMap[nonceStr] = std::move(AuthSecret{didStr, expiration});
+    }
 
     auto responsePtr = Rpc::Factory::MakeResponse(request->method);
     auto response = std::dynamic_pointer_cast<Rpc::StandardSignInResponse>(responsePtr);
@@ -233,29 +289,37 @@ int StandardAuth::onStandardDidAuth(std::shared_ptr<Rpc::Request> request,
     const auto& params = requestPtr->params;
     responseArray.clear();
 
-    int ret;
+    // the request is answered once the token is checked on the resolver
+    // thread, other peers are served meanwhile.
+    auto resume = CommandHandler::GetInstance()->suspend();
+    resolverPool->post([this, request, userName = params.user_name, jwtVP = params.jwt_vp, resume] {
+        auto credentialInfo = std::make_shared<CredentialInfo>();
+        int checked = checkAuthToken(userName, jwtVP, *credentialInfo);
 
-    CredentialInfo credentialInfo;
-    ret = checkAuthToken(params.user_name, params.jwt_vp, credentialInfo);
-    CHECK_ERROR(ret);
+        resume([this, request, checked, credentialInfo](std::vector<std::shared_ptr<Rpc::Response>>& responseArray) -> int {
+            CHECK_ERROR(checked);
 
-    auto userIndex = adaptOldLogin(credentialInfo);
-    CHECK_ERROR(userIndex);
+            auto userIndex = adaptOldLogin(*credentialInfo);
+            CHECK_ERROR(userIndex);
 
-    std::string accessToken;
-    ret = createAccessToken(credentialInfo, userIndex, accessToken);
-    CHECK_ERROR(ret);
+            std::string accessToken;
+            int ret = createAccessToken(*credentialInfo, userIndex, accessToken);
+            CHECK_ERROR(ret);
 
-    auto responsePtr = Rpc::Factory::MakeResponse(request->method);
-    auto response = std::dynamic_pointer_cast<Rpc::StandardDidAuthResponse>(responsePtr);
-    CHECK_ASSERT(response != nullptr, ErrCode::RpcUnimplementedError);
-    response->version = request->version;
-    response->id = request->id;
-    response->result.access_token = std::move(accessToken);
+            auto responsePtr = Rpc::Factory::MakeResponse(request->method);
+            auto response = std::dynamic_pointer_cast<Rpc::StandardDidAuthResponse>(responsePtr);
+            CHECK_ASSERT(response != nullptr, ErrCode::RpcUnimplementedError);
+            response->version = request->version;
+            response->id = request->id;
+            response->result.access_token = std::move(accessToken);
 
-    responseArray.push_back(response);
+            responseArray.push_back(response);
+
+            hdl_stats_changed_notify();
 
-    hdl_stats_changed_notify();
+            return 0;
+        });
+    });
 
     return 0;
 }
@@ -264,6 +328,7 @@ std::string StandardAuth::getServiceDid()
 {
     char didStrBuf[ELA_MAX_DID_LEN] = {0};
 
+    std::lock_guard<DidSdkMutex> sdkLock(didSdkMutex);
     DID_ToString(DIDURL_GetDid(feeeds_auth_key_url), didStrBuf, sizeof(didStrBuf));
 
     return std::string(didStrBuf);
@@ -287,6 +352,8 @@ int StandardAuth::makeJwt(time_t expiration,
                           const std::map<const char*, int>& claimIntMap,
                           std::string& jwt)
 {
+    std::lock_guard<DidSdkMutex> sdkLock(didSdkMutex);
+
     auto jwtCreater = [](DIDDocument* didDoc) -> JWTBuilder* {
         return DIDDocument_GetJwtBuilder(didDoc);
     };
@@ -344,6 +411,8 @@ int StandardAuth::checkAuthToken(const std::string& userName, const std::string&
 {
     CHECK_ASSERT(jwtVP.empty() == false, ErrCode::InvalidArgument);
 
+    std::lock_guard<DidSdkMutex> sdkLock(didSdkMutex);
+
     /** check jwt token **/
     DIDBackend_SetLocalResolveHandle(StandardAuth::LoadLocalDIDDocument);
     auto jwsCreater = [](const std::string& jwtVP) -> JWT* {
@@ -383,9 +452,13 @@ int StandardAuth::checkAuthToken(const std::string& userName, const std::string&
     auto nonce = Presentation_GetNonce(vp.get());
     CHECK_DIDSDK(nonce != nullptr, ErrCode::AuthPresentationEmptyNonce, "Failed to get presentation nonce, return null.");
 
-    auto authSecretIt = authSecretMap.find(nonce); // TODO: change to remove
-    CHECK_DIDSDK(authSecretIt != authSecretMap.end(), ErrCode::AuthPresentationBadNonce, "Bad presentation nonce.");
-    auto authSecret = authSecretIt->second;
+    AuthSecret authSecret;
+    {
+        std::lock_guard<std::mutex> lock(authSecretMutex);
+        auto authSecretIt = authSecretMap.find(nonce); // TODO: change to remove
+        CHECK_DIDSDK(authSecretIt != authSecretMap.end(), ErrCode::AuthPresentationBadNonce, "Bad presentation nonce.");
+        authSecret = authSecretIt->second;
+    }
 
     /** check realm **/
     auto realm = Presentation_GetRealm(vp.get());
@@ -3,6 +3,8 @@
 
 #include <map>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 #include <CommandHandler.hpp>
@@ -12,6 +14,8 @@ struct DIDDocument;
 
 namespace trinity {
 
+class ThreadPool;
+
 class StandardAuth : public CommandHandler::Listener {
 public:
     /*** type define ***/
@@ -50,10 +54,23 @@ private:
         std::string email;
     };
 
+    struct CachedDocument {
+        std::string json;
+        int64_t expiration;
+    };
+
     /*** static function and variable ***/
     static std::filesystem::path GetLocalDocDir();
     static int SaveLocalDIDDocument(DID* did, DIDDocument* doc);
     static DIDDocument* LoadLocalDIDDocument(DID* did);
+    static void CacheDIDDocument(const std::string& id, const std::string& json);
+
+    // local documents by method specific id. DID SDK takes ownership of
+    // every document it resolves, so the json is kept and parsed per resolve.
+    static std::mutex DocCacheMutex;
+    static std::unordered_map<std::string, CachedDocument> DocCache;
+    constexpr static const int64_t DOC_CACHE_TTL = (static_cast<int64_t>(10) * 60); // 10 minute
+    constexpr static const size_t DOC_CACHE_SIZE = 1024;
 
     constexpr static const int64_t JWT_EXPIRATION = (static_cast<int64_t>(5) * 60); // 5 minute
     constexpr static const int64_t ACCESS_EXPIRATION = (static_cast<int64_t>(30) * 24 * 60 * 60); //1 month
@@ -80,7 +97,9 @@ private:
                           std::string& accessToken);
 
     std::filesystem::path localDocDir;
+    std::mutex authSecretMutex;
     std::map<std::string, AuthSecret> authSecretMap;
+    std::shared_ptr<ThreadPool> resolverPool;
 };
 
 /***********************************************/
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2020 trinity-tech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <crystal.h>
+#include <msgpack.hpp>
+#include <zlib.h>
+
+#include "compress.h"
+#include "logging.h"
+
+#define TAG_MSG "[Feedsd.Msg ]: "
+
+#define MIN_DEFLATE_SIZE 512
+#define MIN_DICT_SIZE    64
+#define MAX_DICT_SIZE    4096
+#define SAMPLE_SIZE      4096
+// deflated size must be below 7/8 of the plain one to be worth sending.
+#define worth_sending(deflated, plain) ((deflated) * 8 < (plain) * 7)
+
+typedef struct {
+    bool deflate;
+    bool dict;
+} Accepted;
+
+static thread_local Accepted accepted;
+
+/*
+ * Packed in this order to form COMPRESS_DICT_KEYS, the most frequent keys
+ * come last as zlib finds the end of a dictionary the cheapest to refer to.
+ * Never change the list: clients keep a copy of the dictionary.
+ */
+static const char *dict_keys[] = {
+    "reporter_name", "reporter_did", "reasons", "transaction_payload",
+    "tip_methods", "origin_post_url", "channels", "posts", "did",
+    "last_update", "owner_name", "owner_did", "avatar_hash", "introduction",
+    "name", "hash_id", "updated_at", "user_did", "user_name", "comment_id",
+    "subscribers", "comments", "is_last", "likes", "post_id", "status",
+    "thumbnails", "next_cursor", "created_at", "content", "proof",
+    "channel_id", "result", "1.0", "version", "id"
+};
+
+static
+const std::string &dict_bytes(void)
+{
+    static const std::string bytes = [] {
+        msgpack::sbuffer buf;
+        for (const char *key : dict_keys)
+            msgpack::pack(buf, std::string(key));
+        return std::string(buf.data(), buf.size());
+    }();
+
+    return bytes;
+}
+
+static
+int deflate_buf(const void *data, size_t sz, bool dict, std::vector<uint8_t> &out)
+{
+    z_stream zs;
+    int rc;
+
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit(&zs, Z_DEFAULT_COMPRESSION) != Z_OK)
+        return -1;
+
+    if (dict) {
+        const std::string &bytes = dict_bytes();
+        if (deflateSetDictionary(&zs, (const Bytef *)bytes.data(), bytes.size()) != Z_OK) {
+            deflateEnd(&zs);
+            return -1;
+        }
+    }
+
+    out.resize(deflateBound(&zs, sz));
+    zs.next_in   = (Bytef *)data;
+    zs.avail_in  = sz;
+    zs.next_out  = out.data();
+    zs.avail_out = out.size();
+
+    rc = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+
+    return rc == Z_STREAM_END ? 0 : -1;
+}
+
+static
+Marshalled *frame_create(const std::vector<uint8_t> &payload, bool dict)
+{
+    msgpack::sbuffer buf;
+    msgpack::packer<msgpack::sbuffer> pk(&buf);
+    Marshalled *m;
+
+    pk.pack_map(4);
+    pk.pack(std::string("version"));
+    pk.pack(std::string("1.0"));
+    pk.pack(std::string("encoding"));
+    pk.pack(std::string(COMPRESS_DEFLATE));
+    pk.pack(std::string("dictionary"));
+    pk.pack(dict ? COMPRESS_DICT_KEYS : 0);
+    pk.pack(std::string("payload"));
+    pk.pack_bin(payload.size());
+    pk.pack_bin_body((const char *)payload.data(), payload.size());
+
+    m = (Marshalled *)rc_zalloc(sizeof(Marshalled) + buf.size(), NULL);
+    if (!m)
+        return NULL;
+
+    m->data = m + 1;
+    m->sz   = buf.size();
+    memcpy(m->data, buf.data(), buf.size());
+
+    return m;
+}
+
+void compress_begin(const char *accept_encoding, uint64_t dictionary)
+{
+    accepted.deflate = accept_encoding && !strcmp(accept_encoding, COMPRESS_DEFLATE);
+    accepted.dict    = accepted.deflate && dictionary == COMPRESS_DICT_KEYS;
+}
+
+void compress_end(void)
+{
+    accepted.deflate = false;
+    accepted.dict    = false;
+}
+
+Marshalled *compress_resp(Marshalled *resp)
+{
+    std::vector<uint8_t> payload;
+    bool dict = accepted.dict && resp->sz <= MAX_DICT_SIZE;
+    Marshalled *frame;
+
+    if (!accepted.deflate || resp->sz < (dict ? MIN_DICT_SIZE : MIN_DEFLATE_SIZE))
+        return (Marshalled *)ref(resp);
+
+    // large responses are mostly content and thumbnails, often compressed
+    // already; a sample from the middle saves deflating them for nothing.
+    if (resp->sz > 2 * SAMPLE_SIZE &&
+        (deflate_buf((uint8_t *)resp->data + (resp->sz - SAMPLE_SIZE) / 2, SAMPLE_SIZE, false, payload) < 0 ||
+         !worth_sending(payload.size(), SAMPLE_SIZE)))
+        return (Marshalled *)ref(resp);
+
+    if (deflate_buf(resp->data, resp->sz, dict, payload) < 0 ||
+        !worth_sending(payload.size(), resp->sz))
+        return (Marshalled *)ref(resp);
+
+    frame = frame_create(payload, dict);
+    if (!frame)
+        return (Marshalled *)ref(resp);
+
+    vlogD(TAG_MSG "Deflated response from %zu to %zu bytes%s.",
+          resp->sz, payload.size(), dict ? " with dictionary" : "");
+    return frame;
+}
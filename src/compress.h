@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2020 trinity-tech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __COMPRESS_H__
+#define __COMPRESS_H__
+
+#include <stdint.h>
+
+#include "rpc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define COMPRESS_DEFLATE   "deflate"
+#define COMPRESS_DICT_KEYS 1
+
+/*
+ * A request appending "accept_encoding": "deflate" to its top-level map
+ * gets its responses as {"version", "encoding", "dictionary", "payload"}
+ * frames, payload being the zlib stream of the plain msgpack response.
+ * Also appending "dictionary": COMPRESS_DICT_KEYS lets small responses be
+ * deflated against a preset dictionary of the response keys. Responses
+ * that are small or do not shrink enough are sent as they are.
+ *
+ * compress_begin() and compress_end() bracket a request on its worker
+ * thread, compress_resp() returns a new reference to the frame to send.
+ */
+void compress_begin(const char *accept_encoding, uint64_t dictionary);
+void compress_end(void);
+Marshalled *compress_resp(Marshalled *resp);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif //__COMPRESS_H__
@@ -27,13 +27,26 @@
 #include <time.h>
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
+#include <inttypes.h>
+#include <stdarg.h>
 #include <crystal.h>
 #include <sqlite3.h>
 
 #include "did.h"
 #include "ver.h"
 #include "db.h"
+#include "avatar.h"
+#include "reqepoch.h"
+#include "reqtrace.h"
+#include "logging.h"
 
 #define TAG_DB "[Feedsd.Db  ]: "
 
@@ -46,6 +59,8 @@ typedef void *(*Row2Raw)(sqlite3_stmt *);
 typedef struct DBObjIt {
     sqlite3_stmt *stmt;
     Row2Raw cb;
+    size_t rows;
+    uint64_t elapsed;
 } DBObjIt;
 
 typedef struct DBInitOperator {
@@ -58,17 +73,25 @@ typedef struct DBInitOperator {
     int (*p_check)(const char *, int) = NULL;
     int (*p_del_idx)(const char *) = NULL;
     int (*p_add_idx)(const char *, const char *) = NULL;
+    bool chunked = false;
 } DBInitOperator;
 
 static sqlite3 *db;
 
+/*
+ * The outbox is written from the carrier and timer threads while requests
+ * run their transactions on db, so it goes through its own connection.
+ * msgq serializes every call on it.
+ */
+static sqlite3 *outbox_db;
+
 static
-int sql_execution(const char *sql)
+int sql_execution_on(sqlite3 *handle, const char *sql)
 {
     sqlite3_stmt *stmt;
     int rc;
 
-    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
+    if (SQLITE_OK != sqlite3_prepare_v2(handle, sql, -1, &stmt, NULL)) {
         vlogE(TAG_DB "Sql execution sqlite3_prepare_v2() failed");
         return -1;
     }
@@ -83,6 +106,12 @@ int sql_execution(const char *sql)
     return 0;
 }
 
+static
+int sql_execution(const char *sql)
+{
+    return sql_execution_on(db, sql);
+}
+
 
 static
 int check_table_valid(const char *table_name, int item_num)
@@ -159,53 +188,809 @@ int delete_old_index(const char *table_name)
             table_name);
         return -1;
     }
-    rc = sqlite3_step(stmt);
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        vlogE(TAG_DB "Delete %s_updated_at_index failed", table_name);
+        return -1;
+    }
+
+    return 0;
+}
+
+static
+int create_new_index(const char *table_name, const char *para)
+{
+    sqlite3_stmt *stmt;
+    char sql[128] = {0};
+    int rc;
+
+    snprintf(sql, sizeof(sql), 
+        "CREATE INDEX %s_created_at_index ON %s (%screated_at)", 
+        table_name, table_name, para);
+    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
+        vlogE(TAG_DB "Creating %s_created_at_index sqlite3_prepare_v2() failed", 
+            table_name);
+        return -1;
+    }
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        vlogE(TAG_DB "Creating %s_created_at_index failed", table_name);
+        return -1;
+    }
+
+    memset(sql, 0, sizeof(sql));
+    snprintf(sql, sizeof(sql), 
+        "CREATE INDEX %s_updated_at_index ON %s (%supdated_at)", 
+        table_name, table_name, para);
+    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
+        vlogE(TAG_DB "Creating %s_updated_at_index sqlite3_prepare_v2() failed",
+            table_name);
+        return -1;
+    }
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        vlogE(TAG_DB "Creating %s_updated_at_index failed", table_name);
+        return -1;
+    }
+
+    return 0;
+}
+
+static
+int create_key_index(const char *table_name, const char *para)
+{
+    char sql[128] = {0};
+
+    snprintf(sql, sizeof(sql),
+        "CREATE INDEX %s_key_index ON %s (%s)", table_name, table_name, para);
+
+    return sql_execution(sql);
+}
+
+/*
+ * Append-only change journal read by get_changes_since. Written inside the
+ * mutator's own transaction so a change is journaled iff it is committed.
+ * Rows older than CHANGES_RETENTION are trimmed every CHANGES_TRIM_EVERY
+ * writes, always as a prefix of seq, so everything below MIN(seq) - or below
+ * sqlite_sequence once the journal is empty - is gone and clients behind it
+ * are told to resync.
+ */
+#define CHANGES_RETENTION  (30 * 24 * 60 * 60)
+#define CHANGES_TRIM_EVERY 1024
+
+static
+int journal_add(ChangeKind kind, uint64_t channel_id, uint64_t post_id, uint64_t comment_id)
+{
+    static unsigned int writes;
+    sqlite3_stmt *stmt;
+    const char *sql;
+    int rc;
+
+    sql = "INSERT INTO changes(kind, channel_id, post_id, comment_id, created_at)"
+          "  VALUES (:kind, :channel_id, :post_id, :comment_id, :ts)";
+
+    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
+        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
+        return -1;
+    }
+
+    rc = sqlite3_bind_int(stmt,
+                          sqlite3_bind_parameter_index(stmt, ":kind"),
+                          kind);
+    rc |= sqlite3_bind_int64(stmt,
+                             sqlite3_bind_parameter_index(stmt, ":channel_id"),
+                             channel_id);
+    rc |= sqlite3_bind_int64(stmt,
+                             sqlite3_bind_parameter_index(stmt, ":post_id"),
+                             post_id);
+    rc |= sqlite3_bind_int64(stmt,
+                             sqlite3_bind_parameter_index(stmt, ":comment_id"),
+                             comment_id);
+    rc |= sqlite3_bind_int64(stmt,
+                             sqlite3_bind_parameter_index(stmt, ":ts"),
+                             time(NULL));
+    if (SQLITE_OK != rc) {
+        vlogE(TAG_DB "Binding parameter failed");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (SQLITE_DONE != rc) {
+        vlogE(TAG_DB "Executing INSERT into changes failed");
+        return -1;
+    }
+
+    if (++writes % CHANGES_TRIM_EVERY == 0) {
+        char trim[256] = {0};
+
+        snprintf(trim, sizeof(trim),
+                 "DELETE FROM changes WHERE seq <="
+                 "  (SELECT seq FROM changes WHERE created_at < %" PRIu64
+                 "   ORDER BY created_at DESC LIMIT 1)",
+                 (uint64_t)time(NULL) - CHANGES_RETENTION);
+        if (sql_execution(trim) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Materialized home timeline: one (user_id, created_at, channel_id, post_id)
+ * row per post per subscriber, so opening a timeline is a single range read
+ * of the primary key. Rows are fanned out inside the posting transaction.
+ * A channel is materialized lazily on its first post once this is deployed
+ * and only while it has at most TIMELINE_FANOUT_MAX_SUBS subscribers; larger
+ * channels are recorded with fanout = 0 and merged on read instead. The
+ * lower bound for going back keeps a channel near the limit from flapping.
+ */
+#define TIMELINE_FANOUT_MAX_SUBS 512
+
+static
+int timeline_exec(const char *sql, uint64_t uid, uint64_t channel_id, uint64_t post_id)
+{
+    sqlite3_stmt *stmt;
+    int rc = SQLITE_OK;
+    int idx;
+
+    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
+        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
+        return -1;
+    }
+
+    if ((idx = sqlite3_bind_parameter_index(stmt, ":uid")))
+        rc |= sqlite3_bind_int64(stmt, idx, uid);
+    if ((idx = sqlite3_bind_parameter_index(stmt, ":channel_id")))
+        rc |= sqlite3_bind_int64(stmt, idx, channel_id);
+    if ((idx = sqlite3_bind_parameter_index(stmt, ":post_id")))
+        rc |= sqlite3_bind_int64(stmt, idx, post_id);
+    if ((idx = sqlite3_bind_parameter_index(stmt, ":deleted")))
+        rc |= sqlite3_bind_int(stmt, idx, POST_DELETED);
+    if (SQLITE_OK != rc) {
+        vlogE(TAG_DB "Binding parameter failed");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (SQLITE_DONE != rc) {
+        vlogE(TAG_DB "Executing timeline update failed");
+        return -1;
+    }
+
+    return 0;
+}
+
+static
+int timeline_add_post(uint64_t channel_id, uint64_t post_id)
+{
+    sqlite3_stmt *stmt;
+    const char *sql;
+    uint64_t subs;
+    int fanout;
+    int rc;
+
+    sql = "SELECT c.subscribers, IFNULL(t.fanout, -1)"
+          "  FROM channels c LEFT JOIN timeline_channels t ON t.channel_id = c.channel_id"
+          "  WHERE c.channel_id = :channel_id";
+
+    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
+        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
+        return -1;
+    }
+
+    rc = sqlite3_bind_int64(stmt,
+                            sqlite3_bind_parameter_index(stmt, ":channel_id"),
+                            channel_id);
+    if (SQLITE_OK != rc) {
+        vlogE(TAG_DB "Binding parameter channel_id failed");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    if (SQLITE_ROW != sqlite3_step(stmt)) {
+        vlogE(TAG_DB "Executing SELECT failed");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    subs   = sqlite3_column_int64(stmt, 0);
+    fanout = sqlite3_column_int(stmt, 1);
+    sqlite3_finalize(stmt);
+
+    if (fanout == 1 && subs <= TIMELINE_FANOUT_MAX_SUBS)
+        return timeline_exec("INSERT INTO timeline(user_id, created_at, channel_id, post_id)"
+                             "  SELECT s.user_id, p.created_at, p.channel_id, p.post_id"
+                             "  FROM subscriptions s JOIN posts p ON p.channel_id = s.channel_id"
+                             "  WHERE p.channel_id = :channel_id AND p.post_id = :post_id",
+                             0, channel_id, post_id);
+
+    if (fanout == 1) {
+        vlogI(TAG_DB "Channel %" PRIu64 " has %" PRIu64 " subscribers, timeline falls back to merge on read",
+              channel_id, subs);
+        if (timeline_exec("INSERT OR REPLACE INTO timeline_channels(channel_id, fanout)"
+                          "  VALUES (:channel_id, 0)", 0, channel_id, 0) < 0)
+            return -1;
+        return timeline_exec("DELETE FROM timeline WHERE channel_id = :channel_id", 0, channel_id, 0);
+    }
+
+    if (subs > (fanout < 0 ? TIMELINE_FANOUT_MAX_SUBS : TIMELINE_FANOUT_MAX_SUBS / 2))
+        return 0;
+
+    if (timeline_exec("INSERT OR IGNORE INTO timeline(user_id, created_at, channel_id, post_id)"
+                      "  SELECT s.user_id, p.created_at, p.channel_id, p.post_id"
+                      "  FROM subscriptions s JOIN posts p ON p.channel_id = s.channel_id"
+                      "  WHERE s.channel_id = :channel_id AND p.status <> :deleted",
+                      0, channel_id, 0) < 0)
+        return -1;
+
+    return timeline_exec("INSERT OR REPLACE INTO timeline_channels(channel_id, fanout)"
+                         "  VALUES (:channel_id, 1)", 0, channel_id, 0);
+}
+
+/*
+ * Chunked tables are migrated after startup on their own connection: rows are
+ * moved from <table>_backup in MIGRATE_BATCH sized transactions and deleted
+ * from the backup as they go, so disk use does not double and the backup
+ * table itself records what is left after a crash. Until the copy is done the
+ * request connection reads <table> through a temp view of the same name that
+ * appends the rows still in the backup, and writers move the rows they are
+ * about to touch first (migrate_rows()), so writes always go to main.<table>.
+ * The views and the emptied backups are dropped by the request connection on
+ * the first write after the copy is done.
+ */
+#define MIGRATE_BATCH    2000
+#define MIGRATE_PAUSE_MS 10
+#define MIGRATE_BUSY_MS  5000
+
+typedef struct {
+    const char *table_name;
+    const char *retrive_sql;
+    const char *select_sql;
+} Migration;
+
+static std::vector<Migration> migrations;
+static std::thread migrate_thread;
+static std::atomic<bool> migrate_pending;
+static std::atomic<bool> migrate_stop;
+
+static
+int64_t count_rows(sqlite3 *handle, const char *table)
+{
+    sqlite3_stmt *stmt;
+    char sql[128] = {0};
+    int64_t count;
+
+    snprintf(sql, sizeof(sql), "SELECT count(*) FROM main.%s", table);
+    if (SQLITE_OK != sqlite3_prepare_v2(handle, sql, -1, &stmt, NULL)) {
+        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
+        return -1;
+    }
+    if (SQLITE_ROW != sqlite3_step(stmt)) {
+        vlogE(TAG_DB "Counting rows of %s failed", table);
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+    count = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+
+    return count;
+}
+
+static
+int migrate_table(sqlite3 *conn, const Migration *m)
+{
+    char sql[512] = {0};
+    int64_t total;
+    int64_t moved = 0;
+    int pct = -1;
+    int changes;
+
+    snprintf(sql, sizeof(sql), "%s_backup", m->table_name);
+    total = count_rows(conn, sql);
+    if (total < 0)
+        return -1;
+
+    vlogI(TAG_DB "Migrating table %s, %" PRId64 " rows to copy", m->table_name, total);
+
+    do {
+        // IMMEDIATE takes the write lock up front, a batch never has to
+        // upgrade a read lock against the request connection.
+        if (-1 == sql_execution_on(conn, "BEGIN IMMEDIATE"))
+            return -1;
+
+        snprintf(sql, sizeof(sql), "%s ORDER BY rowid LIMIT %d", m->retrive_sql, MIGRATE_BATCH);
+        if (-1 == sql_execution_on(conn, sql))
+            goto rollback;
+        changes = sqlite3_changes(conn);
+
+        snprintf(sql, sizeof(sql),
+            "DELETE FROM %s_backup WHERE rowid IN (SELECT rowid FROM %s_backup ORDER BY rowid LIMIT %d)",
+            m->table_name, m->table_name, MIGRATE_BATCH);
+        if (-1 == sql_execution_on(conn, sql))
+            goto rollback;
+
+        if (-1 == sql_execution_on(conn, "END"))
+            goto rollback;
+
+        moved += changes;
+        if (total > 0 && moved * 100 / total != pct) {
+            pct = moved * 100 / total;
+            vlogI(TAG_DB "Migrating table %s: %" PRId64 "/%" PRId64 " rows (%d%%)",
+                  m->table_name, moved, total, pct);
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(MIGRATE_PAUSE_MS));
+    } while (changes == MIGRATE_BATCH && !migrate_stop);
+
+    if (!migrate_stop)
+        vlogI(TAG_DB "Migrating table %s done", m->table_name);
+    return 0;
+
+rollback:
+    vlogE(TAG_DB "Migrating table %s failed, resume on next start", m->table_name);
+    if (-1 == sql_execution_on(conn, "ROLLBACK"))
+        vlogE(TAG_DB "ROLLBACK failed");
+
+    return -1;
+}
+
+static
+void migrate_routine(std::string path)
+{
+    sqlite3 *conn = NULL;
+    int rc = -1;
+
+    if (SQLITE_OK != sqlite3_open_v2(path.c_str(), &conn, SQLITE_OPEN_READWRITE, NULL)) {
+        vlogE(TAG_DB "Opening migration connection failed");
+        sqlite3_close(conn);
+        return;
+    }
+    sqlite3_busy_timeout(conn, MIGRATE_BUSY_MS);
+
+    for (const Migration &m : migrations) {
+        rc = migrate_table(conn, &m);
+        if (rc < 0 || migrate_stop)
+            break;
+    }
+    sqlite3_close(conn);
+
+    if (rc == 0 && !migrate_stop)
+        migrate_pending = false;
+}
+
+static
+int start_migrations(std::vector<DBInitOperator *> &ops)
+{
+    char backup[64] = {0};
+    char sql[512] = {0};
+    int64_t left;
+    int rc;
+
+    for (DBInitOperator *op : ops) {
+        if (!op->chunked)
+            continue;
+
+        snprintf(backup, sizeof(backup), "%s_backup", op->table_name);
+        rc = check_table_valid(backup, 0);
+        if (0 == rc)
+            continue;
+        left = rc < 0 ? -1 : count_rows(db, backup);
+        if (left < 0)
+            return -1;
+
+        if (0 == left) {
+            snprintf(sql, sizeof(sql), "DROP TABLE main.%s", backup);
+            if (-1 == sql_execution(sql))
+                return -1;
+            continue;
+        }
+
+        Migration m;
+        m.table_name = op->table_name;
+        m.retrive_sql = strdup(op->retrive_sql);
+        if (!m.retrive_sql)
+            return -1;
+        m.select_sql = strstr(m.retrive_sql, "SELECT");
+
+        snprintf(sql, sizeof(sql), "CREATE TEMP VIEW %s AS SELECT * FROM main.%s UNION ALL %s",
+                 m.table_name, m.table_name, m.select_sql);
+        if (-1 == sql_execution(sql))
+            return -1;
+
+        migrations.push_back(m);
+    }
+
+    if (migrations.empty())
+        return 0;
+
+    migrate_pending = true;
+    migrate_stop = false;
+    migrate_thread = std::thread(migrate_routine, std::string(sqlite3_db_filename(db, "main")));
+
+    return 0;
+}
+
+static
+void settle_migrations()
+{
+    char sql[128] = {0};
+
+    // the views are only dropped outside of a transaction, a rollback
+    // must not bring them back once migrations is cleared.
+    if (migrations.empty() || migrate_pending || !sqlite3_get_autocommit(db))
+        return;
+
+    if (migrate_thread.joinable())
+        migrate_thread.join();
+
+    for (const Migration &m : migrations) {
+        snprintf(sql, sizeof(sql), "DROP VIEW IF EXISTS temp.%s", m.table_name);
+        if (-1 == sql_execution(sql))
+            return;
+        snprintf(sql, sizeof(sql), "DROP TABLE IF EXISTS main.%s_backup", m.table_name);
+        if (-1 == sql_execution(sql))
+            return;
+    }
+
+    for (const Migration &m : migrations)
+        free((void *)m.retrive_sql);
+    migrations.clear();
+}
+
+/*
+ * Moves the rows of table matching the where clause out of its backup, called
+ * by writers before they update or delete rows of a chunked table.
+ */
+static
+int migrate_rows(const char *table, const char *fmt, ...)
+{
+    char where[256] = {0};
+    char sql[768] = {0};
+    va_list ap;
+
+    settle_migrations();
+
+    for (const Migration &m : migrations) {
+        if (strcmp(m.table_name, table))
+            continue;
+
+        va_start(ap, fmt);
+        vsnprintf(where, sizeof(where), fmt, ap);
+        va_end(ap);
+
+        if (-1 == sql_execution("SAVEPOINT migrate_rows"))
+            return -1;
+
+        snprintf(sql, sizeof(sql), "INSERT INTO main.%s %s WHERE %s", table, m.select_sql, where);
+        if (-1 == sql_execution(sql))
+            goto rollback;
+
+        snprintf(sql, sizeof(sql), "DELETE FROM main.%s_backup WHERE %s", table, where);
+        if (-1 == sql_execution(sql))
+            goto rollback;
+
+        return sql_execution("RELEASE migrate_rows");
+    }
+
+    return 0;
+
+rollback:
+    sql_execution("ROLLBACK TO migrate_rows");
+    sql_execution("RELEASE migrate_rows");
+    return -1;
+}
+
+/*
+ * Indexes for the list query shapes. Every list orders by its query column
+ * followed by the unique key columns, so the indexes carry the key as a
+ * suffix and a keyset page is a single seek with no temp b-tree sort. The
+ * per-table created_at/updated_at indexes stay for the migration path; the
+ * unsuffixed ones created here earlier are superseded and dropped.
+ * IF [NOT] EXISTS makes this an idempotent upgrade step.
+ */
+static const char *query_indexes[] = {
+    "DROP INDEX IF EXISTS comments_all_created_at_index",
+    "DROP INDEX IF EXISTS comments_all_updated_at_index",
+    "DROP INDEX IF EXISTS comments_chan_created_at_index",
+    "DROP INDEX IF EXISTS comments_chan_updated_at_index",
+    "DROP INDEX IF EXISTS posts_all_created_at_index",
+    "DROP INDEX IF EXISTS posts_all_updated_at_index",
+    "DROP INDEX IF EXISTS likes_user_created_at_index",
+    "DROP INDEX IF EXISTS reported_comments_created_at_index",
+    "CREATE INDEX IF NOT EXISTS posts_created_at_key_index ON posts (channel_id, created_at, post_id)",
+    "CREATE INDEX IF NOT EXISTS posts_updated_at_key_index ON posts (channel_id, updated_at, post_id)",
+    "CREATE INDEX IF NOT EXISTS posts_all_created_at_key_index ON posts (created_at, channel_id, post_id)",
+    "CREATE INDEX IF NOT EXISTS posts_all_updated_at_key_index ON posts (updated_at, channel_id, post_id)",
+    "CREATE INDEX IF NOT EXISTS comments_created_at_key_index ON comments (channel_id, post_id, created_at, comment_id)",
+    "CREATE INDEX IF NOT EXISTS comments_updated_at_key_index ON comments (channel_id, post_id, updated_at, comment_id)",
+    "CREATE INDEX IF NOT EXISTS comments_chan_created_at_key_index ON comments (channel_id, created_at, post_id, comment_id)",
+    "CREATE INDEX IF NOT EXISTS comments_chan_updated_at_key_index ON comments (channel_id, updated_at, post_id, comment_id)",
+    "CREATE INDEX IF NOT EXISTS comments_all_created_at_key_index ON comments (created_at, channel_id, post_id, comment_id)",
+    "CREATE INDEX IF NOT EXISTS comments_all_updated_at_key_index ON comments (updated_at, channel_id, post_id, comment_id)",
+    "CREATE INDEX IF NOT EXISTS comments_reply_key_index ON comments (channel_id, post_id, refcomment_id, comment_id)",
+    "CREATE INDEX IF NOT EXISTS likes_user_created_at_key_index ON likes (user_id, created_at, channel_id, post_id, comment_id)",
+    "CREATE INDEX IF NOT EXISTS likes_user_post_key_index ON likes (user_id, post_id, channel_id, comment_id)",
+    "CREATE INDEX IF NOT EXISTS likes_target_index ON likes (channel_id, post_id, comment_id, user_id)",
+    "CREATE INDEX IF NOT EXISTS reported_comments_created_at_key_index"
+    "  ON reported_comments (created_at, channel_id, post_id, comment_id, reporter_id)",
+    "CREATE INDEX IF NOT EXISTS reported_comments_comment_key_index"
+    "  ON reported_comments (comment_id, channel_id, post_id, reporter_id)",
+    "CREATE INDEX IF NOT EXISTS subscriptions_channel_index ON subscriptions (channel_id, user_id)",
+    "CREATE INDEX IF NOT EXISTS users_avatar_index ON users (avatar)",
+    "CREATE INDEX IF NOT EXISTS changes_created_at_index ON changes (created_at)",
+};
+
+static
+int create_query_indexes()
+{
+    size_t i;
+
+    if (-1 == sql_execution("BEGIN"))
+        return -1;
+
+    for (i = 0; i < sizeof(query_indexes) / sizeof(query_indexes[0]); ++i) {
+        if (-1 == sql_execution(query_indexes[i])) {
+            vlogE(TAG_DB "Creating query index failed");
+            sql_execution("ROLLBACK");
+            return -1;
+        }
+    }
+
+    return sql_execution("END");
+}
+
+static
+int put_avatar(const void *avatar, size_t len, const char *hash)
+{
+    sqlite3_stmt *stmt;
+    const char *sql;
+    int rc;
+
+    sql = "INSERT OR IGNORE INTO avatars(hash, created_at, avatar)"
+          " VALUES (:hash, :ts, :avatar)";
+
+    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
+        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
+        return -1;
+    }
+
+    rc = sqlite3_bind_text(stmt,
+                           sqlite3_bind_parameter_index(stmt, ":hash"),
+                           hash, -1, NULL);
+    rc |= sqlite3_bind_int64(stmt,
+                             sqlite3_bind_parameter_index(stmt, ":ts"),
+                             time(NULL));
+    rc |= sqlite3_bind_blob(stmt,
+                            sqlite3_bind_parameter_index(stmt, ":avatar"),
+                            avatar, len, NULL);
+    if (SQLITE_OK != rc) {
+        vlogE(TAG_DB "Binding parameter failed");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (SQLITE_DONE != rc) {
+        vlogE(TAG_DB "Inserting avatar failed");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Hash a channel or a user currently refers to, so it can be dropped once
+ * the row points elsewhere. Keyed by did when given, by channel_id if not.
+ */
+static
+int load_avatar_ref(uint64_t chan_id, const char *did, char *hash)
+{
+    sqlite3_stmt *stmt;
+    const char *sql;
+    const char *ref;
+    int rc;
+
+    sql = did ? "SELECT avatar FROM users WHERE did = :key" :
+                "SELECT avatar FROM channels WHERE channel_id = :key";
+
+    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
+        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
+        return -1;
+    }
+
+    rc = did ? sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, ":key"), did, -1, NULL) :
+               sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":key"), chan_id);
+    if (SQLITE_OK != rc) {
+        vlogE(TAG_DB "Binding parameter failed");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    strcpy(hash, AVATAR_NONE);
+    rc = sqlite3_step(stmt);
+    if (SQLITE_ROW == rc && sqlite3_column_type(stmt, 0) == SQLITE_TEXT) {
+        ref = (const char *)sqlite3_column_text(stmt, 0);
+        if (strlen(ref) <= AVATAR_HASH_LEN)
+            strcpy(hash, ref);
+    }
+    sqlite3_finalize(stmt);
+    if (SQLITE_ROW != rc && SQLITE_DONE != rc) {
+        vlogE(TAG_DB "Loading avatar reference failed");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Nothing else refers to avatar blobs, drop one as soon as no channel and
+ * no user points at it anymore.
+ */
+static
+int drop_unused_avatar(const char *hash)
+{
+    sqlite3_stmt *stmt;
+    const char *sql;
+    int rc;
+
+    if (!strcmp(hash, AVATAR_NONE))
+        return 0;
+
+    sql = "DELETE FROM avatars WHERE hash = :hash"
+          "  AND NOT EXISTS (SELECT 1 FROM channels WHERE avatar = :hash)"
+          "  AND NOT EXISTS (SELECT 1 FROM users WHERE avatar = :hash)";
+
+    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
+        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
+        return -1;
+    }
+
+    rc = sqlite3_bind_text(stmt,
+                           sqlite3_bind_parameter_index(stmt, ":hash"),
+                           hash, -1, NULL);
+    if (SQLITE_OK != rc) {
+        vlogE(TAG_DB "Binding parameter failed");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (SQLITE_DONE != rc) {
+        vlogE(TAG_DB "Dropping unused avatar failed");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Avatars used to be stored inline in channels.avatar and users.avatar.
+ * Move every inline blob into the avatars table and leave its hash (as TEXT)
+ * in place. Rows already converted are skipped. db_init() runs it until
+ * user_version records AVATARS_EXTERNALIZED, so later starts skip the scan.
+ */
+#define AVATARS_EXTERNALIZED 1
+
+static
+int user_version(void)
+{
+    sqlite3_stmt *stmt;
+    int ver = -1;
+
+    if (SQLITE_OK != sqlite3_prepare_v2(db, "PRAGMA user_version", -1, &stmt, NULL)) {
+        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
+        return -1;
+    }
+
+    if (SQLITE_ROW == sqlite3_step(stmt))
+        ver = sqlite3_column_int(stmt, 0);
     sqlite3_finalize(stmt);
-    if (rc != SQLITE_DONE) {
-        vlogE(TAG_DB "Delete %s_updated_at_index failed", table_name);
-        return -1;
-    }
 
-    return 0;
+    return ver;
 }
 
 static
-int create_new_index(const char *table_name, const char *para)
+int externalize_avatars(const char *table_name, const char *key_column)
 {
+    std::vector<int64_t> keys;
     sqlite3_stmt *stmt;
-    char sql[128] = {0};
+    char sql[256] = {0};
     int rc;
 
-    snprintf(sql, sizeof(sql), 
-        "CREATE INDEX %s_created_at_index ON %s (%screated_at)", 
-        table_name, table_name, para);
+    snprintf(sql, sizeof(sql),
+        "SELECT %s FROM %s WHERE typeof(avatar) = 'blob'", key_column, table_name);
     if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
-        vlogE(TAG_DB "Creating %s_created_at_index sqlite3_prepare_v2() failed", 
-            table_name);
+        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
         return -1;
     }
-    rc = sqlite3_step(stmt);
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+        keys.push_back(sqlite3_column_int64(stmt, 0));
     sqlite3_finalize(stmt);
     if (rc != SQLITE_DONE) {
-        vlogE(TAG_DB "Creating %s_created_at_index failed", table_name);
+        vlogE(TAG_DB "Collecting inline avatars of %s failed", table_name);
         return -1;
     }
 
-    memset(sql, 0, sizeof(sql));
-    snprintf(sql, sizeof(sql), 
-        "CREATE INDEX %s_updated_at_index ON %s (%supdated_at)", 
-        table_name, table_name, para);
-    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
-        vlogE(TAG_DB "Creating %s_updated_at_index sqlite3_prepare_v2() failed",
-            table_name);
-        return -1;
+    if (keys.empty())
+        return 0;
+
+    vlogI(TAG_DB "Moving %zu avatars of table %s to avatars", keys.size(), table_name);
+
+    for (auto key : keys) {
+        char hash[AVATAR_HASH_LEN + 1];
+        const void *avatar;
+        size_t len;
+
+        snprintf(sql, sizeof(sql),
+            "SELECT avatar, length(avatar) FROM %s WHERE %s = :key", table_name, key_column);
+        if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
+            vlogE(TAG_DB "sqlite3_prepare_v2() failed");
+            return -1;
+        }
+
+        rc = sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":key"), key);
+        if (SQLITE_OK != rc || SQLITE_ROW != sqlite3_step(stmt)) {
+            vlogE(TAG_DB "Loading avatar of %s %" PRId64 " failed", table_name, key);
+            sqlite3_finalize(stmt);
+            return -1;
+        }
+
+        avatar = sqlite3_column_blob(stmt, 0);
+        len = sqlite3_column_int64(stmt, 1);
+        if (len == 1 && *(const unsigned char *)avatar == 0xA0) {  // default placeholder
+            strcpy(hash, AVATAR_NONE);
+        } else {
+            avatar_hash(avatar, len, hash);
+            rc = put_avatar(avatar, len, hash);
+            if (rc < 0) {
+                sqlite3_finalize(stmt);
+                return -1;
+            }
+        }
+        sqlite3_finalize(stmt);
+
+        snprintf(sql, sizeof(sql),
+            "UPDATE %s SET avatar = :hash WHERE %s = :key", table_name, key_column);
+        if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
+            vlogE(TAG_DB "sqlite3_prepare_v2() failed");
+            return -1;
+        }
+
+        rc = sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, ":hash"), hash, -1, NULL);
+        rc |= sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":key"), key);
+        if (SQLITE_OK != rc || SQLITE_DONE != sqlite3_step(stmt)) {
+            vlogE(TAG_DB "Updating avatar of %s %" PRId64 " failed", table_name, key);
+            sqlite3_finalize(stmt);
+            return -1;
+        }
+        sqlite3_finalize(stmt);
     }
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    if (rc != SQLITE_DONE) {
-        vlogE(TAG_DB "Creating %s_updated_at_index failed", table_name);
+
+    return 0;
+}
+
+#define OUTBOX_BUSY_MS 1000
+
+static
+int open_outbox(void)
+{
+    if (SQLITE_OK != sqlite3_open_v2(sqlite3_db_filename(db, "main"), &outbox_db,
+                                     SQLITE_OPEN_READWRITE, NULL)) {
+        vlogE(TAG_DB "Opening outbox connection failed");
+        sqlite3_close(outbox_db);
+        outbox_db = NULL;
         return -1;
     }
+    sqlite3_busy_timeout(outbox_db, OUTBOX_BUSY_MS);
 
     return 0;
 }
@@ -214,6 +999,8 @@ int db_init(sqlite3 *handle)
 {
     db = handle;
     std::vector<DBInitOperator *> operator_vec;
+    char sql[64];
+    int ver;
 
     //init tables operator
     DBInitOperator channels_op;
@@ -276,6 +1063,7 @@ int db_init(sqlite3 *handle)
     posts_op.p_check = check_table_valid;
     posts_op.p_del_idx = delete_old_index;
     posts_op.p_add_idx = create_new_index;
+    posts_op.chunked = true;
     operator_vec.push_back(&posts_op);
 
     DBInitOperator comments_op;
@@ -310,6 +1098,7 @@ int db_init(sqlite3 *handle)
     comments_op.p_check = check_table_valid;
     comments_op.p_del_idx = delete_old_index;
     comments_op.p_add_idx = create_new_index;
+    comments_op.chunked = true;
     operator_vec.push_back(&comments_op);
 
     DBInitOperator users_op;
@@ -325,11 +1114,11 @@ int db_init(sqlite3 *handle)
         "  display_name TEXT NOT NULL DEFAULT 'NA',"
         "  update_at    REAL NOT NULL,"
         "  memo         TEXT NOT NULL DEFAULT 'NA',"
-        "  avatar       BLOB NOT NULL DEFAULT X'A0'"
+        "  avatar       BLOB NOT NULL DEFAULT 'NA'"
         ")";
     sprintf(users_op.retrive_sql,
             "INSERT INTO users SELECT"
-            " user_id, did, name, email, 'NA', %lu, 'NA', X'A0'"
+            " user_id, did, name, email, 'NA', %lu, 'NA', 'NA'"
             " FROM users_backup", time(NULL));
     users_op.p_check = check_table_valid;
     users_op.p_del_idx = NULL;
@@ -381,6 +1170,7 @@ int db_init(sqlite3 *handle)
     likes_op.p_check = check_table_valid;
     likes_op.p_del_idx = NULL;
     likes_op.p_add_idx = NULL;
+    likes_op.chunked = true;
     operator_vec.push_back(&likes_op);
 
     DBInitOperator reported_comments_op;
@@ -451,6 +1241,141 @@ int db_init(sqlite3 *handle)
     notification_op.p_add_idx = NULL;
     operator_vec.push_back(&notification_op);
 
+    DBInitOperator avatars_op;
+    avatars_op.item_num = 3;
+    avatars_op.table_name = "avatars";
+    avatars_op.idx_param = NULL;
+    avatars_op.backup_sql = NULL;
+    avatars_op.create_sql = "CREATE TABLE IF NOT EXISTS avatars ("
+        "  hash       TEXT NOT NULL PRIMARY KEY,"
+        "  created_at REAL NOT NULL,"
+        "  avatar     BLOB NOT NULL"
+        ")";
+    memset(avatars_op.retrive_sql, 0, sizeof(avatars_op.retrive_sql));
+    avatars_op.p_check = check_table_valid;
+    avatars_op.p_del_idx = NULL;
+    avatars_op.p_add_idx = NULL;
+    operator_vec.push_back(&avatars_op);
+
+    DBInitOperator outbox_op;
+    outbox_op.item_num = 4;
+    outbox_op.table_name = "outbox";
+    outbox_op.idx_param = "node_id";
+    outbox_op.backup_sql = NULL;
+    outbox_op.create_sql = "CREATE TABLE IF NOT EXISTS outbox ("
+        "  seq        INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "  node_id    TEXT NOT NULL,"
+        "  created_at REAL NOT NULL,"
+        "  payload    BLOB NOT NULL"
+        ")";
+    memset(outbox_op.retrive_sql, 0, sizeof(outbox_op.retrive_sql));
+    outbox_op.p_check = check_table_valid;
+    outbox_op.p_del_idx = NULL;
+    outbox_op.p_add_idx = create_key_index;
+    operator_vec.push_back(&outbox_op);
+
+    DBInitOperator changes_op;
+    changes_op.item_num = 6;
+    changes_op.table_name = "changes";
+    changes_op.idx_param = "channel_id, seq";
+    changes_op.backup_sql = NULL;
+    changes_op.create_sql = "CREATE TABLE IF NOT EXISTS changes ("
+        "  seq        INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "  kind       INTEGER NOT NULL,"
+        "  channel_id INTEGER NOT NULL,"
+        "  post_id    INTEGER NOT NULL,"
+        "  comment_id INTEGER NOT NULL,"
+        "  created_at REAL    NOT NULL"
+        ")";
+    memset(changes_op.retrive_sql, 0, sizeof(changes_op.retrive_sql));
+    changes_op.p_check = check_table_valid;
+    changes_op.p_del_idx = NULL;
+    changes_op.p_add_idx = create_key_index;
+    operator_vec.push_back(&changes_op);
+
+    // maintained off the request path by SearchIndex, see feedsd-ext.
+    DBInitOperator search_docs_op;
+    search_docs_op.item_num = 4;
+    search_docs_op.table_name = "search_docs";
+    search_docs_op.idx_param = NULL;
+    search_docs_op.backup_sql = NULL;
+    search_docs_op.create_sql = "CREATE TABLE IF NOT EXISTS search_docs ("
+        "  doc_id     INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "  channel_id INTEGER NOT NULL,"
+        "  post_id    INTEGER NOT NULL,"
+        "  comment_id INTEGER NOT NULL,"
+        "  UNIQUE(channel_id, post_id, comment_id)"
+        ")";
+    memset(search_docs_op.retrive_sql, 0, sizeof(search_docs_op.retrive_sql));
+    search_docs_op.p_check = check_table_valid;
+    search_docs_op.p_del_idx = NULL;
+    search_docs_op.p_add_idx = NULL;
+    operator_vec.push_back(&search_docs_op);
+
+    DBInitOperator search_index_op;
+    search_index_op.item_num = 1;
+    search_index_op.table_name = "search_index";
+    search_index_op.idx_param = NULL;
+    search_index_op.backup_sql = NULL;
+    search_index_op.create_sql = "CREATE VIRTUAL TABLE IF NOT EXISTS search_index"
+        "  USING fts5(content, tokenize = 'unicode61 remove_diacritics 2')";
+    memset(search_index_op.retrive_sql, 0, sizeof(search_index_op.retrive_sql));
+    search_index_op.p_check = check_table_valid;
+    search_index_op.p_del_idx = NULL;
+    search_index_op.p_add_idx = NULL;
+    operator_vec.push_back(&search_index_op);
+
+    DBInitOperator search_state_op;
+    search_state_op.item_num = 4;
+    search_state_op.table_name = "search_state";
+    search_state_op.idx_param = NULL;
+    search_state_op.backup_sql = NULL;
+    search_state_op.create_sql = "CREATE TABLE IF NOT EXISTS search_state ("
+        "  id             INTEGER PRIMARY KEY CHECK (id = 0),"
+        "  cursor         INTEGER NOT NULL,"
+        "  posts_rowid    INTEGER NOT NULL,"
+        "  comments_rowid INTEGER NOT NULL"
+        ")";
+    memset(search_state_op.retrive_sql, 0, sizeof(search_state_op.retrive_sql));
+    search_state_op.p_check = check_table_valid;
+    search_state_op.p_del_idx = NULL;
+    search_state_op.p_add_idx = NULL;
+    operator_vec.push_back(&search_state_op);
+
+    // home timeline, maintained by db_add_post/db_set_post_status/db_add_sub/db_unsub.
+    DBInitOperator timeline_op;
+    timeline_op.item_num = 4;
+    timeline_op.table_name = "timeline";
+    timeline_op.idx_param = "channel_id, post_id";
+    timeline_op.backup_sql = NULL;
+    timeline_op.create_sql = "CREATE TABLE IF NOT EXISTS timeline ("
+        "  user_id    INTEGER NOT NULL,"
+        "  created_at REAL    NOT NULL,"
+        "  channel_id INTEGER NOT NULL,"
+        "  post_id    INTEGER NOT NULL,"
+        "  PRIMARY KEY(user_id, created_at, channel_id, post_id)"
+        ") WITHOUT ROWID";
+    memset(timeline_op.retrive_sql, 0, sizeof(timeline_op.retrive_sql));
+    timeline_op.p_check = check_table_valid;
+    timeline_op.p_del_idx = NULL;
+    timeline_op.p_add_idx = create_key_index;
+    operator_vec.push_back(&timeline_op);
+
+    DBInitOperator timeline_channels_op;
+    timeline_channels_op.item_num = 2;
+    timeline_channels_op.table_name = "timeline_channels";
+    timeline_channels_op.idx_param = NULL;
+    timeline_channels_op.backup_sql = NULL;
+    timeline_channels_op.create_sql = "CREATE TABLE IF NOT EXISTS timeline_channels ("
+        "  channel_id INTEGER PRIMARY KEY,"
+        "  fanout     INTEGER NOT NULL"
+        ")";
+    memset(timeline_channels_op.retrive_sql, 0, sizeof(timeline_channels_op.retrive_sql));
+    timeline_channels_op.p_check = check_table_valid;
+    timeline_channels_op.p_del_idx = NULL;
+    timeline_channels_op.p_add_idx = NULL;
+    operator_vec.push_back(&timeline_channels_op);
+
     /* ================== stmt-sep BEGIN ================== */
     if (-1 == sql_execution("BEGIN")) {
         vlogE(TAG_DB "BEGIN sql failed");
@@ -495,6 +1420,9 @@ int db_init(sqlite3 *handle)
                 vlogD(TAG_DB "Create table %s new index done", (*it)->table_name);
             }
 
+            if ((*it)->chunked)    //rows are copied by migrate_routine() after startup
+                continue;
+
             if (-1 == sql_execution((*it)->retrive_sql)) {    //sync table data from backup
                 vlogE(TAG_DB "Retrive table %s failed", (*it)->table_name);
                 goto rollback;
@@ -521,12 +1449,45 @@ int db_init(sqlite3 *handle)
         }
     }
 
+    ver = user_version();
+    if (ver < 0) {
+        vlogE(TAG_DB "Reading user_version failed");
+        goto rollback;
+    }
+
+    if (ver < AVATARS_EXTERNALIZED) {
+        if (-1 == externalize_avatars("channels", "channel_id") ||
+            -1 == externalize_avatars("users", "user_id")) {
+            vlogE(TAG_DB "Moving avatars out of channels and users failed");
+            goto rollback;
+        }
+
+        snprintf(sql, sizeof(sql), "PRAGMA user_version = %d", AVATARS_EXTERNALIZED);
+        if (-1 == sql_execution(sql)) {
+            vlogE(TAG_DB "Recording user_version failed");
+            goto rollback;
+        }
+    }
+
     /* ================== stmt-sep END ================== */
     if (-1 == sql_execution("END")) {
         vlogE(TAG_DB "END sql failed");
         goto rollback;
     }
 
+    if (-1 == create_query_indexes())
+        return -1;
+
+    // after the query indexes, CREATE INDEX ON <table> would resolve to
+    // the temp view shadowing a migrating table.
+    if (!outbox_db && -1 == open_outbox())
+        return -1;
+
+    if (-1 == start_migrations(operator_vec)) {
+        vlogE(TAG_DB "Starting table migrations failed");
+        return -1;
+    }
+
     vlogI(TAG_DB "db init done");
     return 0;
 
@@ -545,6 +1506,9 @@ int db_create_chan(const ChanInfo *ci)
     const char *sql;
     int rc;
 
+    if (put_avatar(ci->avatar, ci->len, ci->avatar_hash) < 0)
+        return -1;
+
     sql = "INSERT INTO channels(created_at, updated_at,"
           " name, intro, avatar, iid, memo, tip_methods, proof) "
           " VALUES (:ts, :ts, :name, :intro, :avatar, 'NA', 'NA', :tip_methods, :proof)";
@@ -564,9 +1528,9 @@ int db_create_chan(const ChanInfo *ci)
     rc |= sqlite3_bind_text(stmt,
                             sqlite3_bind_parameter_index(stmt, ":intro"),
                             ci->intro, -1, NULL);
-    rc |= sqlite3_bind_blob(stmt,
+    rc |= sqlite3_bind_text(stmt,
                             sqlite3_bind_parameter_index(stmt, ":avatar"),
-                            ci->avatar, ci->len, NULL);
+                            ci->avatar_hash, -1, NULL);
     rc |= sqlite3_bind_text(stmt,  //v2.0
                             sqlite3_bind_parameter_index(stmt, ":tip_methods"),
                             ci->tip_methods, -1, NULL);
@@ -586,15 +1550,27 @@ int db_create_chan(const ChanInfo *ci)
         return -1;
     }
 
+    // channel rows are written outside a transaction, a lost journal entry
+    // only delays delta sync until the next change of this channel.
+    if (journal_add(CHANGE_CHAN_NEW, ci->chan_id, 0, 0) < 0)
+        vlogW(TAG_DB "Journaling channel [%" PRIu64 "] change failed", ci->chan_id);
+
     return 0;
 }
 
 int db_upd_chan(const ChanInfo *ci)
 {
+    char old_hash[AVATAR_HASH_LEN + 1];
     sqlite3_stmt *stmt;
     const char *sql;
     int rc;
 
+    if (load_avatar_ref(ci->chan_id, NULL, old_hash) < 0)
+        return -1;
+
+    if (put_avatar(ci->avatar, ci->len, ci->avatar_hash) < 0)
+        return -1;
+
     sql = "UPDATE channels"
           "  SET updated_at = :upd_at, name = :name, intro = :intro,"
           "  avatar = :avatar, tip_methods = :tipm, proof = :proof"
@@ -614,9 +1590,9 @@ int db_upd_chan(const ChanInfo *ci)
     rc |= sqlite3_bind_text(stmt,
                            sqlite3_bind_parameter_index(stmt, ":intro"),
                            ci->intro, -1, NULL);
-    rc |= sqlite3_bind_blob(stmt,
+    rc |= sqlite3_bind_text(stmt,
                            sqlite3_bind_parameter_index(stmt, ":avatar"),
-                           ci->avatar, ci->len, NULL);
+                           ci->avatar_hash, -1, NULL);
     rc |= sqlite3_bind_text(stmt,
                            sqlite3_bind_parameter_index(stmt, ":tipm"),
                            ci->tip_methods, -1, NULL);
@@ -639,6 +1615,14 @@ int db_upd_chan(const ChanInfo *ci)
         return -1;
     }
 
+    if (strcmp(old_hash, ci->avatar_hash) && drop_unused_avatar(old_hash) < 0)
+        vlogW(TAG_DB "Dropping replaced avatar of channel [%" PRIu64 "] failed", ci->chan_id);
+
+    // channel rows are written outside a transaction, a lost journal entry
+    // only delays delta sync until the next change of this channel.
+    if (journal_add(CHANGE_CHAN_UPD, ci->chan_id, 0, 0) < 0)
+        vlogW(TAG_DB "Journaling channel [%" PRIu64 "] change failed", ci->chan_id);
+
     return 0;
 }
 
@@ -663,7 +1647,7 @@ int db_add_post(const PostInfo *pi)
     }
 
     do {
-        sql = "INSERT INTO posts(channel_id, post_id, created_at, updated_at,"
+        sql = "INSERT INTO main.posts(channel_id, post_id, created_at, updated_at,"
             "  content, status, hash_id, proof, origin_post_url, thumbnails, iid, memo) "
             "  VALUES (:channel_id, :post_id, :ts, :ts, :content, :status,"
             "  :hash_id, :proof, :origin_post_url, :thumbnails, 'NA', 'NA')";  //2.0
@@ -738,6 +1722,12 @@ int db_add_post(const PostInfo *pi)
             break;
         }
 
+        if (journal_add(CHANGE_POST_NEW, pi->chan_id, pi->post_id, 0) < 0)
+            break;
+
+        if (timeline_add_post(pi->chan_id, pi->post_id) < 0)
+            break;
+
         sql = "END";
 
         if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
@@ -821,6 +1811,10 @@ int db_upd_post(PostInfo *pi)
     const char *sql;
     int rc;
 
+    if (migrate_rows("posts", "channel_id = %" PRIu64 " AND post_id = %" PRIu64,
+                     pi->chan_id, pi->post_id) < 0)
+        return -1;
+
     sql = "BEGIN";
 
     if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
@@ -836,7 +1830,7 @@ int db_upd_post(PostInfo *pi)
     }
 
     do {
-        sql = "UPDATE posts"
+        sql = "UPDATE main.posts"
               "  SET updated_at = :upd_at, content = :content,"
               "  hash_id = :hash_id, proof = :proof,"  //2.0
               "  origin_post_url = :origin_post_url, thumbnails = :thumbnails"
@@ -917,6 +1911,9 @@ int db_upd_post(PostInfo *pi)
         pi->created_at = sqlite3_column_int64(stmt, 2);
         sqlite3_finalize(stmt);
 
+        if (journal_add(CHANGE_POST_UPD, pi->chan_id, pi->post_id, 0) < 0)
+            break;
+
         sql = "END";
 
         if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
@@ -956,6 +1953,10 @@ int db_set_post_status(PostInfo *pi)
     const char *sql;
     int rc;
 
+    if (migrate_rows("posts", "channel_id = %" PRIu64 " AND post_id = %" PRIu64,
+                     pi->chan_id, pi->post_id) < 0)
+        return -1;
+
     sql = "BEGIN";
 
     if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
@@ -971,7 +1972,7 @@ int db_set_post_status(PostInfo *pi)
     }
 
     do {
-        sql = "UPDATE posts"
+        sql = "UPDATE main.posts"
               "  SET status = :status"
               "  WHERE channel_id = :channel_id AND post_id = :post_id";
 
@@ -1034,6 +2035,15 @@ int db_set_post_status(PostInfo *pi)
         pi->created_at = sqlite3_column_int64(stmt, 2);
         sqlite3_finalize(stmt);
 
+        if (journal_add(CHANGE_POST_STATUS, pi->chan_id, pi->post_id, 0) < 0)
+            break;
+
+        if (pi->stat == POST_DELETED &&
+            timeline_exec("DELETE FROM timeline"
+                          "  WHERE channel_id = :channel_id AND post_id = :post_id",
+                          0, pi->chan_id, pi->post_id) < 0)
+            break;
+
         sql = "END";
 
         if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
@@ -1211,6 +2221,10 @@ int db_add_cmt(CmtInfo *ci, uint64_t *id)
     const char *sql;
     int rc;
 
+    if (migrate_rows("posts", "channel_id = %" PRIu64 " AND post_id = %" PRIu64,
+                     ci->chan_id, ci->post_id) < 0)
+        return -1;
+
     sql = "BEGIN";
 
     if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
@@ -1226,7 +2240,7 @@ int db_add_cmt(CmtInfo *ci, uint64_t *id)
     }
 
     do {
-        sql = "INSERT INTO comments("
+        sql = "INSERT INTO main.comments("
               "  channel_id, post_id, comment_id, "
               "  refcomment_id, user_id, created_at, updated_at, content,"
               "  hash_id, proof, thumbnails, iid, memo"  //2.0
@@ -1284,7 +2298,7 @@ int db_add_cmt(CmtInfo *ci, uint64_t *id)
             break;
         }
 
-        sql = "UPDATE posts "
+        sql = "UPDATE main.posts "
               "  SET next_comment_id = next_comment_id + 1 "
               "  WHERE channel_id = :channel_id AND post_id = :post_id";
 
@@ -1342,6 +2356,9 @@ int db_add_cmt(CmtInfo *ci, uint64_t *id)
         *id = sqlite3_column_int64(stmt, 0);
         sqlite3_finalize(stmt);
 
+        if (journal_add(CHANGE_CMT_NEW, ci->chan_id, ci->post_id, *id) < 0)
+            break;
+
         sql = "END";
 
         if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
@@ -1578,6 +2595,10 @@ int db_upd_cmt(CmtInfo *ci)
     const char *sql;
     int rc;
 
+    if (migrate_rows("comments", "channel_id = %" PRIu64 " AND post_id = %" PRIu64
+                     " AND comment_id = %" PRIu64, ci->chan_id, ci->post_id, ci->cmt_id) < 0)
+        return -1;
+
     sql = "BEGIN";
 
     if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
@@ -1593,7 +2614,7 @@ int db_upd_cmt(CmtInfo *ci)
     }
 
     do {
-        sql = "UPDATE comments"
+        sql = "UPDATE main.comments"
               "  SET updated_at = :upd_at, content = :content,"
               "  refcomment_id = :ref_cmt_id, hash_id = :hash_id,"  //2.0
               "  proof = :proof, thumbnails = :thumbnails"
@@ -1680,6 +2701,9 @@ int db_upd_cmt(CmtInfo *ci)
         sqlite3_finalize(stmt);
 
 
+        if (journal_add(CHANGE_CMT_UPD, ci->chan_id, ci->post_id, ci->cmt_id) < 0)
+            break;
+
         sql = "END";
 
         if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
@@ -1719,6 +2743,10 @@ int db_set_cmt_status(CmtInfo *ci)
     const char *sql;
     int rc;
 
+    if (migrate_rows("comments", "channel_id = %" PRIu64 " AND post_id = %" PRIu64
+                     " AND comment_id = %" PRIu64, ci->chan_id, ci->post_id, ci->cmt_id) < 0)
+        return -1;
+
     sql = "BEGIN";
 
     if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
@@ -1734,7 +2762,7 @@ int db_set_cmt_status(CmtInfo *ci)
     }
 
     do {
-        sql = "UPDATE comments"
+        sql = "UPDATE main.comments"
               "  SET updated_at = :upd_at, status = :deleted"
               "  WHERE channel_id = :channel_id AND post_id = :post_id AND comment_id = :comment_id";
 
@@ -1806,6 +2834,9 @@ int db_set_cmt_status(CmtInfo *ci)
         ci->created_at   = sqlite3_column_int64(stmt, 2);
         sqlite3_finalize(stmt);
 
+        if (journal_add(CHANGE_CMT_STATUS, ci->chan_id, ci->post_id, ci->cmt_id) < 0)
+            break;
+
         sql = "END";
 
         if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
@@ -1839,52 +2870,187 @@ int db_set_cmt_status(CmtInfo *ci)
     return -1;
 }
 
-int db_like_exists(uint64_t uid, uint64_t channel_id, uint64_t post_id, uint64_t comment_id)
+/*
+ * Set of user ids. User ids are small dense integers, so as with roaring
+ * containers the set is a sorted array while sparse and becomes a bitmap as
+ * soon as that is no bigger: at most 8 bytes per member, which is 8MB per
+ * million, and down to one bit per user id once dense. A bitmap that a far
+ * away user id or removals would make more than twice that size goes back
+ * to an array, so no set ever takes more than 16 bytes per member.
+ */
+class UidSet {
+public:
+    bool has(uint64_t uid) const {
+        if (!bitmap.empty())
+            return uid / 64 < bitmap.size() && (bitmap[uid / 64] >> (uid % 64)) & 1;
+        return std::binary_search(array.begin(), array.end(), uid);
+    }
+
+    void add(uint64_t uid) {
+        if (has(uid))
+            return;
+        cnt++;
+        if (!bitmap.empty() && uid / 64 + 1 > 2 * cnt)
+            to_array();
+        if (bitmap.empty()) {
+            array.insert(std::upper_bound(array.begin(), array.end(), uid), uid);
+            if (array.back() / 64 + 1 <= array.size())
+                to_bitmap();
+            return;
+        }
+        if (uid / 64 >= bitmap.size())
+            bitmap.resize(uid / 64 + 1, 0);
+        bitmap[uid / 64] |= (uint64_t)1 << (uid % 64);
+    }
+
+    void rm(uint64_t uid) {
+        if (!has(uid))
+            return;
+        cnt--;
+        if (bitmap.empty()) {
+            array.erase(std::lower_bound(array.begin(), array.end(), uid));
+            return;
+        }
+        bitmap[uid / 64] &= ~((uint64_t)1 << (uid % 64));
+        if (bitmap.size() > 2 * cnt)
+            to_array();
+    }
+
+    size_t count() const {
+        return cnt;
+    }
+
+private:
+    void to_bitmap() {
+        bitmap.assign(array.back() / 64 + 1, 0);
+        for (auto id : array)
+            bitmap[id / 64] |= (uint64_t)1 << (id % 64);
+        std::vector<uint64_t>().swap(array);
+    }
+
+    void to_array() {
+        array.reserve(cnt);
+        for (size_t i = 0; i < bitmap.size(); ++i) {
+            for (uint64_t word = bitmap[i]; word; word &= word - 1)
+                array.push_back(i * 64 + __builtin_ctzll(word));
+        }
+        std::vector<uint64_t>().swap(bitmap);
+    }
+
+    std::vector<uint64_t> array;
+    std::vector<uint64_t> bitmap;
+    size_t cnt = 0;
+};
+
+/*
+ * Like membership of a post (comment_id 0) or comment, loaded on first use
+ * and kept in step by db_add_like/db_rm_like once their transaction is
+ * committed. The LIKE_INDEX_TARGETS most recently used targets are kept.
+ */
+#define LIKE_INDEX_TARGETS 4096
+
+struct LikeTarget {
+    uint64_t channel_id;
+    uint64_t post_id;
+    uint64_t comment_id;
+
+    bool operator==(const LikeTarget &other) const {
+        return channel_id == other.channel_id && post_id == other.post_id &&
+               comment_id == other.comment_id;
+    }
+};
+
+struct LikeTargetHash {
+    size_t operator()(const LikeTarget &t) const {
+        return std::hash<uint64_t>()((t.channel_id * 31 + t.post_id) * 31 + t.comment_id);
+    }
+};
+
+typedef std::list<LikeTarget> LikeLru;
+typedef std::unordered_map<LikeTarget, std::pair<UidSet, LikeLru::iterator>, LikeTargetHash> LikeIndex;
+
+static LikeLru like_lru;
+static LikeIndex like_index;
+
+static
+UidSet *like_index_get(uint64_t channel_id, uint64_t post_id, uint64_t comment_id)
 {
+    LikeTarget target = {channel_id, post_id, comment_id};
     sqlite3_stmt *stmt;
     const char *sql;
+    UidSet set;
     int rc;
 
-    sql = "SELECT EXISTS(SELECT * "
-          "                FROM likes "
-          "                WHERE user_id = :uid AND "
-          "                      channel_id = :channel_id AND "
-          "                      post_id = :post_id AND "
-          "                      comment_id = :comment_id)";
+    auto it = like_index.find(target);
+    if (it != like_index.end()) {
+        like_lru.splice(like_lru.begin(), like_lru, it->second.second);
+        return &it->second.first;
+    }
+
+    sql = "SELECT user_id FROM likes"
+          "  WHERE channel_id = :channel_id AND post_id = :post_id AND comment_id = :comment_id";
 
     if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
         vlogE(TAG_DB "sqlite3_prepare_v2() failed");
-        return -1;
+        return NULL;
     }
 
     rc = sqlite3_bind_int64(stmt,
-            sqlite3_bind_parameter_index(stmt, ":uid"),
-            uid);
-    rc |= sqlite3_bind_int64(stmt,
-            sqlite3_bind_parameter_index(stmt, ":channel_id"),
-            channel_id);
+                            sqlite3_bind_parameter_index(stmt, ":channel_id"),
+                            channel_id);
     rc |= sqlite3_bind_int64(stmt,
-            sqlite3_bind_parameter_index(stmt, ":post_id"),
-            post_id);
+                             sqlite3_bind_parameter_index(stmt, ":post_id"),
+                             post_id);
     rc |= sqlite3_bind_int64(stmt,
-            sqlite3_bind_parameter_index(stmt, ":comment_id"),
-            comment_id);
+                             sqlite3_bind_parameter_index(stmt, ":comment_id"),
+                             comment_id);
     if (SQLITE_OK != rc) {
         vlogE(TAG_DB "Binding parameter failed");
         sqlite3_finalize(stmt);
-        return -1;
+        return NULL;
     }
 
-    if (SQLITE_ROW != sqlite3_step(stmt)) {
+    while (SQLITE_ROW == (rc = sqlite3_step(stmt)))
+        set.add(sqlite3_column_int64(stmt, 0));
+    sqlite3_finalize(stmt);
+    if (SQLITE_DONE != rc) {
         vlogE(TAG_DB "Executing SELECT failed");
-        sqlite3_finalize(stmt);
-        return -1;
+        return NULL;
     }
 
-    rc = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
+    if (like_index.size() >= LIKE_INDEX_TARGETS) {
+        like_index.erase(like_lru.back());
+        like_lru.pop_back();
+    }
 
-    return rc ? 1 : 0;
+    like_lru.push_front(target);
+    it = like_index.emplace(target, std::make_pair(std::move(set), like_lru.begin())).first;
+
+    return &it->second.first;
+}
+
+static
+void like_index_upd(uint64_t uid, uint64_t channel_id, uint64_t post_id, uint64_t comment_id, bool liked)
+{
+    auto it = like_index.find(LikeTarget{channel_id, post_id, comment_id});
+
+    if (it == like_index.end())
+        return;
+
+    if (liked)
+        it->second.first.add(uid);
+    else
+        it->second.first.rm(uid);
+}
+
+int db_like_exists(uint64_t uid, uint64_t channel_id, uint64_t post_id, uint64_t comment_id)
+{
+    UidSet *set = like_index_get(channel_id, post_id, comment_id);
+
+    if (!set)
+        return -1;
+
+    return set->has(uid) ? 1 : 0;
 }
 
 int db_add_like(uint64_t uid, uint64_t channel_id, uint64_t post_id,
@@ -1894,6 +3060,15 @@ int db_add_like(uint64_t uid, uint64_t channel_id, uint64_t post_id,
     const char *sql;
     int rc;
 
+    if (migrate_rows(comment_id ? "comments" : "posts",
+                     comment_id ? "channel_id = %" PRIu64 " AND post_id = %" PRIu64 " AND comment_id = %" PRIu64 :
+                                  "channel_id = %" PRIu64 " AND post_id = %" PRIu64,
+                     channel_id, post_id, comment_id) < 0 ||
+        migrate_rows("likes", "user_id = %" PRIu64 " AND channel_id = %" PRIu64
+                     " AND post_id = %" PRIu64 " AND comment_id = %" PRIu64,
+                     uid, channel_id, post_id, comment_id) < 0)
+        return -1;
+
     sql = "BEGIN";
 
     if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
@@ -1910,12 +3085,12 @@ int db_add_like(uint64_t uid, uint64_t channel_id, uint64_t post_id,
 
     do {
         sql = comment_id ?
-            "UPDATE comments "
+            "UPDATE main.comments "
             "  SET likes = likes + 1 "
             "  WHERE channel_id = :channel_id AND "
             "        post_id = :post_id AND "
             "        comment_id = :comment_id" :
-            "UPDATE posts "
+            "UPDATE main.posts "
             "  SET likes = likes + 1 "
             "  WHERE channel_id = :channel_id AND "
             "        post_id = :post_id";
@@ -1949,7 +3124,7 @@ int db_add_like(uint64_t uid, uint64_t channel_id, uint64_t post_id,
             break;
         }
 
-        sql = "INSERT INTO likes(user_id, channel_id, post_id, comment_id,"
+        sql = "INSERT INTO main.likes(user_id, channel_id, post_id, comment_id,"
               "created_at, proof, memo) "
               "  VALUES (:uid, :channel_id, :post_id, :comment_id, :ts, :proof, 'NA')";
         //keep memo NA 
@@ -2032,6 +3207,9 @@ int db_add_like(uint64_t uid, uint64_t channel_id, uint64_t post_id,
         *likes = sqlite3_column_int64(stmt, 0);
         sqlite3_finalize(stmt);
 
+        if (journal_add(CHANGE_LIKE, channel_id, post_id, comment_id) < 0)
+            break;
+
         sql = "END";
 
         if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
@@ -2046,6 +3224,7 @@ int db_add_like(uint64_t uid, uint64_t channel_id, uint64_t post_id,
             break;
         }
 
+        like_index_upd(uid, channel_id, post_id, comment_id, true);
         return 0;
     } while(0);
 
@@ -2071,6 +3250,15 @@ int db_rm_like(uint64_t uid, uint64_t channel_id, uint64_t post_id, uint64_t com
     const char *sql;
     int rc;
 
+    if (migrate_rows(comment_id ? "comments" : "posts",
+                     comment_id ? "channel_id = %" PRIu64 " AND post_id = %" PRIu64 " AND comment_id = %" PRIu64 :
+                                  "channel_id = %" PRIu64 " AND post_id = %" PRIu64,
+                     channel_id, post_id, comment_id) < 0 ||
+        migrate_rows("likes", "user_id = %" PRIu64 " AND channel_id = %" PRIu64
+                     " AND post_id = %" PRIu64 " AND comment_id = %" PRIu64,
+                     uid, channel_id, post_id, comment_id) < 0)
+        return -1;
+
     sql = "BEGIN";
 
     if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
@@ -2087,12 +3275,12 @@ int db_rm_like(uint64_t uid, uint64_t channel_id, uint64_t post_id, uint64_t com
 
     do {
         sql = comment_id ?
-            "UPDATE comments "
+            "UPDATE main.comments "
             "  SET likes = likes - 1 "
             "  WHERE channel_id = :channel_id AND "
             "        post_id = :post_id AND "
             "        comment_id = :comment_id" :
-            "UPDATE posts "
+            "UPDATE main.posts "
             "  SET likes = likes - 1 "
             "  WHERE channel_id = :channel_id AND "
             "        post_id = :post_id";
@@ -2126,7 +3314,7 @@ int db_rm_like(uint64_t uid, uint64_t channel_id, uint64_t post_id, uint64_t com
             break;
         }
 
-        sql = "DELETE FROM likes "
+        sql = "DELETE FROM main.likes "
               "  WHERE user_id = :uid AND channel_id = :channel_id AND "
               "        post_id = :post_id AND comment_id = :comment_id";
 
@@ -2160,6 +3348,9 @@ int db_rm_like(uint64_t uid, uint64_t channel_id, uint64_t post_id, uint64_t com
             break;
         }
 
+        if (journal_add(CHANGE_UNLIKE, channel_id, post_id, comment_id) < 0)
+            break;
+
         sql = "END";
 
         if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
@@ -2174,6 +3365,7 @@ int db_rm_like(uint64_t uid, uint64_t channel_id, uint64_t post_id, uint64_t com
             break;
         }
 
+        like_index_upd(uid, channel_id, post_id, comment_id, false);
         return 0;
     } while(0);
 
@@ -2193,6 +3385,78 @@ int db_rm_like(uint64_t uid, uint64_t channel_id, uint64_t post_id, uint64_t com
     return -1;
 }
 
+/*
+ * Subscribers of each channel, loaded with one range read of
+ * subscriptions_channel_index the first time a channel is asked about and
+ * kept in step by db_add_sub/db_unsub once their transaction is committed.
+ * Channels are few, so every loaded channel stays.
+ */
+static std::unordered_map<uint64_t, UidSet> suber_index;
+
+static
+UidSet *suber_index_get(uint64_t channel_id)
+{
+    sqlite3_stmt *stmt;
+    const char *sql;
+    UidSet set;
+    int rc;
+
+    auto it = suber_index.find(channel_id);
+    if (it != suber_index.end())
+        return &it->second;
+
+    sql = "SELECT user_id FROM subscriptions WHERE channel_id = :channel_id";
+
+    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
+        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
+        return NULL;
+    }
+
+    rc = sqlite3_bind_int64(stmt,
+                            sqlite3_bind_parameter_index(stmt, ":channel_id"),
+                            channel_id);
+    if (SQLITE_OK != rc) {
+        vlogE(TAG_DB "Binding parameter channel_id failed");
+        sqlite3_finalize(stmt);
+        return NULL;
+    }
+
+    while (SQLITE_ROW == (rc = sqlite3_step(stmt)))
+        set.add(sqlite3_column_int64(stmt, 0));
+    sqlite3_finalize(stmt);
+    if (SQLITE_DONE != rc) {
+        vlogE(TAG_DB "Executing SELECT failed");
+        return NULL;
+    }
+
+    return &suber_index.emplace(channel_id, std::move(set)).first->second;
+}
+
+static
+void suber_index_upd(uint64_t uid, uint64_t channel_id, bool subscribed)
+{
+    auto it = suber_index.find(channel_id);
+
+    if (it == suber_index.end())
+        return;
+
+    if (subscribed)
+        it->second.add(uid);
+    else
+        it->second.rm(uid);
+}
+
+int db_suber_count(uint64_t chan_id, uint64_t *subs)
+{
+    UidSet *set = suber_index_get(chan_id);
+
+    if (!set)
+        return -1;
+
+    *subs = set->count();
+    return 0;
+}
+
 int db_add_sub(uint64_t uid, uint64_t channel_id, const char *proof)
 {
     sqlite3_stmt *stmt;
@@ -2272,6 +3536,14 @@ int db_add_sub(uint64_t uid, uint64_t channel_id, const char *proof)
             break;
         }
 
+        if (timeline_exec("INSERT OR IGNORE INTO timeline(user_id, created_at, channel_id, post_id)"
+                          "  SELECT :uid, created_at, channel_id, post_id FROM posts"
+                          "  WHERE channel_id = :channel_id AND status <> :deleted"
+                          "  AND EXISTS (SELECT 1 FROM timeline_channels"
+                          "              WHERE channel_id = :channel_id AND fanout = 1)",
+                          uid, channel_id, 0) < 0)
+            break;
+
         sql = "END";
 
         if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
@@ -2286,6 +3558,7 @@ int db_add_sub(uint64_t uid, uint64_t channel_id, const char *proof)
             break;
         }
 
+        suber_index_upd(uid, channel_id, true);
         return 0;
     } while(0);
 
@@ -2378,6 +3651,11 @@ int db_unsub(uint64_t uid, uint64_t channel_id)
             break;
         }
 
+        if (timeline_exec("DELETE FROM timeline"
+                          "  WHERE user_id = :uid AND channel_id = :channel_id",
+                          uid, channel_id, 0) < 0)
+            break;
+
         sql = "END";
 
         if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
@@ -2392,6 +3670,7 @@ int db_unsub(uint64_t uid, uint64_t channel_id)
             break;
         }
 
+        suber_index_upd(uid, channel_id, false);
         return 0;
     } while(0);
 
@@ -2411,12 +3690,165 @@ int db_unsub(uint64_t uid, uint64_t channel_id)
     return -1;
 }
 
+/*
+ * Users by uid and by DID, the USER_CACHE_SIZE most recently used. Sign-in
+ * and every listing that shows who commented or liked resolve users here
+ * instead of querying or joining the users table. db_upsert_user and
+ * db_update_user_info drop the entry of the user they change.
+ */
+#define USER_CACHE_SIZE 1024
+
+typedef struct {
+    uint64_t uid;
+    std::string did;
+    std::string name;
+    std::string email;
+    std::string avatar_hash;
+} CachedUser;
+
+typedef std::list<CachedUser> UserLru;
+
+static UserLru user_lru;
+static std::unordered_map<uint64_t, UserLru::iterator> users_by_uid;
+static std::unordered_map<std::string, UserLru::iterator> users_by_did;
+
+static
+int user_cache_get(const char *did, uint64_t uid, const CachedUser **cu)
+{
+    sqlite3_stmt *stmt;
+    const char *sql;
+    CachedUser user;
+    int rc;
+
+    if (did) {
+        auto it = users_by_did.find(did);
+        if (it != users_by_did.end()) {
+            user_lru.splice(user_lru.begin(), user_lru, it->second);
+            *cu = &*it->second;
+            return 0;
+        }
+    } else {
+        auto it = users_by_uid.find(uid);
+        if (it != users_by_uid.end()) {
+            user_lru.splice(user_lru.begin(), user_lru, it->second);
+            *cu = &*it->second;
+            return 0;
+        }
+    }
+
+    sql = did ?
+        "SELECT user_id, did, name, email, avatar FROM users WHERE did = :did" :
+        "SELECT user_id, did, name, email, avatar FROM users WHERE user_id = :uid";
+
+    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
+        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
+        return -1;
+    }
+
+    if (did)
+        rc = sqlite3_bind_text(stmt,
+                               sqlite3_bind_parameter_index(stmt, ":did"),
+                               did, -1, NULL);
+    else
+        rc = sqlite3_bind_int64(stmt,
+                                sqlite3_bind_parameter_index(stmt, ":uid"),
+                                uid);
+    if (SQLITE_OK != rc) {
+        vlogE(TAG_DB "Binding parameter failed");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    rc = sqlite3_step(stmt);
+    if (SQLITE_DONE == rc) {
+        sqlite3_finalize(stmt);
+        *cu = NULL;
+        return 0;
+    }
+
+    if (SQLITE_ROW != rc) {
+        vlogE(TAG_DB "Executing SELECT failed");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    user.uid         = sqlite3_column_int64(stmt, 0);
+    user.did         = (const char *)sqlite3_column_text(stmt, 1);
+    user.name        = (const char *)sqlite3_column_text(stmt, 2);
+    user.email       = (const char *)sqlite3_column_text(stmt, 3);
+    user.avatar_hash = (const char *)sqlite3_column_text(stmt, 4);
+    sqlite3_finalize(stmt);
+
+    if (user_lru.size() >= USER_CACHE_SIZE) {
+        users_by_uid.erase(user_lru.back().uid);
+        users_by_did.erase(user_lru.back().did);
+        user_lru.pop_back();
+    }
+
+    user_lru.push_front(std::move(user));
+    users_by_uid[user_lru.front().uid] = user_lru.begin();
+    users_by_did[user_lru.front().did] = user_lru.begin();
+    *cu = &user_lru.front();
+
+    return 0;
+}
+
+static
+void user_cache_drop(const char *did)
+{
+    auto it = users_by_did.find(did);
+
+    if (it == users_by_did.end())
+        return;
+
+    users_by_uid.erase(it->second->uid);
+    user_lru.erase(it->second);
+    users_by_did.erase(it);
+}
+
+static void dbuinfo_dtor(void *obj);
+
+static
+UserInfo *user_dup(const CachedUser *cu)
+{
+    DBUserInfo *tmp;
+    char *buf;
+
+    tmp = (DBUserInfo *)rc_zalloc(sizeof(DBUserInfo) + cu->did.size() + cu->name.size() +
+                                  cu->email.size() + cu->avatar_hash.size() + 4, dbuinfo_dtor);
+    if (!tmp) {
+        vlogE(TAG_DB "OOM");
+        return NULL;
+    }
+
+    buf = (char *)(tmp + 1);
+    tmp->info.uid   = cu->uid;
+    tmp->info.did   = strcpy(buf, cu->did.c_str());
+    buf += cu->did.size() + 1;
+    tmp->info.name  = strcpy(buf, cu->name.c_str());
+    buf += cu->name.size() + 1;
+    tmp->info.email = strcpy(buf, cu->email.c_str());
+    buf += cu->email.size() + 1;
+    tmp->info.avatar_hash = strcpy(buf, cu->avatar_hash.c_str());
+
+    return &tmp->info;
+}
+
 int db_update_user_info(const UserInfo *ui)
 {
+    char old_hash[AVATAR_HASH_LEN + 1];
+    char hash[AVATAR_HASH_LEN + 1];
     sqlite3_stmt *stmt;
     const char *sql;
     int rc;
 
+    if (load_avatar_ref(0, ui->did, old_hash) < 0)
+        return -1;
+
+    avatar_hash(ui->avatar, ui->len, hash);
+    if (put_avatar(ui->avatar, ui->len, hash) < 0)
+        return -1;
+
     sql = "UPDATE users"
         "  SET name = :name, email = :email, display_name = :display_name,"
         "  avatar = :avatar, update_at = :upd_at, memo = 'NA'"
@@ -2439,9 +3871,9 @@ int db_update_user_info(const UserInfo *ui)
     rc |= sqlite3_bind_text(stmt,
             sqlite3_bind_parameter_index(stmt, ":display_name"),
             ui->display_name, -1, NULL);
-    rc |= sqlite3_bind_blob(stmt,
+    rc |= sqlite3_bind_text(stmt,
             sqlite3_bind_parameter_index(stmt, ":avatar"),
-            ui->avatar, ui->len, NULL);
+            hash, -1, NULL);
     rc |= sqlite3_bind_int64(stmt,  //v2.0
             sqlite3_bind_parameter_index(stmt, ":upd_at"),
             time(NULL));
@@ -2458,16 +3890,28 @@ int db_update_user_info(const UserInfo *ui)
         return -1;
     }
 
+    if (strcmp(old_hash, hash) && drop_unused_avatar(old_hash) < 0)
+        vlogW(TAG_DB "Dropping replaced avatar of user [%s] failed", ui->did);
+
+    user_cache_drop(ui->did);
     return 0;
 }
 
 
 int db_upsert_user(const UserInfo *ui, uint64_t *uid)
 {
+    char hash[AVATAR_HASH_LEN + 1] = AVATAR_NONE;
+    const CachedUser *cu;
     sqlite3_stmt *stmt;
     const char *sql;
     int rc;
 
+    if (NULL != ui->avatar) {
+        avatar_hash(ui->avatar, ui->len, hash);
+        if (put_avatar(ui->avatar, ui->len, hash) < 0)
+            return -1;
+    }
+
     sql = "INSERT INTO users(did, name, email, display_name, update_at, memo, avatar)"
           " VALUES (:did, :name, :email, :display_name, :upd_at, 'NA', :avatar)"
           " ON CONFLICT (did) "
@@ -2500,16 +3944,9 @@ int db_upsert_user(const UserInfo *ui, uint64_t *uid)
     rc |= sqlite3_bind_int64(stmt,  //v2.0
             sqlite3_bind_parameter_index(stmt, ":upd_at"),
             time(NULL));
-    if (NULL != ui->avatar) {
-        rc |= sqlite3_bind_blob(stmt,  //2.0
-                sqlite3_bind_parameter_index(stmt, ":avatar"),
-                ui->avatar, ui->len, NULL);
-    } else {
-        const char n = 0xA0;
-        rc |= sqlite3_bind_blob(stmt,  //2.0
-                sqlite3_bind_parameter_index(stmt, ":avatar"),
-                &n, 1, NULL);
-    }
+    rc |= sqlite3_bind_text(stmt,  //2.0
+            sqlite3_bind_parameter_index(stmt, ":avatar"),
+            hash, -1, NULL);
     if (SQLITE_OK != rc) {
         vlogE(TAG_DB "Binding parameter failed");
         sqlite3_finalize(stmt);
@@ -2523,30 +3960,17 @@ int db_upsert_user(const UserInfo *ui, uint64_t *uid)
         return -1;
     }
 
-    sql = "SELECT user_id FROM users WHERE did = :did";
-
-    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
-        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
-        return -1;
-    }
-
-    rc = sqlite3_bind_text(stmt,
-            sqlite3_bind_parameter_index(stmt, ":did"),
-            ui->did, -1, NULL);
-    if (SQLITE_OK != rc) {
-        vlogE(TAG_DB "Binding parameter did failed");
-        sqlite3_finalize(stmt);
-        return -1;
-    }
+    // an existing user keeps its avatar, leaving the one just stored unused.
+    if (drop_unused_avatar(hash) < 0)
+        vlogW(TAG_DB "Dropping unused avatar of user [%s] failed", ui->did);
 
-    if (SQLITE_ROW != sqlite3_step(stmt)) {
-        vlogE(TAG_DB "Executing SELECT failed");
-        sqlite3_finalize(stmt);
+    user_cache_drop(ui->did);
+    if (user_cache_get(ui->did, 0, &cu) < 0 || !cu) {
+        vlogE(TAG_DB "Reading upserted user failed");
         return -1;
     }
 
-    *uid = sqlite3_column_int64(stmt, 0);
-    sqlite3_finalize(stmt);
+    *uid = cu->uid;
 
     return 0;
 }
@@ -2581,13 +4005,81 @@ const char *query_column(QueryObject qo, QryFld qf)
     }
 }
 
+/*
+ * Unique key columns of each list, in QryCursor.keys order. They follow the
+ * query column in ORDER BY so rows sharing a timestamp have a total order,
+ * and the cursor seeks past the last row on (qcol, keys...) as a row value,
+ * which the key suffixed indexes serve without a sort.
+ */
+static const char *const chan_keys[] = {"channel_id", NULL};
+static const char *const post_keys[] = {"post_id", NULL};
+static const char *const cmt_keys[] = {"comment_id", NULL};
+static const char *const liked_post_keys[] = {"channel_id", "post_id", NULL};
+static const char *const like_keys[] = {"channel_id", "post_id", "comment_id", NULL};
+static const char *const reported_cmt_keys[] = {"channel_id", "post_id", "comment_id", "reporter_id", NULL};
+
+static
+int keyset_clause(char *sql, const QryCriteria *qc, const char *qcol, const char *const *keys)
+{
+    const char *dir = qc->by == ID ? "ASC" : "DESC";
+    int rc = 0;
+    int i;
+
+    if (qc->after.by) {
+        rc += sprintf(sql + rc, " AND (%s", qcol);
+        for (i = 0; keys[i]; ++i) {
+            if (strcmp(keys[i], qcol))
+                rc += sprintf(sql + rc, ", %s", keys[i]);
+        }
+        rc += sprintf(sql + rc, ") %s (:after", qc->by == ID ? ">" : "<");
+        for (i = 0; keys[i]; ++i) {
+            if (strcmp(keys[i], qcol))
+                rc += sprintf(sql + rc, ", :after_key%d", i);
+        }
+        rc += sprintf(sql + rc, ")");
+    }
+
+    rc += sprintf(sql + rc, " ORDER BY %s %s", qcol, dir);
+    for (i = 0; keys[i]; ++i) {
+        if (strcmp(keys[i], qcol))
+            rc += sprintf(sql + rc, ", %s %s", keys[i], dir);
+    }
+
+    return rc;
+}
+
+static
+int keyset_bind(sqlite3_stmt *stmt, const QryCriteria *qc)
+{
+    char name[32];
+    int idx;
+    int rc;
+    int i;
+
+    if (!qc->after.by)
+        return SQLITE_OK;
+
+    rc = sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":after"),
+                            qc->after.val);
+    for (i = 0; i < QRY_CURSOR_KEYS; ++i) {
+        sprintf(name, ":after_key%d", i);
+        idx = sqlite3_bind_parameter_index(stmt, name);
+        if (idx)
+            rc |= sqlite3_bind_int64(stmt, idx, qc->after.keys[i]);
+    }
+
+    return rc;
+}
+
 static
 void it_dtor(void *obj)
 {
     DBObjIt *it = (DBObjIt *)obj;
 
-    if (it->stmt)
+    if (it->stmt) {
+        reqtrace_stmt(it->stmt, it->rows, it->elapsed);
         sqlite3_finalize(it->stmt);
+    }
 }
 
 static
@@ -2608,11 +4100,11 @@ void *row2chan(sqlite3_stmt *stmt)
 {
     const char *name = (const char *)sqlite3_column_text(stmt, 1);
     const char *intro = (const char *)sqlite3_column_text(stmt, 2);
-    size_t avatar_sz = sqlite3_column_int64(stmt, 8);
-    const char *tipm = (const char *)sqlite3_column_text(stmt, 9);
-    const char *proof = (const char *)sqlite3_column_text(stmt, 10);
+    const char *avatar = (const char *)sqlite3_column_text(stmt, 7);
+    const char *tipm = (const char *)sqlite3_column_text(stmt, 8);
+    const char *proof = (const char *)sqlite3_column_text(stmt, 9);
     ChanInfo *ci = (ChanInfo *)rc_zalloc(sizeof(ChanInfo) + strlen(name) + 
-            strlen(intro) + strlen(tipm) + strlen(proof) + 4 + avatar_sz, NULL);
+            strlen(intro) + strlen(tipm) + strlen(proof) + strlen(avatar) + 5, NULL);
     void *buf;
 
     if (!ci) {
@@ -2632,13 +4124,12 @@ void *row2chan(sqlite3_stmt *stmt)
     ci->upd_at       = sqlite3_column_int64(stmt, 5);
     ci->created_at   = sqlite3_column_int64(stmt, 6);
     ci->owner        = &feeds_owner_info;
-    ci->avatar       = memcpy(buf, sqlite3_column_blob(stmt, 7), avatar_sz);
-    buf = (char *)buf + avatar_sz;
-    ci->len          = avatar_sz;
+    ci->avatar_hash  = strcpy((char *)buf, avatar);
+    buf = (char *)buf + strlen(avatar) + 1;
     ci->tip_methods  = strcpy((char *)buf, tipm);
     buf = (char *)buf + strlen(tipm) + 1;
     ci->proof        = strcpy((char *)buf, proof);
-    ci->status       = sqlite3_column_int64(stmt, 11);
+    ci->status       = sqlite3_column_int64(stmt, 10);
 
     return ci;
 }
@@ -2654,17 +4145,16 @@ DBObjIt *db_iter_chans(const QryCriteria *qc)
     rc = sprintf(sql,
             "SELECT channel_id, name, intro, subscribers,"
             " next_post_id, updated_at, created_at, avatar,"
-            " length(avatar), tip_methods, proof, status"
-            " FROM channels");
+            " tip_methods, proof, status"
+            " FROM channels"
+            " WHERE true");
     if (qc->by) {
         qcol = query_column(CHANNEL, (QryFld)qc->by);
-        if (qc->lower || qc->upper)
-            rc += sprintf(sql + rc, " WHERE ");
         if (qc->lower)
-            rc += sprintf(sql + rc, "%s >= :lower", qcol);
+            rc += sprintf(sql + rc, " AND %s >= :lower", qcol);
         if (qc->upper)
-            rc += sprintf(sql + rc, "%s %s <= :upper", qc->lower ? " AND" : "", qcol);
-        rc += sprintf(sql + rc, " ORDER BY %s %s", qcol, qc->by == ID ? "ASC" : "DESC");
+            rc += sprintf(sql + rc, " AND %s <= :upper", qcol);
+        rc += keyset_clause(sql + rc, qc, qcol, chan_keys);
     }
     if (qc->maxcnt)
         rc += sprintf(sql + rc, " LIMIT :maxcnt");
@@ -2707,6 +4197,13 @@ DBObjIt *db_iter_chans(const QryCriteria *qc)
         }
     }
 
+    rc = keyset_bind(stmt, qc);
+    if (SQLITE_OK != rc) {
+        vlogE(TAG_DB "Binding parameter after failed");
+        sqlite3_finalize(stmt);
+        return NULL;
+    }
+
     it = it_create(stmt, row2chan);
     if (!it) {
         sqlite3_finalize(stmt);
@@ -2716,16 +4213,158 @@ DBObjIt *db_iter_chans(const QryCriteria *qc)
     return it;
 }
 
+static
+void *row2chanmeta(sqlite3_stmt *stmt)
+{
+    const char *name = (const char *)sqlite3_column_text(stmt, 1);
+    ChanInfo *ci = (ChanInfo *)rc_zalloc(sizeof(ChanInfo) + strlen(name) + 1, NULL);
+
+    if (!ci) {
+        vlogE(TAG_DB "OOM");
+        return NULL;
+    }
+
+    ci->chan_id      = sqlite3_column_int64(stmt, 0);
+    ci->name         = strcpy((char *)(ci + 1), name);
+    ci->subs         = sqlite3_column_int64(stmt, 2);
+    ci->next_post_id = sqlite3_column_int64(stmt, 3);
+    ci->upd_at       = sqlite3_column_int64(stmt, 4);
+    ci->created_at   = sqlite3_column_int64(stmt, 5);
+    ci->owner        = &feeds_owner_info;
+    ci->status       = sqlite3_column_int64(stmt, 6);
+
+    return ci;
+}
+
+DBObjIt *db_iter_chan_metas()
+{
+    sqlite3_stmt *stmt;
+    const char *sql;
+    DBObjIt *it;
+
+    sql = "SELECT channel_id, name, subscribers, next_post_id,"
+          " updated_at, created_at, status"
+          " FROM channels";
+
+    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
+        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
+        return NULL;
+    }
+
+    it = it_create(stmt, row2chanmeta);
+    if (!it) {
+        sqlite3_finalize(stmt);
+        return NULL;
+    }
+
+    return it;
+}
+
+int db_get_chan(uint64_t chan_id, ChanInfo **ci)
+{
+    sqlite3_stmt *stmt;
+    const char *sql;
+    int rc;
+
+    sql = "SELECT channel_id, name, intro, subscribers,"
+          " next_post_id, updated_at, created_at, avatar,"
+          " tip_methods, proof, status"
+          " FROM channels WHERE channel_id = :channel_id";
+
+    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
+        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
+        return -1;
+    }
+
+    rc = sqlite3_bind_int64(stmt,
+                            sqlite3_bind_parameter_index(stmt, ":channel_id"),
+                            chan_id);
+    if (SQLITE_OK != rc) {
+        vlogE(TAG_DB "Binding parameter channel_id failed");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    rc = sqlite3_step(stmt);
+    if (SQLITE_DONE == rc) {
+        sqlite3_finalize(stmt);
+        *ci = NULL;
+        return 0;
+    }
+
+    if (SQLITE_ROW != rc) {
+        vlogE(TAG_DB "Executing SELECT failed");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    *ci = (ChanInfo *)row2chan(stmt);
+    sqlite3_finalize(stmt);
+
+    return *ci ? 0 : -1;
+}
+
+/*
+ * Blob behind an avatar hash for clients that still take avatars inline.
+ * Channels without one get the legacy 0xA0 placeholder they used to store.
+ */
+int db_get_avatar(const char *hash, void **avatar, size_t *len)
+{
+    static const unsigned char none = 0xA0;
+    sqlite3_stmt *stmt;
+    const void *blob;
+    const char *sql;
+    int rc;
+
+    sql = "SELECT avatar, length(avatar) FROM avatars WHERE hash = :hash";
+
+    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
+        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
+        return -1;
+    }
+
+    rc = sqlite3_bind_text(stmt,
+                           sqlite3_bind_parameter_index(stmt, ":hash"),
+                           hash, -1, NULL);
+    if (SQLITE_OK != rc) {
+        vlogE(TAG_DB "Binding parameter hash failed");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    rc = sqlite3_step(stmt);
+    if (SQLITE_ROW != rc && SQLITE_DONE != rc) {
+        vlogE(TAG_DB "Executing SELECT failed");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    if (SQLITE_ROW == rc) {
+        blob = sqlite3_column_blob(stmt, 0);
+        *len = sqlite3_column_int64(stmt, 1);
+    } else {
+        blob = &none;
+        *len = sizeof(none);
+    }
+
+    *avatar = rc_zalloc(*len, NULL);
+    if (*avatar)
+        memcpy(*avatar, blob, *len);
+    sqlite3_finalize(stmt);
+
+    return *avatar ? 0 : -1;
+}
+
 static
 void *row2subchan(sqlite3_stmt *stmt)
 {
     const char *name = (const char *)sqlite3_column_text(stmt, 1);
     const char *intro = (const char *)sqlite3_column_text(stmt, 2);
-    size_t avatar_sz = sqlite3_column_int64(stmt, 7);
-    const char *proof = (const char *)sqlite3_column_text(stmt, 8);
+    const char *avatar = (const char *)sqlite3_column_text(stmt, 6);
+    const char *proof = (const char *)sqlite3_column_text(stmt, 7);
 
     ChanInfo *ci = (ChanInfo *)rc_zalloc(sizeof(ChanInfo) 
-            + strlen(name) + strlen(intro) + strlen(proof) + 3 + avatar_sz, NULL);
+            + strlen(name) + strlen(intro) + strlen(proof) + strlen(avatar) + 4, NULL);
     void *buf;
 
     if (!ci) {
@@ -2745,8 +4384,7 @@ void *row2subchan(sqlite3_stmt *stmt)
     ci->created_at  = sqlite3_column_int64(stmt, 4);
     ci->upd_at  = sqlite3_column_int64(stmt, 5);
     ci->owner   = &feeds_owner_info;
-    ci->avatar  = memcpy(buf, sqlite3_column_blob(stmt, 6), avatar_sz);
-    ci->len     = avatar_sz;
+    ci->avatar_hash = strcpy((char *)buf, avatar);
 
     return ci;
 }
@@ -2761,19 +4399,18 @@ DBObjIt *db_iter_sub_chans(uint64_t uid, const QryCriteria *qc)
 
     rc = sprintf(sql,
                  "SELECT channel_id, name, intro, subscribers, created_at, updated_at,"
-                 "  avatar, length(avatar), proof"
+                 "  avatar, proof"
                  "  FROM (SELECT channel_id "
                  "          FROM subscriptions "
-                 "          WHERE user_id = :uid) JOIN channels USING (channel_id)");
+                 "          WHERE user_id = :uid) JOIN channels USING (channel_id)"
+                 "  WHERE true");
     if (qc->by) {
         qcol = query_column(CHANNEL, (QryFld)qc->by);
-        if (qc->lower || qc->upper)
-            rc += sprintf(sql + rc, " WHERE ");
         if (qc->lower)
-            rc += sprintf(sql + rc, "%s >= :lower", qcol);
+            rc += sprintf(sql + rc, " AND %s >= :lower", qcol);
         if (qc->upper)
-            rc += sprintf(sql + rc, "%s %s <= :upper", qc->lower ? " AND" : "", qcol);
-        rc += sprintf(sql + rc, " ORDER BY %s %s", qcol, qc->by == ID ? "ASC" : "DESC");
+            rc += sprintf(sql + rc, " AND %s <= :upper", qcol);
+        rc += keyset_clause(sql + rc, qc, qcol, chan_keys);
     }
     if (qc->maxcnt)
         rc += sprintf(sql +rc, " LIMIT :maxcnt");
@@ -2801,6 +4438,7 @@ DBObjIt *db_iter_sub_chans(uint64_t uid, const QryCriteria *qc)
                                 sqlite3_bind_parameter_index(stmt, ":maxcnt"),
                                 qc->maxcnt);
     }
+    rc |= keyset_bind(stmt, qc);
     if (SQLITE_OK != rc) {
         vlogE(TAG_DB "Binding parameter failed");
         sqlite3_finalize(stmt);
@@ -2867,13 +4505,16 @@ DBObjIt *db_iter_posts(uint64_t chan_id, const QryCriteria *qc)
     DBObjIt *it;
     int rc;
 
+    // omitted blobs keep their slots as NULL with zero length, so row2post()
+    // stays the same and sqlite never loads their overflow pages.
     rc = sprintf(sql,
-                 "SELECT channel_id, post_id, status, content, length(content),"
+                 "SELECT channel_id, post_id, status, %s,"
                  "       next_comment_id - 1 AS comments, likes, created_at,"
-                 "       updated_at, hash_id, proof, origin_post_url, thumbnails,"
-                 "       length(thumbnails)"
+                 "       updated_at, hash_id, proof, origin_post_url, %s"
                  "  FROM posts "
-                 "  WHERE channel_id = :channel_id");  //2.0
+                 "  WHERE channel_id = :channel_id",
+                 qry_omits(qc->omit, QRY_FLD_CONTENT) ? "NULL, 0" : "content, length(content)",
+                 qry_omits(qc->omit, QRY_FLD_THUMBNAILS) ? "NULL, 0" : "thumbnails, length(thumbnails)");  //2.0
     rc += sprintf(sql + rc, " AND (status=%d OR status=%d)", POST_AVAILABLE, POST_DELETED);
     if (qc->by) {
         qcol = query_column(POST, (QryFld)qc->by);
@@ -2881,7 +4522,7 @@ DBObjIt *db_iter_posts(uint64_t chan_id, const QryCriteria *qc)
             rc += sprintf(sql + rc, " AND %s >= :lower", qcol);
         if (qc->upper)
             rc += sprintf(sql + rc, " AND %s <= :upper", qcol);
-        rc += sprintf(sql + rc, " ORDER BY %s %s", qcol, qc->by == ID ? "ASC" : "DESC");
+        rc += keyset_clause(sql + rc, qc, qcol, post_keys);
     }
     if (qc->maxcnt)
         rc += sprintf(sql + rc, " LIMIT :maxcnt");
@@ -2905,6 +4546,7 @@ DBObjIt *db_iter_posts(uint64_t chan_id, const QryCriteria *qc)
         rc |= sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":maxcnt"),
                                 qc->maxcnt);
     }
+    rc |= keyset_bind(stmt, qc);
     if (SQLITE_OK != rc) {
         vlogE(TAG_DB "Binding parameter channel_id failed");
         sqlite3_finalize(stmt);
@@ -2917,9 +4559,11 @@ DBObjIt *db_iter_posts(uint64_t chan_id, const QryCriteria *qc)
         return NULL;
     }
 
-    char* exsql = sqlite3_expanded_sql(stmt);
-    vlogD(TAG_DB "get posts sql: %s", exsql);
-    sqlite3_free(exsql);
+    if (log_level >= VLOG_DEBUG) {
+        char* exsql = sqlite3_expanded_sql(stmt);
+        vlogD(TAG_DB "get posts sql: %s", exsql);
+        sqlite3_free(exsql);
+    }
 
     return it;
 }
@@ -2933,10 +4577,12 @@ void *row2postlac(sqlite3_stmt *stmt)
         return NULL;
     }
 
-    pi->chan_id = sqlite3_column_int64(stmt, 0);
-    pi->post_id = sqlite3_column_int64(stmt, 1);
-    pi->cmts    = sqlite3_column_int64(stmt, 2);
-    pi->likes   = sqlite3_column_int64(stmt, 3);
+    pi->chan_id    = sqlite3_column_int64(stmt, 0);
+    pi->post_id    = sqlite3_column_int64(stmt, 1);
+    pi->cmts       = sqlite3_column_int64(stmt, 2);
+    pi->likes      = sqlite3_column_int64(stmt, 3);
+    pi->created_at = sqlite3_column_int64(stmt, 4);
+    pi->upd_at     = sqlite3_column_int64(stmt, 5);
 
     return pi;
 }
@@ -2950,7 +4596,8 @@ DBObjIt *db_iter_posts_lac(uint64_t chan_id, const QryCriteria *qc)
     int rc;
 
     rc = sprintf(sql,
-                 "SELECT channel_id, post_id, next_comment_id - 1 AS comments, likes"
+                 "SELECT channel_id, post_id, next_comment_id - 1 AS comments, likes,"
+                 "       created_at, updated_at"
                  "  FROM posts "
                  "  WHERE channel_id = :channel_id");
     if (qc->by) {
@@ -2959,7 +4606,7 @@ DBObjIt *db_iter_posts_lac(uint64_t chan_id, const QryCriteria *qc)
             rc += sprintf(sql + rc, " AND %s >= :lower", qcol);
         if (qc->upper)
             rc += sprintf(sql + rc, " AND %s <= :upper", qcol);
-        rc += sprintf(sql + rc, " ORDER BY %s %s", qcol, qc->by == ID ? "ASC" : "DESC");
+        rc += keyset_clause(sql + rc, qc, qcol, post_keys);
     }
     if (qc->maxcnt)
         rc += sprintf(sql + rc, " LIMIT :maxcnt");
@@ -2983,6 +4630,7 @@ DBObjIt *db_iter_posts_lac(uint64_t chan_id, const QryCriteria *qc)
         rc |= sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":maxcnt"),
                                 qc->maxcnt);
     }
+    rc |= keyset_bind(stmt, qc);
     if (SQLITE_OK != rc) {
         vlogE(TAG_DB "Binding parameter channel_id failed");
         sqlite3_finalize(stmt);
@@ -3018,6 +4666,7 @@ void *row2likedpost(sqlite3_stmt *stmt)
     pi->cmts       = sqlite3_column_int64(stmt, 4);
     pi->likes      = sqlite3_column_int64(stmt, 5);
     pi->created_at = sqlite3_column_int64(stmt, 6);
+    pi->upd_at     = sqlite3_column_int64(stmt, 7);
 
     return pi;
 }
@@ -3032,7 +4681,7 @@ DBObjIt *db_iter_liked_posts(uint64_t uid, const QryCriteria *qc)
 
     rc = sprintf(sql,
                  "SELECT channel_id, post_id, content, length(content), "
-                 "       next_comment_id - 1 AS comments, likes, created_at "
+                 "       next_comment_id - 1 AS comments, likes, created_at, updated_at "
                  "  FROM (SELECT channel_id, post_id "
                  "          FROM likes "
                  "          WHERE user_id = :uid AND comment_id = 0) JOIN "
@@ -3044,7 +4693,7 @@ DBObjIt *db_iter_liked_posts(uint64_t uid, const QryCriteria *qc)
             rc += sprintf(sql + rc, " AND %s >= :lower", qcol);
         if (qc->upper)
             rc += sprintf(sql + rc, " AND %s <= :upper", qcol);
-        rc += sprintf(sql + rc, " ORDER BY %s %s", qcol, qc->by == ID ? "ASC" : "DESC");
+        rc += keyset_clause(sql + rc, qc, qcol, liked_post_keys);
     }
     if (qc->maxcnt)
         rc += sprintf(sql + rc, " LIMIT :maxcnt");
@@ -3070,6 +4719,7 @@ DBObjIt *db_iter_liked_posts(uint64_t uid, const QryCriteria *qc)
         rc |= sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":maxcnt"),
                                 qc->maxcnt);
     }
+    rc |= keyset_bind(stmt, qc);
     if (SQLITE_OK != rc) {
         vlogE(TAG_DB "Binding parameter avail failed");
         sqlite3_finalize(stmt);
@@ -3089,12 +4739,20 @@ static
 void *row2likeddata(sqlite3_stmt *stmt)
 {
     const char *proof = (const char *)sqlite3_column_text(stmt, 4);
-    const char *name = (const char *)sqlite3_column_text(stmt, 5);
-    const char *did = (const char *)sqlite3_column_text(stmt, 6);
-    LikeInfo *li = (LikeInfo *)rc_zalloc(sizeof(LikeInfo) + strlen(proof) + 
-            strlen(name) + strlen(did) + 3, NULL);
+    uint64_t uid = sqlite3_column_int64(stmt, 5);
+    const CachedUser *cu;
+    const char *name;
+    const char *did;
+    LikeInfo *li;
     void *buf;
 
+    if (user_cache_get(NULL, uid, &cu) < 0)
+        return NULL;
+
+    name = cu ? cu->name.c_str() : "";
+    did = cu ? cu->did.c_str() : "";
+    li = (LikeInfo *)rc_zalloc(sizeof(LikeInfo) + strlen(proof) +
+            strlen(name) + strlen(did) + 3, NULL);
     if (!li) {
         vlogE(TAG_DB "OOM");
         return NULL;
@@ -3104,6 +4762,7 @@ void *row2likeddata(sqlite3_stmt *stmt)
     li->post_id    = sqlite3_column_int64(stmt, 1);
     li->cmt_id     = sqlite3_column_int64(stmt, 2);
     li->created_at = sqlite3_column_int64(stmt, 3);
+    li->user.uid   = uid;
     buf = li + 1;
     li->user.name    = strcpy((char *)buf, name);
     buf = (char *)buf + strlen(name) + 1;
@@ -3129,7 +4788,7 @@ DBObjIt *db_iter_liked_data(uint64_t uid, const QryCriteria *qc)
                  "          likes USING (user_id)"
                  "  WHERE status = :avail");*/
                  "SELECT channel_id, post_id, comment_id, created_at, proof, "
-                 "  name, did FROM likes JOIN users USING (user_id) "
+                 "  user_id FROM likes "
                  "  where user_id = :uid");
     if (qc->by) {
         qcol = query_column(POST, (QryFld)qc->by);
@@ -3137,7 +4796,7 @@ DBObjIt *db_iter_liked_data(uint64_t uid, const QryCriteria *qc)
             rc += sprintf(sql + rc, " AND %s >= :lower", qcol);
         if (qc->upper)
             rc += sprintf(sql + rc, " AND %s <= :upper", qcol);
-        rc += sprintf(sql + rc, " ORDER BY %s %s", qcol, qc->by == ID ? "ASC" : "DESC");
+        rc += keyset_clause(sql + rc, qc, qcol, like_keys);
     }
     if (qc->maxcnt)
         rc += sprintf(sql + rc, " LIMIT :maxcnt");
@@ -3161,6 +4820,7 @@ DBObjIt *db_iter_liked_data(uint64_t uid, const QryCriteria *qc)
         rc |= sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":maxcnt"),
                                 qc->maxcnt);
     }
+    rc |= keyset_bind(stmt, qc);
     if (SQLITE_OK != rc) {
         vlogE(TAG_DB "Binding parameter failed");
         sqlite3_finalize(stmt);
@@ -3180,17 +4840,25 @@ static
 void *row2cmt(sqlite3_stmt *stmt)
 {
     CmtStat stat = (CmtStat)sqlite3_column_int64(stmt, 3);
-    size_t content_len = stat == CMT_AVAILABLE ? sqlite3_column_int64(stmt, 8) : 0;
-    size_t thu_len = stat == CMT_AVAILABLE ? sqlite3_column_int64(stmt, 15) : 0;
-    const char *hash_id = (const char *)sqlite3_column_text(stmt, 12);  //2.0
-    const char *proof = (const char *)sqlite3_column_text(stmt, 13);  //2.0
-    const char *name = (const char *)sqlite3_column_text(stmt, 5);
-    const char *did = (const char *)sqlite3_column_text(stmt, 6);
-    CmtInfo *ci = (CmtInfo *)rc_zalloc(sizeof(CmtInfo) + content_len + thu_len +
-                            strlen(hash_id) + strlen(proof) + strlen(name) +
-                            strlen(did) + 6, NULL);
+    size_t content_len = stat == CMT_AVAILABLE ? sqlite3_column_int64(stmt, 7) : 0;
+    size_t thu_len = stat == CMT_AVAILABLE ? sqlite3_column_int64(stmt, 14) : 0;
+    const char *hash_id = (const char *)sqlite3_column_text(stmt, 11);  //2.0
+    const char *proof = (const char *)sqlite3_column_text(stmt, 12);  //2.0
+    uint64_t uid = sqlite3_column_int64(stmt, 5);
+    const CachedUser *cu;
+    const char *name;
+    const char *did;
+    CmtInfo *ci;
     void *buf;
 
+    if (user_cache_get(NULL, uid, &cu) < 0)
+        return NULL;
+
+    name = cu ? cu->name.c_str() : "";
+    did = cu ? cu->did.c_str() : "";
+    ci = (CmtInfo *)rc_zalloc(sizeof(CmtInfo) + content_len + thu_len +
+                              strlen(hash_id) + strlen(proof) + strlen(name) +
+                              strlen(did) + 6, NULL);
     if (!ci) {
         vlogE(TAG_DB "OOM");
         return NULL;
@@ -3201,6 +4869,7 @@ void *row2cmt(sqlite3_stmt *stmt)
     ci->cmt_id       = sqlite3_column_int64(stmt, 2);
     ci->stat         = stat;
     ci->reply_to_cmt = sqlite3_column_int64(stmt, 4);
+    ci->user.uid     = uid;
     buf = ci + 1;
     ci->user.name    = strcpy((char *)buf, name);
     buf = (char *)buf + strlen(name) + 1;
@@ -3211,15 +4880,15 @@ void *row2cmt(sqlite3_stmt *stmt)
     ci->proof        = strcpy((char *)buf, proof);  //2.0
     if (stat == CMT_AVAILABLE) {
         buf = (char *)buf + strlen(proof) + 1;  //2.0
-        ci->content  = memcpy(buf, sqlite3_column_blob(stmt, 7), content_len);
+        ci->content  = memcpy(buf, sqlite3_column_blob(stmt, 6), content_len);
         ci->con_len  = content_len;
         buf = (char *)buf + content_len + 1;   //2.0
-        ci->thumbnails = memcpy(buf, sqlite3_column_blob(stmt, 14), thu_len);  //2.0
+        ci->thumbnails = memcpy(buf, sqlite3_column_blob(stmt, 13), thu_len);  //2.0
         ci->thu_len = thu_len;  //2.0
     }
-    ci->likes        = sqlite3_column_int64(stmt, 9);
-    ci->created_at   = sqlite3_column_int64(stmt, 10);
-    ci->upd_at       = sqlite3_column_int64(stmt, 11);
+    ci->likes        = sqlite3_column_int64(stmt, 8);
+    ci->created_at   = sqlite3_column_int64(stmt, 9);
+    ci->upd_at       = sqlite3_column_int64(stmt, 10);
 
     return ci;
 }
@@ -3250,6 +4919,7 @@ void *row2reportedcmt(sqlite3_stmt *stmt)
     buf = (char *)buf + strlen(did) + 1;
     rci->reasons     = strcpy((char *)buf, reasons);
     rci->created_at   = sqlite3_column_int64(stmt, 6);
+    rci->reporter.uid = sqlite3_column_int64(stmt, 7);
 
     return rci;
 }
@@ -3264,17 +4934,19 @@ DBObjIt *db_iter_cmts(uint64_t chan_id, uint64_t post_id, const QryCriteria *qc)
 
     rc = sprintf(sql,
                  "SELECT channel_id, post_id, comment_id, status, refcomment_id, "
-                 "       name, did, content, length(content), likes, created_at, "
-                 "       updated_at, hash_id, proof, thumbnails, length(thumbnails) "
-                 "  FROM comments JOIN users USING (user_id) "
-                 "  WHERE channel_id = :channel_id AND post_id = :post_id");
+                 "       user_id, %s, likes, created_at, "
+                 "       updated_at, hash_id, proof, %s "
+                 "  FROM comments "
+                 "  WHERE channel_id = :channel_id AND post_id = :post_id",
+                 qry_omits(qc->omit, QRY_FLD_CONTENT) ? "NULL, 0" : "content, length(content)",
+                 qry_omits(qc->omit, QRY_FLD_THUMBNAILS) ? "NULL, 0" : "thumbnails, length(thumbnails)");
     if (qc->by) {
         qcol = query_column(COMMENT, (QryFld)qc->by);
         if (qc->lower)
             rc += sprintf(sql + rc, " AND %s >= :lower", qcol);
         if (qc->upper)
             rc += sprintf(sql + rc, " AND %s <= :upper", qcol);
-        rc += sprintf(sql + rc, " ORDER BY %s %s", qcol, qc->by == ID ? "ASC" : "DESC");
+        rc += keyset_clause(sql + rc, qc, qcol, cmt_keys);
     }
     if (qc->maxcnt)
         rc += sprintf(sql + rc, " LIMIT :maxcnt");
@@ -3300,6 +4972,7 @@ DBObjIt *db_iter_cmts(uint64_t chan_id, uint64_t post_id, const QryCriteria *qc)
         rc |= sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":maxcnt"),
                                 qc->maxcnt);
     }
+    rc |= keyset_bind(stmt, qc);
     if (SQLITE_OK != rc) {
         vlogE(TAG_DB "Binding parameter post_id failed");
         sqlite3_finalize(stmt);
@@ -3324,10 +4997,12 @@ void *row2cmtlikes(sqlite3_stmt *stmt)
         return NULL;
     }
 
-    ci->chan_id = sqlite3_column_int64(stmt, 0);
-    ci->post_id = sqlite3_column_int64(stmt, 1);
-    ci->cmt_id  = sqlite3_column_int64(stmt, 2);
-    ci->likes   = sqlite3_column_int64(stmt, 3);
+    ci->chan_id    = sqlite3_column_int64(stmt, 0);
+    ci->post_id    = sqlite3_column_int64(stmt, 1);
+    ci->cmt_id     = sqlite3_column_int64(stmt, 2);
+    ci->likes      = sqlite3_column_int64(stmt, 3);
+    ci->created_at = sqlite3_column_int64(stmt, 4);
+    ci->upd_at     = sqlite3_column_int64(stmt, 5);
 
     return ci;
 }
@@ -3341,7 +5016,7 @@ DBObjIt *db_iter_cmts_likes(uint64_t chan_id, uint64_t post_id, const QryCriteri
     int rc;
 
     rc = sprintf(sql,
-                 "SELECT channel_id, post_id, comment_id, likes"
+                 "SELECT channel_id, post_id, comment_id, likes, created_at, updated_at"
                  "  FROM comments"
                  "  WHERE channel_id = :channel_id AND post_id = :post_id");
     if (qc->by) {
@@ -3350,7 +5025,7 @@ DBObjIt *db_iter_cmts_likes(uint64_t chan_id, uint64_t post_id, const QryCriteri
             rc += sprintf(sql + rc, " AND %s >= :lower", qcol);
         if (qc->upper)
             rc += sprintf(sql + rc, " AND %s <= :upper", qcol);
-        rc += sprintf(sql + rc, " ORDER BY %s %s", qcol, qc->by == ID ? "ASC" : "DESC");
+        rc += keyset_clause(sql + rc, qc, qcol, cmt_keys);
     }
     if (qc->maxcnt)
         rc += sprintf(sql + rc, " LIMIT :maxcnt");
@@ -3377,6 +5052,7 @@ DBObjIt *db_iter_cmts_likes(uint64_t chan_id, uint64_t post_id, const QryCriteri
         rc |= sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":maxcnt"),
                                 qc->maxcnt);
     }
+    rc |= keyset_bind(stmt, qc);
     if (SQLITE_OK != rc) {
         vlogE(TAG_DB "Binding parameter failed");
         sqlite3_finalize(stmt);
@@ -3394,9 +5070,19 @@ DBObjIt *db_iter_cmts_likes(uint64_t chan_id, uint64_t post_id, const QryCriteri
 
 int db_iter_nxt(DBObjIt *it, void **obj)
 {
+    uint64_t step_at = reqtrace_mark();
+    uint64_t row_at;
     int rc;
 
+    if (reqepoch_cancelled()) {
+        *obj = NULL;
+        return -1;
+    }
+
     rc = sqlite3_step(it->stmt);
+    row_at = reqtrace_stage(TRACE_DB, step_at);
+    if (row_at)
+        it->elapsed += row_at - step_at;
     if (rc != SQLITE_ROW) {
         if (rc != SQLITE_DONE)
             vlogE(TAG_DB "sqlite3_step() failed");
@@ -3405,52 +5091,40 @@ int db_iter_nxt(DBObjIt *it, void **obj)
     }
 
     *obj = it->cb(it->stmt);
-    return *obj ? 0 : -1;
+    reqtrace_stage(TRACE_MATERIALIZE, row_at);
+    if (!*obj)
+        return -1;
+
+    ++it->rows;
+    return 0;
 }
 
-int db_is_suber(uint64_t uid, uint64_t chan_id)
+const char *db_iter_sql(DBObjIt *it)
 {
-    sqlite3_stmt *stmt;
-    const char *sql;
-    int rc;
-
-    sql = "SELECT EXISTS("
-          "  SELECT * "
-          "  FROM subscriptions "
-          "  WHERE user_id = :uid AND channel_id = :channel_id"
-          ")";
-
-    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
-        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
-        return -1;
-    }
+    return sqlite3_sql(it->stmt);
+}
 
-    rc = sqlite3_bind_int64(stmt,
-                            sqlite3_bind_parameter_index(stmt, ":uid"),
-                            uid);
-    rc |= sqlite3_bind_int64(stmt,
-                            sqlite3_bind_parameter_index(stmt, ":channel_id"),
-                            chan_id);
-    if (SQLITE_OK != rc) {
-        vlogE(TAG_DB "Binding parameter failed");
-        sqlite3_finalize(stmt);
-        return -1;
-    }
+int db_is_suber(uint64_t uid, uint64_t chan_id)
+{
+    UidSet *set = suber_index_get(chan_id);
 
-    if (SQLITE_ROW != sqlite3_step(stmt)) {
-        vlogE(TAG_DB "Executing SELECT failed");
-        sqlite3_finalize(stmt);
+    if (!set)
         return -1;
-    }
 
-    rc = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
+    return set->has(uid) ? 1 : 0;
+}
 
-    return rc;
+int db_migration_pending()
+{
+    return migrate_pending ? 1 : 0;
 }
 
 void db_deinit()
 {
+    migrate_stop = true;
+    if (migrate_thread.joinable())
+        migrate_thread.join();
+
     // sqlite3_close(db);
     // sqlite3_shutdown();
 }
@@ -3466,144 +5140,49 @@ void dbuinfo_dtor(void *obj)
 
 int db_get_owner(UserInfo **ui)
 {
-    sqlite3_stmt *stmt;
-    const char *sql;
-    DBUserInfo *tmp;
-    int rc;
-
-    sql = "SELECT did, name, email FROM users WHERE user_id = :owner_user_id";
-
-    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
-        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
-        return -1;
-    }
-
-    rc = sqlite3_bind_int64(stmt,
-                            sqlite3_bind_parameter_index(stmt, ":owner_user_id"),
-                            OWNER_USER_ID);
-    if (SQLITE_OK != rc) {
-        vlogE(TAG_DB "Binding parameter owner_uiser_id failed");
-        sqlite3_finalize(stmt);
-        return -1;
-    }
-
-    rc = sqlite3_step(stmt);
-    if (SQLITE_DONE  == rc) {
-        sqlite3_finalize(stmt);
-        *ui = NULL;
-        return 0;
-    }
-
-    if (SQLITE_ROW != rc) {
-        vlogE(TAG_DB "Executing SELECT failed");
-        sqlite3_finalize(stmt);
-        return -1;
-    }
-
-    tmp = (DBUserInfo *)rc_zalloc(sizeof(DBUserInfo), dbuinfo_dtor);
-    if (!tmp) {
-        vlogE(TAG_DB "OOM");
-        sqlite3_finalize(stmt);
-        return -1;
-    }
-
-    tmp->info.uid   = OWNER_USER_ID;
-    tmp->info.did   = (char *)sqlite3_column_text(stmt, 0);
-    tmp->info.name  = (char *)sqlite3_column_text(stmt, 1);
-    tmp->info.email = (char *)sqlite3_column_text(stmt, 2);
-    tmp->stmt       = stmt;
-
-    *ui = &tmp->info;
-
-    return 0;
+    return db_get_user_by_uid(OWNER_USER_ID, ui);
 }
 
 int db_need_upsert_user(const char *did)
 {
-    sqlite3_stmt *stmt;
-    const char *sql;
-    int rc;
-
-    sql = "SELECT EXISTS(SELECT * FROM users WHERE did = :did AND name != 'NA')";
-
-    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
-        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
-        return -1;
-    }
-
-    rc = sqlite3_bind_text(stmt,
-                           sqlite3_bind_parameter_index(stmt, ":did"),
-                           did, -1, NULL);
-    if (SQLITE_OK != rc) {
-        vlogE(TAG_DB "Binding parameter did failed");
-        sqlite3_finalize(stmt);
-        return -1;
-    }
+    const CachedUser *cu;
 
-    if (SQLITE_ROW != sqlite3_step(stmt)) {
-        vlogE(TAG_DB "Executing SELECT failed");
-        sqlite3_finalize(stmt);
+    if (user_cache_get(did, 0, &cu) < 0)
         return -1;
-    }
 
-    rc = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
-
-    return rc ? 0 : 1;
+    return cu && cu->name != "NA" ? 0 : 1;
 }
 
 int db_get_user(const char *did, UserInfo **ui)
 {
-    sqlite3_stmt *stmt;
-    const char *sql;
-    DBUserInfo *tmp;
-    int rc;
-
-    sql = "SELECT user_id, did, name, email FROM users WHERE did = :did;";
-
-    if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) {
-        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
-        return -1;
-    }
+    const CachedUser *cu;
 
-    rc = sqlite3_bind_text(stmt,
-                           sqlite3_bind_parameter_index(stmt, ":did"),
-                           did, -1, NULL);
-    if (SQLITE_OK != rc) {
-        vlogE(TAG_DB "Binding parameter did failed");
-        sqlite3_finalize(stmt);
+    if (user_cache_get(did, 0, &cu) < 0)
         return -1;
-    }
 
-    rc = sqlite3_step(stmt);
-    if (SQLITE_DONE == rc) {
-        sqlite3_finalize(stmt);
+    if (!cu) {
         *ui = NULL;
         return 0;
     }
 
-    if (SQLITE_ROW != rc) {
-        vlogE(TAG_DB "Executing SELECT failed");
-        sqlite3_finalize(stmt);
-        return -1;
-    }
+    *ui = user_dup(cu);
+    return *ui ? 0 : -1;
+}
 
-    tmp = (DBUserInfo *)rc_zalloc(sizeof(DBUserInfo), dbuinfo_dtor);
-    if (!tmp) {
-        vlogE(TAG_DB "OOM");
-        sqlite3_finalize(stmt);
-        return -1;
-    }
+int db_get_user_by_uid(uint64_t uid, UserInfo **ui)
+{
+    const CachedUser *cu;
 
-    tmp->info.uid   = sqlite3_column_int64(stmt, 0);
-    tmp->info.did   = (char *)sqlite3_column_text(stmt, 1);
-    tmp->info.name  = (char *)sqlite3_column_text(stmt, 2);
-    tmp->info.email = (char *)sqlite3_column_text(stmt, 3);
-    tmp->stmt       = stmt;
+    if (user_cache_get(NULL, uid, &cu) < 0)
+        return -1;
 
-    *ui = &tmp->info;
+    if (!cu) {
+        *ui = NULL;
+        return 0;
+    }
 
-    return 0;
+    *ui = user_dup(cu);
+    return *ui ? 0 : -1;
 }
 
 int db_get_count(const char *table_name)
@@ -3734,7 +5313,8 @@ DBObjIt *db_iter_reported_cmts(const QryCriteria *qc)
     int rc;
 
     rc = sprintf(sql,
-                 "SELECT channel_id, post_id, comment_id, name, did, reasons, created_at"
+                 "SELECT channel_id, post_id, comment_id, name, did, reasons, created_at,"
+                 "       reporter_id"
                  " FROM reported_comments"
                  " JOIN users ON reported_comments.reporter_id = users.user_id"
                  " WHERE true");
@@ -3745,7 +5325,7 @@ DBObjIt *db_iter_reported_cmts(const QryCriteria *qc)
             rc += sprintf(sql + rc, " AND %s >= :lower", qcol);
         if (qc->upper)
             rc += sprintf(sql + rc, " AND %s <= :upper", qcol);
-        rc += sprintf(sql + rc, " ORDER BY %s %s", qcol, qc->by == ID ? "ASC" : "DESC");
+        rc += keyset_clause(sql + rc, qc, qcol, reported_cmt_keys);
     }
     if (qc->maxcnt)
         rc += sprintf(sql + rc, " LIMIT :maxcnt");
@@ -3786,6 +5366,13 @@ DBObjIt *db_iter_reported_cmts(const QryCriteria *qc)
         }
     }
 
+    rc = keyset_bind(stmt, qc);
+    if (SQLITE_OK != rc) {
+        vlogE(TAG_DB "Binding parameter after failed");
+        sqlite3_finalize(stmt);
+        return NULL;
+    }
+
     // char* expanded_sql = sqlite3_expanded_sql(stmt);
     // vlogI(TAG_DB "db_iter_reported_cmts() expanded sql: %s", expanded_sql);
     // sqlite3_free(expanded_sql);
@@ -3799,3 +5386,161 @@ DBObjIt *db_iter_reported_cmts(const QryCriteria *qc)
     return it;
 }
 
+int db_add_outbox(const char *node_id, const void *data, size_t len)
+{
+    sqlite3_stmt *stmt;
+    const char *sql;
+    int rc;
+
+    sql = "INSERT INTO outbox(node_id, created_at, payload)"
+          "  VALUES (:node_id, :ts, :payload)";
+
+    if (SQLITE_OK != sqlite3_prepare_v2(outbox_db, sql, -1, &stmt, NULL)) {
+        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
+        return -1;
+    }
+
+    rc = sqlite3_bind_text(stmt,
+                           sqlite3_bind_parameter_index(stmt, ":node_id"),
+                           node_id, -1, NULL);
+    rc |= sqlite3_bind_int64(stmt,
+                             sqlite3_bind_parameter_index(stmt, ":ts"),
+                             time(NULL));
+    rc |= sqlite3_bind_blob(stmt,
+                            sqlite3_bind_parameter_index(stmt, ":payload"),
+                            data, len, NULL);
+    if (SQLITE_OK != rc) {
+        vlogE(TAG_DB "Binding parameter failed");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (SQLITE_DONE != rc) {
+        vlogE(TAG_DB "Executing INSERT failed");
+        return -1;
+    }
+
+    return 0;
+}
+
+static
+void *row2outbox(sqlite3_stmt *stmt)
+{
+    size_t len = sqlite3_column_bytes(stmt, 1);
+    OutboxMsg *msg = (OutboxMsg *)rc_zalloc(sizeof(OutboxMsg) + len, NULL);
+
+    if (!msg) {
+        vlogE(TAG_DB "OOM");
+        return NULL;
+    }
+
+    msg->seq  = sqlite3_column_int64(stmt, 0);
+    msg->data = memcpy(msg + 1, sqlite3_column_blob(stmt, 1), len);
+    msg->len  = len;
+
+    return msg;
+}
+
+DBObjIt *db_iter_outbox(const char *node_id)
+{
+    sqlite3_stmt *stmt;
+    const char *sql;
+    DBObjIt *it;
+    int rc;
+
+    sql = "SELECT seq, payload FROM outbox"
+          "  WHERE node_id = :node_id"
+          "  ORDER BY seq ASC";
+
+    if (SQLITE_OK != sqlite3_prepare_v2(outbox_db, sql, -1, &stmt, NULL)) {
+        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
+        return NULL;
+    }
+
+    rc = sqlite3_bind_text(stmt,
+                           sqlite3_bind_parameter_index(stmt, ":node_id"),
+                           node_id, -1, NULL);
+    if (SQLITE_OK != rc) {
+        vlogE(TAG_DB "Binding parameter node_id failed");
+        sqlite3_finalize(stmt);
+        return NULL;
+    }
+
+    it = it_create(stmt, row2outbox);
+    if (!it) {
+        sqlite3_finalize(stmt);
+        return NULL;
+    }
+
+    return it;
+}
+
+int db_rm_outbox(const char *node_id, uint64_t upto_seq)
+{
+    sqlite3_stmt *stmt;
+    const char *sql;
+    int rc;
+
+    sql = "DELETE FROM outbox"
+          "  WHERE node_id = :node_id AND seq <= :seq";
+
+    if (SQLITE_OK != sqlite3_prepare_v2(outbox_db, sql, -1, &stmt, NULL)) {
+        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
+        return -1;
+    }
+
+    rc = sqlite3_bind_text(stmt,
+                           sqlite3_bind_parameter_index(stmt, ":node_id"),
+                           node_id, -1, NULL);
+    rc |= sqlite3_bind_int64(stmt,
+                             sqlite3_bind_parameter_index(stmt, ":seq"),
+                             upto_seq);
+    if (SQLITE_OK != rc) {
+        vlogE(TAG_DB "Binding parameter failed");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (SQLITE_DONE != rc) {
+        vlogE(TAG_DB "Executing DELETE failed");
+        return -1;
+    }
+
+    return 0;
+}
+
+int db_expire_outbox(uint64_t before)
+{
+    sqlite3_stmt *stmt;
+    const char *sql;
+    int rc;
+
+    sql = "DELETE FROM outbox WHERE created_at < :before";
+
+    if (SQLITE_OK != sqlite3_prepare_v2(outbox_db, sql, -1, &stmt, NULL)) {
+        vlogE(TAG_DB "sqlite3_prepare_v2() failed");
+        return -1;
+    }
+
+    rc = sqlite3_bind_int64(stmt,
+                            sqlite3_bind_parameter_index(stmt, ":before"),
+                            before);
+    if (SQLITE_OK != rc) {
+        vlogE(TAG_DB "Binding parameter before failed");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (SQLITE_DONE != rc) {
+        vlogE(TAG_DB "Executing DELETE failed");
+        return -1;
+    }
+
+    return sqlite3_changes(outbox_db);
+}
@@ -36,8 +36,22 @@ extern "C" {
 
 typedef struct DBObjIt DBObjIt;
 
+typedef enum {
+    CHANGE_CHAN_NEW = 1,
+    CHANGE_CHAN_UPD,
+    CHANGE_POST_NEW,
+    CHANGE_POST_UPD,
+    CHANGE_POST_STATUS,
+    CHANGE_CMT_NEW,
+    CHANGE_CMT_UPD,
+    CHANGE_CMT_STATUS,
+    CHANGE_LIKE,
+    CHANGE_UNLIKE
+} ChangeKind;
+
 int db_init(sqlite3 *handle);
 void db_deinit();
+int db_migration_pending();
 int db_create_chan(const ChanInfo *ci);
 int db_upd_chan(const ChanInfo *ci);
 int db_add_post(const PostInfo *pi);
@@ -60,7 +74,11 @@ int db_unsub(uint64_t uid, uint64_t channel_id);
 int db_update_user_info(const UserInfo *ui);
 int db_upsert_user(const UserInfo *ui, uint64_t *uid);
 int db_iter_nxt(DBObjIt *it, void **obj);
+const char *db_iter_sql(DBObjIt *it);
 DBObjIt *db_iter_chans(const QryCriteria *qc);
+DBObjIt *db_iter_chan_metas();
+int db_get_chan(uint64_t chan_id, ChanInfo **ci);
+int db_get_avatar(const char *hash, void **avatar, size_t *len);
 DBObjIt *db_iter_sub_chans(uint64_t uid, const QryCriteria *qc);
 DBObjIt *db_iter_posts(uint64_t chan_id, const QryCriteria *qc);
 DBObjIt *db_iter_posts_lac(uint64_t chan_id, const QryCriteria *qc);
@@ -69,13 +87,19 @@ DBObjIt *db_iter_liked_data(uint64_t uid, const QryCriteria *qc);
 DBObjIt *db_iter_cmts(uint64_t chan_id, uint64_t post_id, const QryCriteria *qc);
 DBObjIt *db_iter_cmts_likes(uint64_t chan_id, uint64_t post_id, const QryCriteria *qc);
 int db_is_suber(uint64_t uid, uint64_t chan_id);
+int db_suber_count(uint64_t chan_id, uint64_t *subs);
 int db_get_owner(UserInfo **ui);
 int db_need_upsert_user(const char *did);
 int db_get_user(const char *did, UserInfo **ui);
+int db_get_user_by_uid(uint64_t uid, UserInfo **ui);
 int db_get_count(const char *table_name);
 int db_add_reported_cmts(uint64_t channel_id, uint64_t post_id, uint64_t comment_id,
                          uint64_t reporter_id, const char *reason);
 DBObjIt *db_iter_reported_cmts(const QryCriteria *qc);
+int db_add_outbox(const char *node_id, const void *data, size_t len);
+DBObjIt *db_iter_outbox(const char *node_id);
+int db_rm_outbox(const char *node_id, uint64_t upto_seq);
+int db_expire_outbox(uint64_t before);
 
 #ifdef __cplusplus
 } // extern "C"
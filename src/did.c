@@ -41,6 +41,7 @@
 #include "rpc.h"
 #include "did.h"
 #include "db.h"
+#include "logging.h"
 
 #define VC_FRAG "credential"
 #define TAG_AUTH "[Feedsd.Auth]: "
@@ -69,6 +70,8 @@ static char *payload_buf;
 static pthread_mutex_t http_mutex = PTHREAD_MUTEX_INITIALIZER;
 static bool http_is_running;
 static pthread_t http_tid;
+static pthread_mutex_t sdk_mutex;
+static pthread_once_t sdk_mutex_once = PTHREAD_ONCE_INIT;
 
 typedef struct {
     UserInfo info;
@@ -599,12 +602,36 @@ const char *did_get_nonce()
     return nonce_str;
 }
 
+static
+void sdk_mutex_init()
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&sdk_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void did_sdk_lock()
+{
+    pthread_once(&sdk_mutex_once, sdk_mutex_init);
+    pthread_mutex_lock(&sdk_mutex);
+}
+
+void did_sdk_unlock()
+{
+    pthread_mutex_unlock(&sdk_mutex);
+}
+
 static
 char *gen_tsx_payload()
 {
+    did_sdk_lock();
     DIDBackend_SetLocalResolveHandle(NULL);
     DIDDocument_PublishDID(feeds_doc, feeeds_auth_key_url, true, feeds_storepass);
     DIDBackend_SetLocalResolveHandle(local_resolver);
+    did_sdk_unlock();
     if (!payload_buf)
         vlogE(TAG_AUTH "Failed to generate transaction payload: %s", DIDError_GetLastErrorMessage());
 
@@ -753,6 +780,8 @@ void hdl_imp_did_req(Carrier *c, const char *from, Req *base)
         return;
     }
 
+    did_sdk_lock();
+
     if (!req->params.mnemo) {
         mnemo_gen = (char *)Mnemonic_Generate("english");
         if (!mnemo_gen) {
@@ -829,6 +858,7 @@ finally:
     }
     if (mnemo_gen)
         Mnemonic_Free(mnemo_gen);
+    did_sdk_unlock();
 }
 
 static
@@ -839,6 +869,8 @@ Marshalled *process_vc_req(const char *from, IssVCReq *req)
     DIDURL *vc_url = NULL;
     Credential *vc = NULL;
 
+    did_sdk_lock();
+
     if (state != DID_IMPED && state != VC_ISSED) {
         vlogE(TAG_AUTH "Process credential in a wrong state. Current state: %s", state_str());
         ErrResp resp = {
@@ -960,6 +992,7 @@ finally:
         Credential_Destroy(vc);
     if (vc_url)
         DIDURL_Destroy(vc_url);
+    did_sdk_unlock();
 
     return resp_marshal;
 }
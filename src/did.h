@@ -42,6 +42,15 @@ int did_init(FeedsConfig *cfg);
 void did_deinit();
 bool did_is_ready();
 const char *did_get_nonce();
+
+/*
+ * The DID SDK keeps global state (resolve handle, last error, store
+ * caches) and is not reentrant. Every call into it from the command
+ * handler, the did-resolver pool or the JWT helpers is bracketed by
+ * this recursive lock.
+ */
+void did_sdk_lock();
+void did_sdk_unlock();
 int oinfo_upd(const UserInfo *ui);
 void hdl_decl_owner_req(Carrier *c, const char *from, Req *base);
 void hdl_imp_did_req(Carrier *c, const char *from, Req *base);
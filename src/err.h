@@ -35,6 +35,7 @@
 #define ERR_UNKNOWN_METHOD (-10)
 #define ERR_DB_ERROR (-11)
 #define ERR_MAX_FEEDS_LIMIT (-12)
+#define ERR_BUSY (-13)
 
 #define ERR_LAST_INDEX (-100)
 
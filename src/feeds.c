@@ -25,25 +25,57 @@
 
 #include "feeds.h"
 #include "msgq.h"
+#include "notifdests.h"
 #include "auth.h"
 #include "did.h"
 #include "obj.h"
 #include "err.h"
 #include "db.h"
 #include "ver.h"
+#include "avatar.h"
+#include "timerwheel.h"
+#include "reqepoch.h"
+#include "admission.h"
+#include "logging.h"
 
 #define TAG_CMD "[Feedsd.Cmd ]: "
 
 extern Carrier *carrier;
 extern size_t connecting_clients;
 
+struct NotifDest {
+    linked_hash_entry_t he;
+    char node_id[ELA_MAX_ID_LEN + 1];
+    linked_list_t *ndpass;
+    time_t absent_since;
+    Timer *expiry;
+    int avatar_by_hash;
+};
+
+/*
+ * Registry entry of a channel. Only the hot metadata (name, counters, ids,
+ * status) lives in info; intro, tip_methods, proof and avatar_hash are left
+ * NULL and fetched on demand through chan_info_full().
+ */
 typedef struct {
     linked_hash_entry_t he_name_key;
     linked_hash_entry_t he_id_key;
     linked_list_t *aspcs;
+    ChanNotifDests *cnds;
     ChanInfo info;
 } Chan;
 
+/*
+ * Bounded cache of full channel records read from the database, oldest
+ * first in the linked hashtable so the head is the eviction candidate.
+ */
+typedef struct {
+    linked_hash_entry_t he;
+    ChanInfo *ci;
+} ChanCacheEntry;
+
+#define CHAN_CACHE_MAX 128
+
 typedef struct {
     linked_hash_entry_t he;
     linked_hashtable_t *aspcs;
@@ -58,12 +90,6 @@ typedef struct {
     const ActiveSuber *as;
 } ActiveSuberPerChan;
 
-typedef struct {
-    linked_hash_entry_t he;
-    char node_id[ELA_MAX_ID_LEN + 1];
-    linked_list_t *ndpass;
-} NotifDest;
-
 typedef struct {
     linked_hash_entry_t he;
     linked_list_entry_t le;
@@ -72,10 +98,13 @@ typedef struct {
 } NotifDestPerActiveSuber;
 
 static uint64_t nxt_chan_id = CHAN_ID_START;
+static int outbox_ttl;
 static linked_hashtable_t *ass;
 static linked_hashtable_t *nds;
 static linked_hashtable_t *chans_by_name;
 static linked_hashtable_t *chans_by_id;
+static linked_hashtable_t *chan_cache;
+static size_t chan_cache_sz;
 
 #define hashtable_foreach(htab, entry)                                \
     for (linked_hashtable_iterate((htab), &it);                              \
@@ -133,17 +162,15 @@ void chan_dtor(void *obj)
     Chan *chan = obj;
 
     deref(chan->aspcs);
+    deref(chan->cnds);
 }
 
 static
 Chan *chan_create(const ChanInfo *ci)
 {
     Chan *chan;
-    char *buf;
 
-    chan = rc_zalloc(sizeof(Chan) + strlen(ci->name) +
-                     strlen(ci->intro) + strlen(ci->tip_methods) +  //2.0
-                     strlen(ci->proof) + 4 + ci->len, chan_dtor);
+    chan = rc_zalloc(sizeof(Chan) + strlen(ci->name) + 1, chan_dtor);
     if (!chan)
         return NULL;
 
@@ -153,17 +180,20 @@ Chan *chan_create(const ChanInfo *ci)
         return NULL;
     }
 
-    buf = (char *)(chan + 1);
+    chan->cnds = cnds_create();
+    if (!chan->cnds) {
+        deref(chan);
+        return NULL;
+    }
+
     chan->info        = *ci;
-    chan->info.name   = strcpy(buf, ci->name);
-    buf += strlen(ci->name) + 1;
-    chan->info.intro  = strcpy(buf, ci->intro);
-    buf += strlen(ci->intro) + 1;
-    chan->info.tip_methods = strcpy(buf, ci->tip_methods);  //v2.0
-    buf += strlen(ci->tip_methods) + 1;
-    chan->info.proof  = strcpy(buf, ci->proof);   //v2.0
-    buf += strlen(ci->proof) + 1;
-    chan->info.avatar = memcpy(buf, ci->avatar, ci->len);
+    chan->info.name   = strcpy((char *)(chan + 1), ci->name);
+    chan->info.intro  = NULL;
+    chan->info.tip_methods = NULL;  //v2.0
+    chan->info.proof  = NULL;   //v2.0
+    chan->info.avatar_hash = NULL;
+    chan->info.avatar = NULL;
+    chan->info.len    = 0;
 
     chan->he_name_key.data   = chan;
     chan->he_name_key.key    = chan->info.name;
@@ -180,27 +210,22 @@ static
 Chan *chan_create_upd(const Chan *from, const ChanInfo *ci)
 {
     Chan *chan;
-    char *buf;
 
-    chan = rc_zalloc(sizeof(Chan) + strlen(ci->name) +
-                     strlen(ci->intro) + strlen(ci->tip_methods) +  //2.0
-                     strlen(ci->proof) + 4 + ci->len, chan_dtor);
+    chan = rc_zalloc(sizeof(Chan) + strlen(ci->name) + 1, chan_dtor);
     if (!chan)
         return NULL;
 
     chan->aspcs = ref(from->aspcs);
+    chan->cnds  = ref(from->cnds);
 
-    buf = (char *)(chan + 1);
     chan->info        = *ci;
-    chan->info.name   = strcpy(buf, ci->name);
-    buf += strlen(ci->name) + 1;
-    chan->info.intro  = strcpy(buf, ci->intro);
-    buf += strlen(ci->intro) + 1;
-    chan->info.tip_methods = strcpy(buf, ci->tip_methods);  //v2.0
-    buf += strlen(ci->tip_methods) + 1;
-    chan->info.proof  = strcpy(buf, ci->proof);   //v2.0
-    buf += strlen(ci->proof) + 1;
-    chan->info.avatar = memcpy(buf, ci->avatar, ci->len);
+    chan->info.name   = strcpy((char *)(chan + 1), ci->name);
+    chan->info.intro  = NULL;
+    chan->info.tip_methods = NULL;  //v2.0
+    chan->info.proof  = NULL;   //v2.0
+    chan->info.avatar_hash = NULL;
+    chan->info.avatar = NULL;
+    chan->info.len    = 0;
 
     chan->he_name_key.data   = chan;
     chan->he_name_key.key    = chan->info.name;
@@ -213,20 +238,124 @@ Chan *chan_create_upd(const Chan *from, const ChanInfo *ci)
     return chan;
 }
 
+static
+void chan_cache_entry_dtor(void *obj)
+{
+    ChanCacheEntry *e = obj;
+
+    deref(e->ci);
+}
+
+static
+void chan_cache_evict(uint64_t chan_id)
+{
+    ChanCacheEntry *e;
+
+    e = linked_hashtable_remove(chan_cache, &chan_id, sizeof(chan_id));
+    if (!e)
+        return;
+
+    --chan_cache_sz;
+    deref(e);
+}
+
+static
+ChanInfo *chan_cache_get(uint64_t chan_id)
+{
+    linked_hashtable_iterator_t it;
+    ChanCacheEntry *e;
+    ChanInfo *ci;
+    int rc;
+
+    e = linked_hashtable_remove(chan_cache, &chan_id, sizeof(chan_id));
+    if (e) {
+        // move to the tail, the most recently used end.
+        linked_hashtable_put(chan_cache, &e->he);
+        ci = ref(e->ci);
+        deref(e);
+        return ci;
+    }
+
+    rc = db_get_chan(chan_id, &ci);
+    if (rc < 0 || !ci)
+        return NULL;
+
+    e = rc_zalloc(sizeof(ChanCacheEntry), chan_cache_entry_dtor);
+    if (!e)
+        return ci;
+
+    e->ci        = ref(ci);
+    e->he.data   = e;
+    e->he.key    = &e->ci->chan_id;
+    e->he.keylen = sizeof(e->ci->chan_id);
+    linked_hashtable_put(chan_cache, &e->he);
+    deref(e);
+
+    if (++chan_cache_sz > CHAN_CACHE_MAX) {
+        linked_hashtable_iterate(chan_cache, &it);
+        if (linked_hashtable_iterator_next(&it, NULL, NULL, (void **)&e) > 0) {
+            linked_hashtable_iterator_remove(&it);
+            --chan_cache_sz;
+            deref(e);
+        }
+    }
+
+    return ci;
+}
+
+/*
+ * Fills *full with the registry's hot fields overlaid on the cached cold
+ * record. The returned record backs the strings in *full and must be
+ * deref'ed once *full is no longer used.
+ */
+static
+ChanInfo *chan_info_full(const Chan *chan, ChanInfo *full)
+{
+    ChanInfo *cold;
+
+    cold = chan_cache_get(chan->info.chan_id);
+    if (!cold)
+        return NULL;
+
+    *full             = chan->info;
+    full->intro       = cold->intro;
+    full->tip_methods = cold->tip_methods;
+    full->proof       = cold->proof;
+    full->avatar_hash = cold->avatar_hash;
+
+    return cold;
+}
+
+/*
+ * Clients that did not ask for avatar_hash still get the avatar blob
+ * inline. Points ci->avatar at it, the returned blob must be deref'ed once
+ * *ci is marshalled. NULL when the client takes the hash.
+ */
+static
+void *chan_info_avatar(ChanInfo *ci)
+{
+    void *avatar;
+
+    if (avatar_by_hash())
+        return NULL;
+
+    if (db_get_avatar(ci->avatar_hash, &avatar, &ci->len) < 0) {
+        vlogW(TAG_CMD "Loading avatar of channel [%" PRIu64 "] failed, sending its hash.", ci->chan_id);
+        ci->len = 0;
+        return NULL;
+    }
+
+    return ci->avatar = avatar;
+}
+
 static
 int load_chans_from_db()
 {
-    QryCriteria qc = {
-        .by     = NONE,
-        .upper  = 0,
-        .lower  = 0,
-        .maxcnt = 0
-    };
     DBObjIt *it = NULL;
     ChanInfo *cinfo;
     int rc;
 
-    it = db_iter_chans(&qc);
+    it = db_iter_chan_metas();
     if (!it) {
         vlogE(TAG_CMD"Loading channels from database failed");
         return -1;
@@ -266,6 +395,12 @@ int feeds_init(FeedsConfig *cfg)
         goto failure;
     }
 
+    chan_cache = linked_hashtable_create(8, 0, NULL, u64_cmp);
+    if (!chan_cache) {
+        vlogE(TAG_CMD"Creating channel cache failed");
+        goto failure;
+    }
+
     ass = linked_hashtable_create(8, 0, NULL, u64_cmp);
     if (!ass) {
         vlogE(TAG_CMD "Creating active subscribers failed");
@@ -282,6 +417,8 @@ int feeds_init(FeedsConfig *cfg)
     if (rc < 0)
         goto failure;
 
+    outbox_ttl = cfg->outbox_ttl;
+
     vlogI(TAG_CMD "Feeds module initialized.");
     return 0;
 
@@ -294,6 +431,8 @@ void feeds_deinit()
 {
     deref(chans_by_name);
     deref(chans_by_id);
+    deref(chan_cache);
+    chan_cache_sz = 0;
     deref(ass);
     deref(nds);
 }
@@ -314,7 +453,7 @@ void notify_of_chan_upd(const char *peer, const ChanInfo *ci)
         return;
 
     vlogD(TAG_CMD "Sending channel update notification to [%s]: {channel_id: %" PRIu64 "}", peer, ci->chan_id);
-    msgq_enq(peer, notif_marshal);
+    msgq_enq_prio(peer, notif_marshal, MSGQ_PRIO_NOTIF);
     deref(notif_marshal);
 }
 
@@ -335,7 +474,7 @@ void notify_of_new_post(const char *peer, const PostInfo *pi)
 
     vlogD(TAG_CMD "Sending new post notification to [%s]: " "{channel_id: %" PRIu64 ", post_id: %" PRIu64 "}",
           peer, pi->chan_id, pi->post_id);
-    msgq_enq(peer, notif_marshal);
+    msgq_enq_prio(peer, notif_marshal, MSGQ_PRIO_NOTIF);
     deref(notif_marshal);
 }
 
@@ -360,7 +499,7 @@ void notify_of_post_upd(const char *peer, const PostInfo *pi)
           ", updated_at: %" PRIu64 "}",
           peer, pi->chan_id, pi->post_id, post_stat_str(pi->stat), pi->con_len, pi->cmts,
           pi->likes, pi->created_at, pi->upd_at);
-    msgq_enq(peer, notif_marshal);
+    msgq_enq_prio(peer, notif_marshal, MSGQ_PRIO_NOTIF);
     deref(notif_marshal);
 }
 
@@ -383,7 +522,7 @@ void notify_of_new_cmt(const char *peer, const CmtInfo *ci)
           "{channel_id: %" PRIu64 ", post_id: %" PRIu64
           ", comment_id: %" PRIu64 ", refcomment_id: %" PRIu64 "}",
           peer, ci->chan_id, ci->post_id, ci->cmt_id, ci->reply_to_cmt);
-    msgq_enq(peer, notif_marshal);
+    msgq_enq_prio(peer, notif_marshal, MSGQ_PRIO_NOTIF);
     deref(notif_marshal);
 }
 
@@ -406,7 +545,7 @@ void notify_of_cmt_upd(const char *peer, const CmtInfo *ci)
           "{channel_id: %" PRIu64 ", post_id: %" PRIu64
           ", comment_id: %" PRIu64 ", refcomment_id: %" PRIu64 ", status: %s}",
           peer, ci->chan_id, ci->post_id, ci->cmt_id, ci->reply_to_cmt, cmt_stat_str(ci->stat));
-    msgq_enq(peer, notif_marshal);
+    msgq_enq_prio(peer, notif_marshal, MSGQ_PRIO_NOTIF);
     deref(notif_marshal);
 }
 
@@ -429,7 +568,7 @@ void notify_of_new_like(const char *peer, const LikeInfo *li)
           "{channel_id: %" PRIu64 ", post_id: %" PRIu64
           ", comment_id: %" PRIu64 ", user_name: %s, user_did: %s, total_count: %" PRIu64 "}",
           peer, li->chan_id, li->post_id, li->cmt_id, li->user.name, li->user.did, li->total_cnt);
-    msgq_enq(peer, notif_marshal);
+    msgq_enq_prio(peer, notif_marshal, MSGQ_PRIO_NOTIF);
     deref(notif_marshal);
 }
 
@@ -452,7 +591,7 @@ void notify_of_new_sub(const char *peer, const uint64_t chan_id, const UserInfo
     vlogD(TAG_CMD "Sending new subscription notification to [%s]: "
           "{channel_id: %" PRIu64 ", user_name: %s, user_did: %s}",
           peer, chan_id, uinfo->name, uinfo->did);
-    msgq_enq(peer, notif_marshal);
+    msgq_enq_prio(peer, notif_marshal, MSGQ_PRIO_NOTIF);
     deref(notif_marshal);
 }
 
@@ -473,7 +612,7 @@ void notify_of_stats_changed(const char *peer, uint64_t total_clients)
 
     vlogD(TAG_CMD "Sending statistics changed notification to [%s]: " "{total_clients: %" PRIu64 "}",
           peer, total_clients);
-    msgq_enq(peer, notif_marshal);
+    msgq_enq_prio(peer, notif_marshal, MSGQ_PRIO_BULK);
     deref(notif_marshal);
 }
 
@@ -497,7 +636,7 @@ void notify_of_report_cmt(const char *peer, const ReportedCmtInfo *li)
           ", reporter_name: %s, reporter_did: %s, reasons: %s created_at: %" PRIu64 "}",
           peer, li->chan_id, li->post_id, li->cmt_id,
           li->reporter.name, li->reporter.did, li->reasons, li->created_at);
-    msgq_enq(peer, notif_marshal);
+    msgq_enq_prio(peer, notif_marshal, MSGQ_PRIO_NOTIF);
     deref(notif_marshal);
 }
 
@@ -623,6 +762,12 @@ int ndpas_exist(ActiveSuber *as, const char *node_id)
 static inline
 NotifDestPerActiveSuber *ndpas_put(NotifDestPerActiveSuber *ndpas)
 {
+    linked_hashtable_iterator_t it;
+    ActiveSuberPerChan *aspc;
+
+    hashtable_foreach(ndpas->as->aspcs, aspc)
+        cnds_add(aspc->chan->cnds, ndpas->nd);
+
     linked_list_add(ndpas->nd->ndpass, &ndpas->le);
     return linked_hashtable_put(ndpas->as->ndpass, &ndpas->he);
 }
@@ -630,6 +775,12 @@ NotifDestPerActiveSuber *ndpas_put(NotifDestPerActiveSuber *ndpas)
 static inline
 ActiveSuberPerChan *aspc_put(ActiveSuberPerChan *aspc)
 {
+    linked_hashtable_iterator_t it;
+    NotifDestPerActiveSuber *ndpas;
+
+    hashtable_foreach(aspc->as->ndpass, ndpas)
+        cnds_add(aspc->chan->cnds, ndpas->nd);
+
     linked_list_add(aspc->chan->aspcs, &aspc->le);
     return linked_hashtable_put(aspc->as->aspcs, &aspc->he);
 }
@@ -650,6 +801,14 @@ ActiveSuberPerChan *aspc_remove(uint64_t uid, Chan *chan)
         return NULL;
     }
 
+    {
+        linked_hashtable_iterator_t it;
+        NotifDestPerActiveSuber *ndpas;
+
+        hashtable_foreach(as->ndpass, ndpas)
+            cnds_remove(chan->cnds, ndpas->nd);
+    }
+
     deref(linked_list_remove_entry(chan->aspcs, &aspc->le));
     deref(as);
 
@@ -660,6 +819,7 @@ void hdl_create_chan_req(Carrier *c, const char *from, Req *base)
 {
 
     CreateChanReq *req = (CreateChanReq *)base;
+    char hash[AVATAR_HASH_LEN + 1];
     ChanInfo ci = {
         .chan_id      = nxt_chan_id,
         .name         = req->params.name,
@@ -671,6 +831,7 @@ void hdl_create_chan_req(Carrier *c, const char *from, Req *base)
         .next_post_id = POST_ID_START,
         .avatar       = req->params.avatar,
         .len          = req->params.sz,
+        .avatar_hash  = hash,
         .tip_methods  = req->params.tipm,  //v2.0
         .proof        = req->params.proof  //v2.0
     };
@@ -739,6 +900,7 @@ void hdl_create_chan_req(Carrier *c, const char *from, Req *base)
         goto finally;
     }
 
+    avatar_hash(ci.avatar, ci.len, hash);
     chan = chan_create(&ci);
     if (!chan) {
         vlogE(TAG_CMD "Creating channel failed.");
@@ -790,12 +952,14 @@ void hdl_upd_chan_req(Carrier *c, const char *from, Req *base)
 {
     UpdChanReq *req = (UpdChanReq *)base;
     Marshalled *resp_marshal = NULL;
-    ActiveSuberPerChan *aspc;
+    cvector_vector_type(NotifDest *) dests;
+    NotifDest **nd;
     UserInfo *uinfo = NULL;
     Chan *chan_upd = NULL;
-    linked_list_iterator_t it;
+    char hash[AVATAR_HASH_LEN + 1];
     Chan *chan = NULL;
     ChanInfo ci;
+    ChanInfo by_hash;
     int rc;
 
     vlogD(TAG_CMD "Received update_feedinfo request from [%s]: "
@@ -862,9 +1026,11 @@ void hdl_upd_chan_req(Carrier *c, const char *from, Req *base)
     ci.next_post_id = chan->info.next_post_id;
     ci.avatar       = req->params.avatar;
     ci.len          = req->params.sz;
+    ci.avatar_hash  = hash;
     ci.tip_methods  = req->params.tipm;  //2.0
     ci.proof        = req->params.proof;  //2.0
     ci.status       = chan->info.status;  //2.0
+    avatar_hash(ci.avatar, ci.len, hash);
     chan_upd = chan_create_upd(chan, &ci);
     if (!chan_upd) {
         vlogE(TAG_CMD "Creating updated channel failed.");
@@ -888,6 +1054,7 @@ void hdl_upd_chan_req(Carrier *c, const char *from, Req *base)
     }
 
     chan_sub(chan_upd, chan);
+    chan_cache_evict(ci.chan_id);
     vlogI(TAG_CMD "Channel [%" PRIu64 "] updated.", ci.chan_id);
 
     {
@@ -898,13 +1065,14 @@ void hdl_upd_chan_req(Carrier *c, const char *from, Req *base)
         vlogD(TAG_CMD "Sending update_feedinfo response.");
     }
 
-    list_foreach(chan->aspcs, aspc) {
-        NotifDestPerActiveSuber *ndpas;
-        linked_hashtable_iterator_t it;
-
-        hashtable_foreach(aspc->as->ndpass, ndpas)
-            notify_of_chan_upd(ndpas->nd->node_id, &ci);
-    }
+    // ci carries the new blob for destinations that did not ask for avatar_hash.
+    by_hash = ci;
+    by_hash.avatar = NULL;
+    by_hash.len    = 0;
+    dests = cnds_snapshot(chan->cnds);
+    cvector_foreach(dests, nd)
+        notify_of_chan_upd((*nd)->node_id, (*nd)->avatar_by_hash ? &by_hash : &ci);
+    cnds_release(dests);
 
 finally:
     if (resp_marshal) {
@@ -983,9 +1151,9 @@ void hdl_pub_post_req(Carrier *c, const char *from, Req *base)
 {
     PubPostReq *req = (PubPostReq *)base;
     Marshalled *resp_marshal = NULL;
-    ActiveSuberPerChan *aspc;
+    cvector_vector_type(NotifDest *) dests;
+    NotifDest **nd;
     UserInfo *uinfo = NULL;
-    linked_list_iterator_t it;
     Chan *chan = NULL;
     PostInfo new_post;
     time_t now;
@@ -1073,13 +1241,10 @@ void hdl_pub_post_req(Carrier *c, const char *from, Req *base)
               "{id: %" PRIu64 "}", new_post.post_id);
     }
 
-    list_foreach(chan->aspcs, aspc) {
-        NotifDestPerActiveSuber *ndpas;
-        linked_hashtable_iterator_t it;
-
-        hashtable_foreach(aspc->as->ndpass, ndpas)
-            notify_of_new_post(ndpas->nd->node_id, &new_post);
-    }
+    dests = cnds_snapshot(chan->cnds);
+    cvector_foreach(dests, nd)
+        notify_of_new_post((*nd)->node_id, &new_post);
+    cnds_release(dests);
 
 finally:
     if (resp_marshal) {
@@ -1094,9 +1259,9 @@ void hdl_declare_post_req(Carrier *c, const char *from, Req *base)
 {
     DeclarePostReq *req = (DeclarePostReq *)base;
     Marshalled *resp_marshal = NULL;
-    ActiveSuberPerChan *aspc;
+    cvector_vector_type(NotifDest *) dests;
+    NotifDest **nd;
     UserInfo *uinfo = NULL;
-    linked_list_iterator_t it;
     Chan *chan = NULL;
     PostInfo new_post;
     time_t now;
@@ -1188,13 +1353,10 @@ void hdl_declare_post_req(Carrier *c, const char *from, Req *base)
     }
 
     if(req->params.with_notify) {
-        list_foreach(chan->aspcs, aspc) {
-            NotifDestPerActiveSuber *ndpas;
-            linked_hashtable_iterator_t it;
-
-            hashtable_foreach(aspc->as->ndpass, ndpas)
-                notify_of_new_post(ndpas->nd->node_id, &new_post);
-        }
+        dests = cnds_snapshot(chan->cnds);
+        cvector_foreach(dests, nd)
+            notify_of_new_post((*nd)->node_id, &new_post);
+        cnds_release(dests);
     }
 
 finally:
@@ -1210,9 +1372,9 @@ void hdl_notify_post_req(Carrier *c, const char *from, Req *base)
 {
     NotifyPostReq *req = (NotifyPostReq *)base;
     Marshalled *resp_marshal = NULL;
-    ActiveSuberPerChan *aspc;
+    cvector_vector_type(NotifDest *) dests;
+    NotifDest **nd;
     UserInfo *uinfo = NULL;
-    linked_list_iterator_t it;
     Chan *chan = NULL;
     PostInfo post_notify;
     int rc;
@@ -1315,13 +1477,10 @@ void hdl_notify_post_req(Carrier *c, const char *from, Req *base)
         goto finally;
     }
 
-    list_foreach(chan->aspcs, aspc) {
-        NotifDestPerActiveSuber *ndpas;
-        linked_hashtable_iterator_t it;
-
-        hashtable_foreach(aspc->as->ndpass, ndpas)
-            notify_of_post_upd(ndpas->nd->node_id, &post_notify);
-    }
+    dests = cnds_snapshot(chan->cnds);
+    cvector_foreach(dests, nd)
+        notify_of_post_upd((*nd)->node_id, &post_notify);
+    cnds_release(dests);
 
     deref(post_notify.content);
 
@@ -1338,9 +1497,9 @@ void hdl_edit_post_req(Carrier *c, const char *from, Req *base)
 {
     EditPostReq *req = (EditPostReq *)base;
     Marshalled *resp_marshal = NULL;
-    ActiveSuberPerChan *aspc;
+    cvector_vector_type(NotifDest *) dests;
+    NotifDest **nd;
     UserInfo *uinfo = NULL;
-    linked_list_iterator_t it;
     Chan *chan = NULL;
     PostInfo post_mod;
     int rc;
@@ -1435,13 +1594,10 @@ void hdl_edit_post_req(Carrier *c, const char *from, Req *base)
         vlogD(TAG_CMD "Sending edit_post response");
     }
 
-    list_foreach(chan->aspcs, aspc) {
-        NotifDestPerActiveSuber *ndpas;
-        linked_hashtable_iterator_t it;
-
-        hashtable_foreach(aspc->as->ndpass, ndpas)
-            notify_of_post_upd(ndpas->nd->node_id, &post_mod);
-    }
+    dests = cnds_snapshot(chan->cnds);
+    cvector_foreach(dests, nd)
+        notify_of_post_upd((*nd)->node_id, &post_mod);
+    cnds_release(dests);
 
 finally:
     if (resp_marshal) {
@@ -1456,9 +1612,9 @@ void hdl_del_post_req(Carrier *c, const char *from, Req *base)
 {
     DelPostReq *req = (DelPostReq *)base;
     Marshalled *resp_marshal = NULL;
-    ActiveSuberPerChan *aspc;
+    cvector_vector_type(NotifDest *) dests;
+    NotifDest **nd;
     UserInfo *uinfo = NULL;
-    linked_list_iterator_t it;
     Chan *chan = NULL;
     PostInfo post_del;
     int rc;
@@ -1541,13 +1697,10 @@ void hdl_del_post_req(Carrier *c, const char *from, Req *base)
         vlogD(TAG_CMD "Sending delete_post response");
     }
 
-    list_foreach(chan->aspcs, aspc) {
-        NotifDestPerActiveSuber *ndpas;
-        linked_hashtable_iterator_t it;
-
-        hashtable_foreach(aspc->as->ndpass, ndpas)
-            notify_of_post_upd(ndpas->nd->node_id, &post_del);
-    }
+    dests = cnds_snapshot(chan->cnds);
+    cvector_foreach(dests, nd)
+        notify_of_post_upd((*nd)->node_id, &post_del);
+    cnds_release(dests);
 
 finally:
     if (resp_marshal) {
@@ -1562,9 +1715,9 @@ void hdl_post_cmt_req(Carrier *c, const char *from, Req *base)
 {
     PostCmtReq *req = (PostCmtReq *)base;
     Marshalled *resp_marshal = NULL;
-    ActiveSuberPerChan *aspc;
+    cvector_vector_type(NotifDest *) dests;
+    NotifDest **nd;
     UserInfo *uinfo = NULL;
-    linked_list_iterator_t it;
     Chan *chan = NULL;
     CmtInfo new_cmt;
     time_t now;
@@ -1667,13 +1820,10 @@ void hdl_post_cmt_req(Carrier *c, const char *from, Req *base)
         vlogD(TAG_CMD "Sending post_comment response: {id: %" PRIu64 "}", new_cmt.cmt_id);
     }
 
-    list_foreach(chan->aspcs, aspc) {
-        NotifDestPerActiveSuber *ndpas;
-        linked_hashtable_iterator_t it;
-
-        hashtable_foreach(aspc->as->ndpass, ndpas)
-            notify_of_new_cmt(ndpas->nd->node_id, &new_cmt);
-    }
+    dests = cnds_snapshot(chan->cnds);
+    cvector_foreach(dests, nd)
+        notify_of_new_cmt((*nd)->node_id, &new_cmt);
+    cnds_release(dests);
 
 finally:
     if (resp_marshal) {
@@ -1688,9 +1838,9 @@ void hdl_edit_cmt_req(Carrier *c, const char *from, Req *base)
 {
     EditCmtReq *req = (EditCmtReq *)base;
     Marshalled *resp_marshal = NULL;
-    ActiveSuberPerChan *aspc;
+    cvector_vector_type(NotifDest *) dests;
+    NotifDest **nd;
     UserInfo *uinfo = NULL;
-    linked_list_iterator_t it;
     Chan *chan = NULL;
     uint64_t cmt_uid;
     CmtInfo cmt_mod;
@@ -1816,13 +1966,10 @@ void hdl_edit_cmt_req(Carrier *c, const char *from, Req *base)
         vlogD(TAG_CMD "Sending edit_comment response");
     }
 
-    list_foreach(chan->aspcs, aspc) {
-        NotifDestPerActiveSuber *ndpas;
-        linked_hashtable_iterator_t it;
-
-        hashtable_foreach(aspc->as->ndpass, ndpas)
-            notify_of_cmt_upd(ndpas->nd->node_id, &cmt_mod);
-    }
+    dests = cnds_snapshot(chan->cnds);
+    cvector_foreach(dests, nd)
+        notify_of_cmt_upd((*nd)->node_id, &cmt_mod);
+    cnds_release(dests);
 
 finally:
     if (resp_marshal) {
@@ -1837,9 +1984,9 @@ void hdl_del_cmt_req(Carrier *c, const char *from, Req *base)
 {
     DelCmtReq *req = (DelCmtReq *)base;
     Marshalled *resp_marshal = NULL;
-    ActiveSuberPerChan *aspc;
+    cvector_vector_type(NotifDest *) dests;
+    NotifDest **nd;
     UserInfo *uinfo = NULL;
-    linked_list_iterator_t it;
     Chan *chan = NULL;
     uint64_t cmt_uid;
     CmtInfo cmt_del;
@@ -1941,13 +2088,10 @@ void hdl_del_cmt_req(Carrier *c, const char *from, Req *base)
         vlogD(TAG_CMD "Sending delete_comment response");
     }
 
-    list_foreach(chan->aspcs, aspc) {
-        NotifDestPerActiveSuber *ndpas;
-        linked_hashtable_iterator_t it;
-
-        hashtable_foreach(aspc->as->ndpass, ndpas)
-            notify_of_cmt_upd(ndpas->nd->node_id, &cmt_del);
-    }
+    dests = cnds_snapshot(chan->cnds);
+    cvector_foreach(dests, nd)
+        notify_of_cmt_upd((*nd)->node_id, &cmt_del);
+    cnds_release(dests);
 
 finally:
     if (resp_marshal) {
@@ -1962,9 +2106,9 @@ void hdl_block_cmt_req(Carrier *c, const char *from, Req *base)
 {
     BlockCmtReq *req = (BlockCmtReq *)base;
     Marshalled *resp_marshal = NULL;
-    ActiveSuberPerChan *aspc;
+    cvector_vector_type(NotifDest *) dests;
+    NotifDest **nd;
     UserInfo *uinfo = NULL;
-    linked_list_iterator_t it;
     Chan *chan = NULL;
     uint64_t cmt_uid;
     CmtInfo cmt_block;
@@ -2066,13 +2210,10 @@ void hdl_block_cmt_req(Carrier *c, const char *from, Req *base)
         vlogD(TAG_CMD "Sending block_comment response");
     }
 
-    list_foreach(chan->aspcs, aspc) {
-        NotifDestPerActiveSuber *ndpas;
-        linked_hashtable_iterator_t it;
-
-        hashtable_foreach(aspc->as->ndpass, ndpas)
-            notify_of_cmt_upd(ndpas->nd->node_id, &cmt_block);
-    }
+    dests = cnds_snapshot(chan->cnds);
+    cvector_foreach(dests, nd)
+        notify_of_cmt_upd((*nd)->node_id, &cmt_block);
+    cnds_release(dests);
 
 finally:
     if (resp_marshal) {
@@ -2087,9 +2228,9 @@ void hdl_unblock_cmt_req(Carrier *c, const char *from, Req *base)
 {
     UnblockCmtReq *req = (UnblockCmtReq *)base;
     Marshalled *resp_marshal = NULL;
-    ActiveSuberPerChan *aspc;
+    cvector_vector_type(NotifDest *) dests;
+    NotifDest **nd;
     UserInfo *uinfo = NULL;
-    linked_list_iterator_t it;
     Chan *chan = NULL;
     uint64_t cmt_uid;
     CmtInfo cmt_unblock;
@@ -2191,13 +2332,10 @@ void hdl_unblock_cmt_req(Carrier *c, const char *from, Req *base)
         vlogD(TAG_CMD "Sending unblock_comment response");
     }
 
-    list_foreach(chan->aspcs, aspc) {
-        NotifDestPerActiveSuber *ndpas;
-        linked_hashtable_iterator_t it;
-
-        hashtable_foreach(aspc->as->ndpass, ndpas)
-            notify_of_cmt_upd(ndpas->nd->node_id, &cmt_unblock);
-    }
+    dests = cnds_snapshot(chan->cnds);
+    cvector_foreach(dests, nd)
+        notify_of_cmt_upd((*nd)->node_id, &cmt_unblock);
+    cnds_release(dests);
 
 finally:
     if (resp_marshal) {
@@ -2213,8 +2351,8 @@ void hdl_post_like_req(Carrier *c, const char *from, Req *base)
     PostLikeReq *req = (PostLikeReq *)base;
     Marshalled *resp_marshal = NULL;
     UserInfo *uinfo = NULL;
-    ActiveSuberPerChan *aspc;
-    linked_list_iterator_t it;
+    cvector_vector_type(NotifDest *) dests;
+    NotifDest **nd;
     Chan *chan = NULL;
     LikeInfo li;
     int rc;
@@ -2318,13 +2456,10 @@ void hdl_post_like_req(Carrier *c, const char *from, Req *base)
     li.user    = *uinfo;
     li.proof   = req->params.proof;  //2.0
 
-    list_foreach(chan->aspcs, aspc) {
-        NotifDestPerActiveSuber *ndpas;
-        linked_hashtable_iterator_t it;
-
-        hashtable_foreach(aspc->as->ndpass, ndpas)
-            notify_of_new_like(ndpas->nd->node_id, &li);
-    }
+    dests = cnds_snapshot(chan->cnds);
+    cvector_foreach(dests, nd)
+        notify_of_new_like((*nd)->node_id, &li);
+    cnds_release(dests);
 
 finally:
     if (resp_marshal) {
@@ -2418,6 +2553,111 @@ finally:
     deref(chan);
 }
 
+/*
+ * A full page may have more rows behind it, so the client is handed the
+ * position of its last row to continue from; a short page ends the list.
+ */
+static
+bool page_has_next(QryCursor *next, const QryCriteria *qc, size_t rows)
+{
+    memset(next, 0, sizeof(*next));
+    if (qc->by == NONE || !qc->maxcnt || rows < qc->maxcnt)
+        return false;
+
+    next->by = qc->by;
+    return true;
+}
+
+static inline
+uint64_t cursor_val(const QryCriteria *qc, uint64_t id, uint64_t upd_at, uint64_t created_at)
+{
+    return qc->by == ID ? id : qc->by == UPD_AT ? upd_at : created_at;
+}
+
+static
+void chans_cursor(QryCursor *next, const QryCriteria *qc, ChanInfo **cinfos)
+{
+    ChanInfo *last;
+
+    if (!page_has_next(next, qc, cvector_size(cinfos)))
+        return;
+
+    last = cinfos[cvector_size(cinfos) - 1];
+    next->val     = cursor_val(qc, last->chan_id, last->upd_at, last->created_at);
+    next->keys[0] = last->chan_id;
+}
+
+static
+void posts_cursor(QryCursor *next, const QryCriteria *qc, PostInfo **pinfos)
+{
+    PostInfo *last;
+
+    if (!page_has_next(next, qc, cvector_size(pinfos)))
+        return;
+
+    last = pinfos[cvector_size(pinfos) - 1];
+    next->val     = cursor_val(qc, last->post_id, last->upd_at, last->created_at);
+    next->keys[0] = last->post_id;
+}
+
+static
+void liked_posts_cursor(QryCursor *next, const QryCriteria *qc, PostInfo **pinfos)
+{
+    PostInfo *last;
+
+    if (!page_has_next(next, qc, cvector_size(pinfos)))
+        return;
+
+    last = pinfos[cvector_size(pinfos) - 1];
+    next->val     = cursor_val(qc, last->post_id, last->upd_at, last->created_at);
+    next->keys[0] = last->chan_id;
+    next->keys[1] = last->post_id;
+}
+
+static
+void likes_cursor(QryCursor *next, const QryCriteria *qc, LikeInfo **linfos)
+{
+    LikeInfo *last;
+
+    if (!page_has_next(next, qc, cvector_size(linfos)))
+        return;
+
+    last = linfos[cvector_size(linfos) - 1];
+    next->val     = cursor_val(qc, last->post_id, 0, last->created_at);
+    next->keys[0] = last->chan_id;
+    next->keys[1] = last->post_id;
+    next->keys[2] = last->cmt_id;
+}
+
+static
+void cmts_cursor(QryCursor *next, const QryCriteria *qc, CmtInfo **cinfos)
+{
+    CmtInfo *last;
+
+    if (!page_has_next(next, qc, cvector_size(cinfos)))
+        return;
+
+    last = cinfos[cvector_size(cinfos) - 1];
+    next->val     = cursor_val(qc, last->cmt_id, last->upd_at, last->created_at);
+    next->keys[0] = last->cmt_id;
+}
+
+static
+void reported_cmts_cursor(QryCursor *next, const QryCriteria *qc, ReportedCmtInfo **rcinfos)
+{
+    ReportedCmtInfo *last;
+
+    if (!page_has_next(next, qc, cvector_size(rcinfos)))
+        return;
+
+    last = rcinfos[cvector_size(rcinfos) - 1];
+    next->val     = cursor_val(qc, last->cmt_id, 0, last->created_at);
+    next->keys[0] = last->chan_id;
+    next->keys[1] = last->post_id;
+    next->keys[2] = last->cmt_id;
+    next->keys[3] = last->reporter.uid;
+}
+
 #define MAX_CONTENT_LEN (ELA_MAX_APP_BULKMSG_LEN - 100 * 1024)
 void hdl_get_my_chans_req(Carrier *c, const char *from, Req *base)
 {
@@ -2426,6 +2666,7 @@ void hdl_get_my_chans_req(Carrier *c, const char *from, Req *base)
     Marshalled *resp_marshal = NULL;
     UserInfo *uinfo = NULL;
     DBObjIt *it = NULL;
+    QryCursor next;
     ChanInfo *cinfo;
     int rc;
 
@@ -2472,13 +2713,16 @@ void hdl_get_my_chans_req(Carrier *c, const char *from, Req *base)
     }
 
     foreach_db_obj(cinfo) {
+        chan_info_avatar(cinfo);
         cvector_push_back(cinfos, ref(cinfo));
         vlogD(TAG_CMD "Retrieved channel: "
               "{channel_id: %" PRIu64 ", name: %s, introduction: %s, subscribers: %" PRIu64
-              ", avatar_length: %zu}",
-              cinfo->chan_id, cinfo->name, cinfo->intro, cinfo->subs, cinfo->len);
+              ", avatar_hash: %s}",
+              cinfo->chan_id, cinfo->name, cinfo->intro, cinfo->subs, cinfo->avatar_hash);
     }
     if (rc < 0) {
+        if (reqepoch_cancelled())
+            goto finally;
         vlogE(TAG_CMD "Iterating owned channels failed");
         ErrResp resp = {
             .tsx_id = req->tsx_id,
@@ -2488,6 +2732,8 @@ void hdl_get_my_chans_req(Carrier *c, const char *from, Req *base)
         goto finally;
     }
 
+    chans_cursor(&next, &req->params.qc, cinfos);
+
     {
         size_t left = MAX_CONTENT_LEN;
         cvector_vector_type(ChanInfo *) cinfos_tmp = NULL;
@@ -2517,7 +2763,8 @@ void hdl_get_my_chans_req(Carrier *c, const char *from, Req *base)
                 .tsx_id = req->tsx_id,
                 .result = {
                     .is_last = i == cvector_size(cinfos) - 1,
-                    .cinfos  = cinfos_tmp
+                    .cinfos  = cinfos_tmp,
+                    .next    = next
                 }
             };
             resp_marshal = rpc_marshal_get_my_chans_resp(&resp);
@@ -2544,8 +2791,10 @@ finally:
     }
     if (cinfos) {
         ChanInfo **i;
-        cvector_foreach(cinfos, i)
+        cvector_foreach(cinfos, i) {
+            deref((*i)->avatar);
             deref(*i);
+        }
         cvector_free(cinfos);
     }
     deref(uinfo);
@@ -2610,6 +2859,8 @@ void hdl_get_my_chans_meta_req(Carrier *c, const char *from, Req *base)
               "{channel_id: %" PRIu64 ", subscribers: %" PRIu64 "}", cinfo->chan_id, cinfo->subs);
     }
     if (rc < 0) {
+        if (reqepoch_cancelled())
+            goto finally;
         vlogE(TAG_CMD "Iterating owned channels metadata failed");
         ErrResp resp = {
             .tsx_id = req->tsx_id,
@@ -2652,6 +2903,7 @@ void hdl_get_chans_req(Carrier *c, const char *from, Req *base)
     Marshalled *resp_marshal = NULL;
     UserInfo *uinfo = NULL;
     DBObjIt *it = NULL;
+    QryCursor next;
     ChanInfo *cinfo;
     int rc;
 
@@ -2689,15 +2941,18 @@ void hdl_get_chans_req(Carrier *c, const char *from, Req *base)
     }
 
     foreach_db_obj(cinfo) {
+        chan_info_avatar(cinfo);
         cvector_push_back(cinfos, ref(cinfo));
         vlogD(TAG_CMD "Retrieved channel: "
               "{channel_id: %" PRIu64 ", name: %s, introduction: %s, "
               "owner_name: %s, owner_did: %s, subscribers: %" PRIu64 ", last_update: %" PRIu64
-              ", avatar_length: %zu}",
+              ", avatar_hash: %s}",
               cinfo->chan_id, cinfo->name, cinfo->intro, cinfo->owner->name,
-              cinfo->owner->did, cinfo->subs, cinfo->upd_at, cinfo->len);
+              cinfo->owner->did, cinfo->subs, cinfo->upd_at, cinfo->avatar_hash);
     }
     if (rc < 0) {
+        if (reqepoch_cancelled())
+            goto finally;
         vlogE(TAG_CMD "Iterating channels failed.");
         ErrResp resp = {
             .tsx_id = req->tsx_id,
@@ -2707,6 +2962,8 @@ void hdl_get_chans_req(Carrier *c, const char *from, Req *base)
         goto finally;
     }
 
+    chans_cursor(&next, &req->params.qc, cinfos);
+
     {
         size_t left = MAX_CONTENT_LEN;
         cvector_vector_type(ChanInfo *) cinfos_tmp = NULL;
@@ -2736,7 +2993,8 @@ void hdl_get_chans_req(Carrier *c, const char *from, Req *base)
                 .tsx_id = req->tsx_id,
                 .result = {
                     .is_last = i == cvector_size(cinfos) - 1,
-                    .cinfos  = cinfos_tmp
+                    .cinfos  = cinfos_tmp,
+                    .next    = next
                 }
             };
             resp_marshal = rpc_marshal_get_chans_resp(&resp);
@@ -2763,8 +3021,10 @@ finally:
     }
     if (cinfos) {
         ChanInfo **i;
-        cvector_foreach(cinfos, i)
+        cvector_foreach(cinfos, i) {
+            deref((*i)->avatar);
             deref(*i);
+        }
         cvector_free(cinfos);
     }
     deref(uinfo);
@@ -2776,7 +3036,10 @@ void hdl_get_chan_dtl_req(Carrier *c, const char *from, Req *base)
     GetChanDtlReq *req = (GetChanDtlReq *)base;
     Marshalled *resp_marshal = NULL;
     UserInfo *uinfo = NULL;
+    ChanInfo *cold = NULL;
+    void *avatar = NULL;
     Chan *chan = NULL;
+    ChanInfo ci;
 
     vlogD(TAG_CMD "Received get_channel_detail request from [%s]: "
           "{access_token: %s, id: %" PRIu64 "}", from, req->params.tk, req->params.id);
@@ -2807,20 +3070,31 @@ void hdl_get_chan_dtl_req(Carrier *c, const char *from, Req *base)
         goto finally;
     }
 
+    if (!(cold = chan_info_full(chan, &ci))) {
+        vlogE(TAG_CMD "Loading channel [%" PRIu64 "] from database failed", req->params.id);
+        ErrResp resp = {
+            .tsx_id = req->tsx_id,
+            .ec     = ERR_INTERNAL_ERROR
+        };
+        resp_marshal = rpc_marshal_err_resp(&resp);
+        goto finally;
+    }
+    avatar = chan_info_avatar(&ci);
+
     {
         GetChanDtlResp resp = {
             .tsx_id = req->tsx_id,
             .result = {
-                .cinfo = &chan->info
+                .cinfo = &ci
             }
         };
         resp_marshal = rpc_marshal_get_chan_dtl_resp(&resp);
         vlogD(TAG_CMD "Sending get_channel_detail response: "
               "{channel_id: %" PRIu64 ", name: %s, introduction: %s, "
               "owner_name: %s, owner_did: %s, subscribers: %" PRIu64
-              ", last_update: %" PRIu64 ", avatar_length: %zu}",
-              chan->info.chan_id, chan->info.name, chan->info.intro, chan->info.owner->name,
-              chan->info.owner->did, chan->info.subs, chan->info.upd_at, chan->info.len);
+              ", last_update: %" PRIu64 ", avatar_hash: %s}",
+              ci.chan_id, ci.name, ci.intro, ci.owner->name,
+              ci.owner->did, ci.subs, ci.upd_at, ci.avatar_hash);
     }
 
 finally:
@@ -2829,6 +3103,8 @@ finally:
         deref(resp_marshal);
     }
     deref(uinfo);
+    deref(avatar);
+    deref(cold);
     deref(chan);
 }
 
@@ -2839,6 +3115,7 @@ void hdl_get_sub_chans_req(Carrier *c, const char *from, Req *base)
     Marshalled *resp_marshal = NULL;
     UserInfo *uinfo = NULL;
     DBObjIt *it = NULL;
+    QryCursor next;
     ChanInfo *cinfo;
     int rc;
 
@@ -2876,14 +3153,17 @@ void hdl_get_sub_chans_req(Carrier *c, const char *from, Req *base)
     }
 
     foreach_db_obj(cinfo) {
+        chan_info_avatar(cinfo);
         cvector_push_back(cinfos, ref(cinfo));
         vlogD(TAG_CMD "Retrieved channel: "
               "{channel_id: %" PRIu64 ", name: %s, introduction: %s, owner_name: %s, "
-              "owner_did: %s, subscribers: %" PRIu64 ", last_update: %" PRIu64 ", avatar_length: %zu}",
+              "owner_did: %s, subscribers: %" PRIu64 ", last_update: %" PRIu64 ", avatar_hash: %s}",
               cinfo->chan_id, cinfo->name, cinfo->intro, cinfo->owner->name,
-              cinfo->owner->did, cinfo->subs, cinfo->upd_at, cinfo->len);
+              cinfo->owner->did, cinfo->subs, cinfo->upd_at, cinfo->avatar_hash);
     }
     if (rc < 0) {
+        if (reqepoch_cancelled())
+            goto finally;
         vlogE(TAG_CMD "Iterating subscribed channels failed.");
         ErrResp resp = {
             .tsx_id = req->tsx_id,
@@ -2893,6 +3173,8 @@ void hdl_get_sub_chans_req(Carrier *c, const char *from, Req *base)
         goto finally;
     }
 
+    chans_cursor(&next, &req->params.qc, cinfos);
+
     {
         size_t left = MAX_CONTENT_LEN;
         cvector_vector_type(ChanInfo *) cinfos_tmp = NULL;
@@ -2922,7 +3204,8 @@ void hdl_get_sub_chans_req(Carrier *c, const char *from, Req *base)
                 .tsx_id = req->tsx_id,
                 .result = {
                     .is_last = i == cvector_size(cinfos) - 1,
-                    .cinfos  = cinfos_tmp
+                    .cinfos  = cinfos_tmp,
+                    .next    = next
                 }
             };
             resp_marshal = rpc_marshal_get_sub_chans_resp(&resp);
@@ -2949,8 +3232,10 @@ finally:
     }
     if (cinfos) {
         ChanInfo **i;
-        cvector_foreach(cinfos, i)
+        cvector_foreach(cinfos, i) {
+            deref((*i)->avatar);
             deref(*i);
+        }
         cvector_free(cinfos);
     }
     deref(uinfo);
@@ -2964,6 +3249,7 @@ void hdl_get_posts_req(Carrier *c, const char *from, Req *base)
     Marshalled *resp_marshal = NULL;
     UserInfo *uinfo = NULL;
     DBObjIt *it = NULL;
+    QryCursor next;
     PostInfo *pinfo;
     int rc;
 
@@ -3022,6 +3308,8 @@ void hdl_get_posts_req(Carrier *c, const char *from, Req *base)
               pinfo->hash_id, pinfo->proof, pinfo->origin_post_url, pinfo->thu_len);
     }
     if (rc < 0) {
+        if (reqepoch_cancelled())
+            goto finally;
         vlogE(TAG_CMD "Iterating posts failed.");
         ErrResp resp = {
             .tsx_id = req->tsx_id,
@@ -3031,6 +3319,8 @@ void hdl_get_posts_req(Carrier *c, const char *from, Req *base)
         goto finally;
     }
 
+    posts_cursor(&next, &req->params.qc, pinfos);
+
     {
         size_t left = MAX_CONTENT_LEN;
         cvector_vector_type(PostInfo *) pinfos_tmp = NULL;
@@ -3041,7 +3331,8 @@ void hdl_get_posts_req(Carrier *c, const char *from, Req *base)
                 .tsx_id = req->tsx_id,
                 .result = {
                     .is_last = true,
-                    .pinfos  = pinfos
+                    .pinfos  = pinfos,
+                    .omit    = req->params.qc.omit
                 }
             };
             resp_marshal = rpc_marshal_get_posts_resp(&resp);
@@ -3062,7 +3353,9 @@ void hdl_get_posts_req(Carrier *c, const char *from, Req *base)
                 .tsx_id = req->tsx_id,
                 .result = {
                     .is_last = i == cvector_size(pinfos) - 1,
-                    .pinfos  = pinfos_tmp
+                    .pinfos  = pinfos_tmp,
+                    .next    = next,
+                    .omit    = req->params.qc.omit
                 }
             };
             resp_marshal = rpc_marshal_get_posts_resp(&resp);
@@ -3104,6 +3397,7 @@ void hdl_get_posts_lac_req(Carrier *c, const char *from, Req *base)
     Marshalled *resp_marshal = NULL;
     UserInfo *uinfo = NULL;
     DBObjIt *it = NULL;
+    QryCursor next;
     PostInfo *pinfo;
     int rc;
 
@@ -3157,6 +3451,8 @@ void hdl_get_posts_lac_req(Carrier *c, const char *from, Req *base)
               pinfo->chan_id, pinfo->post_id, pinfo->cmts, pinfo->likes);
     }
     if (rc < 0) {
+        if (reqepoch_cancelled())
+            goto finally;
         vlogE(TAG_CMD "Iterating posts likes and comments failed.");
         ErrResp resp = {
             .tsx_id = req->tsx_id,
@@ -3166,11 +3462,14 @@ void hdl_get_posts_lac_req(Carrier *c, const char *from, Req *base)
         goto finally;
     }
 
+    posts_cursor(&next, &req->params.qc, pinfos);
+
     {
         GetPostsLACResp resp = {
             .tsx_id = req->tsx_id,
             .result = {
-                .pinfos  = pinfos
+                .pinfos  = pinfos,
+                .next    = next
             }
         };
         resp_marshal = rpc_marshal_get_posts_lac_resp(&resp);
@@ -3199,6 +3498,7 @@ void hdl_get_liked_posts_req(Carrier *c, const char *from, Req *base)
     Marshalled *resp_marshal = NULL;
     UserInfo *uinfo = NULL;
     DBObjIt *it = NULL;
+    QryCursor next;
     PostInfo *pinfo;
     int rc;
 
@@ -3242,6 +3542,8 @@ void hdl_get_liked_posts_req(Carrier *c, const char *from, Req *base)
               pinfo->chan_id, pinfo->post_id, pinfo->cmts, pinfo->likes, pinfo->created_at, pinfo->con_len);
     }
     if (rc < 0) {
+        if (reqepoch_cancelled())
+            goto finally;
         vlogE(TAG_CMD "Iterating posts failed.");
         ErrResp resp = {
             .tsx_id = req->tsx_id,
@@ -3251,6 +3553,8 @@ void hdl_get_liked_posts_req(Carrier *c, const char *from, Req *base)
         goto finally;
     }
 
+    liked_posts_cursor(&next, &req->params.qc, pinfos);
+
     {
         size_t left = MAX_CONTENT_LEN;
         cvector_vector_type(PostInfo *) pinfos_tmp = NULL;
@@ -3280,7 +3584,8 @@ void hdl_get_liked_posts_req(Carrier *c, const char *from, Req *base)
                 .tsx_id = req->tsx_id,
                 .result = {
                     .is_last = i == cvector_size(pinfos) - 1,
-                    .pinfos  = pinfos_tmp
+                    .pinfos  = pinfos_tmp,
+                    .next    = next
                 }
             };
             resp_marshal = rpc_marshal_get_liked_posts_resp(&resp);
@@ -3322,6 +3627,7 @@ void hdl_get_liked_data_req(Carrier *c, const char *from, Req *base)
     Marshalled *resp_marshal = NULL;
     UserInfo *uinfo = NULL;
     DBObjIt *it = NULL;
+    QryCursor next;
     LikeInfo *linfo;
     int rc;
 
@@ -3368,6 +3674,8 @@ void hdl_get_liked_data_req(Carrier *c, const char *from, Req *base)
               linfo->user.name, linfo->user.did);
     }
     if (rc < 0) {
+        if (reqepoch_cancelled())
+            goto finally;
         vlogE(TAG_CMD "Iterating likes failed.");
         ErrResp resp = {
             .tsx_id = req->tsx_id,
@@ -3377,6 +3685,8 @@ void hdl_get_liked_data_req(Carrier *c, const char *from, Req *base)
         goto finally;
     }
 
+    likes_cursor(&next, &req->params.qc, linfos);
+
     {
         size_t left = MAX_CONTENT_LEN;
         cvector_vector_type(LikeInfo *) linfos_tmp = NULL;
@@ -3412,7 +3722,8 @@ void hdl_get_liked_data_req(Carrier *c, const char *from, Req *base)
                 .tsx_id = req->tsx_id,
                 .result = {
                     .is_last = i == cvector_size(linfos) - 1,
-                    .linfos  = linfos_tmp
+                    .linfos  = linfos_tmp,
+                    .next    = next
                 }
             };
             resp_marshal = rpc_marshal_get_liked_data_resp(&resp);
@@ -3455,6 +3766,7 @@ void hdl_get_cmts_req(Carrier *c, const char *from, Req *base)
     Marshalled *resp_marshal = NULL;
     UserInfo *uinfo = NULL;
     DBObjIt *it = NULL;
+    QryCursor next;
     Chan *chan = NULL;
     CmtInfo *cinfo;
     int rc;
@@ -3525,6 +3837,8 @@ void hdl_get_cmts_req(Carrier *c, const char *from, Req *base)
               cinfo->proof, cinfo->thu_len);
     }
     if (rc < 0) {
+        if (reqepoch_cancelled())
+            goto finally;
         vlogE(TAG_CMD "Iterating comments failed.");
         ErrResp resp = {
             .tsx_id = req->tsx_id,
@@ -3534,6 +3848,8 @@ void hdl_get_cmts_req(Carrier *c, const char *from, Req *base)
         goto finally;
     }
 
+    cmts_cursor(&next, &req->params.qc, cinfos);
+
     {
         size_t left = MAX_CONTENT_LEN;
         cvector_vector_type(CmtInfo *) cinfos_tmp = NULL;
@@ -3544,7 +3860,8 @@ void hdl_get_cmts_req(Carrier *c, const char *from, Req *base)
                 .tsx_id = req->tsx_id,
                 .result = {
                     .is_last = true,
-                    .cinfos  = cinfos
+                    .cinfos  = cinfos,
+                    .omit    = req->params.qc.omit
                 }
             };
             resp_marshal = rpc_marshal_get_cmts_resp(&resp);
@@ -3564,7 +3881,9 @@ void hdl_get_cmts_req(Carrier *c, const char *from, Req *base)
                 .tsx_id = req->tsx_id,
                 .result = {
                     .is_last = i == cvector_size(cinfos) - 1,
-                    .cinfos  = cinfos_tmp
+                    .cinfos  = cinfos_tmp,
+                    .next    = next,
+                    .omit    = req->params.qc.omit
                 }
             };
             resp_marshal = rpc_marshal_get_cmts_resp(&resp);
@@ -3607,6 +3926,7 @@ void hdl_get_cmts_likes_req(Carrier *c, const char *from, Req *base)
     Marshalled *resp_marshal = NULL;
     UserInfo *uinfo = NULL;
     DBObjIt *it = NULL;
+    QryCursor next;
     Chan *chan = NULL;
     CmtInfo *cinfo;
     int rc;
@@ -3671,6 +3991,8 @@ void hdl_get_cmts_likes_req(Carrier *c, const char *from, Req *base)
               cinfo->chan_id, cinfo->post_id, cinfo->cmt_id, cinfo->likes);
     }
     if (rc < 0) {
+        if (reqepoch_cancelled())
+            goto finally;
         vlogE(TAG_CMD "Iterating comments likes failed.");
         ErrResp resp = {
             .tsx_id = req->tsx_id,
@@ -3680,11 +4002,14 @@ void hdl_get_cmts_likes_req(Carrier *c, const char *from, Req *base)
         goto finally;
     }
 
+    cmts_cursor(&next, &req->params.qc, cinfos);
+
     {
         GetCmtsLikesResp resp = {
             .tsx_id = req->tsx_id,
             .result = {
-                .cinfos  = cinfos
+                .cinfos  = cinfos,
+                .next    = next
             }
         };
         resp_marshal = rpc_marshal_get_cmts_likes_resp(&resp);
@@ -3712,6 +4037,7 @@ void hdl_get_stats_req(Carrier *c, const char *from, Req *base)
     GetStatsReq *req = (GetStatsReq *)base;
     Marshalled *resp_marshal = NULL;
     UserInfo *uinfo = NULL;
+    AdmissionStats as;
     int total_clients;
 
     vlogD(TAG_CMD "Received get_statistics request from [%s]: "
@@ -3744,6 +4070,8 @@ void hdl_get_stats_req(Carrier *c, const char *from, Req *base)
         goto finally;
     }
 
+    admission_get_stats(&as);
+
     {
         GetStatsResp resp = {
             .tsx_id = req->tsx_id,
@@ -3751,12 +4079,18 @@ void hdl_get_stats_req(Carrier *c, const char *from, Req *base)
                 .did     = feeds_owner_info.did,
                 .conn_cs = connecting_clients,
                 .total_cs = total_clients,
+                .cancelled_reqs = reqepoch_avoided(),
+                .accepted_reqs = as.accepted,
+                .throttled_reqs = as.throttled,
+                .shed_reqs = as.shed,
             }
         };
         resp_marshal = rpc_marshal_get_stats_resp(&resp);
         vlogD(TAG_CMD "Sending get_statistics response: "
-              "{did: %s, connecting_clients: %zu, total_clients: %zu}",
-              feeds_owner_info.did, connecting_clients, total_clients);
+              "{did: %s, connecting_clients: %zu, total_clients: %zu, cancelled_requests: %" PRIu64 ", "
+              "accepted_requests: %" PRIu64 ", throttled_requests: %" PRIu64 ", shed_requests: %" PRIu64 "}",
+              feeds_owner_info.did, connecting_clients, total_clients, resp.result.cancelled_reqs,
+              resp.result.accepted_reqs, resp.result.throttled_reqs, resp.result.shed_reqs);
     }
 
 finally:
@@ -3775,7 +4109,10 @@ void hdl_sub_chan_req(Carrier *c, const char *from, Req *base)
     ActiveSuber *owner = NULL;
     ActiveSuber *as = NULL;
     UserInfo *uinfo = NULL;
+    ChanInfo *cold = NULL;
+    void *avatar = NULL;
     Chan *chan = NULL;
+    ChanInfo ci;
     int rc;
 
     vlogD(TAG_CMD "Received subscribe_channel request from [%s]: "
@@ -3808,6 +4145,17 @@ void hdl_sub_chan_req(Carrier *c, const char *from, Req *base)
         goto finally;
     }
 
+    if (!(cold = chan_info_full(chan, &ci))) {
+        vlogE(TAG_CMD "Loading channel [%" PRIu64 "] from database failed", req->params.id);
+        ErrResp resp = {
+            .tsx_id = req->tsx_id,
+            .ec     = ERR_INTERNAL_ERROR
+        };
+        resp_marshal = rpc_marshal_err_resp(&resp);
+        goto finally;
+    }
+    avatar = chan_info_avatar(&ci);
+
     if ((rc = db_is_suber(uinfo->uid, req->params.id)) < 0 || rc) {
         vlogE(TAG_CMD "Subscribing subscribed channel");
         ErrResp resp = {
@@ -3847,6 +4195,7 @@ void hdl_sub_chan_req(Carrier *c, const char *from, Req *base)
         aspc_put(aspc);
 
     ++chan->info.subs;
+    ci.subs = chan->info.subs;
     vlogI(TAG_CMD "[%s] subscribed to channel [%" PRIu64 "]", uinfo->did, req->params.id);
 
     {
@@ -3854,7 +4203,7 @@ void hdl_sub_chan_req(Carrier *c, const char *from, Req *base)
             .tsx_id = req->tsx_id,
             .result = {
                 .is_last = true,
-                .cinfo = &chan->info
+                .cinfo = &ci
             }
         };
         resp_marshal = rpc_marshal_sub_chan_resp(&resp);
@@ -3876,6 +4225,8 @@ finally:
     }
     deref(owner);
     deref(uinfo);
+    deref(avatar);
+    deref(cold);
     deref(chan);
     deref(aspc);
     deref(as);
@@ -3967,6 +4318,7 @@ void nd_dtor(void *obj)
     NotifDest *nd = (NotifDest *)obj;
 
     deref(nd->ndpass);
+    deref(nd->expiry);
 }
 
 static
@@ -4084,6 +4436,7 @@ void hdl_enbl_notif_req(Carrier *c, const char *from, Req *base)
         }
         new_nd = true;
     }
+    nd->avatar_by_hash = avatar_by_hash();
 
     ndpas = ndpas_create(as, nd);
     if (!ndpas) {
@@ -4132,6 +4485,8 @@ void hdl_enbl_notif_req(Carrier *c, const char *from, Req *base)
         }
         deref(it);
         if (rc < 0) {
+            if (reqepoch_cancelled())
+                goto finally;
             vlogE(TAG_CMD "Iterating subscribed channels failed.");
             ErrResp resp = {
                 .tsx_id = req->tsx_id,
@@ -4332,6 +4687,7 @@ void hdl_get_reported_cmts_req(Carrier *c, const char *from, Req *base)
     Marshalled *resp_marshal = NULL;
     UserInfo *uinfo = NULL;
     DBObjIt *it = NULL;
+    QryCursor next;
     Chan *chan = NULL;
     ReportedCmtInfo *rcinfo;
     int rc;
@@ -4390,6 +4746,8 @@ void hdl_get_reported_cmts_req(Carrier *c, const char *from, Req *base)
               rcinfo->created_at);
     }
     if (rc < 0) {
+        if (reqepoch_cancelled())
+            goto finally;
         vlogE(TAG_CMD "Iterating comments failed.");
         ErrResp resp = {
             .tsx_id = req->tsx_id,
@@ -4399,6 +4757,8 @@ void hdl_get_reported_cmts_req(Carrier *c, const char *from, Req *base)
         goto finally;
     }
 
+    reported_cmts_cursor(&next, &req->params.qc, rcinfos);
+
     {
         // size_t left = MAX_CONTENT_LEN;
         cvector_vector_type(ReportedCmtInfo *) rcinfos_tmp = NULL;
@@ -4428,7 +4788,8 @@ void hdl_get_reported_cmts_req(Carrier *c, const char *from, Req *base)
                 .tsx_id = req->tsx_id,
                 .result = {
                     .is_last = i == cvector_size(rcinfos) - 1,
-                    .rcinfos  = rcinfos_tmp
+                    .rcinfos  = rcinfos_tmp,
+                    .next     = next
                 }
             };
             resp_marshal = rpc_marshal_get_reported_cmts_resp(&resp);
@@ -4491,13 +4852,19 @@ void feeds_deactivate_suber(const char *node_id)
     if (!nd)
         return;
 
+    if (nd->expiry)
+        timer_stop(nd->expiry);
+
     list_foreach(nd->ndpass, ndpas) {
         ActiveSuber *as = ndpas->as;
+        linked_hashtable_iterator_t it;
+        ActiveSuberPerChan *aspc;
+
+        hashtable_foreach(as->aspcs, aspc)
+            cnds_remove(aspc->chan->cnds, nd);
+
         deref(linked_hashtable_remove(as->ndpass, node_id, strlen(node_id)));
         if (linked_hashtable_is_empty(as->ndpass)) {
-            linked_hashtable_iterator_t it;
-            ActiveSuberPerChan *aspc;
-
             hashtable_foreach(as->aspcs, aspc)
                 deref(linked_list_remove_entry(aspc->chan->aspcs, &aspc->le));
             deref(as_remove(as->uid));
@@ -4507,6 +4874,63 @@ void feeds_deactivate_suber(const char *node_id)
     deref(nd);
 }
 
+static
+void nd_expire(void *context)
+{
+    NotifDest *nd = (NotifDest *)context;
+    NotifDest *cur;
+
+    cur = nd_get(nd->node_id);
+    if (cur == nd) {
+        vlogI(TAG_CMD "Notification destination [%s] expired.", nd->node_id);
+        feeds_deactivate_suber(nd->node_id);
+    }
+    deref(cur);
+}
+
+/*
+ * With the outbox enabled, a disconnected destination keeps its place in
+ * the fan-out for outbox_ttl seconds so the notifications it misses are
+ * queued to the outbox. It is dropped on reconnect (the client enables
+ * notification again as before) or once the ttl is over.
+ */
+void feeds_suspend_suber(const char *node_id)
+{
+    NotifDest *nd;
+
+    if (!outbox_ttl) {
+        feeds_deactivate_suber(node_id);
+        return;
+    }
+
+    nd = nd_get(node_id);
+    if (!nd)
+        return;
+
+    nd->absent_since = time(NULL);
+    if (nd->expiry)
+        timer_restart(nd->expiry, outbox_ttl * 1000ULL);
+    else
+        nd->expiry = timer_start(outbox_ttl * 1000ULL, nd_expire, nd);
+    deref(nd);
+}
+
+void feeds_resume_suber(const char *node_id)
+{
+    NotifDest *nd;
+    bool absent;
+
+    nd = nd_get(node_id);
+    if (!nd)
+        return;
+
+    absent = nd->absent_since != 0;
+    deref(nd);
+
+    if (absent)
+        feeds_deactivate_suber(node_id);
+}
+
 void hdl_stats_changed_notify()
 {
     linked_hashtable_iterator_t it;
@@ -4520,6 +4944,8 @@ void hdl_stats_changed_notify()
 
     hashtable_foreach(nds, nd) {
         linked_list_iterator_t it;
+        if (nd->absent_since)
+            continue;
         list_foreach(nd->ndpass, ndpas) {
             ActiveSuber *as = ndpas->as;
             notify_of_stats_changed(ndpas->nd->node_id, total_clients);
@@ -32,6 +32,8 @@
 int feeds_init(FeedsConfig *cfg);
 void feeds_deinit();
 void feeds_deactivate_suber(const char *node_id);
+void feeds_suspend_suber(const char *node_id);
+void feeds_resume_suber(const char *node_id);
 void hdl_create_chan_req(Carrier *c, const char *from, Req *base);
 void hdl_upd_chan_req(Carrier *c, const char *from, Req *base);
 void hdl_upd_user_info_req(Carrier *c, const char *from, Req *base);
@@ -1,10 +1,14 @@
 #include "DataBase.hpp"
 
+#include <queue>
 #include <ErrCode.hpp>
 #include <Log.hpp>
+#include <SearchIndex.hpp>
 
 extern "C" {
 #include <db.h>
+#include <reqepoch.h>
+#include <reqtrace.h>
 }
 
 
@@ -61,25 +65,39 @@ const char* DataBase::ConditionBy(ConditionField field, ConditionIdType idType)
 /* =========================================== */
 int DataBase::config(const std::filesystem::path& databaseFilePath)
 {
-    Log::D(Log::Tag::Db, "Config database.");
+    LOG_D(Log::Tag::Db, "Config database.");
 
-    handler = std::make_shared<SQLite::Database>(databaseFilePath.string().c_str(), SQLite::OPEN_READWRITE|SQLite::OPEN_CREATE);
+    handler = std::make_shared<SQLite::Database>(databaseFilePath.string().c_str(), SQLite::OPEN_READWRITE|SQLite::OPEN_CREATE,
+                                                 SearchIndex::BusyTimeoutMS);
     CHECK_ASSERT(handler != nullptr, ErrCode::DBOpenFailed);
 
+    // the search indexer writes through its own connection, WAL keeps it
+    // from blocking readers on the request thread.
+    try {
+        handler->exec("PRAGMA journal_mode = WAL");
+    } catch (SQLite::Exception& e) {
+        Log::W(Log::Tag::Db, "Enable WAL journal failed. exception: %s", e.what());
+    }
+
     int ret = db_init(handler->getHandle());
     if(ret < 0) {
         CHECK_ERROR(ErrCode::DBInitFailed);
     }
 
+    searchIndex = SearchIndex::Create(databaseFilePath);
+    CHECK_ASSERT(searchIndex != nullptr, ErrCode::DBOpenFailed);
+    searchIndex->start();
+
     return 0;
 }
 
 void DataBase::cleanup()
 {
+    searchIndex.reset();
     db_deinit();
     DataBaseInstance.reset();
 
-    Log::D(Log::Tag::Db, "Cleanup database.");
+    LOG_D(Log::Tag::Db, "Cleanup database.");
 }
 
 std::shared_ptr<SQLite::Database> DataBase::getHandler()
@@ -89,15 +107,44 @@ std::shared_ptr<SQLite::Database> DataBase::getHandler()
 
 int DataBase::executeStep(const std::string& sql, Step& step)
 {
+    return executeStep(sql, nullptr, step);
+}
+
+int DataBase::executeStep(const std::string& sql, const Bind& bind, Step& step)
+{
+    size_t rows = 0;
+    uint64_t elapsed = 0;
     try {
-        Log::D(Log::Tag::Db, "DataBase sql: %s", sql.c_str());
+        LOG_D(Log::Tag::Db, "DataBase sql: %s", sql.c_str());
         SQLite::Statement stmt(*handler, sql);
+        if(bind != nullptr) {
+            bind(stmt);
+        }
 
+        // leave the loop instead of returning from it, a failed statement
+        // belongs in the slow request trace as much as a successful one.
+        int ret = 0;
+        auto stepAt = reqtrace_mark();
         while (stmt.executeStep()) {
-            int ret = step(stmt);
-            CHECK_ERROR(ret);
+            auto rowAt = reqtrace_stage(TRACE_DB, stepAt);
+            elapsed += rowAt - stepAt;
+            rows++;
+
+            ret = step(stmt);
+            stepAt = reqtrace_stage(TRACE_MATERIALIZE, rowAt);
+            if(ret < 0 || reqepoch_cancelled() == true) {
+                break;
+            }
         }
+        auto doneAt = reqtrace_stage(TRACE_DB, stepAt);
+        elapsed += doneAt - stepAt;
+        reqtrace_sql(sql.c_str(), rows, elapsed);
+        if(reqepoch_cancelled() == true) {
+            return ErrCode::RequestCanceled;
+        }
+        CHECK_ERROR(ret);
     } catch (SQLite::Exception& e) {
+        reqtrace_sql(sql.c_str(), rows, elapsed);
         Log::E(Log::Tag::Db, "DataBase exec failed. exception: %s", e.what());
         CHECK_ERROR(ErrCode::DBException);
     }
@@ -105,6 +152,76 @@ int DataBase::executeStep(const std::string& sql, Step& step)
     return 0;
 }
 
+/*
+ * K-way merge of one statement per query, each of them already ordered the
+ * way `before` expects. Statements are stepped lazily, one row ahead, so
+ * a statement is only read as deep as the merged output needs and the
+ * merge stops as soon as maxCount rows have been handed to step.
+ */
+int DataBase::executeMerge(const std::vector<Query>& queryArray,
+                           const Before& before, size_t maxCount, Step& step)
+{
+    size_t rows = 0;
+    uint64_t elapsed = 0;
+    try {
+        LOG_D(Log::Tag::Db, "DataBase merge %zu queries", queryArray.size());
+        auto after = [&](const std::shared_ptr<SQLite::Statement>& lhs,
+                         const std::shared_ptr<SQLite::Statement>& rhs) -> bool {
+            return before(*rhs, *lhs);
+        };
+        std::priority_queue<std::shared_ptr<SQLite::Statement>,
+                            std::vector<std::shared_ptr<SQLite::Statement>>,
+                            decltype(after)> heads(after);
+
+        int ret = 0;
+        auto stepAt = reqtrace_mark();
+        for(const auto& query: queryArray) {
+            LOG_D(Log::Tag::Db, "DataBase merge sql: %s", query.first.c_str());
+            auto stmt = std::make_shared<SQLite::Statement>(*handler, query.first);
+            query.second(*stmt);
+            if(stmt->executeStep()) {
+                heads.push(stmt);
+            }
+        }
+
+        while(heads.empty() == false && rows < maxCount) {
+            auto stmt = heads.top();
+            heads.pop();
+
+            auto rowAt = reqtrace_stage(TRACE_DB, stepAt);
+            elapsed += rowAt - stepAt;
+            rows++;
+
+            ret = step(*stmt);
+            stepAt = reqtrace_stage(TRACE_MATERIALIZE, rowAt);
+            if(ret < 0 || reqepoch_cancelled() == true) {
+                break;
+            }
+
+            if(rows < maxCount && stmt->executeStep()) {
+                heads.push(stmt);
+            }
+        }
+        auto doneAt = reqtrace_stage(TRACE_DB, stepAt);
+        elapsed += doneAt - stepAt;
+        if(queryArray.empty() == false) {
+            reqtrace_sql(queryArray.front().first.c_str(), rows, elapsed);
+        }
+        if(reqepoch_cancelled() == true) {
+            return ErrCode::RequestCanceled;
+        }
+        CHECK_ERROR(ret);
+    } catch (SQLite::Exception& e) {
+        if(queryArray.empty() == false) {
+            reqtrace_sql(queryArray.front().first.c_str(), rows, elapsed);
+        }
+        Log::E(Log::Tag::Db, "DataBase merge failed. exception: %s", e.what());
+        CHECK_ERROR(ErrCode::DBException);
+    }
+
+    return 0;
+}
+
 /* =========================================== */
 /* === class protected function implement  === */
 /* =========================================== */
@@ -12,10 +12,16 @@
 
 namespace trinity {
 
+class SearchIndex;
+
 class DataBase {
 public:
     /*** type define ***/
     using Step = std::function<int(SQLite::Statement&)>;
+    using Bind = std::function<void(SQLite::Statement&)>;
+    using Query = std::pair<std::string, Bind>;
+    // true if lhs's current row sorts before rhs's in the merged output
+    using Before = std::function<bool(SQLite::Statement&, SQLite::Statement&)>;
     enum ConditionField {
         Id = 1,
         UpdatedAt = 2,
@@ -37,6 +43,9 @@ public:
 
     std::shared_ptr<SQLite::Database> getHandler();
     int executeStep(const std::string& sql, Step& step);
+    int executeStep(const std::string& sql, const Bind& bind, Step& step);
+    int executeMerge(const std::vector<Query>& queryArray,
+                     const Before& before, size_t maxCount, Step& step);
 
 protected:
     /*** type define ***/
@@ -55,6 +64,7 @@ private:
     explicit DataBase() = default;
     virtual ~DataBase() = default;
     std::shared_ptr<SQLite::Database> handler;
+    std::shared_ptr<SearchIndex> searchIndex;
 };
 
 /***********************************************/
@@ -1,6 +1,7 @@
 #ifndef _FEEDS_RPC_DECLARE_HPP_
 #define _FEEDS_RPC_DECLARE_HPP_
 
+#include <optional>
 #include <MsgPackExtension.hpp>
 
 namespace trinity {
@@ -81,8 +82,11 @@ struct GetMultiCommentsRequest : RequestWithToken {
         int64_t upper_bound = -1;
         int64_t lower_bound = -1;
         int64_t max_count = -1;
+        std::string cursor;
+        // blob columns wanted per comment, see QRY_FLDS_BLOBS.
+        std::optional<std::vector<std::string>> fields;
         MSGPACK_DEFINE(MSGPACK_REQUEST_TOKEN_ARGS,
-                       channel_id, post_id, by, upper_bound, lower_bound, max_count);
+                       channel_id, post_id, by, upper_bound, lower_bound, max_count, cursor, fields);
     };
 
     Params params;
@@ -107,13 +111,46 @@ struct GetMultiCommentsResponse : Response {
             std::vector<uint8_t> thumbnails;  //2.0
             std::string hash_id;  //2.0
             std::string proof;  //2.0
-            MSGPACK_DEFINE(channel_id, post_id, comment_id, refer_comment_id,
-                           status, user_did, user_name, content, likes, created_at, updated_at);
+
+            // set when the request left content out of its fields, the
+            // key is then dropped from the packed comment.
+            bool omit_content = false;
+
+            // what MSGPACK_DEFINE would declare.
+            template <typename Self>
+            static auto DefineMap(Self& self) {
+                return msgpack::type::make_define_map("channel_id", self.channel_id, "post_id", self.post_id,
+                                                      "comment_id", self.comment_id, "refer_comment_id", self.refer_comment_id,
+                                                      "status", self.status, "user_did", self.user_did, "user_name", self.user_name,
+                                                      "content", self.content, "likes", self.likes, "created_at", self.created_at,
+                                                      "updated_at", self.updated_at);
+            }
+
+            template <typename Packer>
+            void msgpack_pack(Packer& pk) const {
+                if(omit_content == true) {
+                    msgpack::type::make_define_map("channel_id", channel_id, "post_id", post_id,
+                                                   "comment_id", comment_id, "refer_comment_id", refer_comment_id,
+                                                   "status", status, "user_did", user_did, "user_name", user_name,
+                                                   "likes", likes, "created_at", created_at,
+                                                   "updated_at", updated_at).msgpack_pack(pk);
+                    return;
+                }
+                DefineMap(*this).msgpack_pack(pk);
+            }
+            void msgpack_unpack(const msgpack::object& o) {
+                DefineMap(*this).msgpack_unpack(o);
+            }
+            template <typename MSGPACK_OBJECT>
+            void msgpack_object(MSGPACK_OBJECT* o, msgpack::zone& z) const {
+                DefineMap(*this).msgpack_object(o, z);
+            }
         };
 
         bool is_last = false;
         std::vector<Comment> comments;
-        MSGPACK_DEFINE(is_last, comments);
+        std::string next_cursor;
+        MSGPACK_DEFINE(is_last, comments, next_cursor);
     };
 
     Result result;
@@ -129,8 +166,9 @@ struct GetMultiLikesAndCommentsCountRequest : RequestWithToken {
         int64_t upper_bound = -1;
         int64_t lower_bound = -1;
         int64_t max_count = -1;
+        std::string cursor;
         MSGPACK_DEFINE(MSGPACK_REQUEST_TOKEN_ARGS,
-                       channel_id, post_id, by, upper_bound, lower_bound, max_count);
+                       channel_id, post_id, by, upper_bound, lower_bound, max_count, cursor);
     };
 
     Params params;
@@ -151,7 +189,8 @@ struct GetMultiLikesAndCommentsCountResponse : Response {
 
         bool is_last = false;
         std::vector<Post> posts;
-        MSGPACK_DEFINE(is_last, posts);
+        std::string next_cursor;
+        MSGPACK_DEFINE(is_last, posts, next_cursor);
     };
 
     Result result;
@@ -189,6 +228,201 @@ struct GetMultiSubscribersCountResponse : Response {
                           MSGPACK_RESPONSE_ARGS, result);
 };
 
+struct GetAvatarRequest : RequestWithToken {
+    struct Params : RequestWithToken::Params {
+        int64_t channel_id = -1;
+        std::string user_did;
+        std::string avatar_hash;
+        MSGPACK_DEFINE(MSGPACK_REQUEST_TOKEN_ARGS,
+                       channel_id, user_did, avatar_hash);
+    };
+
+    Params params;
+    MSGPACK_DEFINE_WITHTOKEN(GetAvatarRequest, params.access_token,
+                             MSGPACK_REQUEST_ARGS, params)
+};
+
+struct GetAvatarResponse : Response {
+    struct Result {
+        std::string avatar_hash;
+        bool not_modified = false;
+        std::vector<uint8_t> avatar;
+        MSGPACK_DEFINE(avatar_hash, not_modified, avatar);
+    };
+
+    Result result;
+    MSGPACK_DEFINE_STRUCT(GetAvatarResponse,
+                          MSGPACK_RESPONSE_ARGS, result);
+};
+
+struct GetChangesSinceRequest : RequestWithToken {
+    struct Params : RequestWithToken::Params {
+        int64_t cursor = -1;
+        std::vector<int64_t> channels;
+        int64_t max_count = -1;
+        MSGPACK_DEFINE(MSGPACK_REQUEST_TOKEN_ARGS,
+                       cursor, channels, max_count);
+    };
+
+    Params params;
+    MSGPACK_DEFINE_WITHTOKEN(GetChangesSinceRequest, params.access_token,
+                             MSGPACK_REQUEST_ARGS, params)
+};
+
+struct GetChangesSinceResponse : Response {
+    struct Result {
+        struct Change {
+            int64_t seq = -1;
+            int64_t kind = -1;
+            int64_t channel_id = -1;
+            int64_t post_id = -1;
+            int64_t comment_id = -1;
+            int64_t created_at = -1;
+            MSGPACK_DEFINE(seq, kind, channel_id, post_id, comment_id, created_at);
+        };
+
+        bool is_last = false;
+        bool reset = false;
+        int64_t cursor = -1;
+        std::vector<Change> changes;
+        MSGPACK_DEFINE(is_last, reset, cursor, changes);
+    };
+
+    Result result;
+    MSGPACK_DEFINE_STRUCT(GetChangesSinceResponse,
+                          MSGPACK_RESPONSE_ARGS, result);
+};
+
+struct SearchRequest : RequestWithToken {
+    struct Params : RequestWithToken::Params {
+        std::string keywords;
+        int64_t channel_id = -1;
+        double after_rank = 0;
+        int64_t after_id = -1;
+        int64_t max_count = -1;
+        MSGPACK_DEFINE(MSGPACK_REQUEST_TOKEN_ARGS,
+                       keywords, channel_id, after_rank, after_id, max_count);
+    };
+
+    Params params;
+    MSGPACK_DEFINE_WITHTOKEN(SearchRequest, params.access_token,
+                             MSGPACK_REQUEST_ARGS, params)
+};
+
+struct SearchResponse : Response {
+    struct Result {
+        struct Hit {
+            int64_t channel_id = -1;
+            int64_t post_id = -1;
+            int64_t comment_id = -1;
+            double rank = 0;
+            int64_t doc_id = -1;
+            MSGPACK_DEFINE(channel_id, post_id, comment_id, rank, doc_id);
+        };
+
+        bool is_last = false;
+        std::vector<Hit> hits;
+        MSGPACK_DEFINE(is_last, hits);
+    };
+
+    Result result;
+    MSGPACK_DEFINE_STRUCT(SearchResponse,
+                          MSGPACK_RESPONSE_ARGS, result);
+};
+
+struct GetTimelineRequest : RequestWithToken {
+    struct Params : RequestWithToken::Params {
+        std::string cursor;
+        int64_t max_count = -1;
+        MSGPACK_DEFINE(MSGPACK_REQUEST_TOKEN_ARGS, cursor, max_count);
+    };
+
+    Params params;
+    MSGPACK_DEFINE_WITHTOKEN(GetTimelineRequest, params.access_token,
+                             MSGPACK_REQUEST_ARGS, params)
+};
+
+struct GetTimelineResponse : Response {
+    struct Result {
+        struct Post {
+            int64_t channel_id = -1;
+            int64_t post_id = -1;
+            int64_t status = -1;
+            std::vector<uint8_t> content;
+            int64_t comments = -1;
+            int64_t likes = -1;
+            int64_t created_at = -1;
+            int64_t updated_at = -1;
+            std::vector<uint8_t> thumbnails;
+            std::string hash_id;
+            std::string proof;
+            std::string origin_post_url;
+            MSGPACK_DEFINE(channel_id, post_id, status, content, comments, likes,
+                           created_at, updated_at, thumbnails, hash_id, proof, origin_post_url);
+        };
+
+        bool is_last = false;
+        std::vector<Post> posts;
+        std::string next_cursor;
+        MSGPACK_DEFINE(is_last, posts, next_cursor);
+    };
+
+    Result result;
+    MSGPACK_DEFINE_STRUCT(GetTimelineResponse,
+                          MSGPACK_RESPONSE_ARGS, result);
+};
+
+struct GetCommentThreadRequest : RequestWithToken {
+    struct Params : RequestWithToken::Params {
+        int64_t channel_id = -1;
+        int64_t post_id = -1;
+        int64_t comment_id = -1;
+        int64_t replies = -1;
+        int64_t max_count = -1;
+        std::string cursor;
+        MSGPACK_DEFINE(MSGPACK_REQUEST_TOKEN_ARGS,
+                       channel_id, post_id, comment_id, replies, max_count, cursor);
+    };
+
+    Params params;
+    MSGPACK_DEFINE_WITHTOKEN(GetCommentThreadRequest, params.access_token,
+                             MSGPACK_REQUEST_ARGS, params)
+};
+
+struct GetCommentThreadResponse : Response {
+    struct Result {
+        struct Comment {
+            int64_t channel_id = -1;
+            int64_t post_id = -1;
+            int64_t comment_id = -1;
+            int64_t refer_comment_id = -1;
+            int64_t status = -1;
+            std::string user_did;
+            std::string user_name;
+            std::vector<uint8_t> content;
+            int64_t likes = -1;
+            int64_t created_at = -1;
+            int64_t updated_at = -1;
+            std::vector<uint8_t> thumbnails;
+            std::string hash_id;
+            std::string proof;
+            int64_t reply_count = -1;
+            std::string replies_cursor;
+            MSGPACK_DEFINE(channel_id, post_id, comment_id, refer_comment_id,
+                           status, user_did, user_name, content, likes, created_at, updated_at,
+                           thumbnails, hash_id, proof, reply_count, replies_cursor);
+        };
+
+        bool is_last = false;
+        std::vector<Comment> comments;
+        std::string next_cursor;
+        MSGPACK_DEFINE(is_last, comments, next_cursor);
+    };
+
+    Result result;
+    MSGPACK_DEFINE_STRUCT(GetCommentThreadResponse,
+                          MSGPACK_RESPONSE_ARGS, result);
+};
 
 } // namespace Rpc
 } // namespace trinity
@@ -43,16 +43,71 @@ int Factory::Unmarshal(const std::vector<uint8_t>& data, std::shared_ptr<Request
     return processed;
 }
 
-int Factory::Marshal(const std::shared_ptr<Response>& response, std::vector<uint8_t>& data)
+int Factory::Marshal(const std::shared_ptr<Response>& response, const Consumer& consumer)
 {
-    msgpack::sbuffer mpBuf;
+    // one encoder buffer per thread, it keeps its capacity across responses
+    // so packing stops reallocating once it has seen the largest page.
+    thread_local msgpack::sbuffer mpBuf(EncoderBufferSize);
 
+    mpBuf.clear();
     response->pack(mpBuf);
 
-    auto mpBufPtr = reinterpret_cast<uint8_t*>(mpBuf.data());
-    data = {mpBufPtr, mpBufPtr + mpBuf.size()};
+    int ret = consumer(reinterpret_cast<const uint8_t*>(mpBuf.data()), mpBuf.size());
 
-    return data.size();
+    // an occasional huge response should not pin its buffer for good.
+    if(mpBuf.size() > EncoderBufferLimit) {
+        mpBuf = msgpack::sbuffer(EncoderBufferSize);
+    }
+
+    return ret;
+}
+
+int Factory::Peek(const std::vector<uint8_t>& data, Envelope& envelope)
+{
+    // strings and binaries are referenced in place instead of being copied
+    // out of the request, only the envelope is looked at.
+    auto reference = [](msgpack::type::object_type, std::size_t, void*) -> bool {
+        return true;
+    };
+
+    try {
+        auto mpUnpackHandle = msgpack::unpack(reinterpret_cast<const char*>(data.data()), data.size(), reference);
+        const msgpack::object& mpRoot = mpUnpackHandle.get();
+        CHECK_ASSERT(mpRoot.type == msgpack::type::MAP, ErrCode::MsgPackInvalidStruct);
+
+        for(uint32_t idx = 0; idx < mpRoot.via.map.size; idx++) {
+            const auto& kv = mpRoot.via.map.ptr[idx];
+            if(kv.key.type != msgpack::type::STR) {
+                continue;
+            }
+
+            auto key = kv.key.as<std::string>();
+            if(key == DictKeyMethod && kv.val.type == msgpack::type::STR) {
+                envelope.method = kv.val.as<std::string>();
+            } else if(key == DictKeyId && kv.val.type == msgpack::type::POSITIVE_INTEGER) {
+                envelope.id = kv.val.as<int64_t>();
+            } else if(key == DictKeyAcceptEncoding && kv.val.type == msgpack::type::STR) {
+                envelope.acceptEncoding = kv.val.as<std::string>();
+            } else if(key == DictKeyDictionary && kv.val.type == msgpack::type::POSITIVE_INTEGER) {
+                envelope.dictionary = kv.val.as<int64_t>();
+            } else if(key == DictKeyAvatarHash && kv.val.type == msgpack::type::BOOLEAN) {
+                envelope.avatarHash = kv.val.as<bool>();
+            } else if(key == DictKeyParams && kv.val.type == msgpack::type::MAP) {
+                for(uint32_t pidx = 0; pidx < kv.val.via.map.size; pidx++) {
+                    const auto& param = kv.val.via.map.ptr[pidx];
+                    if(param.key.type == msgpack::type::STR && param.key.as<std::string>() == DictKeyMaxCount
+                    && param.val.type == msgpack::type::POSITIVE_INTEGER) {
+                        envelope.maxCount = param.val.as<int64_t>();
+                    }
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        Log::W(Log::Tag::Rpc, "Failed to peek request. exception: %s", e.what());
+        CHECK_ERROR(ErrCode::MsgPackParseFailed);
+    }
+
+    return 0;
 }
 
 std::shared_ptr<Request> Factory::MakeRequest(const std::string& method)
@@ -69,6 +124,16 @@ std::shared_ptr<Request> Factory::MakeRequest(const std::string& method)
         request = std::make_shared<GetMultiLikesAndCommentsCountRequest>();
     } else if(method == Method::GetMultiSubscribersCount) {
         request = std::make_shared<GetMultiSubscribersCountRequest>();
+    } else if(method == Method::GetAvatar) {
+        request = std::make_shared<GetAvatarRequest>();
+    } else if(method == Method::GetChangesSince) {
+        request = std::make_shared<GetChangesSinceRequest>();
+    } else if(method == Method::Search) {
+        request = std::make_shared<SearchRequest>();
+    } else if(method == Method::GetTimeline) {
+        request = std::make_shared<GetTimelineRequest>();
+    } else if(method == Method::GetCommentThread) {
+        request = std::make_shared<GetCommentThreadRequest>();
     }
 
     return request;
@@ -88,6 +153,16 @@ std::shared_ptr<Response> Factory::MakeResponse(const std::string& method)
         response = std::make_shared<GetMultiLikesAndCommentsCountResponse>();
     } else if(method == Method::GetMultiSubscribersCount) {
         response = std::make_shared<GetMultiSubscribersCountResponse>();
+    } else if(method == Method::GetAvatar) {
+        response = std::make_shared<GetAvatarResponse>();
+    } else if(method == Method::GetChangesSince) {
+        response = std::make_shared<GetChangesSinceResponse>();
+    } else if(method == Method::Search) {
+        response = std::make_shared<SearchResponse>();
+    } else if(method == Method::GetTimeline) {
+        response = std::make_shared<GetTimelineResponse>();
+    } else if(method == Method::GetCommentThread) {
+        response = std::make_shared<GetCommentThreadResponse>();
     } else {
         Log::E(Log::Tag::Rpc, "RPC Factory ignore to make response from method: %s.", method.c_str());
     }
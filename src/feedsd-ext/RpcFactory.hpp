@@ -1,6 +1,7 @@
 #ifndef _FEEDS_RPC_FACTORY_HPP_
 #define _FEEDS_RPC_FACTORY_HPP_
 
+#include <functional>
 #include <map>
 #include <string>
 #include <vector>
@@ -18,14 +19,33 @@ public:
         static constexpr const char* GetMultiComments = "get_multi_comments";
         static constexpr const char* GetMultiLikesAndCommentsCount = "get_multi_likes_and_comments_count";
         static constexpr const char* GetMultiSubscribersCount = "get_multi_subscribers_count";
+        static constexpr const char* GetAvatar = "get_avatar";
+        static constexpr const char* GetChangesSince = "get_changes_since";
+        static constexpr const char* Search = "search";
+        static constexpr const char* GetTimeline = "get_timeline";
+        static constexpr const char* GetCommentThread = "get_comment_thread";
     };
 
+    // top-level fields of a request, legacy or not, read without decoding it.
+    struct Envelope {
+        std::string method;
+        int64_t id = -1;
+        int64_t maxCount = -1;
+        std::string acceptEncoding;
+        int64_t dictionary = 0;
+        bool avatarHash = false;
+    };
+
+    // sees the packed bytes before the encoder buffer is reused.
+    using Consumer = std::function<int(const uint8_t* data, size_t size)>;
+
     /*** static function and variable ***/
     static std::shared_ptr<Request> MakeRequest(const std::string& method);
     static std::shared_ptr<Response> MakeResponse(const std::string& method);
 
     static int Unmarshal(const std::vector<uint8_t>& data, std::shared_ptr<Request>& request);
-    static int Marshal(const std::shared_ptr<Response>& response, std::vector<uint8_t>& data);
+    static int Marshal(const std::shared_ptr<Response>& response, const Consumer& consumer);
+    static int Peek(const std::vector<uint8_t>& data, Envelope& envelope);
 
     static constexpr const int MaxAvailableSize = 4 * 1024; // 4KB
 
@@ -44,6 +64,15 @@ private:
 
     /*** static function and variable ***/
     static constexpr const char* DictKeyMethod = "method";
+    static constexpr const char* DictKeyId = "id";
+    static constexpr const char* DictKeyParams = "params";
+    static constexpr const char* DictKeyMaxCount = "max_count";
+    static constexpr const char* DictKeyAcceptEncoding = "accept_encoding";
+    static constexpr const char* DictKeyDictionary = "dictionary";
+    static constexpr const char* DictKeyAvatarHash = "avatar_hash";
+
+    static constexpr const size_t EncoderBufferSize = 64 * 1024; // 64KB
+    static constexpr const size_t EncoderBufferLimit = 4 * 1024 * 1024; // 4MB
 
     /*** class function and variable ***/
     explicit Factory() = delete;
@@ -0,0 +1,292 @@
+#include "SearchIndex.hpp"
+
+#include <chrono>
+#include <sstream>
+#include <thread>
+#include <ErrCode.hpp>
+#include <Log.hpp>
+#include <ThreadPool.hpp>
+
+extern "C" {
+#include <crystal.h>
+#include <db.h>
+#include <obj.h>
+}
+
+namespace trinity {
+
+/* =========================================== */
+/* === static variables initialize =========== */
+/* =========================================== */
+
+/* =========================================== */
+/* === static function implement ============= */
+/* =========================================== */
+std::shared_ptr<SearchIndex> SearchIndex::Create(const std::filesystem::path& databaseFilePath)
+{
+    struct Impl: SearchIndex {
+        explicit Impl(const std::filesystem::path& databaseFilePath)
+            : SearchIndex(databaseFilePath) {}
+        virtual ~Impl() {};
+    };
+    auto impl = std::make_shared<Impl>(databaseFilePath);
+
+    return impl;
+}
+
+std::string SearchIndex::MakeQuery(const std::string& keywords)
+{
+    // quote every keyword as a phrase, so user input can never be parsed
+    // as fts5 query syntax; adjacent phrases are implicitly AND-ed.
+    std::stringstream query;
+    std::stringstream words(keywords);
+    std::string word;
+    while (words >> word) {
+        query << (query.tellp() > 0 ? " \"" : "\"");
+        for(auto ch: word) {
+            query << (ch == '"' ? "\"\"" : std::string(1, ch));
+        }
+        query << "\"";
+    }
+
+    return query.str();
+}
+
+/* =========================================== */
+/* === class public function implement  ====== */
+/* =========================================== */
+void SearchIndex::start()
+{
+    LOG_D(Log::Tag::Db, "Start search indexer.");
+
+    schedule(0);
+}
+
+/* =========================================== */
+/* === class protected function implement  === */
+/* =========================================== */
+SearchIndex::SearchIndex(const std::filesystem::path& databaseFilePath)
+{
+    handler = std::make_shared<SQLite::Database>(databaseFilePath.string().c_str(),
+                                                 SQLite::OPEN_READWRITE, BusyTimeoutMS);
+    threadPool = ThreadPool::Create("search-indexer");
+}
+
+/* =========================================== */
+/* === class private function implement  ===== */
+/* =========================================== */
+void SearchIndex::schedule(long delayMS)
+{
+    // hold only a weak reference while sleeping, DataBase::cleanup() releases
+    // the indexer and the pending task quits on its next poll.
+    std::weak_ptr<SearchIndex> weakSelf = shared_from_this();
+    threadPool->post([weakSelf, delayMS] {
+        for(long slept = 0; slept < delayMS; slept += PollIntervalMS) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(PollIntervalMS));
+            if(weakSelf.expired() == true) {
+                return;
+            }
+        }
+
+        auto self = weakSelf.lock();
+        if(self == nullptr) {
+            return;
+        }
+
+        // this connection does not see the rows still waiting in a backup
+        // table, wait until db_init's background migration is done.
+        if(db_migration_pending() != 0) {
+            self->schedule(IdleIntervalMS);
+            return;
+        }
+
+        bool drained = true;
+        int ret = self->indexBatch(drained);
+        if(ret < 0) {
+            Log::W(Log::Tag::Db, "Search indexer batch failed, retry later.");
+        }
+        self->schedule(drained == true || ret < 0 ? IdleIntervalMS : 0);
+    });
+}
+
+int SearchIndex::indexBatch(bool& drained)
+{
+    try {
+        // IMMEDIATE takes the write lock up front, so the request thread never
+        // has to upgrade a read lock against the indexer.
+        handler->exec("BEGIN IMMEDIATE");
+
+        int64_t cursor = -1;
+        int64_t postsRowid = -1;
+        int64_t commentsRowid = -1;
+        bool found = false;
+        SQLite::Statement state(*handler, "SELECT cursor, posts_rowid, comments_rowid FROM search_state WHERE id = 0");
+        if(state.executeStep()) {
+            cursor = state.getColumn(0).getInt64();
+            postsRowid = state.getColumn(1).getInt64();
+            commentsRowid = state.getColumn(2).getInt64();
+            found = true;
+        }
+        state.reset();
+
+        // trimmed through the oldest row, or through the last seq handed out
+        // once the journal is empty; see get_changes_since.
+        SQLite::Statement oldest(*handler, "SELECT COALESCE((SELECT MIN(seq) - 1 FROM changes), seq), seq"
+                                           " FROM (SELECT COALESCE((SELECT seq FROM sqlite_sequence WHERE name = 'changes'), 0) AS seq)");
+        oldest.executeStep();
+        bool trimmed = (cursor < oldest.getColumn(0).getInt64());
+        if(found == false || trimmed == true) {
+            Log::I(Log::Tag::Db, "Search index is %s, rebuilding.", found ? "behind the change journal" : "missing");
+            handler->exec("DELETE FROM search_docs");
+            handler->exec("DELETE FROM search_index");
+            cursor = oldest.getColumn(1).getInt64();
+            postsRowid = 0;
+            commentsRowid = 0;
+        }
+        oldest.reset();
+
+        int ret = 0;
+        drained = false;
+        if(postsRowid >= 0) {
+            ret = rebuildBatch("posts", postsRowid, false);
+        } else if(commentsRowid >= 0) {
+            ret = rebuildBatch("comments", commentsRowid, true);
+        } else {
+            ret = journalBatch(cursor, drained);
+        }
+        if(ret < 0) {
+            handler->exec("ROLLBACK");
+            CHECK_ERROR(ret);
+        }
+
+        SQLite::Statement save(*handler, "INSERT OR REPLACE INTO search_state(id, cursor, posts_rowid, comments_rowid)"
+                                         " VALUES (0, :cursor, :posts_rowid, :comments_rowid)");
+        save.bind(":cursor", cursor);
+        save.bind(":posts_rowid", postsRowid);
+        save.bind(":comments_rowid", commentsRowid);
+        save.exec();
+
+        handler->exec("COMMIT");
+    } catch (SQLite::Exception& e) {
+        Log::E(Log::Tag::Db, "Search index update failed. exception: %s", e.what());
+        try {
+            handler->exec("ROLLBACK");
+        } catch (SQLite::Exception&) {
+        }
+        CHECK_ERROR(ErrCode::DBException);
+    }
+
+    return 0;
+}
+
+int SearchIndex::rebuildBatch(const char* table, int64_t& rowid, bool isComment)
+{
+    std::stringstream sql;
+    sql << " SELECT rowid, channel_id, post_id, " << (isComment ? "comment_id" : "0");
+    sql << " FROM " << table;
+    sql << " WHERE rowid > " << rowid;
+    sql << " ORDER BY rowid ASC LIMIT " << BatchSize;
+    sql << ";";
+
+    int count = 0;
+    SQLite::Statement stmt(*handler, sql.str());
+    while (stmt.executeStep()) {
+        rowid = stmt.getColumn(0).getInt64();
+        int ret = reindex(stmt.getColumn(1).getInt64(), stmt.getColumn(2).getInt64(), stmt.getColumn(3).getInt64());
+        CHECK_ERROR(ret);
+        count++;
+    }
+    if(count < BatchSize) {
+        Log::I(Log::Tag::Db, "Search index rebuild of %s done.", table);
+        rowid = -1;
+    }
+
+    return 0;
+}
+
+int SearchIndex::journalBatch(int64_t& cursor, bool& drained)
+{
+    std::stringstream sql;
+    sql << " SELECT seq, kind, channel_id, post_id, comment_id";
+    sql << " FROM changes";
+    sql << " WHERE seq > " << cursor;
+    sql << " ORDER BY seq ASC LIMIT " << BatchSize;
+    sql << ";";
+
+    int count = 0;
+    SQLite::Statement stmt(*handler, sql.str());
+    while (stmt.executeStep()) {
+        cursor = stmt.getColumn(0).getInt64();
+        count++;
+
+        auto kind = stmt.getColumn(1).getInt();
+        if(kind < CHANGE_POST_NEW || kind > CHANGE_CMT_STATUS) {
+            continue;
+        }
+        int ret = reindex(stmt.getColumn(2).getInt64(), stmt.getColumn(3).getInt64(), stmt.getColumn(4).getInt64());
+        CHECK_ERROR(ret);
+    }
+    drained = (count < BatchSize);
+
+    return 0;
+}
+
+int SearchIndex::reindex(int64_t channelId, int64_t postId, int64_t commentId)
+{
+    std::stringstream sql;
+    sql << " SELECT CAST(content AS TEXT)";
+    if(commentId > 0) {
+        sql << " FROM comments";
+        sql << " WHERE channel_id = " << channelId << " AND post_id = " << postId << " AND comment_id = " << commentId;
+        sql << " AND status = " << CMT_AVAILABLE;
+    } else {
+        sql << " FROM posts";
+        sql << " WHERE channel_id = " << channelId << " AND post_id = " << postId;
+        sql << " AND status = " << POST_AVAILABLE;
+    }
+    sql << ";";
+
+    SQLite::Statement content(*handler, sql.str());
+    bool available = content.executeStep();
+
+    SQLite::Statement doc(*handler, "SELECT doc_id FROM search_docs"
+                                    " WHERE channel_id = :channel_id AND post_id = :post_id AND comment_id = :comment_id");
+    doc.bind(":channel_id", channelId);
+    doc.bind(":post_id", postId);
+    doc.bind(":comment_id", commentId);
+    int64_t docId = doc.executeStep() ? doc.getColumn(0).getInt64() : -1;
+
+    if(docId > 0) {
+        SQLite::Statement drop(*handler, "DELETE FROM search_index WHERE rowid = :doc_id");
+        drop.bind(":doc_id", docId);
+        drop.exec();
+    }
+
+    if(available == false) {
+        if(docId > 0) {
+            SQLite::Statement drop(*handler, "DELETE FROM search_docs WHERE doc_id = :doc_id");
+            drop.bind(":doc_id", docId);
+            drop.exec();
+        }
+        return 0;
+    }
+
+    if(docId < 0) {
+        SQLite::Statement add(*handler, "INSERT INTO search_docs(channel_id, post_id, comment_id)"
+                                        " VALUES (:channel_id, :post_id, :comment_id)");
+        add.bind(":channel_id", channelId);
+        add.bind(":post_id", postId);
+        add.bind(":comment_id", commentId);
+        add.exec();
+        docId = handler->getLastInsertRowid();
+    }
+
+    SQLite::Statement add(*handler, "INSERT INTO search_index(rowid, content) VALUES (:doc_id, :content)");
+    add.bind(":doc_id", docId);
+    add.bind(":content", content.getColumn(0).getText());
+    add.exec();
+
+    return 0;
+}
+
+} // namespace trinity
@@ -0,0 +1,71 @@
+#ifndef _FEEDS_SEARCH_INDEX_HPP_
+#define _FEEDS_SEARCH_INDEX_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <StdFileSystem.hpp>
+#include <SQLiteCpp/SQLiteCpp.h>
+
+namespace trinity {
+
+class ThreadPool;
+
+/*
+ * Keeps the search_index FTS5 table in sync with posts and comments.
+ * Runs on its own thread and connection, tailing the change journal so the
+ * mutators never pay for tokenizing. A missing or trimmed-away cursor
+ * triggers a chunked rebuild from the base tables.
+ */
+class SearchIndex : public std::enable_shared_from_this<SearchIndex> {
+public:
+    /*** type define ***/
+
+    /*** static function and variable ***/
+    static std::shared_ptr<SearchIndex> Create(const std::filesystem::path& databaseFilePath);
+    static std::string MakeQuery(const std::string& keywords);
+
+    static constexpr const int BusyTimeoutMS = 5000;
+
+    /*** class function and variable ***/
+    void start();
+
+protected:
+    /*** type define ***/
+
+    /*** static function and variable ***/
+
+    /*** class function and variable ***/
+    explicit SearchIndex(const std::filesystem::path& databaseFilePath);
+    virtual ~SearchIndex() = default;
+
+private:
+    /*** type define ***/
+
+    /*** static function and variable ***/
+    static constexpr const int BatchSize = 64;
+    static constexpr const long IdleIntervalMS = 2000;
+    static constexpr const long PollIntervalMS = 100;
+
+    /*** class function and variable ***/
+    void schedule(long delayMS);
+    int indexBatch(bool& drained);
+    int rebuildBatch(const char* table, int64_t& rowid, bool isComment);
+    int journalBatch(int64_t& cursor, bool& drained);
+    int reindex(int64_t channelId, int64_t postId, int64_t commentId);
+
+    std::shared_ptr<SQLite::Database> handler;
+    std::shared_ptr<ThreadPool> threadPool;
+};
+
+/***********************************************/
+/***** class template function implement *******/
+/***********************************************/
+
+/***********************************************/
+/***** macro definition ************************/
+/***********************************************/
+
+} // namespace trinity
+
+#endif /* _FEEDS_SEARCH_INDEX_HPP_ */
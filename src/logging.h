@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2020 trinity-tech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __LOGGING_H__
+#define __LOGGING_H__
+
+#include <crystal/vlog.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Route the crystal log macros through the asynchronous writer: arguments
+ * are captured on the calling thread and formatted later. Formats must be
+ * string literals.
+ */
+void feeds_vlog(int level, const char *format, ...);
+
+#undef vlogF
+#undef vlogE
+#undef vlogW
+#undef vlogI
+#undef vlogD
+#undef vlogT
+#undef vlogV
+
+#define feeds_vlog_at(level, format, ...) \
+    ((level) <= log_level ? feeds_vlog(level, format, ##__VA_ARGS__) : (void)0)
+
+#define vlogF(format, ...) feeds_vlog_at(VLOG_FATAL, format, ##__VA_ARGS__)
+#define vlogE(format, ...) feeds_vlog_at(VLOG_ERROR, format, ##__VA_ARGS__)
+#define vlogW(format, ...) feeds_vlog_at(VLOG_WARN, format, ##__VA_ARGS__)
+#define vlogI(format, ...) feeds_vlog_at(VLOG_INFO, format, ##__VA_ARGS__)
+
+#ifdef FEEDS_LOG_NO_DEBUG
+#define vlogD(format, ...) ((void)0)
+#define vlogT(format, ...) ((void)0)
+#define vlogV(format, ...) ((void)0)
+#else
+#define vlogD(format, ...) feeds_vlog_at(VLOG_DEBUG, format, ##__VA_ARGS__)
+#define vlogT(format, ...) feeds_vlog_at(VLOG_TRACE, format, ##__VA_ARGS__)
+#define vlogV(format, ...) feeds_vlog_at(VLOG_VERBOSE, format, ##__VA_ARGS__)
+#endif
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif //__LOGGING_H__
@@ -48,6 +48,7 @@
 #include <memory>
 #include <iostream>
 
+#include <AsyncLog.hpp>
 #include <CommandHandler.hpp>
 #include <DataBase.hpp>
 #include <MassDataManager.hpp>
@@ -66,6 +67,10 @@ extern "C" {
 #include "rpc.h"
 #include "db.h"
 #include "ver.h"
+#include "reqepoch.h"
+#include "reqtrace.h"
+#include "timerwheel.h"
+#include "logging.h"
 #undef new
 
 size_t connecting_clients;
@@ -105,7 +110,7 @@ void idle_callback(Carrier *c, void *context)
         return;
     }
 
-    auth_expire_login();
+    timerwheel_tick();
 }
 
 static
@@ -130,12 +135,15 @@ void friend_connection_callback(Carrier *c, const char *friend_id,
 
     if (status == CarrierConnectionStatus_Connected) {
         ++connecting_clients;
+        feeds_resume_suber(friend_id);
+        msgq_peer_online(friend_id);
         return;
     } else
         trinity::MassDataManager::GetInstance()->removeDataPipe(friend_id);
 
     --connecting_clients;
-    feeds_deactivate_suber(friend_id);
+    reqepoch_peer_offline(friend_id);
+    feeds_suspend_suber(friend_id);
     msgq_peer_offline(friend_id);
 }
 
@@ -416,16 +424,26 @@ int main(int argc, char *argv[])
         return -1;
     }
 
+    reqtrace_init(cfg.slow_req_threshold, cfg.trace_sample_rate);
+
+    rc = timerwheel_init();
+    if (rc < 0) {
+        free_cfg(&cfg);
+        return -1;
+    }
+
     rc = transport_init(&cfg);
     if (rc < 0) {
         free_cfg(&cfg);
+        timerwheel_deinit();
         return -1;
     }
 
-    rc = msgq_init();
+    rc = msgq_init(cfg.outbox_ttl);
     if (rc < 0) {
         free_cfg(&cfg);
         transport_deinit();
+        timerwheel_deinit();
         return -1;
     }
 
@@ -434,6 +452,7 @@ int main(int argc, char *argv[])
         free_cfg(&cfg);
         msgq_deinit();
         transport_deinit();
+        timerwheel_deinit();
         return -1;
     }
 
@@ -443,6 +462,7 @@ int main(int argc, char *argv[])
         trinity::DataBase::GetInstance()->cleanup();
         msgq_deinit();
         transport_deinit();
+        timerwheel_deinit();
         return -1;
     }
 
@@ -453,6 +473,7 @@ int main(int argc, char *argv[])
         trinity::DataBase::GetInstance()->cleanup();
         msgq_deinit();
         transport_deinit();
+        timerwheel_deinit();
         return -1;
     }
 
@@ -464,6 +485,7 @@ int main(int argc, char *argv[])
         trinity::DataBase::GetInstance()->cleanup();
         msgq_deinit();
         transport_deinit();
+        timerwheel_deinit();
         return -1;
     }
 
@@ -501,9 +523,13 @@ int main(int argc, char *argv[])
         trinity::DataBase::GetInstance()->cleanup();
         msgq_deinit();
         transport_deinit();
+        timerwheel_deinit();
         return -1;
     }
 
+    // started after daemonize(), the writer thread does not survive fork().
+    trinity::AsyncLog::Start();
+
     rc = carrier_run(carrier, 10);
 
     feeds_deinit();
@@ -512,6 +538,8 @@ int main(int argc, char *argv[])
     trinity::DataBase::GetInstance()->cleanup();
     msgq_deinit();
     transport_deinit();
+    timerwheel_deinit();
+    trinity::AsyncLog::Stop();
 
     return rc;
 }
@@ -40,7 +40,7 @@ int CarrierSessionHelper::Factory::Init(
             Carrier *carrier, const char *from,
             const char *bundle, const char *sdp, size_t len, void *context)
     {
-        Log::D(Log::Tag::Msg, "Carrier session request callback!");
+        LOG_D(Log::Tag::Msg, "Carrier session request callback!");
         OnRequestListener(CarrierHandler, from, sdp);
     };
     ret = carrier_session_set_callback(ptr.get(), nullptr, onSessionRequest, nullptr);
@@ -116,7 +116,7 @@ void CarrierSessionHelper::disconnect()
 
 int64_t CarrierSessionHelper::sendData(const std::vector<uint8_t>& data)
 {
-    Log::D(Log::Tag::Msg, "CarrierSessionHelper send vector data, len: %d", data.size());
+    LOG_D(Log::Tag::Msg, "CarrierSessionHelper send vector data, len: %d", data.size());
 
     const int step = 2048;
     for(int idx = 0; idx < data.size(); idx+=step) {
@@ -138,7 +138,7 @@ int64_t CarrierSessionHelper::sendData(std::iostream& data)
     data.seekg(0, data.end);
     int dataSize = data.tellg();
     data.seekg(0, data.beg);
-    Log::D(Log::Tag::Msg, "CarrierSessionHelper send stream data, len: %d", dataSize);
+    LOG_D(Log::Tag::Msg, "CarrierSessionHelper send stream data, len: %d", dataSize);
 
     const int step = 2048;
     uint8_t buf[step];
@@ -193,7 +193,7 @@ int CarrierSessionHelper::makeSessionAndStream(const std::string& peerId)
     auto deleter = [=](CarrierSession* ptr) -> void {
         if(ptr != nullptr) {
             carrier_session_close(ptr);
-            Log::D(Log::Tag::Msg, "Destroy an ela carrier session with %s, stream %d", peerId.c_str(), sessionStreamId);
+            LOG_D(Log::Tag::Msg, "Destroy an ela carrier session with %s, stream %d", peerId.c_str(), sessionStreamId);
         }
     };
     sessionHandler = std::shared_ptr<CarrierSession>(creater(), deleter);
@@ -207,11 +207,11 @@ int CarrierSessionHelper::makeSessionAndStream(const std::string& peerId)
             CarrierStreamState state, void *context)
     {
         auto thiz = reinterpret_cast<CarrierSessionHelper*>(context);
-        Log::D(Log::Tag::Msg, "CarrierSessionHelper state change to %d at session stream %d", state, stream);
+        LOG_D(Log::Tag::Msg, "CarrierSessionHelper state change to %d at session stream %d", state, stream);
         auto weakPtr = thiz->weak_from_this();
         auto carrierSession = weakPtr.lock();
         if(carrierSession == nullptr) {
-            Log::D(Log::Tag::Msg, "CarrierSessionHelper has been released");
+            LOG_D(Log::Tag::Msg, "CarrierSessionHelper has been released");
             return;
         }
 
@@ -281,7 +281,7 @@ int CarrierSessionHelper::makeSessionAndStream(const std::string& peerId)
     }
     CHECK_ERROR(ret);
     sessionStreamId = ret;
-    Log::D(Log::Tag::Msg, "Create a new ela carrier session with %s stream %d", peerId.c_str(), sessionStreamId);
+    LOG_D(Log::Tag::Msg, "Create a new ela carrier session with %s stream %d", peerId.c_str(), sessionStreamId);
 
     return 0;
 }
@@ -1,14 +1,21 @@
 #include "MassDataManager.hpp"
 
 #include <cassert>
+#include <cstring>
 #include <carrier.h>
 #include <functional>
+#include <utility>
 #include <SafePtr.hpp>
 #include "CarrierSessionHelper.hpp"
 #include "MassDataProcessor.hpp"
 #include "SessionParser.hpp"
 #include "DateTime.hpp"
 
+#include <crystal.h>
+extern "C" {
+#include <timerwheel.h>
+}
+
 namespace trinity {
 
 /* =========================================== */
@@ -34,6 +41,35 @@ std::shared_ptr<MassDataManager> MassDataManager::GetInstance()
     return MassDataMgrInstance;
 }
 
+void MassDataManager::OnIdleTimeout(void* context)
+{
+    auto idleKey = static_cast<char*>(context);
+
+    auto mgrPtr = MassDataMgrInstance;
+    if(mgrPtr == nullptr) {
+        return;
+    }
+
+    std::shared_ptr<DataPipe> dataPipe;
+    {
+        std::lock_guard<std::mutex> lock(mgrPtr->dataPipeMutex);
+
+        // a newer pipe of the same peer has its own timer.
+        auto dataPipeIt = mgrPtr->dataPipeMap.find(idleKey);
+        if(dataPipeIt == mgrPtr->dataPipeMap.end()
+        || dataPipeIt->second->idleKey != idleKey) {
+            return;
+        }
+
+        dataPipe = std::move(dataPipeIt->second);
+        mgrPtr->dataPipeMap.erase(dataPipeIt);
+    }
+
+    // idleKey is owned by the pipe, log before releasing it.
+    Log::I(Log::Tag::Msg, "Mass data session of %s is idle, close it.", idleKey);
+    dataPipe.reset();
+}
+
 /* =========================================== */
 /* === class public function implement  ====== */
 /* =========================================== */
@@ -41,9 +77,9 @@ int MassDataManager::config(const std::filesystem::path& dataDir,
                             std::weak_ptr<Carrier> carrier)
 {
     massDataDir = dataDir / MassData::MassDataDirName;
-    Log::D(Log::Tag::Msg, "Config mass data manager. Data saved to: %s", massDataDir.c_str());
+    LOG_D(Log::Tag::Msg, "Config mass data manager. Data saved to: %s", massDataDir.c_str());
 
-    Log::D(Log::Tag::Msg, "Mass data saved to: %s", massDataDir.c_str());
+    LOG_D(Log::Tag::Msg, "Mass data saved to: %s", massDataDir.c_str());
     auto dirExists = std::filesystem::exists(massDataDir);
     if(dirExists == false) {
         auto dirExists = std::filesystem::create_directories(massDataDir);
@@ -65,7 +101,7 @@ void MassDataManager::cleanup()
 
     MassDataMgrInstance.reset();
 
-    Log::D(Log::Tag::Msg, "Cleanup mass data manager.");
+    LOG_D(Log::Tag::Msg, "Cleanup mass data manager.");
 }
 
 /* =========================================== */
@@ -76,10 +112,19 @@ void MassDataManager::cleanup()
 /* =========================================== */
 /* === class private function implement  ===== */
 /* =========================================== */
+MassDataManager::DataPipe::~DataPipe()
+{
+    if(idleTimer != nullptr) {
+        timer_stop(idleTimer);
+        deref(idleTimer);
+    }
+    deref(idleKey);
+}
+
 void MassDataManager::onSessionRequest(std::weak_ptr<Carrier> carrier,
                                        const std::string& from, const std::string& sdp)
 {
-    Log::D(Log::Tag::Msg, "Received carrier session request from %s. sdp:\n%s",
+    LOG_D(Log::Tag::Msg, "Received carrier session request from %s. sdp:\n%s",
                      from.c_str(), sdp.c_str());
 
     auto dataPipe = std::make_shared<DataPipe>();
@@ -103,24 +148,68 @@ void MassDataManager::onSessionRequest(std::weak_ptr<Carrier> carrier,
 
 void MassDataManager::appendDataPipe(const std::string& key, std::shared_ptr<MassDataManager::DataPipe> value)
 {
-    Log::D(Log::Tag::Msg, "append datapipe key=%s,val=%p", key.c_str(), value->session.get());
-    dataPipeMap[key] = value;
+    LOG_D(Log::Tag::Msg, "append datapipe key=%s,val=%p", key.c_str(), value->session.get());
+
+    value->idleKey = static_cast<char*>(rc_zalloc(key.length() + 1, nullptr));
+    if(value->idleKey != nullptr) {
+        std::strcpy(value->idleKey, key.c_str());
+        value->idleTimer = timer_start(IdleTimeoutMS, OnIdleTimeout, value->idleKey);
+    }
+    if(value->idleTimer == nullptr) {
+        Log::W(Log::Tag::Msg, "Failed to arm idle timeout of datapipe key=%s", key.c_str());
+    }
+
+    // a pipe replaced by a new session of the same peer is released unlocked.
+    std::shared_ptr<DataPipe> replaced;
+    {
+        std::lock_guard<std::mutex> lock(dataPipeMutex);
+        replaced = std::exchange(dataPipeMap[key], value);
+    }
 }
 
 void MassDataManager::removeDataPipe(const std::string& key)
 {
-    Log::D(Log::Tag::Msg, "remove datapipe key=%s", key.c_str());
-    dataPipeMap.erase(key);
+    LOG_D(Log::Tag::Msg, "remove datapipe key=%s", key.c_str());
+
+    // released outside the lock, closing a session may call back into us.
+    std::shared_ptr<DataPipe> removed;
+    {
+        std::lock_guard<std::mutex> lock(dataPipeMutex);
+        auto dataPipeIt = dataPipeMap.find(key);
+        if(dataPipeIt == dataPipeMap.end()) {
+            return;
+        }
+        removed = std::move(dataPipeIt->second);
+        dataPipeMap.erase(dataPipeIt);
+    }
 }
 
 void MassDataManager::clearAllDataPipe()
 {
-    Log::D(Log::Tag::Msg, "clear all datapipe.");
-    dataPipeMap.clear();
+    LOG_D(Log::Tag::Msg, "clear all datapipe.");
+
+    std::map<std::string, std::shared_ptr<DataPipe>> removed;
+    {
+        std::lock_guard<std::mutex> lock(dataPipeMutex);
+        removed.swap(dataPipeMap);
+    }
+}
+
+void MassDataManager::touchDataPipe(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(dataPipeMutex);
+    auto dataPipeIt = dataPipeMap.find(key);
+    if(dataPipeIt == dataPipeMap.end()
+    || dataPipeIt->second->idleTimer == nullptr) {
+        return;
+    }
+
+    timer_restart(dataPipeIt->second->idleTimer, IdleTimeoutMS);
 }
 
 std::shared_ptr<MassDataManager::DataPipe> MassDataManager::find(const std::string& key)
 {
+    std::lock_guard<std::mutex> lock(dataPipeMutex);
     auto dataPipeIt = dataPipeMap.find(key);
     if(dataPipeIt == dataPipeMap.end()) {
         CHECK_AND_RETDEF(ErrCode::CarrierSessionReleasedError, nullptr);
@@ -142,7 +231,7 @@ std::shared_ptr<CarrierSessionHelper::ConnectListener> MassDataManager::makeConn
         }
 
         virtual void onNotify(Notify notify, int errCode) override {
-            Log::D(Log::Tag::Msg, "Session nofify: notify:%s, errCode:%d", toString(notify), errCode);
+            LOG_D(Log::Tag::Msg, "Session nofify: notify:%s, errCode:%d", toString(notify), errCode);
 
             if(notify == Notify::Closed
             || notify == Notify::Error) {
@@ -152,7 +241,12 @@ std::shared_ptr<CarrierSessionHelper::ConnectListener> MassDataManager::makeConn
         };
         virtual void onReceivedData(const std::vector<uint8_t>& data) override {
             SAFE_GET_PTR_NO_RETVAL(mgrPtr, mgr);
+            mgrPtr->touchDataPipe(peerId);
+            // the pipe may have just been closed as idle.
             auto dataPipe = mgrPtr->find(peerId);
+            if(dataPipe == nullptr) {
+                return;
+            }
             assert(dataPipe->parser != nullptr);
 
             int ret = dataPipe->parser->unpack(data, unpackedListener);
@@ -175,11 +269,14 @@ std::shared_ptr<SessionParser::OnUnpackedListener> MassDataManager::makeUnpacked
             const std::vector<uint8_t>& headData,
             const std::filesystem::path& bodyPath) -> void
     {
-        Log::D(Log::Tag::Msg, "MassData: start to process unpacked data.");
+        LOG_D(Log::Tag::Msg, "MassData: start to process unpacked data.");
         auto weakPtr = this->weak_from_this();
         SAFE_GET_PTR_NO_RETVAL(mgrPtr, weakPtr);
 
         auto dataPipe = mgrPtr->find(peerId);
+        if(dataPipe == nullptr) {
+            return;
+        }
         assert(dataPipe->processor != nullptr);
 
         int ret = dataPipe->processor->dispose(headData, bodyPath);
@@ -212,7 +309,8 @@ std::shared_ptr<SessionParser::OnUnpackedListener> MassDataManager::makeUnpacked
             future.get();
         }
 
-        Log::D(Log::Tag::Msg, "MassData: finish to process unpacked data.");
+        mgrPtr->touchDataPipe(peerId);
+        LOG_D(Log::Tag::Msg, "MassData: finish to process unpacked data.");
     });
 
     return unpackedListener;
@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <CarrierSessionHelper.hpp>
@@ -11,6 +12,7 @@
 
 struct Carrier;
 struct ElaSession;
+struct Timer;
 
 namespace trinity {
 
@@ -41,13 +43,21 @@ protected:
 private:
     /*** type define ***/
     struct DataPipe {
+        ~DataPipe();
+
         std::shared_ptr<CarrierSessionHelper> session;
         std::shared_ptr<SessionParser> parser;
         std::shared_ptr<MassDataProcessor> processor;
+        // ref counted peer id, context of idleTimer.
+        char* idleKey = nullptr;
+        Timer* idleTimer = nullptr;
     };
 
     /*** static function and variable ***/
+    static void OnIdleTimeout(void* context);
+
     static std::shared_ptr<MassDataManager> MassDataMgrInstance;
+    static constexpr const uint64_t IdleTimeoutMS = 5 * 60 * 1000;
 
     /*** class function and variable ***/
     explicit MassDataManager() = default;
@@ -58,12 +68,15 @@ private:
                         
     void appendDataPipe(const std::string& key, std::shared_ptr<DataPipe> value);
     std::shared_ptr<DataPipe> find(const std::string& key);
+    void touchDataPipe(const std::string& key);
 
     std::shared_ptr<CarrierSessionHelper::ConnectListener> makeConnectListener(const std::string& peerId,
                                                                                std::shared_ptr<SessionParser::OnUnpackedListener> unpackedListener);
     std::shared_ptr<SessionParser::OnUnpackedListener> makeUnpackedListener(const std::string& peerId);
 
     std::filesystem::path massDataDir;
+    // idle timeouts fire on the timer thread, session data on the session thread.
+    std::mutex dataPipeMutex;
     std::map<std::string, std::shared_ptr<DataPipe>> dataPipeMap;
 };
 
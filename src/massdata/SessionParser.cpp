@@ -138,7 +138,7 @@ int SessionParser::unpackProtocol(const std::vector<uint8_t>& data, int offset)
 
         // return and parse next time if data is not enough to parse info.
         if(cachingData.size() < sizeof(Protocol::Info)) {
-            Log::D(Log::Tag::Msg, "Protocol info data is not enough.");
+            LOG_D(Log::Tag::Msg, "Protocol info data is not enough.");
             return ErrCode::CarrierSessionDataNotEnough;
         }
 
@@ -173,12 +173,12 @@ int SessionParser::unpackProtocol(const std::vector<uint8_t>& data, int offset)
         protocol->info.bodySize = ntoh(netOrderBodySize);
         dataPtr += sizeof(protocol->info.bodySize);
 
-        Log::D(Log::Tag::Msg, "Receiving session body start.");
+        LOG_D(Log::Tag::Msg, "Receiving session body start.");
     }
 
     // return and parse next time if data is not enough to save as head data.
     if(cachingData.size() < (sizeof(protocol->info) + protocol->info.headSize)) {
-        Log::D(Log::Tag::Msg, "Protocol head data is not enough. caching size: %d", cachingData.size());
+        LOG_D(Log::Tag::Msg, "Protocol head data is not enough. caching size: %d", cachingData.size());
         return ErrCode::CarrierSessionDataNotEnough;
     }
 
@@ -203,7 +203,7 @@ int SessionParser::unpackBodyData(const std::vector<uint8_t>& data, int offset,
     protocol->payload->bodyData.receivedBodySize += realSize;
 
     if(protocol->payload->bodyData.receivedBodySize == protocol->info.bodySize) {
-        Log::D(Log::Tag::Msg, "Receiving session body finished.");
+        LOG_D(Log::Tag::Msg, "Receiving session body finished.");
 
         if(listener != nullptr) {
             protocol->payload->bodyData.stream.flush();
@@ -28,25 +28,70 @@
 #undef static_assert // fix double conflict between crystal and std functional
 #include <CommandHandler.hpp>
 #include "msgq.h"
+#include "db.h"
+#include "compress.h"
+#include "reqepoch.h"
+#include "reqtrace.h"
+#include "timerwheel.h"
+#include "logging.h"
 
 #define TAG_MSG "[Feedsd.Msg ]: "
 
+#define LANE_STATS_INTERVAL (60 * 1000000ULL)
+#define OUTBOX_EXPIRE_INTERVAL 60
+#define RECEIPT_TIMEOUT (30 * 1000)
+#define RECEIPT_MIN_RATE (16 * 1024)
+
 typedef struct {
     linked_hash_entry_t he;
     char peer[CARRIER_MAX_ID_LEN + 1];
-    linked_list_t *q;
+    linked_list_t *lanes[MSGQ_PRIO_NUM];
+    int credits[MSGQ_PRIO_NUM];
+    Timer *receipt;
+    uint64_t seq;
     bool depr;
 } MsgQ;
 
+/*
+ * Context of one send: the receipt of a message only moves its queue on
+ * while seq is still the queue's current one.
+ */
+typedef struct {
+    MsgQ *q;
+    uint64_t seq;
+} MsgReceipt;
+
 typedef struct {
     linked_list_entry_t le;
     Marshalled *data;
+    MsgPrio prio;
+    uint64_t enq_at;
 } Msg;
 
+typedef struct {
+    linked_hash_entry_t he;
+    char peer[CARRIER_MAX_ID_LEN + 1];
+    Timer *expiry;
+} AbsentPeer;
+
+typedef struct {
+    uint64_t sent;
+    uint64_t total_wait;
+    uint64_t max_wait;
+} LaneStats;
+
 extern Carrier *carrier;
 
 static linked_hashtable_t *msgqs;
+static linked_hashtable_t *absents;
 static std::recursive_mutex mutex;
+static int outbox_ttl;
+static Timer *outbox_timer;
+
+static const int lane_weights[MSGQ_PRIO_NUM] = { 8, 3, 1 };
+static const char *lane_names[MSGQ_PRIO_NUM] = { "response", "notification", "bulk" };
+static LaneStats lane_stats[MSGQ_PRIO_NUM];
+static uint64_t lane_stats_since;
 
 static inline
 MsgQ *msgq_get(const char *peer)
@@ -69,18 +114,139 @@ MsgQ *msgq_rm(const char *peer)
     return (MsgQ*)linked_hashtable_remove(msgqs, peer, strlen(peer));
 }
 
-static inline
+static
 Msg *msgq_pop_head(MsgQ *q)
 {
     std::lock_guard<decltype(mutex)> lock(mutex);
-    return (Msg*)(linked_list_is_empty(q->q) ? NULL : linked_list_pop_head(q->q));
+    int round;
+    int i;
+
+    // weighted round robin: a lane is served while it has credits left,
+    // credits of all lanes are refilled once no pending lane has any.
+    for (round = 0; round < 2; ++round) {
+        for (i = 0; i < MSGQ_PRIO_NUM; ++i) {
+            if (q->credits[i] <= 0 || linked_list_is_empty(q->lanes[i]))
+                continue;
+
+            --q->credits[i];
+            return (Msg*)linked_list_pop_head(q->lanes[i]);
+        }
+
+        memcpy(q->credits, lane_weights, sizeof(q->credits));
+    }
+
+    return NULL;
 }
 
 static inline
 void msgq_push_tail(MsgQ *q, Msg *m)
 {
     std::lock_guard<decltype(mutex)> lock(mutex);
-    linked_list_push_tail(q->q, &m->le);
+    linked_list_push_tail(q->lanes[m->prio], &m->le);
+}
+
+static
+void lane_stats_add(MsgPrio prio, uint64_t enq_at)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    uint64_t now = reqtrace_clock();
+    uint64_t wait = enq_at ? now - enq_at : 0;
+    LaneStats *stats = &lane_stats[prio];
+    int i;
+
+    ++stats->sent;
+    stats->total_wait += wait;
+    if (wait > stats->max_wait)
+        stats->max_wait = wait;
+
+    if (now - lane_stats_since < LANE_STATS_INTERVAL)
+        return;
+
+    for (i = 0; i < MSGQ_PRIO_NUM; ++i) {
+        stats = &lane_stats[i];
+        if (!stats->sent)
+            continue;
+
+        vlogI(TAG_MSG "Lane %s: sent %" PRIu64 ", queue wait avg %.3fms, max %.3fms.",
+              lane_names[i], stats->sent, stats->total_wait / 1000.0 / stats->sent,
+              stats->max_wait / 1000.0);
+    }
+
+    memset(lane_stats, 0, sizeof(lane_stats));
+    lane_stats_since = now;
+}
+
+static
+void absent_dtor(void *obj)
+{
+    AbsentPeer *ap = (AbsentPeer*)obj;
+
+    deref(ap->expiry);
+}
+
+static
+AbsentPeer *absent_create(const char *peer)
+{
+    AbsentPeer *ap = (AbsentPeer*)rc_zalloc(sizeof(AbsentPeer), absent_dtor);
+    if (!ap)
+        return NULL;
+
+    strcpy(ap->peer, peer);
+    ap->he.data   = ap;
+    ap->he.key    = ap->peer;
+    ap->he.keylen = strlen(ap->peer);
+
+    return ap;
+}
+
+static
+void absent_rm(const char *peer)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    AbsentPeer *ap = (AbsentPeer*)linked_hashtable_remove(absents, peer, strlen(peer));
+
+    if (ap && ap->expiry)
+        timer_stop(ap->expiry);
+    deref(ap);
+}
+
+static
+void absent_expire(void *context)
+{
+    AbsentPeer *ap = (AbsentPeer*)context;
+
+    vlogD(TAG_MSG "Peer [%s] has been offline over outbox ttl.", ap->peer);
+    absent_rm(ap->peer);
+}
+
+static
+void absent_put(AbsentPeer *ap)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+
+    absent_rm(ap->peer);
+    ap->expiry = timer_start(outbox_ttl * 1000ULL, absent_expire, ap);
+    deref(linked_hashtable_put(absents, &ap->he));
+}
+
+static inline
+bool absent_exist(const char *peer)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    return linked_hashtable_exist(absents, peer, strlen(peer));
+}
+
+static
+Marshalled *marshalled_create(const void *data, size_t len)
+{
+    Marshalled *m = (Marshalled*)rc_zalloc(sizeof(Marshalled) + len, NULL);
+    if (!m)
+        return NULL;
+
+    m->data = memcpy(m + 1, data, len);
+    m->sz   = len;
+
+    return m;
 }
 
 static
@@ -93,7 +259,7 @@ void msg_dtor(void *obj)
 }
 
 static
-Msg *msg_create(Marshalled *msg)
+Msg *msg_create(Marshalled *msg, MsgPrio prio)
 {
     std::lock_guard<decltype(mutex)> lock(mutex);
     Msg *m = (Msg*)rc_zalloc(sizeof(Msg), msg_dtor);
@@ -102,6 +268,8 @@ Msg *msg_create(Marshalled *msg)
 
     m->le.data = m;
     m->data    = (Marshalled*)ref(msg);
+    m->prio    = prio;
+    m->enq_at  = reqtrace_clock();
 
     return m;
 }
@@ -111,8 +279,11 @@ void msgq_dtor(void *obj)
 {
     std::lock_guard<decltype(mutex)> lock(mutex);
     MsgQ *q = (MsgQ*)obj;
+    int i;
 
-    deref(q->q);
+    for (i = 0; i < MSGQ_PRIO_NUM; ++i)
+        deref(q->lanes[i]);
+    deref(q->receipt);
 }
 
 static
@@ -120,14 +291,19 @@ MsgQ *msgq_create(const char *to)
 {
     std::lock_guard<decltype(mutex)> lock(mutex);
     MsgQ *q = (MsgQ*)rc_zalloc(sizeof(MsgQ), msgq_dtor);
+    int i;
+
     if (!q)
         return NULL;
 
-    q->q = linked_list_create(0, NULL);
-    if (!q->q) {
-        deref(q);
-        return NULL;
+    for (i = 0; i < MSGQ_PRIO_NUM; ++i) {
+        q->lanes[i] = linked_list_create(0, NULL);
+        if (!q->lanes[i]) {
+            deref(q);
+            return NULL;
+        }
     }
+    memcpy(q->credits, lane_weights, sizeof(q->credits));
 
     strcpy(q->peer, to);
     q->he.data   = q;
@@ -138,11 +314,129 @@ MsgQ *msgq_create(const char *to)
 }
 
 static
-void on_msg_receipt(uint32_t msgid, CarrierReceiptState state, void *context)
+void msgq_deprecate(MsgQ *q)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    Msg *m;
+    int saved = 0;
+
+    vlogD(TAG_MSG "Set message queue[%s] deprecated.", q->peer);
+    q->depr = true;
+    if (q->receipt)
+        timer_stop(q->receipt);
+
+    // pending notifications go to the outbox instead of being dropped.
+    while (outbox_ttl && !linked_list_is_empty(q->lanes[MSGQ_PRIO_NOTIF])) {
+        m = (Msg*)linked_list_pop_head(q->lanes[MSGQ_PRIO_NOTIF]);
+        if (!db_add_outbox(q->peer, m->data->data, m->data->sz))
+            ++saved;
+        deref(m);
+    }
+    if (saved)
+        vlogI(TAG_MSG "Saved %d pending notifications of [%s] to outbox.", saved, q->peer);
+}
+
+/*
+ * Time allowed for the receipt of a message: RECEIPT_TIMEOUT plus the time
+ * its bytes take at RECEIPT_MIN_RATE bytes per second, so a large response
+ * on a slow link is not taken for a lost one.
+ */
+static inline
+uint64_t receipt_timeout(size_t sz)
 {
+    return RECEIPT_TIMEOUT + sz * 1000ULL / RECEIPT_MIN_RATE;
+}
+
+static void on_msg_receipt(uint32_t msgid, CarrierReceiptState state, void *context);
+static void on_receipt_timeout(void *context);
+
+static
+void msg_receipt_dtor(void *obj)
+{
+    MsgReceipt *r = (MsgReceipt*)obj;
+
+    deref(r->q);
+}
+
+/*
+ * Sends data as the current message of q and arms its receipt timer.
+ */
+static
+void msgq_send(MsgQ *q, Marshalled *data)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    MsgReceipt *r;
+    int rc;
+
+    if (q->receipt)
+        timer_restart(q->receipt, receipt_timeout(data->sz));
+    else
+        q->receipt = timer_start(receipt_timeout(data->sz), on_receipt_timeout, q);
+
+    r = (MsgReceipt*)rc_zalloc(sizeof(MsgReceipt), msg_receipt_dtor);
+    if (!r) {
+        vlogE(TAG_MSG "Creating message receipt failed.");
+        return;
+    }
+    r->q   = (MsgQ*)ref(q);
+    r->seq = ++q->seq;
+
+    rc = trinity::CommandHandler::GetInstance()->send(q->peer, data, on_msg_receipt, r);
+    if (rc < 0)
+        deref(r);
+}
+
+/*
+ * Sends the next queued message of q, or retires q once all are sent.
+ */
+static
+void msgq_send_next(MsgQ *q)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    MsgQ *cur;
+    Msg *m;
+
+    if (!(m = msgq_pop_head(q))) {
+        vlogD(TAG_MSG "Transport channel becomes idle.");
+        if (q->receipt)
+            timer_stop(q->receipt);
+        cur = msgq_get(q->peer);
+        if (cur == q)
+            deref(msgq_rm(q->peer));
+        deref(cur);
+        return;
+    }
+
+    lane_stats_add(m->prio, m->enq_at);
+    msgq_send(q, m->data);
+    deref(m);
+}
+
+/*
+ * A message whose receipt never arrives would keep the transport channel
+ * busy forever. Once its receipt_timeout() passes the next message goes
+ * out, nothing queued is dropped; the late receipt, if any, no longer
+ * matches the queue's current send and is ignored.
+ */
+static
+void on_receipt_timeout(void *context)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
     MsgQ *q = (MsgQ*)context;
-    Msg *m = NULL;
-    std::vector<uint8_t> data;
+
+    if (q->depr)
+        return;
+
+    vlogW(TAG_MSG "Receipt of message to [%s] timed out.", q->peer);
+    msgq_send_next(q);
+}
+
+static
+void on_msg_receipt(uint32_t msgid, CarrierReceiptState state, void *context)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    MsgReceipt *r = (MsgReceipt*)context;
+    MsgQ *q = r->q;
 
     (void)msgid;
     (void)state;
@@ -160,33 +454,52 @@ void on_msg_receipt(uint32_t msgid, CarrierReceiptState state, void *context)
         goto finally;
     }
 
-    if (!(m = msgq_pop_head(q))) {
-        vlogD(TAG_MSG "Transport channel becomes idle.");
-        deref(msgq_rm(q->peer));
+    if (r->seq != q->seq) {
+        vlogD(TAG_MSG "Late receipt of a timed out message.");
         goto finally;
     }
 
-    data = std::move(std::vector<uint8_t>{ reinterpret_cast<uint8_t*>(m->data->data),
-                                           reinterpret_cast<uint8_t*>(m->data->data) + m->data->sz });
-    std::ignore = trinity::CommandHandler::GetInstance()->send(q->peer, data, on_msg_receipt, ref(q));
+    msgq_send_next(q);
 
 finally:
-    deref(q);
-    deref(m);
+    deref(r);
 }
 
 int msgq_enq(const char *to, Marshalled *msg)
 {
+    Marshalled *frame = compress_resp(msg);
+    int rc;
+
+    rc = msgq_enq_prio(to, frame, MSGQ_PRIO_RESP);
+    deref(frame);
+
+    return rc;
+}
+
+int msgq_enq_prio(const char *to, Marshalled *msg, MsgPrio prio)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    uint64_t trace_at = reqtrace_mark();
     MsgQ *q = NULL;
     Msg *m = NULL;
     int rc = -1;
-    std::vector<uint8_t> data;
+
+    if (prio == MSGQ_PRIO_RESP && reqepoch_cancelled()) {
+        rc = 0;
+        goto finally;
+    }
+
+    if (prio == MSGQ_PRIO_NOTIF && outbox_ttl && absent_exist(to)) {
+        vlogD(TAG_MSG "Peer [%s] is offline, put in outbox.", to);
+        rc = db_add_outbox(to, msg->data, msg->sz);
+        goto finally;
+    }
 
     q = msgq_get(to);
     if (q) {
         vlogD(TAG_MSG "Transport channel[%s] is busy, put in message queue.", to);
 
-        m = msg_create(msg);
+        m = msg_create(msg, prio);
         if (!m) {
             vlogE(TAG_MSG "Creating message failed.");
             goto finally;
@@ -203,9 +516,8 @@ int msgq_enq(const char *to, Marshalled *msg)
         goto finally;
     }
 
-    data = std::move(std::vector<uint8_t>{ reinterpret_cast<uint8_t*>(msg->data),
-                                           reinterpret_cast<uint8_t*>(msg->data) + msg->sz });
-    std::ignore = trinity::CommandHandler::GetInstance()->send(to, data, on_msg_receipt, ref(q));
+    lane_stats_add(prio, 0);
+    msgq_send(q, msg);
 
     msgq_put(q);
     rc = 0;
@@ -213,22 +525,88 @@ int msgq_enq(const char *to, Marshalled *msg)
 finally:
     deref(q);
     deref(m);
+    reqtrace_stage(TRACE_ENQUEUE, trace_at);
     return rc;
 }
 
 void msgq_peer_offline(const char *peer)
 {
+    std::lock_guard<decltype(mutex)> lock(mutex);
     MsgQ *q = msgq_rm(peer);
+    AbsentPeer *ap;
 
-    if (q) {
-        vlogD(TAG_MSG "Set message queue[%s] deprecated.", q->peer);
-        q->depr = true;
+    if (outbox_ttl && (ap = absent_create(peer))) {
+        absent_put(ap);
+        deref(ap);
     }
 
+    if (!q)
+        return;
+
+    msgq_deprecate(q);
     deref(q);
 }
 
-int msgq_init()
+void msgq_peer_online(const char *peer)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    uint64_t last_seq = 0;
+    OutboxMsg *om;
+    DBObjIt *it;
+    int replayed = 0;
+    int rc;
+
+    if (!outbox_ttl)
+        return;
+
+    absent_rm(peer);
+
+    it = db_iter_outbox(peer);
+    if (!it) {
+        vlogE(TAG_MSG "Loading outbox of [%s] failed.", peer);
+        return;
+    }
+
+    while (!(rc = db_iter_nxt(it, (void **)&om))) {
+        Marshalled *m = marshalled_create(om->data, om->len);
+        if (m) {
+            msgq_enq_prio(peer, m, MSGQ_PRIO_NOTIF);
+            ++replayed;
+        }
+        last_seq = om->seq;
+        deref(m);
+        deref(om);
+    }
+    deref(it);
+    if (rc < 0)
+        vlogE(TAG_MSG "Iterating outbox of [%s] failed.", peer);
+
+    if (last_seq && db_rm_outbox(peer, last_seq) < 0)
+        vlogE(TAG_MSG "Removing replayed outbox of [%s] failed.", peer);
+
+    if (replayed)
+        vlogI(TAG_MSG "Replayed %d notifications from outbox to [%s].", replayed, peer);
+}
+
+static
+void outbox_expire(void *context)
+{
+    int rc;
+
+    (void)context;
+
+    {
+        // the outbox connection is only used under the queue lock.
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        rc = db_expire_outbox(time(NULL) - outbox_ttl);
+    }
+    if (rc > 0)
+        vlogI(TAG_MSG "Dropped %d expired notifications from outbox.", rc);
+
+    timer_restart(outbox_timer, OUTBOX_EXPIRE_INTERVAL * 1000);
+}
+
+int msgq_init(int ttl)
 {
     msgqs = linked_hashtable_create(8, 0, NULL, NULL);
     if (!msgqs) {
@@ -236,6 +614,23 @@ int msgq_init()
         return -1;
     }
 
+    absents = linked_hashtable_create(8, 0, NULL, NULL);
+    if (!absents) {
+        vlogE(TAG_MSG "Creating absent peers failed");
+        deref(msgqs);
+        return -1;
+    }
+
+    outbox_ttl = ttl;
+    lane_stats_since = reqtrace_clock();
+
+    if (outbox_ttl && !(outbox_timer = timer_start(OUTBOX_EXPIRE_INTERVAL * 1000, outbox_expire, NULL))) {
+        vlogE(TAG_MSG "Arming outbox expiry failed");
+        deref(msgqs);
+        deref(absents);
+        return -1;
+    }
+
     vlogI(TAG_MSG "Message queue module initialized.");
 
     return 0;
@@ -243,5 +638,11 @@ int msgq_init()
 
 void msgq_deinit()
 {
+    if (outbox_timer) {
+        timer_stop(outbox_timer);
+        deref(outbox_timer);
+        outbox_timer = NULL;
+    }
     deref(msgqs);
+    deref(absents);
 }
@@ -29,10 +29,29 @@
 extern "C" {
 #endif
 
-int msgq_init();
+/*
+ * Outbound messages of a peer are queued in priority lanes and drained
+ * by weighted round robin, so responses are not stuck behind a burst of
+ * notifications while bulk traffic still gets its share.
+ */
+typedef enum {
+    MSGQ_PRIO_RESP,
+    MSGQ_PRIO_NOTIF,
+    MSGQ_PRIO_BULK,
+    MSGQ_PRIO_NUM
+} MsgPrio;
+
+/*
+ * With a non-zero outbox_ttl (seconds), notifications that can not be
+ * delivered because the peer is offline are kept in the database outbox
+ * and replayed in order by msgq_peer_online().
+ */
+int msgq_init(int outbox_ttl);
 void msgq_deinit();
 int msgq_enq(const char *to, Marshalled *msg);
+int msgq_enq_prio(const char *to, Marshalled *msg, MsgPrio prio);
 void msgq_peer_offline(const char *peer);
+void msgq_peer_online(const char *peer);
 
 #ifdef __cplusplus
 } // extern "C"
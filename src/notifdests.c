@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2020 trinity-tech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <crystal.h>
+
+#include "notifdests.h"
+
+static
+void cnds_dtor(void *obj)
+{
+    ChanNotifDests *cnds = obj;
+
+    cvector_free(cnds->nds);
+    pthread_mutex_destroy(&cnds->lock);
+}
+
+ChanNotifDests *cnds_create(void)
+{
+    ChanNotifDests *cnds;
+
+    cnds = rc_zalloc(sizeof(ChanNotifDests), cnds_dtor);
+    if (!cnds)
+        return NULL;
+
+    pthread_mutex_init(&cnds->lock, NULL);
+
+    return cnds;
+}
+
+void cnds_add(ChanNotifDests *cnds, NotifDest *nd)
+{
+    size_t cap;
+
+    pthread_mutex_lock(&cnds->lock);
+    cap = cvector_capacity(cnds->nds);
+    if (cvector_size(cnds->nds) == cap)
+        cvector_grow(cnds->nds, cap ? cap * 2 : 8);
+    cvector_push_back(cnds->nds, nd);
+    pthread_mutex_unlock(&cnds->lock);
+}
+
+void cnds_remove(ChanNotifDests *cnds, const NotifDest *nd)
+{
+    size_t sz;
+    size_t i;
+
+    pthread_mutex_lock(&cnds->lock);
+    sz = cvector_size(cnds->nds);
+    for (i = 0; i < sz; ++i) {
+        if (cnds->nds[i] != nd)
+            continue;
+
+        cnds->nds[i] = cnds->nds[sz - 1];
+        cvector_pop_back(cnds->nds);
+        break;
+    }
+    pthread_mutex_unlock(&cnds->lock);
+}
+
+cvector_vector_type(NotifDest *) cnds_snapshot(ChanNotifDests *cnds)
+{
+    cvector_vector_type(NotifDest *) nds = NULL;
+    NotifDest **nd;
+
+    pthread_mutex_lock(&cnds->lock);
+    if (cvector_size(cnds->nds)) {
+        cvector_grow(nds, cvector_size(cnds->nds));
+        cvector_foreach(cnds->nds, nd)
+            cvector_push_back(nds, ref(*nd));
+    }
+    pthread_mutex_unlock(&cnds->lock);
+
+    return nds;
+}
+
+void cnds_release(cvector_vector_type(NotifDest *) nds)
+{
+    NotifDest **nd;
+
+    cvector_foreach(nds, nd)
+        deref(*nd);
+    cvector_free(nds);
+}
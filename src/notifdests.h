@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2020 trinity-tech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __NOTIFDESTS_H__
+#define __NOTIFDESTS_H__
+
+#include <pthread.h>
+
+#include "cvector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct NotifDest NotifDest;
+
+/*
+ * Flat fan-out array of a channel: one entry per (active subscriber,
+ * notification destination) pair, kept in step with the aspcs/ndpass
+ * graph so that notifying a channel is a linear scan. Destinations go
+ * away on the carrier thread while channels are notified on the command
+ * handler thread, so every access holds the lock.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    cvector_vector_type(NotifDest *) nds;
+} ChanNotifDests;
+
+ChanNotifDests *cnds_create(void);
+void cnds_add(ChanNotifDests *cnds, NotifDest *nd);
+void cnds_remove(ChanNotifDests *cnds, const NotifDest *nd);
+
+/*
+ * Ref'ed copy of the destinations taken under the lock. Notifying walks
+ * the copy unlocked, so the lock never nests around the message queue and
+ * a destination removed meanwhile stays valid until cnds_release().
+ */
+cvector_vector_type(NotifDest *) cnds_snapshot(ChanNotifDests *cnds);
+void cnds_release(cvector_vector_type(NotifDest *) nds);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif //__NOTIFDESTS_H__
@@ -45,11 +45,39 @@ typedef enum {
 
 #define qry_fld_is_valid(qf) ((uint64_t)(qf) <= CREATED_AT)
 
+#define QRY_CURSOR_KEYS 4
+
+/*
+ * Position of the last row of a page. The list is ordered by (by, keys...),
+ * keys being the unique key columns of the listed table, so the next page
+ * starts strictly after it no matter how many rows share the same value.
+ * by == NONE means no cursor.
+ */
+typedef struct {
+    uint64_t by;
+    uint64_t val;
+    uint64_t keys[QRY_CURSOR_KEYS];
+} QryCursor;
+
+/*
+ * Blob columns a list request may go without, by naming the columns it
+ * wants in its fields param. Only these are selectable: every other column
+ * is always sent. Without fields all blobs are sent, an empty fields array
+ * sends none. Omitted columns are neither read nor sent.
+ */
+#define QRY_FLD_CONTENT    0x1
+#define QRY_FLD_THUMBNAILS 0x2
+#define QRY_FLDS_BLOBS     (QRY_FLD_CONTENT | QRY_FLD_THUMBNAILS)
+
+#define qry_omits(omit, fld) (((omit) & (fld)) != 0)
+
 typedef struct {
     uint64_t by;
     uint64_t upper;
     uint64_t lower;
     uint64_t maxcnt;
+    QryCursor after;
+    uint64_t omit;
 } QryCriteria;
 
 typedef struct {
@@ -62,6 +90,7 @@ typedef struct {
     char    *memo;  //v2.0
     void    *avatar;  //v2.0
     size_t   len;  //v2.0
+    char    *avatar_hash;
 } UserInfo;
 
 typedef struct {
@@ -75,6 +104,7 @@ typedef struct {
     uint64_t    next_post_id;
     void       *avatar;
     size_t      len;
+    const char *avatar_hash;
     const char *tip_methods;  //v2.0
     const char *proof;  //v2.0
     uint64_t    status;  //2.0
@@ -180,4 +210,10 @@ typedef struct {
     uint64_t    created_at;
 } ReportedCmtInfo;
 
+typedef struct {
+    uint64_t    seq;
+    void       *data;
+    size_t      len;
+} OutboxMsg;
+
 #endif // __OBJ_H__
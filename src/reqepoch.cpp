@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2020 trinity-tech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <crystal.h>
+
+#include "reqepoch.h"
+#include "logging.h"
+
+#define TAG_CMD "[Feedsd.Cmd ]: "
+
+typedef struct {
+    std::atomic<uint64_t> epoch;
+    int pinned;
+} PeerEpoch;
+
+typedef struct {
+    std::string peer;
+    std::shared_ptr<PeerEpoch> pe;
+    uint64_t epoch;
+    bool cancelled;
+} CurrentReq;
+
+// only peers with pinned requests are tracked, their epoch restarts from 0
+// once nothing refers to the old one anymore.
+static std::unordered_map<std::string, std::shared_ptr<PeerEpoch>> peers;
+static std::mutex mutex;
+static std::atomic<uint64_t> avoided;
+static thread_local CurrentReq current;
+
+static
+void reqepoch_cancel(void)
+{
+    current.cancelled = true;
+    ++avoided;
+
+    vlogD(TAG_CMD "Peer [%s] went offline, dropping its request.", current.peer.c_str());
+}
+
+uint64_t reqepoch_enter(const char *peer)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    auto &pe = peers[peer];
+
+    if (!pe)
+        pe = std::make_shared<PeerEpoch>();
+
+    ++pe->pinned;
+    return pe->epoch;
+}
+
+bool reqepoch_begin(const char *peer, uint64_t epoch)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    auto it = peers.find(peer);
+
+    assert(it != peers.end());
+
+    current.peer      = peer;
+    current.pe        = it->second;
+    current.epoch     = epoch;
+    current.cancelled = false;
+
+    if (current.pe->epoch != epoch)
+        reqepoch_cancel();
+
+    return !current.cancelled;
+}
+
+bool reqepoch_cancelled(void)
+{
+    if (!current.pe || current.cancelled)
+        return current.cancelled;
+
+    if (current.pe->epoch.load(std::memory_order_relaxed) == current.epoch)
+        return false;
+
+    reqepoch_cancel();
+    return true;
+}
+
+void reqepoch_hold(void)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+
+    if (current.pe)
+        ++current.pe->pinned;
+}
+
+void reqepoch_end(void)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+
+    if (!current.pe)
+        return;
+
+    if (!--current.pe->pinned)
+        peers.erase(current.peer);
+
+    current.pe.reset();
+    current.cancelled = false;
+}
+
+void reqepoch_peer_offline(const char *peer)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    auto it = peers.find(peer);
+
+    if (it == peers.end())
+        return;
+
+    ++it->second->epoch;
+}
+
+uint64_t reqepoch_avoided(void)
+{
+    return avoided;
+}
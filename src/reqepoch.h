@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2020 trinity-tech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __REQEPOCH_H__
+#define __REQEPOCH_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Every disconnect of a peer starts a new connection epoch for it. Requests
+ * are pinned to the epoch they arrived in by reqepoch_enter() and checked on
+ * the worker thread between reqepoch_begin() and reqepoch_end(): once the
+ * epoch has moved on nobody is left to read the response, so the request is
+ * skipped or, polling reqepoch_cancelled(), abandoned mid-iteration.
+ * A request that suspends calls reqepoch_hold() before its reqepoch_end(),
+ * the continuation then runs its own begin/end on the same epoch.
+ */
+uint64_t reqepoch_enter(const char *peer);
+bool reqepoch_begin(const char *peer, uint64_t epoch);
+bool reqepoch_cancelled(void);
+void reqepoch_hold(void);
+void reqepoch_end(void);
+
+void reqepoch_peer_offline(const char *peer);
+uint64_t reqepoch_avoided(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif //__REQEPOCH_H__
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2020 trinity-tech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <crystal.h>
+#include <inttypes.h>
+
+#include "reqtrace.h"
+#include "logging.h"
+
+#define TAG_PERF "[Feedsd.Perf]: "
+
+#define MAX_TRACED_STMTS 8
+
+typedef struct {
+    std::string sql;
+    size_t rows;
+    uint64_t elapsed;
+} TracedStmt;
+
+typedef struct {
+    bool active;
+    uint64_t begin_at;
+    uint64_t stages[TRACE_STAGE_NUM];
+    std::string from;
+    std::string method;
+    uint64_t tsx_id;
+    size_t rows;
+    std::vector<TracedStmt> stmts;
+} ReqTrace;
+
+static const char *stage_names[TRACE_STAGE_NUM] = {
+    "decode",
+    "auth",
+    "db",
+    "materialize",
+    "marshal",
+    "enqueue"
+};
+
+static uint64_t slow_threshold;
+static uint64_t sample_rate = 1;
+static std::atomic<uint64_t> sample_seq;
+static thread_local ReqTrace trace;
+
+static inline
+double us2ms(uint64_t us)
+{
+    return us / 1000.0;
+}
+
+void reqtrace_init(int slow_threshold_ms, int rate)
+{
+    slow_threshold = slow_threshold_ms > 0 ? (uint64_t)slow_threshold_ms * 1000 : 0;
+    sample_rate    = rate > 0 ? rate : 1;
+
+    if (slow_threshold)
+        vlogI(TAG_PERF "Slow request log enabled, threshold: %dms, sample rate: 1/%" PRIu64 ".",
+              slow_threshold_ms, sample_rate);
+}
+
+uint64_t reqtrace_clock(void)
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+void reqtrace_begin(const char *from)
+{
+    trace.active = false;
+    if (!slow_threshold)
+        return;
+
+    if (sample_rate > 1 && sample_seq++ % sample_rate)
+        return;
+
+    trace.active   = true;
+    trace.begin_at = reqtrace_clock();
+    trace.from     = from;
+    trace.method.clear();
+    trace.tsx_id   = 0;
+    trace.rows     = 0;
+    trace.stmts.clear();
+    memset(trace.stages, 0, sizeof(trace.stages));
+}
+
+void reqtrace_method(const char *method, uint64_t tsx_id)
+{
+    if (!trace.active)
+        return;
+
+    trace.method = method;
+    trace.tsx_id = tsx_id;
+}
+
+uint64_t reqtrace_mark(void)
+{
+    return trace.active ? reqtrace_clock() : 0;
+}
+
+uint64_t reqtrace_stage(TraceStage stage, uint64_t since)
+{
+    uint64_t now;
+
+    if (!since || !trace.active)
+        return 0;
+
+    now = reqtrace_clock();
+    trace.stages[stage] += now - since;
+
+    return now;
+}
+
+static
+void trace_add_stmt(const char *sql, size_t rows, uint64_t elapsed)
+{
+    trace.rows += rows;
+    if (trace.stmts.size() < MAX_TRACED_STMTS)
+        trace.stmts.push_back({sql, rows, elapsed});
+}
+
+void reqtrace_stmt(sqlite3_stmt *stmt, size_t rows, uint64_t elapsed)
+{
+    char *exsql;
+
+    if (!trace.active)
+        return;
+
+    // expanding the bound parameters renders every blob, only pay for it
+    // once the request has already crossed the threshold.
+    if (reqtrace_clock() - trace.begin_at < slow_threshold) {
+        trace_add_stmt(sqlite3_sql(stmt), rows, elapsed);
+        return;
+    }
+
+    exsql = sqlite3_expanded_sql(stmt);
+    trace_add_stmt(exsql ? exsql : sqlite3_sql(stmt), rows, elapsed);
+    sqlite3_free(exsql);
+}
+
+void reqtrace_sql(const char *sql, size_t rows, uint64_t elapsed)
+{
+    if (!trace.active)
+        return;
+
+    trace_add_stmt(sql, rows, elapsed);
+}
+
+void reqtrace_end(void)
+{
+    uint64_t total;
+    uint64_t sum = 0;
+    char stages[256];
+    int rc = 0;
+    int i;
+
+    if (!trace.active)
+        return;
+
+    trace.active = false;
+    total = reqtrace_clock() - trace.begin_at;
+    if (total < slow_threshold)
+        return;
+
+    // snprintf() returns the length it wanted, stop appending once the
+    // buffer is full instead of writing past it.
+    for (i = 0; i < TRACE_STAGE_NUM; ++i) {
+        sum += trace.stages[i];
+        if (rc < (int)sizeof(stages))
+            rc += snprintf(stages + rc, sizeof(stages) - rc, "%s: %.3fms, ",
+                           stage_names[i], us2ms(trace.stages[i]));
+    }
+    if (rc < (int)sizeof(stages))
+        snprintf(stages + rc, sizeof(stages) - rc, "other: %.3fms", us2ms(total > sum ? total - sum : 0));
+
+    vlogW(TAG_PERF "Slow request %s(tsx_id: %" PRIu64 ") from [%s] took %.3fms,"
+          " rows: %zu, {%s}", trace.method.empty() ? "unknown" : trace.method.c_str(),
+          trace.tsx_id, trace.from.c_str(), us2ms(total), trace.rows, stages);
+    for (const auto &stmt : trace.stmts)
+        vlogW(TAG_PERF "  sql(rows: %zu, %.3fms): %s",
+              stmt.rows, us2ms(stmt.elapsed), stmt.sql.c_str());
+}
+
+void reqtrace_send(const char *to, size_t len, uint64_t queued_at, uint64_t send_at)
+{
+    uint64_t now;
+
+    if (!slow_threshold)
+        return;
+
+    now = reqtrace_clock();
+    if (now - queued_at < slow_threshold)
+        return;
+
+    vlogW(TAG_PERF "Slow send to [%s] of %zu bytes took %.3fms, {queued: %.3fms, carrier: %.3fms}",
+          to, len, us2ms(now - queued_at), us2ms(send_at - queued_at), us2ms(now - send_at));
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2020 trinity-tech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __REQTRACE_H__
+#define __REQTRACE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sqlite3.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    TRACE_DECODE,
+    TRACE_AUTH,
+    TRACE_DB,
+    TRACE_MATERIALIZE,
+    TRACE_MARSHAL,
+    TRACE_ENQUEUE,
+    TRACE_STAGE_NUM
+} TraceStage;
+
+/*
+ * Requests are timed per worker thread between reqtrace_begin() and
+ * reqtrace_end(). Stage probes are no-ops (reqtrace_mark() returns 0)
+ * unless the current request is sampled, so they are cheap to leave on.
+ */
+void reqtrace_init(int slow_threshold_ms, int sample_rate);
+void reqtrace_begin(const char *from);
+void reqtrace_method(const char *method, uint64_t tsx_id);
+void reqtrace_end(void);
+
+uint64_t reqtrace_clock(void);
+uint64_t reqtrace_mark(void);
+uint64_t reqtrace_stage(TraceStage stage, uint64_t since);
+
+void reqtrace_stmt(sqlite3_stmt *stmt, size_t rows, uint64_t elapsed);
+void reqtrace_sql(const char *sql, size_t rows, uint64_t elapsed);
+void reqtrace_send(const char *to, size_t len, uint64_t queued_at, uint64_t send_at);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif //__REQTRACE_H__
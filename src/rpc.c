@@ -25,9 +25,12 @@
 #include <msgpack.h>
 #include <crystal.h>
 #include <ela_did.h>
+#include <sodium.h>
 
 #include "rpc.h"
 #include "err.h"
+#include "reqtrace.h"
+#include "logging.h"
 
 #define TAG_RPC "[Feedsd.Rpc ]: "
 
@@ -171,6 +174,130 @@ size_t str_reserve_spc(const msgpack_object *str)
     return str ? str->str_sz + 1 : 0;
 }
 
+/*
+ * Cursors are opaque to clients: a version byte, the query field and the
+ * value/keys of the last row as big endian u64s, base64url encoded.
+ */
+#define CURSOR_VERSION 1
+#define CURSOR_BIN_SZ  (2 + 8 * (1 + QRY_CURSOR_KEYS))
+
+static
+uint8_t *cursor_put_u64(uint8_t *p, uint64_t v)
+{
+    int i;
+
+    for (i = 7; i >= 0; --i) {
+        p[i] = (uint8_t)v;
+        v >>= 8;
+    }
+
+    return p + 8;
+}
+
+static
+const uint8_t *cursor_get_u64(const uint8_t *p, uint64_t *v)
+{
+    int i;
+
+    *v = 0;
+    for (i = 0; i < 8; ++i)
+        *v = (*v << 8) | p[i];
+
+    return p + 8;
+}
+
+int rpc_encode_cursor(const QryCursor *cur, char *buf, size_t sz)
+{
+    uint8_t bin[CURSOR_BIN_SZ];
+    uint8_t *p = bin;
+    int i;
+
+    if (sz < sodium_base64_ENCODED_LEN(sizeof(bin), sodium_base64_VARIANT_URLSAFE_NO_PADDING))
+        return -1;
+
+    *p++ = CURSOR_VERSION;
+    *p++ = (uint8_t)cur->by;
+    p = cursor_put_u64(p, cur->val);
+    for (i = 0; i < QRY_CURSOR_KEYS; ++i)
+        p = cursor_put_u64(p, cur->keys[i]);
+
+    sodium_bin2base64(buf, sz, bin, sizeof(bin), sodium_base64_VARIANT_URLSAFE_NO_PADDING);
+    return 0;
+}
+
+int rpc_decode_cursor(const char *str, size_t len, QryCursor *cur)
+{
+    uint8_t bin[CURSOR_BIN_SZ];
+    const uint8_t *p = bin;
+    size_t decoded;
+    int i;
+
+    if (sodium_base642bin(bin, sizeof(bin), str, len, NULL, &decoded, NULL,
+                          sodium_base64_VARIANT_URLSAFE_NO_PADDING) ||
+        decoded != sizeof(bin) || bin[0] != CURSOR_VERSION)
+        return -1;
+
+    p += 1;
+    cur->by = *p++;
+    p = cursor_get_u64(p, &cur->val);
+    for (i = 0; i < QRY_CURSOR_KEYS; ++i)
+        p = cursor_get_u64(p, &cur->keys[i]);
+
+    return 0;
+}
+
+/*
+ * The cursor param is optional and trails max_count. A cursor is only
+ * meaningful for the ordering it was taken from.
+ */
+static
+bool cursor_is_valid(const msgpack_object *cursor, uint64_t by, QryCursor *after)
+{
+    memset(after, 0, sizeof(*after));
+    if (!cursor)
+        return true;
+
+    return by != NONE && !rpc_decode_cursor(cursor->str_val, cursor->str_sz, after) &&
+           after->by == by;
+}
+
+/*
+ * The fields param is optional and trails the cursor. It lists the columns
+ * wanted in each row, the blob columns (QRY_FLDS_BLOBS) it leaves out are
+ * omitted, so an empty array omits them all. Other names are accepted and
+ * have no effect, non-blob columns are always sent.
+ */
+static
+bool fields_is_valid(const msgpack_object *fields, uint64_t *omit)
+{
+    size_t i;
+
+    *omit = 0;
+    if (!fields)
+        return true;
+
+    *omit = QRY_FLDS_BLOBS;
+    for (i = 0; i < fields->arr_sz; ++i) {
+        const msgpack_object *fld = &fields->arr_val(i);
+
+        if (fld->type != MSGPACK_OBJECT_STR)
+            return false;
+
+        if (fld->str_sz == strlen("content") && !memcmp(fld->str_val, "content", fld->str_sz))
+            *omit &= ~QRY_FLD_CONTENT;
+        else if (fld->str_sz == strlen("thumbnails") && !memcmp(fld->str_val, "thumbnails", fld->str_sz))
+            *omit &= ~QRY_FLD_THUMBNAILS;
+    }
+
+    return true;
+}
+
+static inline
+size_t omitted_cnt(uint64_t omit)
+{
+    return qry_omits(omit, QRY_FLD_CONTENT) + qry_omits(omit, QRY_FLD_THUMBNAILS);
+}
+
 static
 int unmarshal_decl_owner_req(const msgpack_object *req, Req **req_unmarshal)
 {
@@ -1815,6 +1942,8 @@ int unmarshal_get_my_chans_req(const msgpack_object *req, Req **req_unmarshal)
     const msgpack_object *upper;
     const msgpack_object *lower;
     const msgpack_object *maxcnt;
+    const msgpack_object *cursor;
+    QryCursor after;
     GetMyChansReq *tmp;
     char *buf;
 
@@ -1830,10 +1959,12 @@ int unmarshal_get_my_chans_req(const msgpack_object *req, Req **req_unmarshal)
             upper  = map_val_u64("upper_bound");
             lower  = map_val_u64("lower_bound");
             maxcnt = map_val_u64("max_count");
+            cursor = map_val_str("cursor");
         });
     });
 
-    if (!tk || !tk->str_sz || !by || !qry_fld_is_valid(by->u64_val) || !upper || !lower || !maxcnt) {
+    if (!tk || !tk->str_sz || !by || !qry_fld_is_valid(by->u64_val) || !upper || !lower || !maxcnt ||
+        !cursor_is_valid(cursor, by->u64_val, &after)) {
         vlogE(TAG_RPC "Invalid get_my_channels request.");
         return -1;
     }
@@ -1851,6 +1982,7 @@ int unmarshal_get_my_chans_req(const msgpack_object *req, Req **req_unmarshal)
     tmp->params.qc.upper  = upper->u64_val;
     tmp->params.qc.lower  = lower->u64_val;
     tmp->params.qc.maxcnt = maxcnt->u64_val;
+    tmp->params.qc.after  = after;
 
     *req_unmarshal = (Req *)tmp;
     return 0;
@@ -1866,6 +1998,8 @@ int unmarshal_get_my_chans_meta_req(const msgpack_object *req, Req **req_unmarsh
     const msgpack_object *upper;
     const msgpack_object *lower;
     const msgpack_object *maxcnt;
+    const msgpack_object *cursor;
+    QryCursor after;
     GetMyChansMetaReq *tmp;
     char *buf;
 
@@ -1881,10 +2015,12 @@ int unmarshal_get_my_chans_meta_req(const msgpack_object *req, Req **req_unmarsh
             upper  = map_val_u64("upper_bound");
             lower  = map_val_u64("lower_bound");
             maxcnt = map_val_u64("max_count");
+            cursor = map_val_str("cursor");
         });
     });
 
-    if (!tk || !tk->str_sz || !by || !qry_fld_is_valid(by->u64_val) || !upper || !lower || !maxcnt) {
+    if (!tk || !tk->str_sz || !by || !qry_fld_is_valid(by->u64_val) || !upper || !lower || !maxcnt ||
+        !cursor_is_valid(cursor, by->u64_val, &after)) {
         vlogE(TAG_RPC "Invalid get_my_channels_metadata request.");
         return -1;
     }
@@ -1902,6 +2038,7 @@ int unmarshal_get_my_chans_meta_req(const msgpack_object *req, Req **req_unmarsh
     tmp->params.qc.upper  = upper->u64_val;
     tmp->params.qc.lower  = lower->u64_val;
     tmp->params.qc.maxcnt = maxcnt->u64_val;
+    tmp->params.qc.after  = after;
 
     *req_unmarshal = (Req *)tmp;
     return 0;
@@ -1917,6 +2054,8 @@ int unmarshal_get_chans_req(const msgpack_object *req, Req **req_unmarshal)
     const msgpack_object *upper;
     const msgpack_object *lower;
     const msgpack_object *maxcnt;
+    const msgpack_object *cursor;
+    QryCursor after;
     GetChansReq *tmp;
     char *buf;
 
@@ -1932,10 +2071,12 @@ int unmarshal_get_chans_req(const msgpack_object *req, Req **req_unmarshal)
             upper  = map_val_u64("upper_bound");
             lower  = map_val_u64("lower_bound");
             maxcnt = map_val_u64("max_count");
+            cursor = map_val_str("cursor");
         });
     });
 
-    if (!tk || !tk->str_sz || !by || !qry_fld_is_valid(by->u64_val) || !upper || !lower || !maxcnt) {
+    if (!tk || !tk->str_sz || !by || !qry_fld_is_valid(by->u64_val) || !upper || !lower || !maxcnt ||
+        !cursor_is_valid(cursor, by->u64_val, &after)) {
         vlogE(TAG_RPC "Invalid get_channels request.");
         return -1;
     }
@@ -1953,6 +2094,7 @@ int unmarshal_get_chans_req(const msgpack_object *req, Req **req_unmarshal)
     tmp->params.qc.upper  = upper->u64_val;
     tmp->params.qc.lower  = lower->u64_val;
     tmp->params.qc.maxcnt = maxcnt->u64_val;
+    tmp->params.qc.after  = after;
 
     *req_unmarshal = (Req *)tmp;
     return 0;
@@ -2010,6 +2152,8 @@ int unmarshal_get_sub_chans_req(const msgpack_object *req, Req **req_unmarshal)
     const msgpack_object *upper;
     const msgpack_object *lower;
     const msgpack_object *maxcnt;
+    const msgpack_object *cursor;
+    QryCursor after;
     GetSubChansReq *tmp;
     char *buf;
 
@@ -2025,10 +2169,12 @@ int unmarshal_get_sub_chans_req(const msgpack_object *req, Req **req_unmarshal)
             upper  = map_val_u64("upper_bound");
             lower  = map_val_u64("lower_bound");
             maxcnt = map_val_u64("max_count");
+            cursor = map_val_str("cursor");
         });
     });
 
-    if (!tk || !tk->str_sz || !by || !qry_fld_is_valid(by->u64_val) || !upper || !lower || !maxcnt) {
+    if (!tk || !tk->str_sz || !by || !qry_fld_is_valid(by->u64_val) || !upper || !lower || !maxcnt ||
+        !cursor_is_valid(cursor, by->u64_val, &after)) {
         vlogE(TAG_RPC "Invalid get_subscribed_channels request.");
         return -1;
     }
@@ -2046,6 +2192,7 @@ int unmarshal_get_sub_chans_req(const msgpack_object *req, Req **req_unmarshal)
     tmp->params.qc.upper  = upper->u64_val;
     tmp->params.qc.lower  = lower->u64_val;
     tmp->params.qc.maxcnt = maxcnt->u64_val;
+    tmp->params.qc.after  = after;
 
     *req_unmarshal = (Req *)tmp;
     return 0;
@@ -2062,6 +2209,10 @@ int unmarshal_get_posts_req(const msgpack_object *req, Req **req_unmarshal)
     const msgpack_object *upper;
     const msgpack_object *lower;
     const msgpack_object *maxcnt;
+    const msgpack_object *cursor;
+    const msgpack_object *fields;
+    QryCursor after;
+    uint64_t omit;
     GetPostsReq *tmp;
     char *buf;
 
@@ -2078,11 +2229,14 @@ int unmarshal_get_posts_req(const msgpack_object *req, Req **req_unmarshal)
             upper   = map_val_u64("upper_bound");
             lower   = map_val_u64("lower_bound");
             maxcnt  = map_val_u64("max_count");
+            cursor  = map_val_str("cursor");
+            fields  = map_val_arr("fields");
         });
     });
 
     if (!tk || !tk->str_sz || !chan_id || !chan_id_is_valid(chan_id->u64_val) ||
-        !by || !qry_fld_is_valid(by->u64_val) || !upper || !lower || !maxcnt) {
+        !by || !qry_fld_is_valid(by->u64_val) || !upper || !lower || !maxcnt ||
+        !cursor_is_valid(cursor, by->u64_val, &after) || !fields_is_valid(fields, &omit)) {
         vlogE(TAG_RPC "Invalid get_posts request.");
         return -1;
     }
@@ -2101,6 +2255,8 @@ int unmarshal_get_posts_req(const msgpack_object *req, Req **req_unmarshal)
     tmp->params.qc.upper  = upper->u64_val;
     tmp->params.qc.lower  = lower->u64_val;
     tmp->params.qc.maxcnt = maxcnt->u64_val;
+    tmp->params.qc.after  = after;
+    tmp->params.qc.omit   = omit;
 
     *req_unmarshal = (Req *)tmp;
     return 0;
@@ -2117,6 +2273,8 @@ int unmarshal_get_posts_lac_req(const msgpack_object *req, Req **req_unmarshal)
     const msgpack_object *upper;
     const msgpack_object *lower;
     const msgpack_object *maxcnt;
+    const msgpack_object *cursor;
+    QryCursor after;
     GetPostsLACReq *tmp;
     char *buf;
 
@@ -2133,11 +2291,13 @@ int unmarshal_get_posts_lac_req(const msgpack_object *req, Req **req_unmarshal)
             upper   = map_val_u64("upper_bound");
             lower   = map_val_u64("lower_bound");
             maxcnt  = map_val_u64("max_count");
+            cursor  = map_val_str("cursor");
         });
     });
 
     if (!tk || !tk->str_sz || !chan_id || !chan_id_is_valid(chan_id->u64_val) ||
-        !by || !qry_fld_is_valid(by->u64_val) || !upper || !lower || !maxcnt) {
+        !by || !qry_fld_is_valid(by->u64_val) || !upper || !lower || !maxcnt ||
+        !cursor_is_valid(cursor, by->u64_val, &after)) {
         vlogE(TAG_RPC "Invalid get_posts_likes_and_comments request.");
         return -1;
     }
@@ -2156,6 +2316,7 @@ int unmarshal_get_posts_lac_req(const msgpack_object *req, Req **req_unmarshal)
     tmp->params.qc.upper  = upper->u64_val;
     tmp->params.qc.lower  = lower->u64_val;
     tmp->params.qc.maxcnt = maxcnt->u64_val;
+    tmp->params.qc.after  = after;
 
     *req_unmarshal = (Req *)tmp;
     return 0;
@@ -2171,6 +2332,8 @@ int unmarshal_get_liked_posts_req(const msgpack_object *req, Req **req_unmarshal
     const msgpack_object *upper;
     const msgpack_object *lower;
     const msgpack_object *maxcnt;
+    const msgpack_object *cursor;
+    QryCursor after;
     GetLikedPostsReq *tmp;
     char *buf;
 
@@ -2186,11 +2349,13 @@ int unmarshal_get_liked_posts_req(const msgpack_object *req, Req **req_unmarshal
             upper   = map_val_u64("upper_bound");
             lower   = map_val_u64("lower_bound");
             maxcnt  = map_val_u64("max_count");
+            cursor  = map_val_str("cursor");
         });
     });
 
     if (!tk || !tk->str_sz || !by || !qry_fld_is_valid(by->u64_val) ||
-        !upper || !lower || !maxcnt) {
+        !upper || !lower || !maxcnt ||
+        !cursor_is_valid(cursor, by->u64_val, &after)) {
         vlogE(TAG_RPC "Invalid get_liked_posts request.");
         return -1;
     }
@@ -2208,6 +2373,7 @@ int unmarshal_get_liked_posts_req(const msgpack_object *req, Req **req_unmarshal
     tmp->params.qc.upper  = upper->u64_val;
     tmp->params.qc.lower  = lower->u64_val;
     tmp->params.qc.maxcnt = maxcnt->u64_val;
+    tmp->params.qc.after  = after;
 
     *req_unmarshal = (Req *)tmp;
     return 0;
@@ -2223,6 +2389,8 @@ int unmarshal_get_liked_data_req(const msgpack_object *req, Req **req_unmarshal)
     const msgpack_object *upper;
     const msgpack_object *lower;
     const msgpack_object *maxcnt;
+    const msgpack_object *cursor;
+    QryCursor after;
     GetLikedDataReq *tmp;
     char *buf;
 
@@ -2238,11 +2406,13 @@ int unmarshal_get_liked_data_req(const msgpack_object *req, Req **req_unmarshal)
             upper   = map_val_u64("upper_bound");
             lower   = map_val_u64("lower_bound");
             maxcnt  = map_val_u64("max_count");
+            cursor  = map_val_str("cursor");
         });
     });
 
     if (!tk || !tk->str_sz || !by || !qry_fld_is_valid(by->u64_val) ||
-        !upper || !lower || !maxcnt) {
+        !upper || !lower || !maxcnt ||
+        !cursor_is_valid(cursor, by->u64_val, &after)) {
         vlogE(TAG_RPC "Invalid get_liked_data request.");
         return -1;
     }
@@ -2260,6 +2430,7 @@ int unmarshal_get_liked_data_req(const msgpack_object *req, Req **req_unmarshal)
     tmp->params.qc.upper  = upper->u64_val;
     tmp->params.qc.lower  = lower->u64_val;
     tmp->params.qc.maxcnt = maxcnt->u64_val;
+    tmp->params.qc.after  = after;
 
     *req_unmarshal = (Req *)tmp;
     return 0;
@@ -2277,6 +2448,10 @@ int unmarshal_get_cmts_req(const msgpack_object *req, Req **req_unmarshal)
     const msgpack_object *upper;
     const msgpack_object *lower;
     const msgpack_object *maxcnt;
+    const msgpack_object *cursor;
+    const msgpack_object *fields;
+    QryCursor after;
+    uint64_t omit;
     GetCmtsReq *tmp;
     char *buf;
 
@@ -2294,12 +2469,15 @@ int unmarshal_get_cmts_req(const msgpack_object *req, Req **req_unmarshal)
             upper   = map_val_u64("upper_bound");
             lower   = map_val_u64("lower_bound");
             maxcnt  = map_val_u64("max_count");
+            cursor  = map_val_str("cursor");
+            fields  = map_val_arr("fields");
         });
     });
 
     if (!tk || !tk->str_sz || !chan_id || !chan_id_is_valid(chan_id->u64_val) ||
         !post_id || !post_id_is_valid(post_id->u64_val) ||
-        !by || !qry_fld_is_valid(by->u64_val) || !upper || !lower || !maxcnt) {
+        !by || !qry_fld_is_valid(by->u64_val) || !upper || !lower || !maxcnt ||
+        !cursor_is_valid(cursor, by->u64_val, &after) || !fields_is_valid(fields, &omit)) {
         vlogE(TAG_RPC "Invalid get_comments request.");
         return -1;
     }
@@ -2319,6 +2497,8 @@ int unmarshal_get_cmts_req(const msgpack_object *req, Req **req_unmarshal)
     tmp->params.qc.upper  = upper->u64_val;
     tmp->params.qc.lower  = lower->u64_val;
     tmp->params.qc.maxcnt = maxcnt->u64_val;
+    tmp->params.qc.after  = after;
+    tmp->params.qc.omit   = omit;
 
     *req_unmarshal = (Req *)tmp;
     return 0;
@@ -2336,6 +2516,8 @@ int unmarshal_get_cmts_likes_req(const msgpack_object *req, Req **req_unmarshal)
     const msgpack_object *upper;
     const msgpack_object *lower;
     const msgpack_object *maxcnt;
+    const msgpack_object *cursor;
+    QryCursor after;
     GetCmtsLikesReq *tmp;
     char *buf;
 
@@ -2353,12 +2535,14 @@ int unmarshal_get_cmts_likes_req(const msgpack_object *req, Req **req_unmarshal)
             upper   = map_val_u64("upper_bound");
             lower   = map_val_u64("lower_bound");
             maxcnt  = map_val_u64("max_count");
+            cursor  = map_val_str("cursor");
         });
     });
 
     if (!tk || !tk->str_sz || !chan_id || !chan_id_is_valid(chan_id->u64_val) ||
         !post_id || !post_id_is_valid(post_id->u64_val) ||
-        !by || !qry_fld_is_valid(by->u64_val) || !upper || !lower || !maxcnt) {
+        !by || !qry_fld_is_valid(by->u64_val) || !upper || !lower || !maxcnt ||
+        !cursor_is_valid(cursor, by->u64_val, &after)) {
         vlogE(TAG_RPC "Invalid get_comments_likes request.");
         return -1;
     }
@@ -2378,6 +2562,7 @@ int unmarshal_get_cmts_likes_req(const msgpack_object *req, Req **req_unmarshal)
     tmp->params.qc.upper  = upper->u64_val;
     tmp->params.qc.lower  = lower->u64_val;
     tmp->params.qc.maxcnt = maxcnt->u64_val;
+    tmp->params.qc.after  = after;
 
     *req_unmarshal = (Req *)tmp;
     return 0;
@@ -2800,6 +2985,8 @@ int unmarshal_get_reported_cmts_req(const msgpack_object *req, Req **req_unmarsh
     const msgpack_object *upper;
     const msgpack_object *lower;
     const msgpack_object *maxcnt;
+    const msgpack_object *cursor;
+    QryCursor after;
     GetReportedCmtsReq *tmp;
     char *buf;
 
@@ -2815,11 +3002,13 @@ int unmarshal_get_reported_cmts_req(const msgpack_object *req, Req **req_unmarsh
             upper   = map_val_u64("upper_bound");
             lower   = map_val_u64("lower_bound");
             maxcnt  = map_val_u64("max_count");
+            cursor  = map_val_str("cursor");
         });
     });
 
     if (!tk || !tk->str_sz ||
-        !by || !qry_fld_is_valid(by->u64_val) || !upper || !lower || !maxcnt) {
+        !by || !qry_fld_is_valid(by->u64_val) || !upper || !lower || !maxcnt ||
+        !cursor_is_valid(cursor, by->u64_val, &after)) {
         vlogE(TAG_RPC "Invalid get_reported_comments request.");
         return -1;
     }
@@ -2837,6 +3026,7 @@ int unmarshal_get_reported_cmts_req(const msgpack_object *req, Req **req_unmarsh
     tmp->params.qc.upper  = upper->u64_val;
     tmp->params.qc.lower  = lower->u64_val;
     tmp->params.qc.maxcnt = maxcnt->u64_val;
+    tmp->params.qc.after  = after;
 
     *req_unmarshal = (Req *)tmp;
     return 0;
@@ -3462,6 +3652,35 @@ void pack_kv_bin_withzero(msgpack_packer* pk, const char *k, const void *bin, si
     msgpack_pack_bin_body(pk, bin, sz);
 }
 
+/*
+ * Channels carry their avatar blob only towards clients that did not ask
+ * for avatar_hash, the handlers attach it for those, see avatar_by_hash().
+ */
+static inline
+void pack_kv_chan_avatar(msgpack_packer* pk, const ChanInfo *ci)
+{
+    if (ci->avatar)
+        pack_kv_bin(pk, "avatar", ci->avatar, ci->len);
+    else
+        pack_kv_str(pk, "avatar_hash", ci->avatar_hash);
+}
+
+static inline
+void pack_kv_cursor(msgpack_packer* pk, const char *k, const QryCursor *cur)
+{
+    char str[RPC_CURSOR_LEN];
+
+    assert(pk);
+    assert(k);
+
+    if (!cur || !cur->by || rpc_encode_cursor(cur, str, sizeof(str)) < 0) {
+        pack_kv_nil(pk, k);
+        return;
+    }
+
+    pack_kv_str(pk, k, str);
+}
+
 #define pack_map(pk, kvs, set_kvs)     \
     do {                               \
         if (kvs) {                     \
@@ -3490,25 +3709,65 @@ void pack_kv_bin_withzero(msgpack_packer* pk, const char *k, const void *bin, si
         pack_arr(pk, elems, set_elems);      \
     } while (0)
 
+/*
+ * Messages are packed twice. The first pass only adds up the bytes, so the
+ * second one writes into a block of exactly that size, allocated together
+ * with its Marshalled header: a page of content costs one allocation and
+ * no realloc, and the packer itself lives on the stack.
+ */
 typedef struct {
-    Marshalled m;
-    msgpack_sbuffer *buf;
-} MarshalledIntl;
+    char  *data;
+    size_t sz;
+} PackBuf;
 
 static
-void mintl_dtor(void *obj)
+int packbuf_write(void *data, const char *buf, size_t len)
 {
-    MarshalledIntl *m = obj;
+    PackBuf *pb = data;
 
-    if (m->buf)
-        msgpack_sbuffer_free(m->buf);
+    if (pb->data && len)
+        memcpy(pb->data + pb->sz, buf, len);
+    pb->sz += len;
+
+    return 0;
 }
 
+static
+Marshalled *packbuf_alloc(PackBuf *pb)
+{
+    Marshalled *m = rc_zalloc(sizeof(Marshalled) + pb->sz, NULL);
+    if (!m) {
+        vlogE(TAG_RPC "OOM");
+        return NULL;
+    }
+
+    m->data  = m + 1;
+    m->sz    = pb->sz;
+    pb->data = m->data;
+    pb->sz   = 0;
+
+    return m;
+}
+
+#define marshal_packs(m, pk, packs)                     \
+    do {                                                \
+        PackBuf __pb = {NULL, 0};                       \
+        msgpack_packer __pk;                            \
+        msgpack_packer *pk = &__pk;                     \
+                                                        \
+        msgpack_packer_init(pk, &__pb, packbuf_write);  \
+        packs                                           \
+        (m) = packbuf_alloc(&__pb);                     \
+        if (m) {                                        \
+            packs                                       \
+            assert(__pb.sz == (m)->sz);                 \
+        }                                               \
+    } while (0)
+
 Marshalled *rpc_marshal_new_post_notif(const NewPostNotif *notif)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
 /*    vlogE(TAG_RPC "channel_id = %lu", notif->params.pinfo->chan_id);
     vlogE(TAG_RPC "id = %lu", notif->params.pinfo->post_id);
@@ -3522,429 +3781,370 @@ Marshalled *rpc_marshal_new_post_notif(const NewPostNotif *notif)
     vlogE(TAG_RPC "hash_id = %s", notif->params.pinfo->hash_id);
     vlogE(TAG_RPC "proof = %s", notif->params.pinfo->proof);
     vlogE(TAG_RPC "origin_post_url = %s", notif->params.pinfo->origin_post_url);*/
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_str(pk, "method", "new_post");
-        pack_kv_map(pk, "params", 12, {
-            pack_kv_u64(pk, "channel_id", notif->params.pinfo->chan_id);
-            pack_kv_u64(pk, "id", notif->params.pinfo->post_id);
-            pack_kv_u64(pk, "status", notif->params.pinfo->stat);
-            pack_kv_bin(pk, "content", notif->params.pinfo->content, notif->params.pinfo->con_len);
-            pack_kv_u64(pk, "comments", notif->params.pinfo->cmts);
-            pack_kv_u64(pk, "likes", notif->params.pinfo->likes);
-            pack_kv_u64(pk, "created_at", notif->params.pinfo->created_at);
-            pack_kv_u64(pk, "updated_at", notif->params.pinfo->upd_at);
-            pack_kv_bin(pk, "thumbnails", notif->params.pinfo->thumbnails, notif->params.pinfo->thu_len);  //2.0
-            pack_kv_str(pk, "hash_id", notif->params.pinfo->hash_id);  //2.0
-            pack_kv_str(pk, "proof", notif->params.pinfo->proof);  //2.0
-            pack_kv_str(pk, "origin_post_url", notif->params.pinfo->origin_post_url);  //2.0
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_str(pk, "method", "new_post");
+            pack_kv_map(pk, "params", 12, {
+                pack_kv_u64(pk, "channel_id", notif->params.pinfo->chan_id);
+                pack_kv_u64(pk, "id", notif->params.pinfo->post_id);
+                pack_kv_u64(pk, "status", notif->params.pinfo->stat);
+                pack_kv_bin(pk, "content", notif->params.pinfo->content, notif->params.pinfo->con_len);
+                pack_kv_u64(pk, "comments", notif->params.pinfo->cmts);
+                pack_kv_u64(pk, "likes", notif->params.pinfo->likes);
+                pack_kv_u64(pk, "created_at", notif->params.pinfo->created_at);
+                pack_kv_u64(pk, "updated_at", notif->params.pinfo->upd_at);
+                pack_kv_bin(pk, "thumbnails", notif->params.pinfo->thumbnails, notif->params.pinfo->thu_len);  //2.0
+                pack_kv_str(pk, "hash_id", notif->params.pinfo->hash_id);  //2.0
+                pack_kv_str(pk, "proof", notif->params.pinfo->proof);  //2.0
+                pack_kv_str(pk, "origin_post_url", notif->params.pinfo->origin_post_url);  //2.0
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_post_upd_notif(const PostUpdNotif *notif)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_str(pk, "method", "post_update");
-        pack_kv_map(pk, "params", 8, {
-            pack_kv_u64(pk, "channel_id", notif->params.pinfo->chan_id);
-            pack_kv_u64(pk, "id", notif->params.pinfo->post_id);
-            pack_kv_u64(pk, "status", notif->params.pinfo->stat);
-            notif->params.pinfo->stat == POST_DELETED ? pack_kv_nil(pk, "content") :
-                                                        pack_kv_bin(pk, "content", notif->params.pinfo->content,
-                                                                    notif->params.pinfo->con_len);
-            pack_kv_u64(pk, "comments", notif->params.pinfo->cmts);
-            pack_kv_u64(pk, "likes", notif->params.pinfo->likes);
-            pack_kv_u64(pk, "created_at", notif->params.pinfo->created_at);
-            pack_kv_u64(pk, "updated_at", notif->params.pinfo->upd_at);
-            /*
-            notif->params.pinfo->stat == POST_DELETED ? pack_kv_nil(pk, "thumbnails") :  //2.0
-                                                        pack_kv_bin(pk, "thumbnails", notif->params.pinfo->thumbnails,
-                                                                    notif->params.pinfo->thu_len);
-            pack_kv_str(pk, "hash_id", notif->params.pinfo->hash_id);  //2.0
-            pack_kv_str(pk, "proof", notif->params.pinfo->proof);  //2.0
-            pack_kv_str(pk, "origin_post_url", notif->params.pinfo->origin_post_url);  //2.0
-            */
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_str(pk, "method", "post_update");
+            pack_kv_map(pk, "params", 8, {
+                pack_kv_u64(pk, "channel_id", notif->params.pinfo->chan_id);
+                pack_kv_u64(pk, "id", notif->params.pinfo->post_id);
+                pack_kv_u64(pk, "status", notif->params.pinfo->stat);
+                notif->params.pinfo->stat == POST_DELETED ? pack_kv_nil(pk, "content") :
+                                                            pack_kv_bin(pk, "content", notif->params.pinfo->content,
+                                                                        notif->params.pinfo->con_len);
+                pack_kv_u64(pk, "comments", notif->params.pinfo->cmts);
+                pack_kv_u64(pk, "likes", notif->params.pinfo->likes);
+                pack_kv_u64(pk, "created_at", notif->params.pinfo->created_at);
+                pack_kv_u64(pk, "updated_at", notif->params.pinfo->upd_at);
+                /*
+                notif->params.pinfo->stat == POST_DELETED ? pack_kv_nil(pk, "thumbnails") :  //2.0
+                                                            pack_kv_bin(pk, "thumbnails", notif->params.pinfo->thumbnails,
+                                                                        notif->params.pinfo->thu_len);
+                pack_kv_str(pk, "hash_id", notif->params.pinfo->hash_id);  //2.0
+                pack_kv_str(pk, "proof", notif->params.pinfo->proof);  //2.0
+                pack_kv_str(pk, "origin_post_url", notif->params.pinfo->origin_post_url);  //2.0
+                */
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_new_cmt_notif(const NewCmtNotif *notif)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
-
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_str(pk, "method", "new_comment");
-        pack_kv_map(pk, "params", 14, {
-            pack_kv_u64(pk, "channel_id", notif->params.cinfo->chan_id);
-            pack_kv_u64(pk, "post_id", notif->params.cinfo->post_id);
-            pack_kv_u64(pk, "id", notif->params.cinfo->cmt_id);
-            pack_kv_u64(pk, "status", notif->params.cinfo->stat);
-            pack_kv_u64(pk, "comment_id", notif->params.cinfo->reply_to_cmt);
-            pack_kv_str(pk, "user_did", notif->params.cinfo->user.did);
-            pack_kv_str(pk, "user_name", notif->params.cinfo->user.name);
-            pack_kv_bin(pk, "content", notif->params.cinfo->content, notif->params.cinfo->con_len);
-            pack_kv_u64(pk, "likes", notif->params.cinfo->likes);
-            pack_kv_u64(pk, "created_at", notif->params.cinfo->created_at);
-            pack_kv_u64(pk, "updated_at", notif->params.cinfo->upd_at);
-            pack_kv_bin(pk, "thumbnails", notif->params.cinfo->thumbnails, notif->params.cinfo->thu_len);  //2.0
-            pack_kv_str(pk, "hash_id", notif->params.cinfo->hash_id);  //2.0
-            pack_kv_str(pk, "proof", notif->params.cinfo->proof);  //2.0
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
+
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_str(pk, "method", "new_comment");
+            pack_kv_map(pk, "params", 14, {
+                pack_kv_u64(pk, "channel_id", notif->params.cinfo->chan_id);
+                pack_kv_u64(pk, "post_id", notif->params.cinfo->post_id);
+                pack_kv_u64(pk, "id", notif->params.cinfo->cmt_id);
+                pack_kv_u64(pk, "status", notif->params.cinfo->stat);
+                pack_kv_u64(pk, "comment_id", notif->params.cinfo->reply_to_cmt);
+                pack_kv_str(pk, "user_did", notif->params.cinfo->user.did);
+                pack_kv_str(pk, "user_name", notif->params.cinfo->user.name);
+                pack_kv_bin(pk, "content", notif->params.cinfo->content, notif->params.cinfo->con_len);
+                pack_kv_u64(pk, "likes", notif->params.cinfo->likes);
+                pack_kv_u64(pk, "created_at", notif->params.cinfo->created_at);
+                pack_kv_u64(pk, "updated_at", notif->params.cinfo->upd_at);
+                pack_kv_bin(pk, "thumbnails", notif->params.cinfo->thumbnails, notif->params.cinfo->thu_len);  //2.0
+                pack_kv_str(pk, "hash_id", notif->params.cinfo->hash_id);  //2.0
+                pack_kv_str(pk, "proof", notif->params.cinfo->proof);  //2.0
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_cmt_upd_notif(const CmtUpdNotif *notif)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
-
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_str(pk, "method", "comment_update");
-        pack_kv_map(pk, "params", 11, {
-            pack_kv_u64(pk, "channel_id", notif->params.cinfo->chan_id);
-            pack_kv_u64(pk, "post_id", notif->params.cinfo->post_id);
-            pack_kv_u64(pk, "id", notif->params.cinfo->cmt_id);
-            pack_kv_u64(pk, "status", notif->params.cinfo->stat);
-            pack_kv_u64(pk, "comment_id", notif->params.cinfo->reply_to_cmt);
-            pack_kv_str(pk, "user_did", notif->params.cinfo->user.did);
-            pack_kv_str(pk, "user_name", notif->params.cinfo->user.name);
-            notif->params.cinfo->stat == CMT_AVAILABLE ? pack_kv_bin(pk, "content", notif->params.cinfo->content,
-                                                                     notif->params.cinfo->con_len) :
-                                                         pack_kv_nil(pk, "content");
-            pack_kv_u64(pk, "likes", notif->params.cinfo->likes);
-            pack_kv_u64(pk, "created_at", notif->params.cinfo->created_at);
-            pack_kv_u64(pk, "updated_at", notif->params.cinfo->upd_at);
-            /*
-            notif->params.cinfo->stat == CMT_AVAILABLE ? pack_kv_bin(pk, "thumbnails", notif->params.cinfo->thumbnails,
-                                                                     notif->params.cinfo->thu_len) :
-                                                         pack_kv_nil(pk, "content");  //2.0
-            pack_kv_str(pk, "hash_id", notif->params.cinfo->hash_id);  //2.0
-            pack_kv_str(pk, "proof", notif->params.cinfo->proof);  //2.0
-            */
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
+
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_str(pk, "method", "comment_update");
+            pack_kv_map(pk, "params", 11, {
+                pack_kv_u64(pk, "channel_id", notif->params.cinfo->chan_id);
+                pack_kv_u64(pk, "post_id", notif->params.cinfo->post_id);
+                pack_kv_u64(pk, "id", notif->params.cinfo->cmt_id);
+                pack_kv_u64(pk, "status", notif->params.cinfo->stat);
+                pack_kv_u64(pk, "comment_id", notif->params.cinfo->reply_to_cmt);
+                pack_kv_str(pk, "user_did", notif->params.cinfo->user.did);
+                pack_kv_str(pk, "user_name", notif->params.cinfo->user.name);
+                notif->params.cinfo->stat == CMT_AVAILABLE ? pack_kv_bin(pk, "content", notif->params.cinfo->content,
+                                                                         notif->params.cinfo->con_len) :
+                                                             pack_kv_nil(pk, "content");
+                pack_kv_u64(pk, "likes", notif->params.cinfo->likes);
+                pack_kv_u64(pk, "created_at", notif->params.cinfo->created_at);
+                pack_kv_u64(pk, "updated_at", notif->params.cinfo->upd_at);
+                /*
+                notif->params.cinfo->stat == CMT_AVAILABLE ? pack_kv_bin(pk, "thumbnails", notif->params.cinfo->thumbnails,
+                                                                         notif->params.cinfo->thu_len) :
+                                                             pack_kv_nil(pk, "content");  //2.0
+                pack_kv_str(pk, "hash_id", notif->params.cinfo->hash_id);  //2.0
+                pack_kv_str(pk, "proof", notif->params.cinfo->proof);  //2.0
+                */
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_new_like_notif(const NewLikeNotif *notif)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
-
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_str(pk, "method", "new_like");
-        pack_kv_map(pk, "params", 7, {
-            pack_kv_u64(pk, "channel_id", notif->params.li->chan_id);
-            pack_kv_u64(pk, "post_id", notif->params.li->post_id);
-            pack_kv_u64(pk, "comment_id", notif->params.li->cmt_id);
-            pack_kv_str(pk, "user_name", notif->params.li->user.name);
-            pack_kv_str(pk, "user_did", notif->params.li->user.did);
-            pack_kv_str(pk, "proof", notif->params.li->proof);  //2.0
-            pack_kv_u64(pk, "total_count", notif->params.li->total_cnt);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
+
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_str(pk, "method", "new_like");
+            pack_kv_map(pk, "params", 7, {
+                pack_kv_u64(pk, "channel_id", notif->params.li->chan_id);
+                pack_kv_u64(pk, "post_id", notif->params.li->post_id);
+                pack_kv_u64(pk, "comment_id", notif->params.li->cmt_id);
+                pack_kv_str(pk, "user_name", notif->params.li->user.name);
+                pack_kv_str(pk, "user_did", notif->params.li->user.did);
+                pack_kv_str(pk, "proof", notif->params.li->proof);  //2.0
+                pack_kv_u64(pk, "total_count", notif->params.li->total_cnt);
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_new_sub_notif(const NewSubNotif *notif)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
-
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_str(pk, "method", "new_subscription");
-        pack_kv_map(pk, "params", 3, {
-            pack_kv_u64(pk, "channel_id", notif->params.chan_id);
-            pack_kv_str(pk, "user_name", notif->params.uinfo->name);
-            pack_kv_str(pk, "user_did", notif->params.uinfo->did);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
+
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_str(pk, "method", "new_subscription");
+            pack_kv_map(pk, "params", 3, {
+                pack_kv_u64(pk, "channel_id", notif->params.chan_id);
+                pack_kv_str(pk, "user_name", notif->params.uinfo->name);
+                pack_kv_str(pk, "user_did", notif->params.uinfo->did);
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_chan_upd_notif(const ChanUpdNotif *notif)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
-
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_str(pk, "method", "feedinfo_update");
-        pack_kv_map(pk, "params", 11, {
-            pack_kv_u64(pk, "id", notif->params.cinfo->chan_id);
-            pack_kv_str(pk, "name", notif->params.cinfo->name);
-            pack_kv_str(pk, "introduction", notif->params.cinfo->intro);
-            pack_kv_str(pk, "owner_name", notif->params.cinfo->owner->name);
-            pack_kv_str(pk, "owner_did", notif->params.cinfo->owner->did);
-            pack_kv_u64(pk, "subscribers", notif->params.cinfo->subs);
-            pack_kv_u64(pk, "last_update", notif->params.cinfo->upd_at);
-            pack_kv_bin(pk, "avatar", notif->params.cinfo->avatar, notif->params.cinfo->len);
-            pack_kv_str(pk, "tip_methods", notif->params.cinfo->tip_methods);  //2.0
-            pack_kv_str(pk, "proof", notif->params.cinfo->proof);  //2.0
-            pack_kv_u64(pk, "status", notif->params.cinfo->status);  //2.0
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
+
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_str(pk, "method", "feedinfo_update");
+            pack_kv_map(pk, "params", 11, {
+                pack_kv_u64(pk, "id", notif->params.cinfo->chan_id);
+                pack_kv_str(pk, "name", notif->params.cinfo->name);
+                pack_kv_str(pk, "introduction", notif->params.cinfo->intro);
+                pack_kv_str(pk, "owner_name", notif->params.cinfo->owner->name);
+                pack_kv_str(pk, "owner_did", notif->params.cinfo->owner->did);
+                pack_kv_u64(pk, "subscribers", notif->params.cinfo->subs);
+                pack_kv_u64(pk, "last_update", notif->params.cinfo->upd_at);
+                pack_kv_chan_avatar(pk, notif->params.cinfo);
+                pack_kv_str(pk, "tip_methods", notif->params.cinfo->tip_methods);  //2.0
+                pack_kv_str(pk, "proof", notif->params.cinfo->proof);  //2.0
+                pack_kv_u64(pk, "status", notif->params.cinfo->status);  //2.0
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_stats_changed_notif(const StatsChangedNotif *notif)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_str(pk, "method", "statistics_changed");
-        pack_kv_map(pk, "params", 1, {
-            pack_kv_u64(pk, "total_clients", notif->params.total_cs);
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_str(pk, "method", "statistics_changed");
+            pack_kv_map(pk, "params", 1, {
+                pack_kv_u64(pk, "total_clients", notif->params.total_cs);
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_report_cmt_notif(const ReportCmtNotif *notif)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
-
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_str(pk, "method", "report_illegal_comment");
-        pack_kv_map(pk, "params", 6, {
-            pack_kv_u64(pk, "channel_id", notif->params.li->chan_id);
-            pack_kv_u64(pk, "post_id", notif->params.li->post_id);
-            pack_kv_u64(pk, "comment_id", notif->params.li->cmt_id);
-            pack_kv_str(pk, "reporter_name", notif->params.li->reporter.name);
-            pack_kv_str(pk, "reporter_did", notif->params.li->reporter.did);
-            pack_kv_str(pk, "reasons", notif->params.li->reasons);
-            pack_kv_u64(pk, "created_at", notif->params.li->created_at);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
+
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_str(pk, "method", "report_illegal_comment");
+            pack_kv_map(pk, "params", 6, {
+                pack_kv_u64(pk, "channel_id", notif->params.li->chan_id);
+                pack_kv_u64(pk, "post_id", notif->params.li->post_id);
+                pack_kv_u64(pk, "comment_id", notif->params.li->cmt_id);
+                pack_kv_str(pk, "reporter_name", notif->params.li->reporter.name);
+                pack_kv_str(pk, "reporter_did", notif->params.li->reporter.did);
+                pack_kv_str(pk, "reasons", notif->params.li->reasons);
+                pack_kv_u64(pk, "created_at", notif->params.li->created_at);
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 
 Marshalled *rpc_marshal_decl_owner_resp(const DeclOwnerResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
-
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", resp->result.did ? 3 : 1, {
-            pack_kv_str(pk, "phase", resp->result.phase);
-            pack_kv_str(pk, "did", resp->result.did);
-            pack_kv_str(pk, "transaction_payload", resp->result.tsx_payload);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
+
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", resp->result.did ? 3 : 1, {
+                pack_kv_str(pk, "phase", resp->result.phase);
+                pack_kv_str(pk, "did", resp->result.did);
+                pack_kv_str(pk, "transaction_payload", resp->result.tsx_payload);
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_imp_did_resp(const ImpDIDResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 2, {
-            pack_kv_str(pk, "did", resp->result.did);
-            pack_kv_str(pk, "transaction_payload", resp->result.tsx_payload);
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 2, {
+                pack_kv_str(pk, "did", resp->result.did);
+                pack_kv_str(pk, "transaction_payload", resp->result.tsx_payload);
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_iss_vc_resp(const IssVCResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_nil(pk, "result");
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_nil(pk, "result");
+        });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_update_vc_resp(const UpdateVCResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_nil(pk, "result");
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_nil(pk, "result");
+        });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_signin_req_chal_resp(const SigninReqChalResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
-
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", resp->result.vc ? 3 : 2, {
-            pack_kv_bool(pk, "credential_required", resp->result.vc_req);
-            pack_kv_str(pk, "jws", resp->result.jws);
-            pack_kv_str(pk, "credential", resp->result.vc);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
+
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", resp->result.vc ? 3 : 2, {
+                pack_kv_bool(pk, "credential_required", resp->result.vc_req);
+                pack_kv_str(pk, "jws", resp->result.jws);
+                pack_kv_str(pk, "credential", resp->result.vc);
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_signin_conf_chal_resp(const SigninConfChalResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 2, {
-            pack_kv_str(pk, "access_token", resp->result.tk);
-            pack_kv_u64(pk, "exp", resp->result.exp);
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 2, {
+                pack_kv_str(pk, "access_token", resp->result.tk);
+                pack_kv_u64(pk, "exp", resp->result.exp);
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_err_resp(const ErrResp *resp)
@@ -3954,967 +4154,853 @@ Marshalled *rpc_marshal_err_resp(const ErrResp *resp)
 
 Marshalled *rpc_marshal_create_chan_resp(const CreateChanResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 1, {
-            pack_kv_u64(pk, "id", resp->result.id);
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 1, {
+                pack_kv_u64(pk, "id", resp->result.id);
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_upd_chan_resp(const UpdChanResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_nil(pk, "result");
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_nil(pk, "result");
+        });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_upd_user_info_resp(const UpdUserInfoResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_nil(pk, "result");
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_nil(pk, "result");
+        });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_pub_post_resp(const PubPostResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 1, {
-            pack_kv_u64(pk, "id", resp->result.id);
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 1, {
+                pack_kv_u64(pk, "id", resp->result.id);
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_declare_post_resp(const DeclarePostResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 1, {
-            pack_kv_u64(pk, "id", resp->result.id);
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 1, {
+                pack_kv_u64(pk, "id", resp->result.id);
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_notify_post_resp(const NotifyPostResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_nil(pk, "result");
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_nil(pk, "result");
+        });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_edit_post_resp(const EditPostResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_nil(pk, "result");
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_nil(pk, "result");
+        });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_del_post_resp(const DelPostResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_nil(pk, "result");
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_nil(pk, "result");
+        });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_post_cmt_resp(const PostCmtResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 1, {
-            pack_kv_u64(pk, "id", resp->result.id);
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 1, {
+                pack_kv_u64(pk, "id", resp->result.id);
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_edit_cmt_resp(const EditCmtResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_nil(pk, "result");
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_nil(pk, "result");
+        });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_del_cmt_resp(const DelCmtResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_nil(pk, "result");
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_nil(pk, "result");
+        });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_block_cmt_resp(const BlockCmtResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_nil(pk, "result");
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_nil(pk, "result");
+        });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_unblock_cmt_resp(const UnblockCmtResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_nil(pk, "result");
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_nil(pk, "result");
+        });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_post_like_resp(const PostLikeResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_nil(pk, "result");
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_nil(pk, "result");
+        });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_post_unlike_resp(const PostUnlikeResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_nil(pk, "result");
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_nil(pk, "result");
+        });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_get_my_chans_resp(const GetMyChansResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
     ChanInfo **cinfo;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 2, {
-            pack_kv_bool(pk, "is_last", resp->result.is_last);
-            pack_kv_arr(pk, "channels", cvector_size(resp->result.cinfos), {
-                cvector_foreach(resp->result.cinfos, cinfo) {
-                    pack_map(pk, 5, {
-                        pack_kv_u64(pk, "id", (*cinfo)->chan_id);
-                        pack_kv_str(pk, "name", (*cinfo)->name);
-                        pack_kv_str(pk, "introduction", (*cinfo)->intro);
-                        pack_kv_u64(pk, "subscribers", (*cinfo)->subs);
-                        pack_kv_bin(pk, "avatar", (*cinfo)->avatar, (*cinfo)->len);
-                    });
-                }
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 3, {
+                pack_kv_bool(pk, "is_last", resp->result.is_last);
+                pack_kv_arr(pk, "channels", cvector_size(resp->result.cinfos), {
+                    cvector_foreach(resp->result.cinfos, cinfo) {
+                        pack_map(pk, 5, {
+                            pack_kv_u64(pk, "id", (*cinfo)->chan_id);
+                            pack_kv_str(pk, "name", (*cinfo)->name);
+                            pack_kv_str(pk, "introduction", (*cinfo)->intro);
+                            pack_kv_u64(pk, "subscribers", (*cinfo)->subs);
+                            pack_kv_chan_avatar(pk, *cinfo);
+                        });
+                    }
+                });
+                pack_kv_cursor(pk, "next_cursor",
+                               resp->result.is_last ? &resp->result.next : NULL);
             });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_get_my_chans_meta_resp(const GetMyChansMetaResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
     ChanInfo **cinfo;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_arr(pk, "result", cvector_size(resp->result.cinfos), {
-            cvector_foreach(resp->result.cinfos, cinfo) {
-                pack_map(pk, 2, {
-                    pack_kv_u64(pk, "id", (*cinfo)->chan_id);
-                    pack_kv_u64(pk, "subscribers", (*cinfo)->subs);
-                });
-            }
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_arr(pk, "result", cvector_size(resp->result.cinfos), {
+                cvector_foreach(resp->result.cinfos, cinfo) {
+                    pack_map(pk, 2, {
+                        pack_kv_u64(pk, "id", (*cinfo)->chan_id);
+                        pack_kv_u64(pk, "subscribers", (*cinfo)->subs);
+                    });
+                }
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_get_chans_resp(const GetChansResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
     ChanInfo **cinfo;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 2, {
-            pack_kv_bool(pk, "is_last", resp->result.is_last);
-            pack_kv_arr(pk, "channels", cvector_size(resp->result.cinfos), {
-                cvector_foreach(resp->result.cinfos, cinfo) {
-                    pack_map(pk, 11, {
-                        pack_kv_u64(pk, "id", (*cinfo)->chan_id);
-                        pack_kv_str(pk, "name", (*cinfo)->name);
-                        pack_kv_str(pk, "introduction", (*cinfo)->intro);
-                        pack_kv_str(pk, "owner_name", (*cinfo)->owner->name);
-                        pack_kv_str(pk, "owner_did", (*cinfo)->owner->did);
-                        pack_kv_u64(pk, "subscribers", (*cinfo)->subs);
-                        pack_kv_u64(pk, "last_update", (*cinfo)->upd_at);
-                        pack_kv_bin(pk, "avatar", (*cinfo)->avatar, (*cinfo)->len);
-                        pack_kv_str(pk, "tip_methods", (*cinfo)->tip_methods);  //2.0
-                        pack_kv_str(pk, "proof", (*cinfo)->proof);  //2.0
-                        pack_kv_u64(pk, "status", (*cinfo)->status);  //2.0
-                    });
-                }
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 3, {
+                pack_kv_bool(pk, "is_last", resp->result.is_last);
+                pack_kv_arr(pk, "channels", cvector_size(resp->result.cinfos), {
+                    cvector_foreach(resp->result.cinfos, cinfo) {
+                        pack_map(pk, 11, {
+                            pack_kv_u64(pk, "id", (*cinfo)->chan_id);
+                            pack_kv_str(pk, "name", (*cinfo)->name);
+                            pack_kv_str(pk, "introduction", (*cinfo)->intro);
+                            pack_kv_str(pk, "owner_name", (*cinfo)->owner->name);
+                            pack_kv_str(pk, "owner_did", (*cinfo)->owner->did);
+                            pack_kv_u64(pk, "subscribers", (*cinfo)->subs);
+                            pack_kv_u64(pk, "last_update", (*cinfo)->upd_at);
+                            pack_kv_chan_avatar(pk, *cinfo);
+                            pack_kv_str(pk, "tip_methods", (*cinfo)->tip_methods);  //2.0
+                            pack_kv_str(pk, "proof", (*cinfo)->proof);  //2.0
+                            pack_kv_u64(pk, "status", (*cinfo)->status);  //2.0
+                        });
+                    }
+                });
+                pack_kv_cursor(pk, "next_cursor",
+                               resp->result.is_last ? &resp->result.next : NULL);
             });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_get_chan_dtl_resp(const GetChanDtlResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
-
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 8, {
-            pack_kv_u64(pk, "id", resp->result.cinfo->chan_id);
-            pack_kv_str(pk, "name", resp->result.cinfo->name);
-            pack_kv_str(pk, "introduction", resp->result.cinfo->intro);
-            pack_kv_str(pk, "owner_name", resp->result.cinfo->owner->name);
-            pack_kv_str(pk, "owner_did", resp->result.cinfo->owner->did);
-            pack_kv_u64(pk, "subscribers", resp->result.cinfo->subs);
-            pack_kv_u64(pk, "last_update", resp->result.cinfo->upd_at);
-            pack_kv_bin(pk, "avatar", resp->result.cinfo->avatar, resp->result.cinfo->len);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
+
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 8, {
+                pack_kv_u64(pk, "id", resp->result.cinfo->chan_id);
+                pack_kv_str(pk, "name", resp->result.cinfo->name);
+                pack_kv_str(pk, "introduction", resp->result.cinfo->intro);
+                pack_kv_str(pk, "owner_name", resp->result.cinfo->owner->name);
+                pack_kv_str(pk, "owner_did", resp->result.cinfo->owner->did);
+                pack_kv_u64(pk, "subscribers", resp->result.cinfo->subs);
+                pack_kv_u64(pk, "last_update", resp->result.cinfo->upd_at);
+                pack_kv_chan_avatar(pk, resp->result.cinfo);
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_get_sub_chans_resp(const GetSubChansResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
     ChanInfo **cinfo;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 2, {
-            pack_kv_bool(pk, "is_last", resp->result.is_last);
-            pack_kv_arr(pk, "channels", cvector_size(resp->result.cinfos), {
-                cvector_foreach(resp->result.cinfos, cinfo) {
-                    pack_map(pk, 10, {
-                        pack_kv_u64(pk, "id", (*cinfo)->chan_id);
-                        pack_kv_str(pk, "name", (*cinfo)->name);
-                        pack_kv_str(pk, "introduction", (*cinfo)->intro);
-                        pack_kv_str(pk, "owner_name", (*cinfo)->owner->name);
-                        pack_kv_str(pk, "owner_did", (*cinfo)->owner->did);
-                        pack_kv_u64(pk, "subscribers", (*cinfo)->subs);
-                        pack_kv_u64(pk, "last_update", (*cinfo)->upd_at);
-                        pack_kv_bin(pk, "avatar", (*cinfo)->avatar, (*cinfo)->len);
-                        pack_kv_str(pk, "proof", (*cinfo)->proof);
-                        pack_kv_u64(pk, "created_at", (*cinfo)->created_at);
-                    });
-                }
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 3, {
+                pack_kv_bool(pk, "is_last", resp->result.is_last);
+                pack_kv_arr(pk, "channels", cvector_size(resp->result.cinfos), {
+                    cvector_foreach(resp->result.cinfos, cinfo) {
+                        pack_map(pk, 10, {
+                            pack_kv_u64(pk, "id", (*cinfo)->chan_id);
+                            pack_kv_str(pk, "name", (*cinfo)->name);
+                            pack_kv_str(pk, "introduction", (*cinfo)->intro);
+                            pack_kv_str(pk, "owner_name", (*cinfo)->owner->name);
+                            pack_kv_str(pk, "owner_did", (*cinfo)->owner->did);
+                            pack_kv_u64(pk, "subscribers", (*cinfo)->subs);
+                            pack_kv_u64(pk, "last_update", (*cinfo)->upd_at);
+                            pack_kv_chan_avatar(pk, *cinfo);
+                            pack_kv_str(pk, "proof", (*cinfo)->proof);
+                            pack_kv_u64(pk, "created_at", (*cinfo)->created_at);
+                        });
+                    }
+                });
+                pack_kv_cursor(pk, "next_cursor",
+                               resp->result.is_last ? &resp->result.next : NULL);
             });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_get_posts_resp(const GetPostsResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
     PostInfo **pinfo;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 2, {
-            pack_kv_bool(pk, "is_last", resp->result.is_last);
-            pack_kv_arr(pk, "posts", cvector_size(resp->result.pinfos), {
-                cvector_foreach(resp->result.pinfos, pinfo) {
-                    pack_map(pk, 12, {
-                        pack_kv_u64(pk, "channel_id", (*pinfo)->chan_id);
-                        pack_kv_u64(pk, "id", (*pinfo)->post_id);
-                        pack_kv_u64(pk, "status", (*pinfo)->stat);
-                        (*pinfo)->stat == POST_DELETED ? pack_kv_nil(pk, "content") :
-                            pack_kv_bin(pk, "content", (*pinfo)->content, (*pinfo)->con_len);
-                        pack_kv_u64(pk, "comments", (*pinfo)->cmts);
-                        pack_kv_u64(pk, "likes", (*pinfo)->likes);
-                        pack_kv_u64(pk, "created_at", (*pinfo)->created_at);
-                        pack_kv_u64(pk, "updated_at", (*pinfo)->upd_at);
-                        (*pinfo)->stat == POST_DELETED ? pack_kv_nil(pk, "thumbnails") :  //2.0
-                            pack_kv_bin(pk, "thumbnails", (*pinfo)->thumbnails, (*pinfo)->thu_len);
-                        pack_kv_str(pk, "hash_id", (*pinfo)->hash_id);  //2.0
-                        pack_kv_str(pk, "proof", (*pinfo)->proof);  //2.0
-                        pack_kv_str(pk, "origin_post_url", (*pinfo)->origin_post_url);  //2.0
-                    });
-                }
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 3, {
+                pack_kv_bool(pk, "is_last", resp->result.is_last);
+                pack_kv_arr(pk, "posts", cvector_size(resp->result.pinfos), {
+                    cvector_foreach(resp->result.pinfos, pinfo) {
+                        pack_map(pk, 12 - omitted_cnt(resp->result.omit), {
+                            pack_kv_u64(pk, "channel_id", (*pinfo)->chan_id);
+                            pack_kv_u64(pk, "id", (*pinfo)->post_id);
+                            pack_kv_u64(pk, "status", (*pinfo)->stat);
+                            if (!qry_omits(resp->result.omit, QRY_FLD_CONTENT))
+                                (*pinfo)->stat == POST_DELETED ? pack_kv_nil(pk, "content") :
+                                    pack_kv_bin(pk, "content", (*pinfo)->content, (*pinfo)->con_len);
+                            pack_kv_u64(pk, "comments", (*pinfo)->cmts);
+                            pack_kv_u64(pk, "likes", (*pinfo)->likes);
+                            pack_kv_u64(pk, "created_at", (*pinfo)->created_at);
+                            pack_kv_u64(pk, "updated_at", (*pinfo)->upd_at);
+                            if (!qry_omits(resp->result.omit, QRY_FLD_THUMBNAILS))
+                                (*pinfo)->stat == POST_DELETED ? pack_kv_nil(pk, "thumbnails") :  //2.0
+                                    pack_kv_bin(pk, "thumbnails", (*pinfo)->thumbnails, (*pinfo)->thu_len);
+                            pack_kv_str(pk, "hash_id", (*pinfo)->hash_id);  //2.0
+                            pack_kv_str(pk, "proof", (*pinfo)->proof);  //2.0
+                            pack_kv_str(pk, "origin_post_url", (*pinfo)->origin_post_url);  //2.0
+                        });
+                    }
+                });
+                pack_kv_cursor(pk, "next_cursor",
+                               resp->result.is_last ? &resp->result.next : NULL);
             });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_get_posts_lac_resp(const GetPostsLACResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
     PostInfo **pinfo;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 1, {
-            pack_kv_arr(pk, "posts", cvector_size(resp->result.pinfos), {
-                cvector_foreach(resp->result.pinfos, pinfo) {
-                    pack_map(pk, 4, {
-                        pack_kv_u64(pk, "channel_id", (*pinfo)->chan_id);
-                        pack_kv_u64(pk, "post_id", (*pinfo)->post_id);
-                        pack_kv_u64(pk, "comments", (*pinfo)->cmts);
-                        pack_kv_u64(pk, "likes", (*pinfo)->likes);
-                    });
-                }
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 2, {
+                pack_kv_arr(pk, "posts", cvector_size(resp->result.pinfos), {
+                    cvector_foreach(resp->result.pinfos, pinfo) {
+                        pack_map(pk, 4, {
+                            pack_kv_u64(pk, "channel_id", (*pinfo)->chan_id);
+                            pack_kv_u64(pk, "post_id", (*pinfo)->post_id);
+                            pack_kv_u64(pk, "comments", (*pinfo)->cmts);
+                            pack_kv_u64(pk, "likes", (*pinfo)->likes);
+                        });
+                    }
+                });
+                pack_kv_cursor(pk, "next_cursor", &resp->result.next);
             });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_get_liked_posts_resp(const GetLikedPostsResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
     PostInfo **pinfo;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 2, {
-            pack_kv_bool(pk, "is_last", resp->result.is_last);
-            pack_kv_arr(pk, "posts", cvector_size(resp->result.pinfos), {
-                cvector_foreach(resp->result.pinfos, pinfo) {
-                    pack_map(pk, 6, {
-                        pack_kv_u64(pk, "channel_id", (*pinfo)->chan_id);
-                        pack_kv_u64(pk, "id", (*pinfo)->post_id);
-                        pack_kv_bin(pk, "content", (*pinfo)->content, (*pinfo)->con_len);
-                        pack_kv_u64(pk, "comments", (*pinfo)->cmts);
-                        pack_kv_u64(pk, "likes", (*pinfo)->likes);
-                        pack_kv_u64(pk, "created_at", (*pinfo)->created_at);
-                    });
-                }
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 3, {
+                pack_kv_bool(pk, "is_last", resp->result.is_last);
+                pack_kv_arr(pk, "posts", cvector_size(resp->result.pinfos), {
+                    cvector_foreach(resp->result.pinfos, pinfo) {
+                        pack_map(pk, 6, {
+                            pack_kv_u64(pk, "channel_id", (*pinfo)->chan_id);
+                            pack_kv_u64(pk, "id", (*pinfo)->post_id);
+                            pack_kv_bin(pk, "content", (*pinfo)->content, (*pinfo)->con_len);
+                            pack_kv_u64(pk, "comments", (*pinfo)->cmts);
+                            pack_kv_u64(pk, "likes", (*pinfo)->likes);
+                            pack_kv_u64(pk, "created_at", (*pinfo)->created_at);
+                        });
+                    }
+                });
+                pack_kv_cursor(pk, "next_cursor",
+                               resp->result.is_last ? &resp->result.next : NULL);
             });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_get_liked_data_resp(const GetLikedDataResp *resp)  //2.0
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
     LikeInfo **linfo;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 2, {
-            pack_kv_bool(pk, "is_last", resp->result.is_last);
-            pack_kv_arr(pk, "liked", cvector_size(resp->result.linfos), {
-                cvector_foreach(resp->result.linfos, linfo) {
-                    pack_map(pk, 7, {
-                        pack_kv_u64(pk, "channel_id", (*linfo)->chan_id);
-                        pack_kv_u64(pk, "post_id", (*linfo)->post_id);
-                        pack_kv_u64(pk, "comment_id", (*linfo)->cmt_id);
-                        pack_kv_str(pk, "user_did", (*linfo)->user.did);
-                        pack_kv_str(pk, "user_name", (*linfo)->user.name);
-                        pack_kv_u64(pk, "created_at", (*linfo)->created_at);
-                        pack_kv_str(pk, "proof", (*linfo)->proof);
-                    });
-                }
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 3, {
+                pack_kv_bool(pk, "is_last", resp->result.is_last);
+                pack_kv_arr(pk, "liked", cvector_size(resp->result.linfos), {
+                    cvector_foreach(resp->result.linfos, linfo) {
+                        pack_map(pk, 7, {
+                            pack_kv_u64(pk, "channel_id", (*linfo)->chan_id);
+                            pack_kv_u64(pk, "post_id", (*linfo)->post_id);
+                            pack_kv_u64(pk, "comment_id", (*linfo)->cmt_id);
+                            pack_kv_str(pk, "user_did", (*linfo)->user.did);
+                            pack_kv_str(pk, "user_name", (*linfo)->user.name);
+                            pack_kv_u64(pk, "created_at", (*linfo)->created_at);
+                            pack_kv_str(pk, "proof", (*linfo)->proof);
+                        });
+                    }
+                });
+                pack_kv_cursor(pk, "next_cursor",
+                               resp->result.is_last ? &resp->result.next : NULL);
             });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_get_cmts_resp(const GetCmtsResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
     CmtInfo **cinfo;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 2, {
-            pack_kv_bool(pk, "is_last", resp->result.is_last);
-            pack_kv_arr(pk, "comments", cvector_size(resp->result.cinfos), {
-                cvector_foreach(resp->result.cinfos, cinfo) {
-                    pack_map(pk, 14, {
-                        pack_kv_u64(pk, "channel_id", (*cinfo)->chan_id);
-                        pack_kv_u64(pk, "post_id", (*cinfo)->post_id);
-                        pack_kv_u64(pk, "id", (*cinfo)->cmt_id);
-                        pack_kv_u64(pk, "status", (*cinfo)->stat);
-                        pack_kv_u64(pk, "comment_id", (*cinfo)->reply_to_cmt);
-                        pack_kv_str(pk, "user_did", (*cinfo)->user.did);
-                        pack_kv_str(pk, "user_name", (*cinfo)->user.name);
-                        (*cinfo)->stat == CMT_AVAILABLE ? pack_kv_bin(pk, "content", (*cinfo)->content, (*cinfo)->con_len) :
-                                                          pack_kv_nil(pk, "content");
-                        pack_kv_u64(pk, "likes", (*cinfo)->likes);
-                        pack_kv_u64(pk, "created_at", (*cinfo)->created_at);
-                        pack_kv_u64(pk, "updated_at", (*cinfo)->upd_at);
-                        (*cinfo)->stat == CMT_AVAILABLE ? pack_kv_bin(pk, "thumbnails", (*cinfo)->thumbnails, (*cinfo)->thu_len) :
-                                                          pack_kv_nil(pk, "thumbnails");  //2.0
-                        pack_kv_str(pk, "hash_id", (*cinfo)->hash_id);  //2.0
-                        pack_kv_str(pk, "proof", (*cinfo)->proof);  //2.0
-                    });
-                }
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 3, {
+                pack_kv_bool(pk, "is_last", resp->result.is_last);
+                pack_kv_arr(pk, "comments", cvector_size(resp->result.cinfos), {
+                    cvector_foreach(resp->result.cinfos, cinfo) {
+                        pack_map(pk, 14 - omitted_cnt(resp->result.omit), {
+                            pack_kv_u64(pk, "channel_id", (*cinfo)->chan_id);
+                            pack_kv_u64(pk, "post_id", (*cinfo)->post_id);
+                            pack_kv_u64(pk, "id", (*cinfo)->cmt_id);
+                            pack_kv_u64(pk, "status", (*cinfo)->stat);
+                            pack_kv_u64(pk, "comment_id", (*cinfo)->reply_to_cmt);
+                            pack_kv_str(pk, "user_did", (*cinfo)->user.did);
+                            pack_kv_str(pk, "user_name", (*cinfo)->user.name);
+                            if (!qry_omits(resp->result.omit, QRY_FLD_CONTENT))
+                                (*cinfo)->stat == CMT_AVAILABLE ? pack_kv_bin(pk, "content", (*cinfo)->content, (*cinfo)->con_len) :
+                                                                  pack_kv_nil(pk, "content");
+                            pack_kv_u64(pk, "likes", (*cinfo)->likes);
+                            pack_kv_u64(pk, "created_at", (*cinfo)->created_at);
+                            pack_kv_u64(pk, "updated_at", (*cinfo)->upd_at);
+                            if (!qry_omits(resp->result.omit, QRY_FLD_THUMBNAILS))
+                                (*cinfo)->stat == CMT_AVAILABLE ? pack_kv_bin(pk, "thumbnails", (*cinfo)->thumbnails, (*cinfo)->thu_len) :
+                                                                  pack_kv_nil(pk, "thumbnails");  //2.0
+                            pack_kv_str(pk, "hash_id", (*cinfo)->hash_id);  //2.0
+                            pack_kv_str(pk, "proof", (*cinfo)->proof);  //2.0
+                        });
+                    }
+                });
+                pack_kv_cursor(pk, "next_cursor",
+                               resp->result.is_last ? &resp->result.next : NULL);
             });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_get_cmts_likes_resp(const GetCmtsLikesResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
     CmtInfo **cinfo;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 1, {
-            pack_kv_arr(pk, "comments", cvector_size(resp->result.cinfos), {
-                cvector_foreach(resp->result.cinfos, cinfo) {
-                    pack_map(pk, 4, {
-                        pack_kv_u64(pk, "channel_id", (*cinfo)->chan_id);
-                        pack_kv_u64(pk, "post_id", (*cinfo)->post_id);
-                        pack_kv_u64(pk, "id", (*cinfo)->cmt_id);
-                        pack_kv_u64(pk, "likes", (*cinfo)->likes);
-                    });
-                }
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 2, {
+                pack_kv_arr(pk, "comments", cvector_size(resp->result.cinfos), {
+                    cvector_foreach(resp->result.cinfos, cinfo) {
+                        pack_map(pk, 4, {
+                            pack_kv_u64(pk, "channel_id", (*cinfo)->chan_id);
+                            pack_kv_u64(pk, "post_id", (*cinfo)->post_id);
+                            pack_kv_u64(pk, "id", (*cinfo)->cmt_id);
+                            pack_kv_u64(pk, "likes", (*cinfo)->likes);
+                        });
+                    }
+                });
+                pack_kv_cursor(pk, "next_cursor", &resp->result.next);
             });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_get_stats_resp(const GetStatsResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
-
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 3, {
-            pack_kv_str(pk, "did", resp->result.did);
-            pack_kv_u64(pk, "connecting_clients", resp->result.conn_cs);
-            pack_kv_u64(pk, "total_clients", resp->result.total_cs);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
+
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 7, {
+                pack_kv_str(pk, "did", resp->result.did);
+                pack_kv_u64(pk, "connecting_clients", resp->result.conn_cs);
+                pack_kv_u64(pk, "total_clients", resp->result.total_cs);
+                pack_kv_u64(pk, "cancelled_requests", resp->result.cancelled_reqs);
+                pack_kv_u64(pk, "accepted_requests", resp->result.accepted_reqs);
+                pack_kv_u64(pk, "throttled_requests", resp->result.throttled_reqs);
+                pack_kv_u64(pk, "shed_requests", resp->result.shed_reqs);
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_sub_chan_resp(const SubChanResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
-
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "2.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 12, {
-            pack_kv_bool(pk, "is_last", resp->result.is_last);
-            pack_kv_u64(pk, "id", resp->result.cinfo->chan_id);
-            pack_kv_str(pk, "name", resp->result.cinfo->name);
-            pack_kv_str(pk, "introduction", resp->result.cinfo->intro);
-            pack_kv_str(pk, "owner_name", resp->result.cinfo->owner->name);
-            pack_kv_str(pk, "owner_did", resp->result.cinfo->owner->did);
-            pack_kv_u64(pk, "subscribers", resp->result.cinfo->subs);
-            pack_kv_u64(pk, "last_update", resp->result.cinfo->upd_at);
-            pack_kv_bin(pk, "avatar", resp->result.cinfo->avatar, resp->result.cinfo->len);
-            pack_kv_str(pk, "tip_methods", resp->result.cinfo->tip_methods);
-            pack_kv_str(pk, "proof", resp->result.cinfo->proof);
-            pack_kv_u64(pk, "status", resp->result.cinfo->status);
-        });
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
+
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "2.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 12, {
+                pack_kv_bool(pk, "is_last", resp->result.is_last);
+                pack_kv_u64(pk, "id", resp->result.cinfo->chan_id);
+                pack_kv_str(pk, "name", resp->result.cinfo->name);
+                pack_kv_str(pk, "introduction", resp->result.cinfo->intro);
+                pack_kv_str(pk, "owner_name", resp->result.cinfo->owner->name);
+                pack_kv_str(pk, "owner_did", resp->result.cinfo->owner->did);
+                pack_kv_u64(pk, "subscribers", resp->result.cinfo->subs);
+                pack_kv_u64(pk, "last_update", resp->result.cinfo->upd_at);
+                pack_kv_chan_avatar(pk, resp->result.cinfo);
+                pack_kv_str(pk, "tip_methods", resp->result.cinfo->tip_methods);
+                pack_kv_str(pk, "proof", resp->result.cinfo->proof);
+                pack_kv_u64(pk, "status", resp->result.cinfo->status);
+            });
 
+        });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_unsub_chan_resp(const UnsubChanResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_nil(pk, "result");
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_nil(pk, "result");
+        });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_enbl_notif_resp(const EnblNotifResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_nil(pk, "result");
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_nil(pk, "result");
+        });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_get_srv_ver_resp(const GetSrvVerResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 2, {
-            pack_kv_str(pk, "version", resp->result.version);
-            pack_kv_i64(pk, "version_code", resp->result.version_code);
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 2, {
+                pack_kv_str(pk, "version", resp->result.version);
+                pack_kv_i64(pk, "version_code", resp->result.version_code);
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_report_illegal_cmt_resp(const ReportIllegalCmtResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_nil(pk, "result");
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_nil(pk, "result");
+        });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_get_reported_cmts_resp(const GetReportedCmtsResp *resp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
     ReportedCmtInfo **rcinfo;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", resp->tsx_id);
-        pack_kv_map(pk, "result", 2, {
-            pack_kv_bool(pk, "is_last", resp->result.is_last);
-            pack_kv_arr(pk, "comments", cvector_size(resp->result.rcinfos), {
-                cvector_foreach(resp->result.rcinfos, rcinfo) {
-                    pack_map(pk, 11, {
-                        pack_kv_u64(pk, "channel_id", (*rcinfo)->chan_id);
-                        pack_kv_u64(pk, "post_id", (*rcinfo)->post_id);
-                        pack_kv_u64(pk, "comment_id", (*rcinfo)->cmt_id);
-                        pack_kv_str(pk, "reporter_name", (*rcinfo)->reporter.name);
-                        pack_kv_str(pk, "reporter_did", (*rcinfo)->reporter.did);
-                        pack_kv_str(pk, "reasons", (*rcinfo)->reasons);
-                        pack_kv_u64(pk, "created_at", (*rcinfo)->created_at);
-                    });
-                }
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", resp->tsx_id);
+            pack_kv_map(pk, "result", 3, {
+                pack_kv_bool(pk, "is_last", resp->result.is_last);
+                pack_kv_arr(pk, "comments", cvector_size(resp->result.rcinfos), {
+                    cvector_foreach(resp->result.rcinfos, rcinfo) {
+                        pack_map(pk, 11, {
+                            pack_kv_u64(pk, "channel_id", (*rcinfo)->chan_id);
+                            pack_kv_u64(pk, "post_id", (*rcinfo)->post_id);
+                            pack_kv_u64(pk, "comment_id", (*rcinfo)->cmt_id);
+                            pack_kv_str(pk, "reporter_name", (*rcinfo)->reporter.name);
+                            pack_kv_str(pk, "reporter_did", (*rcinfo)->reporter.did);
+                            pack_kv_str(pk, "reasons", (*rcinfo)->reasons);
+                            pack_kv_u64(pk, "created_at", (*rcinfo)->created_at);
+                        });
+                    }
+                });
+                pack_kv_cursor(pk, "next_cursor",
+                               resp->result.is_last ? &resp->result.next : NULL);
             });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_set_binary_resp(const Resp *resp)
 {
     SetBinaryResp *wrap_resp = (SetBinaryResp*)resp;
 
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", wrap_resp->tsx_id);
-        pack_kv_map(pk, "result", 1, {
-            pack_kv_str(pk, "key", wrap_resp->result.key);
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", wrap_resp->tsx_id);
+            pack_kv_map(pk, "result", 1, {
+                pack_kv_str(pk, "key", wrap_resp->result.key);
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 Marshalled *rpc_marshal_get_binary_resp(const Resp *resp)
 {
     GetBinaryResp *wrap_resp = (GetBinaryResp*)resp;
 
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
-
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", wrap_resp->tsx_id);
-        pack_kv_map(pk, "result", 4, {
-            pack_kv_str(pk, "key", wrap_resp->result.key);
-            pack_kv_str(pk, "algo", wrap_resp->result.algo);
-            pack_kv_str(pk, "checksum", wrap_resp->result.checksum);
-            pack_kv_bin_withzero(pk, "content", wrap_resp->result.content, wrap_resp->result.content_sz);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
+
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", wrap_resp->tsx_id);
+            pack_kv_map(pk, "result", 4, {
+                pack_kv_str(pk, "key", wrap_resp->result.key);
+                pack_kv_str(pk, "algo", wrap_resp->result.algo);
+                pack_kv_str(pk, "checksum", wrap_resp->result.checksum);
+                pack_kv_bin_withzero(pk, "content", wrap_resp->result.content, wrap_resp->result.content_sz);
+            });
         });
     });
     deref(wrap_resp->result.content);
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 typedef Marshalled *RespHdlr(const Resp *resp);
@@ -4948,26 +5034,22 @@ Marshalled *rpc_marshal_resp(const char* method, const Resp *resp)
 
 Marshalled *rpc_marshal_err(uint64_t tsx_id, int64_t errcode, const char *errdesp)
 {
-    msgpack_sbuffer *buf = msgpack_sbuffer_new();
-    msgpack_packer *pk = msgpack_packer_new(buf, msgpack_sbuffer_write);
-    MarshalledIntl *m = rc_zalloc(sizeof(MarshalledIntl), mintl_dtor);
+    uint64_t trace_at = reqtrace_mark();
+    Marshalled *m;
 
-    pack_map(pk, 3, {
-        pack_kv_str(pk, "version", "1.0");
-        pack_kv_u64(pk, "id", tsx_id);
-        pack_kv_map(pk, "error", 2, {
-            pack_kv_i64(pk, "code", errcode);
-            pack_kv_str(pk, "message", errdesp);
+    marshal_packs(m, pk, {
+        pack_map(pk, 3, {
+            pack_kv_str(pk, "version", "1.0");
+            pack_kv_u64(pk, "id", tsx_id);
+            pack_kv_map(pk, "error", 2, {
+                pack_kv_i64(pk, "code", errcode);
+                pack_kv_str(pk, "message", errdesp);
+            });
         });
     });
 
-    m->m.data = buf->data;
-    m->m.sz   = buf->size;
-    m->buf    = buf;
-
-    msgpack_packer_free(pk);
-
-    return &m->m;
+    reqtrace_stage(TRACE_MARSHAL, trace_at);
+    return m;
 }
 
 int get_rpc_version(void)
@@ -400,6 +400,7 @@ typedef struct {
     struct {
         bool is_last;
         cvector_vector_type(ChanInfo *) cinfos;
+        QryCursor next;
     } result;
 } GetMyChansResp;
 
@@ -433,6 +434,7 @@ typedef struct {
     struct {
         bool is_last;
         cvector_vector_type(ChanInfo *) cinfos;
+        QryCursor next;
     } result;
 } GetChansResp;
 
@@ -466,6 +468,7 @@ typedef struct {
     struct {
         bool is_last;
         cvector_vector_type(ChanInfo *) cinfos;
+        QryCursor next;
     } result;
 } GetSubChansResp;
 
@@ -484,6 +487,8 @@ typedef struct {
     struct {
         bool is_last;
         cvector_vector_type(PostInfo *) pinfos;
+        QryCursor next;
+        uint64_t omit;
     } result;
 } GetPostsResp;
 
@@ -501,6 +506,7 @@ typedef struct {
     uint64_t tsx_id;
     struct {
         cvector_vector_type(PostInfo *) pinfos;
+        QryCursor next;
     } result;
 } GetPostsLACResp;
 
@@ -518,6 +524,7 @@ typedef struct {
     struct {
         bool is_last;
         cvector_vector_type(PostInfo *) pinfos;
+        QryCursor next;
     } result;
 } GetLikedPostsResp;
 
@@ -535,6 +542,7 @@ typedef struct {  //2.0
     struct {
         bool is_last;
         cvector_vector_type(LikeInfo *) linfos;
+        QryCursor next;
     } result;
 } GetLikedDataResp;
 
@@ -554,6 +562,8 @@ typedef struct {
     struct {
         bool is_last;
         cvector_vector_type(CmtInfo *) cinfos;
+        QryCursor next;
+        uint64_t omit;
     } result;
 } GetCmtsResp;
 
@@ -572,6 +582,7 @@ typedef struct {
     uint64_t tsx_id;
     struct {
         cvector_vector_type(CmtInfo *) cinfos;
+        QryCursor next;
     } result;
 } GetCmtsLikesResp;
 
@@ -589,6 +600,10 @@ typedef struct {
         char    *did;
         uint64_t conn_cs;
         uint64_t total_cs;
+        uint64_t cancelled_reqs;
+        uint64_t accepted_reqs;
+        uint64_t throttled_reqs;
+        uint64_t shed_reqs;
     } result;
 } GetStatsResp;
 
@@ -681,6 +696,7 @@ typedef struct {
     struct {
         bool is_last;
         cvector_vector_type(ReportedCmtInfo *) rcinfos;
+        QryCursor next;
     } result;
 } GetReportedCmtsResp;
 
@@ -842,6 +858,11 @@ typedef struct {
 } Marshalled;
 
 int rpc_unmarshal_req(const void *rpc, size_t len, Req **req);
+
+#define RPC_CURSOR_LEN 64
+
+int rpc_encode_cursor(const QryCursor *cur, char *buf, size_t sz);
+int rpc_decode_cursor(const char *str, size_t len, QryCursor *cur);
 Marshalled *rpc_marshal_err(uint64_t tsx_id, int64_t errcode, const char *errdesp);
 
 Marshalled *rpc_marshal_new_post_notif(const NewPostNotif *notif);
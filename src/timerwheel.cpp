@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2020 trinity-tech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <crystal.h>
+
+#include "timerwheel.h"
+
+#define TAG_TIMER "[Feedsd.Timer]: "
+
+#define TIMER_TICK_MS 100
+#define WHEEL_BITS    6
+#define WHEEL_SLOTS   (1 << WHEEL_BITS)
+#define WHEEL_MASK    (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS  4
+// about 19 days at 100ms a tick, longer delays are re-placed on cascade.
+#define WHEEL_SPAN    (1ULL << (WHEEL_BITS * WHEEL_LEVELS))
+
+struct Timer {
+    Timer *prev;
+    Timer *next;
+    uint64_t expires;
+    uint64_t gen;
+    bool armed;
+    TimerCallback *cb;
+    void *context;
+};
+
+typedef struct {
+    Timer *timer;
+    uint64_t gen;
+} DueTimer;
+
+// slot lists are circular with a sentinel head, level l of the wheel holds
+// the timers due in [64^l, 64^(l+1)) ticks, indexed by bits of the deadline.
+static Timer wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static uint64_t next_tick;
+static std::chrono::steady_clock::time_point epoch;
+static std::mutex mutex;
+
+static
+uint64_t current_tick(void)
+{
+    auto elapsed = std::chrono::steady_clock::now() - epoch;
+    return std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() / TIMER_TICK_MS;
+}
+
+static inline
+void slot_link(Timer *head, Timer *t)
+{
+    t->prev = head->prev;
+    t->next = head;
+    head->prev->next = t;
+    head->prev = t;
+}
+
+static inline
+void slot_unlink(Timer *t)
+{
+    if (!t->next)
+        return;
+
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->prev = t->next = NULL;
+}
+
+static
+void wheel_place(Timer *t)
+{
+    uint64_t expires = t->expires;
+    uint64_t delta;
+    int level;
+
+    if (expires < next_tick) {
+        slot_link(&wheel[0][next_tick & WHEEL_MASK], t);
+        return;
+    }
+
+    delta = expires - next_tick;
+    if (delta >= WHEEL_SPAN) {
+        expires = next_tick + WHEEL_SPAN - 1;
+        delta = WHEEL_SPAN - 1;
+    }
+
+    for (level = 0; delta >= (1ULL << (WHEEL_BITS * (level + 1))); ++level);
+
+    slot_link(&wheel[level][(expires >> (WHEEL_BITS * level)) & WHEEL_MASK], t);
+}
+
+static
+int wheel_cascade(int level)
+{
+    int idx = (next_tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    Timer *head = &wheel[level][idx];
+
+    while (head->next != head) {
+        Timer *t = head->next;
+
+        slot_unlink(t);
+        wheel_place(t);
+    }
+
+    return idx;
+}
+
+void timerwheel_tick(void)
+{
+    std::vector<DueTimer> due;
+    uint64_t now;
+
+    {
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        now = current_tick();
+
+        while (next_tick <= now) {
+            int idx = next_tick & WHEEL_MASK;
+            Timer *head = &wheel[0][idx];
+            int level;
+
+            for (level = 1; !idx && level < WHEEL_LEVELS; ++level)
+                idx = wheel_cascade(level);
+
+            while (head->next != head) {
+                Timer *t = head->next;
+
+                slot_unlink(t);
+                due.push_back({(Timer *)ref(t), t->gen});
+            }
+
+            ++next_tick;
+        }
+    }
+
+    // a timer stopped or re-armed by an earlier callback of this tick has
+    // a new generation and is skipped.
+    for (auto &d: due) {
+        bool fire = false;
+
+        {
+            std::lock_guard<decltype(mutex)> lock(mutex);
+            if (d.timer->armed && d.timer->gen == d.gen) {
+                d.timer->armed = false;
+                ++d.timer->gen;
+                fire = true;
+            }
+        }
+
+        if (fire) {
+            d.timer->cb(d.timer->context);
+            deref(d.timer->context);
+            deref(d.timer);
+        }
+        deref(d.timer);
+    }
+}
+
+static
+void timer_arm(Timer *t, uint64_t delay_ms)
+{
+    if (t->armed) {
+        slot_unlink(t);
+    } else {
+        ref(t);
+        if (t->context)
+            ref(t->context);
+    }
+
+    t->armed = true;
+    ++t->gen;
+    t->expires = current_tick() + (delay_ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+    wheel_place(t);
+}
+
+Timer *timer_start(uint64_t delay_ms, TimerCallback *cb, void *context)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    Timer *t = (Timer *)rc_zalloc(sizeof(Timer), NULL);
+
+    if (!t) {
+        vlogE(TAG_TIMER "OOM");
+        return NULL;
+    }
+
+    t->cb      = cb;
+    t->context = context;
+    timer_arm(t, delay_ms);
+
+    return t;
+}
+
+void timer_restart(Timer *timer, uint64_t delay_ms)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    timer_arm(timer, delay_ms);
+}
+
+void timer_stop(Timer *timer)
+{
+    {
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        if (!timer->armed)
+            return;
+
+        slot_unlink(timer);
+        timer->armed = false;
+        ++timer->gen;
+    }
+
+    deref(timer->context);
+    deref(timer);
+}
+
+int timerwheel_init(void)
+{
+    int level;
+    int idx;
+
+    for (level = 0; level < WHEEL_LEVELS; ++level) {
+        for (idx = 0; idx < WHEEL_SLOTS; ++idx)
+            wheel[level][idx].prev = wheel[level][idx].next = &wheel[level][idx];
+    }
+
+    epoch = std::chrono::steady_clock::now();
+    next_tick = 0;
+
+    vlogI(TAG_TIMER "Timer wheel initialized.");
+
+    return 0;
+}
+
+void timerwheel_deinit(void)
+{
+    int level;
+    int idx;
+
+    for (level = 0; level < WHEEL_LEVELS; ++level) {
+        for (idx = 0; idx < WHEEL_SLOTS; ++idx) {
+            Timer *head = &wheel[level][idx];
+
+            while (head->next != head) {
+                Timer *t = head->next;
+
+                timer_stop(t);
+            }
+        }
+    }
+}
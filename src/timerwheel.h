@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2020 trinity-tech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __TIMERWHEEL_H__
+#define __TIMERWHEEL_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Deadlines (login expiry, message receipts, session idle, ttl of cached
+ * entries) live in one hierarchical timer wheel, so arming, re-arming and
+ * stopping a timer is O(1) and a tick only touches the timers that are due.
+ * The wheel is advanced by timerwheel_tick() from the carrier idle callback
+ * and callbacks run on that thread.
+ *
+ * A timer holds a reference to its context (a ref counted object or NULL)
+ * only while it is armed, so a context owning its timer makes no cycle.
+ * Re-arming a fired or stopped timer takes the reference again, the caller
+ * must still hold the context then. The returned timer is owned by the
+ * caller, which derefs it when no longer needed.
+ */
+typedef struct Timer Timer;
+typedef void TimerCallback(void *context);
+
+int timerwheel_init(void);
+void timerwheel_deinit(void);
+void timerwheel_tick(void);
+
+Timer *timer_start(uint64_t delay_ms, TimerCallback *cb, void *context);
+void timer_restart(Timer *timer, uint64_t delay_ms);
+void timer_stop(Timer *timer);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif //__TIMERWHEEL_H__
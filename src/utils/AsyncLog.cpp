@@ -0,0 +1,600 @@
+#include "AsyncLog.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <crystal/vlog.h>
+
+#include "Log.hpp"
+
+namespace trinity {
+
+/***********************************************/
+/***** static variables initialize *************/
+/***********************************************/
+std::mutex AsyncLog::RingsMutex;
+std::vector<std::shared_ptr<AsyncLog::Ring>> AsyncLog::Rings;
+std::condition_variable AsyncLog::WakeUp;
+std::atomic<bool> AsyncLog::Running(false);
+std::thread AsyncLog::Writer;
+thread_local AsyncLog::RingHolder AsyncLog::ThreadRing;
+
+namespace {
+
+constexpr const int IdleWaitMS = 10;
+
+enum ArgKind : uint8_t {
+    IntArg,
+    UintArg,
+    DoubleArg,
+    LongDoubleArg,
+    PointerArg,
+    StringArg,
+    NullStringArg,
+};
+
+struct Spec {
+    char text[32];   // the conversion itself, "%...c"
+    char length[3];
+    char conv;
+    int stars;
+    bool precStar;
+    int prec;
+};
+
+// A captured log line: the format pointer plus the packed argument values.
+// Strings are copied, everything else is stored by value. Lines that do not
+// fit are written inline instead.
+struct Record {
+    static constexpr const size_t PayloadSize = 488;
+
+    int level;
+    const char* tag;
+    const char* format;
+    size_t size;
+    uint8_t payload[PayloadSize];
+
+    template <typename T>
+    bool put(ArgKind kind, const T& value) {
+        if (size + 1 + sizeof(T) > PayloadSize) {
+            return false;
+        }
+        payload[size++] = kind;
+        std::memcpy(payload + size, &value, sizeof(T));
+        size += sizeof(T);
+        return true;
+    }
+
+    bool putString(const char* str, size_t len) {
+        if (str == nullptr) {
+            return put(NullStringArg, uint8_t(0));
+        }
+        if (size + 1 + sizeof(uint16_t) + len > PayloadSize) {
+            return false;
+        }
+
+        uint16_t strLen = len;
+        put(StringArg, strLen);
+        std::memcpy(payload + size, str, len);
+        size += len;
+        return true;
+    }
+
+    template <typename T>
+    bool get(size_t& offset, ArgKind kind, T& value) const {
+        if (offset + 1 + sizeof(T) > size || payload[offset] != kind) {
+            return false;
+        }
+        std::memcpy(&value, payload + offset + 1, sizeof(T));
+        offset += 1 + sizeof(T);
+        return true;
+    }
+};
+
+using SignedSize = std::make_signed<size_t>::type;
+
+const char* ParseSpec(const char* format, Spec& spec)
+{
+    const char* ptr = format + 1;
+
+    spec.stars = 0;
+    spec.precStar = false;
+    spec.prec = -1;
+
+    while (*ptr != '\0' && std::strchr("-+ #0'", *ptr) != nullptr) {
+        ptr++;
+    }
+    if (*ptr == '*') {
+        spec.stars++;
+        ptr++;
+    } else {
+        while (std::isdigit(*ptr)) {
+            ptr++;
+        }
+    }
+    if (*ptr == '.') {
+        ptr++;
+        if (*ptr == '*') {
+            spec.stars++;
+            spec.precStar = true;
+            ptr++;
+        } else {
+            spec.prec = 0;
+            while (std::isdigit(*ptr)) {
+                spec.prec = spec.prec * 10 + (*ptr++ - '0');
+            }
+        }
+    }
+
+    size_t len = 0;
+    while (len < 2 && *ptr != '\0' && std::strchr("hljztLq", *ptr) != nullptr) {
+        spec.length[len++] = *ptr++;
+    }
+    spec.length[len] = '\0';
+
+    spec.conv = *ptr;
+    if (spec.conv == '\0' || std::strchr("diouxXcfFeEgGaAsp%", spec.conv) == nullptr) {
+        return nullptr; // %n and unknown conversions are never deferred
+    }
+    if ((spec.conv == 's' || spec.conv == 'c') && len > 0) {
+        return nullptr; // wide characters
+    }
+
+    len = ptr + 1 - format;
+    if (len >= sizeof(spec.text)) {
+        return nullptr;
+    }
+    std::memcpy(spec.text, format, len);
+    spec.text[len] = '\0';
+
+    return ptr + 1;
+}
+
+long long SignedArg(const char* length, va_list* ap)
+{
+    if (std::strcmp(length, "l") == 0) {
+        return va_arg(*ap, long);
+    } else if (std::strcmp(length, "ll") == 0 || std::strcmp(length, "q") == 0) {
+        return va_arg(*ap, long long);
+    } else if (std::strcmp(length, "j") == 0) {
+        return va_arg(*ap, intmax_t);
+    } else if (std::strcmp(length, "z") == 0) {
+        return va_arg(*ap, SignedSize);
+    } else if (std::strcmp(length, "t") == 0) {
+        return va_arg(*ap, ptrdiff_t);
+    }
+
+    return va_arg(*ap, int); // char and short are promoted
+}
+
+unsigned long long UnsignedArg(const char* length, va_list* ap)
+{
+    if (std::strcmp(length, "l") == 0) {
+        return va_arg(*ap, unsigned long);
+    } else if (std::strcmp(length, "ll") == 0 || std::strcmp(length, "q") == 0) {
+        return va_arg(*ap, unsigned long long);
+    } else if (std::strcmp(length, "j") == 0) {
+        return va_arg(*ap, uintmax_t);
+    } else if (std::strcmp(length, "z") == 0) {
+        return va_arg(*ap, size_t);
+    } else if (std::strcmp(length, "t") == 0) {
+        return va_arg(*ap, std::make_unsigned<ptrdiff_t>::type);
+    }
+
+    return va_arg(*ap, unsigned int);
+}
+
+bool Capture(Record& record, const char* format, va_list* ap)
+{
+    record.size = 0;
+
+    for (auto ptr = std::strchr(format, '%'); ptr != nullptr; ptr = std::strchr(ptr, '%')) {
+        Spec spec;
+        ptr = ParseSpec(ptr, spec);
+        if (ptr == nullptr) {
+            return false;
+        }
+        if (spec.conv == '%') {
+            continue;
+        }
+
+        int prec = spec.prec;
+        for (int idx = 0; idx < spec.stars; idx++) {
+            int star = va_arg(*ap, int);
+            if (record.put(IntArg, (long long)star) == false) {
+                return false;
+            }
+            if (spec.precStar && idx == spec.stars - 1) {
+                prec = star;
+            }
+        }
+
+        bool captured = false;
+        switch (spec.conv) {
+        case 'd':
+        case 'i':
+            captured = record.put(IntArg, SignedArg(spec.length, ap));
+            break;
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            captured = record.put(UintArg, UnsignedArg(spec.length, ap));
+            break;
+        case 'c':
+            captured = record.put(IntArg, (long long)va_arg(*ap, int));
+            break;
+        case 'p':
+            captured = record.put(PointerArg, va_arg(*ap, void*));
+            break;
+        case 's': {
+            auto str = va_arg(*ap, const char*);
+            size_t len = 0;
+            if (str != nullptr) {
+                len = prec >= 0 ? strnlen(str, prec) : std::strlen(str);
+            }
+            captured = record.putString(str, len);
+            break;
+        }
+        default: // floating point
+            if (spec.length[0] == 'L') {
+                captured = record.put(LongDoubleArg, va_arg(*ap, long double));
+            } else {
+                captured = record.put(DoubleArg, va_arg(*ap, double));
+            }
+            break;
+        }
+        if (captured == false) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename T>
+void Append(std::string& text, const Spec& spec, const int* stars, T value)
+{
+    auto print = [&](char* buf, size_t size) -> int {
+        switch (spec.stars) {
+        case 0:
+            return snprintf(buf, size, spec.text, value);
+        case 1:
+            return snprintf(buf, size, spec.text, stars[0], value);
+        default:
+            return snprintf(buf, size, spec.text, stars[0], stars[1], value);
+        }
+    };
+
+    char buf[256];
+    int len = print(buf, sizeof(buf));
+    if (len < 0) {
+        return;
+    }
+    if (len < (int)sizeof(buf)) {
+        text.append(buf, len);
+        return;
+    }
+
+    std::vector<char> largeBuf(len + 1);
+    print(largeBuf.data(), largeBuf.size());
+    text.append(largeBuf.data(), len);
+}
+
+void AppendSigned(std::string& text, const Spec& spec, const int* stars, long long value)
+{
+    if (std::strcmp(spec.length, "l") == 0) {
+        Append(text, spec, stars, (long)value);
+    } else if (std::strcmp(spec.length, "ll") == 0 || std::strcmp(spec.length, "q") == 0) {
+        Append(text, spec, stars, value);
+    } else if (std::strcmp(spec.length, "j") == 0) {
+        Append(text, spec, stars, (intmax_t)value);
+    } else if (std::strcmp(spec.length, "z") == 0) {
+        Append(text, spec, stars, (SignedSize)value);
+    } else if (std::strcmp(spec.length, "t") == 0) {
+        Append(text, spec, stars, (ptrdiff_t)value);
+    } else {
+        Append(text, spec, stars, (int)value);
+    }
+}
+
+void AppendUnsigned(std::string& text, const Spec& spec, const int* stars, unsigned long long value)
+{
+    if (std::strcmp(spec.length, "l") == 0) {
+        Append(text, spec, stars, (unsigned long)value);
+    } else if (std::strcmp(spec.length, "ll") == 0 || std::strcmp(spec.length, "q") == 0) {
+        Append(text, spec, stars, value);
+    } else if (std::strcmp(spec.length, "j") == 0) {
+        Append(text, spec, stars, (uintmax_t)value);
+    } else if (std::strcmp(spec.length, "z") == 0) {
+        Append(text, spec, stars, (size_t)value);
+    } else if (std::strcmp(spec.length, "t") == 0) {
+        Append(text, spec, stars, (std::make_unsigned<ptrdiff_t>::type)value);
+    } else {
+        Append(text, spec, stars, (unsigned int)value);
+    }
+}
+
+void Format(const Record& record, std::string& text)
+{
+    const char* format = record.format;
+    size_t offset = 0;
+
+    for (auto ptr = std::strchr(format, '%'); ptr != nullptr; ptr = std::strchr(format, '%')) {
+        text.append(format, ptr - format);
+
+        Spec spec;
+        format = ParseSpec(ptr, spec);
+        if (spec.conv == '%') {
+            text.push_back('%');
+            continue;
+        }
+
+        int stars[2] = {0, 0};
+        for (int idx = 0; idx < spec.stars; idx++) {
+            long long star = 0;
+            record.get(offset, IntArg, star);
+            stars[idx] = star;
+        }
+
+        long long sval;
+        unsigned long long uval;
+        double dval;
+        long double ldval;
+        void* pval;
+        uint16_t len;
+        uint8_t nul;
+        switch (spec.conv) {
+        case 'd':
+        case 'i':
+            if (record.get(offset, IntArg, sval)) {
+                AppendSigned(text, spec, stars, sval);
+            }
+            break;
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            if (record.get(offset, UintArg, uval)) {
+                AppendUnsigned(text, spec, stars, uval);
+            }
+            break;
+        case 'c':
+            if (record.get(offset, IntArg, sval)) {
+                Append(text, spec, stars, (int)sval);
+            }
+            break;
+        case 'p':
+            if (record.get(offset, PointerArg, pval)) {
+                Append(text, spec, stars, pval);
+            }
+            break;
+        case 's':
+            if (record.get(offset, NullStringArg, nul)) {
+                Append(text, spec, stars, "(null)");
+            } else if (record.get(offset, StringArg, len)) {
+                std::string str(reinterpret_cast<const char*>(record.payload + offset), len);
+                offset += len;
+                Append(text, spec, stars, str.c_str());
+            }
+            break;
+        default:
+            if (spec.length[0] == 'L') {
+                if (record.get(offset, LongDoubleArg, ldval)) {
+                    Append(text, spec, stars, ldval);
+                }
+            } else if (record.get(offset, DoubleArg, dval)) {
+                Append(text, spec, stars, dval);
+            }
+            break;
+        }
+    }
+
+    text.append(format);
+}
+
+void Output(const Record& record)
+{
+    std::string text;
+    Format(record, text);
+
+    if (record.tag == nullptr) {
+        vlog(record.level, "%s", text.c_str());
+        return;
+    }
+
+    auto prettyFormat = Log::Decorate(record.level, record.tag, "%s");
+    vlog(record.level, prettyFormat.c_str(), text.c_str());
+}
+
+} // namespace
+
+// Single producer (the owner thread), single consumer (the writer thread).
+class AsyncLog::Ring {
+public:
+    static constexpr const size_t Capacity = 256; // power of 2
+
+    explicit Ring()
+        : mSlots(Capacity)
+        , mHead(0)
+        , mTail(0)
+        , mOrphaned(false) {
+    }
+
+    Record* acquire() {
+        auto head = mHead.load(std::memory_order_relaxed);
+        if (head - mTail.load(std::memory_order_acquire) >= Capacity) {
+            return nullptr;
+        }
+        return &mSlots[head & (Capacity - 1)];
+    }
+
+    void commit() {
+        mHead.store(mHead.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    Record* front() {
+        auto tail = mTail.load(std::memory_order_relaxed);
+        if (tail == mHead.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &mSlots[tail & (Capacity - 1)];
+    }
+
+    void pop() {
+        mTail.store(mTail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    void orphan() {
+        mOrphaned.store(true, std::memory_order_release);
+    }
+
+    bool orphaned() {
+        return mOrphaned.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<Record> mSlots;
+    alignas(64) std::atomic<size_t> mHead;
+    alignas(64) std::atomic<size_t> mTail;
+    std::atomic<bool> mOrphaned;
+};
+
+/***********************************************/
+/***** static function implement ***************/
+/***********************************************/
+void AsyncLog::Start()
+{
+    if (Running == true) {
+        return;
+    }
+
+    Running = true;
+    Writer = std::thread(&AsyncLog::Process);
+}
+
+void AsyncLog::Stop()
+{
+    if (Running == false) {
+        return;
+    }
+
+    Running = false;
+    WakeUp.notify_all();
+    if (Writer.joinable()) {
+        Writer.join();
+    }
+}
+
+bool AsyncLog::Write(int level, const char* tag, const char* format, va_list ap)
+{
+    if (Running == false) {
+        return false;
+    }
+
+    auto ring = GetThreadRing();
+    auto record = ring->acquire();
+    if (record == nullptr) { // writer is behind, don't block the caller
+        return false;
+    }
+
+    record->level = level;
+    record->tag = tag;
+    record->format = format;
+
+    va_list args;
+    va_copy(args, ap);
+    bool captured = Capture(*record, format, &args);
+    va_end(args);
+    if (captured == false) {
+        return false;
+    }
+
+    ring->commit();
+    if (level <= VLOG_WARN) {
+        WakeUp.notify_one();
+    }
+
+    return true;
+}
+
+/***********************************************/
+/***** class public function implement  ********/
+/***********************************************/
+
+
+/***********************************************/
+/***** class protected function implement  *****/
+/***********************************************/
+
+
+/***********************************************/
+/***** class private function implement  *******/
+/***********************************************/
+AsyncLog::RingHolder::~RingHolder()
+{
+    if (ring != nullptr) {
+        ring->orphan();
+    }
+}
+
+AsyncLog::Ring* AsyncLog::GetThreadRing()
+{
+    if (ThreadRing.ring == nullptr) {
+        ThreadRing.ring = std::make_shared<Ring>();
+
+        std::lock_guard<std::mutex> lock(RingsMutex);
+        Rings.push_back(ThreadRing.ring);
+    }
+
+    return ThreadRing.ring.get();
+}
+
+void AsyncLog::Process()
+{
+    std::vector<std::shared_ptr<Ring>> rings;
+
+    while (true) {
+        // only the ring list is guarded, records are formatted and written
+        // with the lock released so registering threads never wait on I/O.
+        {
+            std::lock_guard<std::mutex> lock(RingsMutex);
+            rings = Rings;
+        }
+
+        bool idle = true;
+        bool reaped = false;
+        for (auto& ring : rings) {
+            bool orphaned = ring->orphaned();
+
+            for (auto record = ring->front(); record != nullptr; record = ring->front()) {
+                Output(*record);
+                ring->pop();
+                idle = false;
+            }
+
+            reaped |= orphaned;
+        }
+        rings.clear();
+
+        std::unique_lock<std::mutex> lock(RingsMutex);
+        if (reaped == true) { // owner thread exited and its ring is drained
+            Rings.erase(std::remove_if(Rings.begin(), Rings.end(), [](const std::shared_ptr<Ring>& ring) {
+                return ring->orphaned() && ring->front() == nullptr;
+            }), Rings.end());
+        }
+
+        if (idle == true) {
+            if (Running == false) {
+                break;
+            }
+            WakeUp.wait_for(lock, std::chrono::milliseconds(IdleWaitMS));
+        }
+    }
+}
+
+} // namespace trinity
@@ -0,0 +1,64 @@
+#ifndef _FEEDS_ASYNC_LOG_HPP_
+#define _FEEDS_ASYNC_LOG_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdarg>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace trinity {
+
+class AsyncLog {
+public:
+    /*** type define ***/
+
+    /*** static function and variable ***/
+    static void Start();
+    static void Stop();
+
+    // Capture the arguments into the calling thread's ring buffer and leave
+    // formatting and output to the writer thread. The format string is kept
+    // by pointer, so it must be a string literal.
+    // Returns false if the line was not queued and should be written inline.
+    static bool Write(int level, const char* tag, const char* format, va_list ap);
+
+    /*** class function and variable ***/
+
+private:
+    /*** type define ***/
+    class Ring;
+    struct RingHolder {
+        ~RingHolder();
+        std::shared_ptr<Ring> ring;
+    };
+
+    /*** static function and variable ***/
+    static Ring* GetThreadRing();
+    static void Process();
+
+    static std::mutex RingsMutex;
+    static std::vector<std::shared_ptr<Ring>> Rings;
+    static std::condition_variable WakeUp;
+    static std::atomic<bool> Running;
+    static std::thread Writer;
+    static thread_local RingHolder ThreadRing;
+
+    /*** class function and variable ***/
+    explicit AsyncLog() = delete;
+    virtual ~AsyncLog() = delete;
+};
+
+/***********************************************/
+/***** class template function implement *******/
+/***********************************************/
+
+/***********************************************/
+/***** macro definition ************************/
+/***********************************************/
+
+} // namespace trinity
+
+#endif /* _FEEDS_ASYNC_LOG_HPP_ */
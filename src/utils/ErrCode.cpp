@@ -53,6 +53,7 @@ std::string ErrCode::ToString(int errCode)
         { OutOfMemoryError                     , "OutOfMemoryError"},
         { CompletelyFinishedNotify             , "CompletelyFinishedNotify"},
         { DirectoryNotExistsError              , "DirectoryNotExistsError"},
+        { RequestCanceled                      , "RequestCanceled"},
 
         { DidNotReady                          , "DidNotReady"},
         { InvalidAccessToken                   , "InvalidAccessToken"},
@@ -17,7 +17,9 @@ public:
 	if((errCode) < 0) { \
 	    int errRet = (errCode); \
 		APPEND_SRCLINE(errRet); \
-		Log::E(Log::Tag::Err, "Failed to call %s in line %d, return %s(%d).", FORMAT_METHOD, __LINE__, ErrCode::ToString(errRet).c_str(), errRet); \
+		if(GET_ERRCODE(errRet) != ErrCode::RequestCanceled) { \
+			Log::E(Log::Tag::Err, "Failed to call %s in line %d, return %s(%d).", FORMAT_METHOD, __LINE__, ErrCode::ToString(errRet).c_str(), errRet); \
+		} \
 		return errRet; \
 	}
 
@@ -25,7 +27,9 @@ public:
 	if(errCode < 0) { \
 	    int errRet = errCode; \
 		APPEND_SRCLINE(errRet); \
-		Log::E(Log::Tag::Err, "Failed to call %s in line %d, return %s(%d).", FORMAT_METHOD, __LINE__, ErrCode::ToString(errRet).c_str(), errRet); \
+		if(GET_ERRCODE(errRet) != ErrCode::RequestCanceled) { \
+			Log::E(Log::Tag::Err, "Failed to call %s in line %d, return %s(%d).", FORMAT_METHOD, __LINE__, ErrCode::ToString(errRet).c_str(), errRet); \
+		} \
         return; \
 	}
 
@@ -81,6 +85,7 @@ public:
     constexpr static const int OutOfMemoryError                 = -111;
     constexpr static const int CompletelyFinishedNotify         = -112;
     constexpr static const int DirectoryNotExistsError          = -113;
+    constexpr static const int RequestCanceled                  = -114;
 
     constexpr static const int DidNotReady                      = -120;
     constexpr static const int InvalidAccessToken               = -121;
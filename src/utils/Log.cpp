@@ -4,6 +4,8 @@
 #include <sstream>
 #include <crystal/vlog.h>
 
+#include "AsyncLog.hpp"
+
 namespace trinity {
 
 /***********************************************/
@@ -61,6 +63,7 @@ void Log::I(const char* tag, const char* format, ...)
   va_end(ap);
 }
 
+#ifndef FEEDS_LOG_NO_DEBUG
 void Log::D(const char* tag, const char* format, ...)
 {
   if (log_level < VLOG_DEBUG) {
@@ -97,6 +100,12 @@ void Log::V(const char* tag, const char* format, ...)
   va_end(ap);
 }
 
+bool Log::Debuggable()
+{
+  return log_level >= VLOG_DEBUG;
+}
+#endif
+
 std::string Log::GetFormatMethod(const std::string& prettyFunction) {
   auto colons = prettyFunction.find("::");
   if(colons == prettyFunction.npos) {
@@ -109,20 +118,7 @@ std::string Log::GetFormatMethod(const std::string& prettyFunction) {
   return method;
 }
 
-/***********************************************/
-/***** class public function implement  ********/
-/***********************************************/
-
-
-/***********************************************/
-/***** class protected function implement  *****/
-/***********************************************/
-
-
-/***********************************************/
-/***** class private function implement  *******/
-/***********************************************/
-void Log::Print(int level, const char* tag, const char* format, va_list ap)
+std::string Log::Decorate(int level, const char* tag, const char* format)
 {
   std::stringstream prettyFormat;
 
@@ -143,7 +139,29 @@ void Log::Print(int level, const char* tag, const char* format, va_list ap)
 #endif
 #endif
 
-  vlogv(level, prettyFormat.str().c_str(), ap);
+  return prettyFormat.str();
+}
+
+/***********************************************/
+/***** class public function implement  ********/
+/***********************************************/
+
+
+/***********************************************/
+/***** class protected function implement  *****/
+/***********************************************/
+
+
+/***********************************************/
+/***** class private function implement  *******/
+/***********************************************/
+void Log::Print(int level, const char* tag, const char* format, va_list ap)
+{
+  if (AsyncLog::Write(level, tag, format, ap) == true) {
+    return;
+  }
+
+  vlogv(level, Decorate(level, tag, format).c_str(), ap);
 }
 
 const char* Log::ConvColor(int level)
@@ -4,6 +4,7 @@
 #include <cstdarg>
 #include <mutex>
 #include <chrono>
+#include <string>
 
 namespace trinity {
 
@@ -11,6 +12,20 @@ namespace trinity {
 #define __PRETTY_FUNCTION__        __FUNCSIG__
 #endif
 
+/*
+ * Debug, trace and verbose lines go through these macros, so that with
+ * FEEDS_LOG_NO_DEBUG the call and its arguments compile out like vlogD.
+ */
+#ifdef FEEDS_LOG_NO_DEBUG
+#define LOG_D(tag, format, ...) ((void)0)
+#define LOG_T(tag, format, ...) ((void)0)
+#define LOG_V(tag, format, ...) ((void)0)
+#else
+#define LOG_D(tag, format, ...) trinity::Log::D(tag, format, ##__VA_ARGS__)
+#define LOG_T(tag, format, ...) trinity::Log::T(tag, format, ##__VA_ARGS__)
+#define LOG_V(tag, format, ...) trinity::Log::V(tag, format, ##__VA_ARGS__)
+#endif
+
 class Log {
 public:
   /*** type define ***/
@@ -21,10 +36,16 @@ public:
   static void E(const char* tag, const char* format, ...);
   static void W(const char* tag, const char* format, ...);
   static void I(const char* tag, const char* format, ...);
+#ifdef FEEDS_LOG_NO_DEBUG
+  static constexpr bool Debuggable() { return false; }
+#else
   static void D(const char* tag, const char* format, ...);
   static void T(const char* tag, const char* format, ...);
   static void V(const char* tag, const char* format, ...);
+  static bool Debuggable();
+#endif
   static std::string GetFormatMethod(const std::string& prettyFunction);
+  static std::string Decorate(int level, const char* tag, const char* format);
 
   struct Tag {
     static constexpr const char *Err = "Feedsd.Err";
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2020 trinity-tech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Fan-out cost of a channel with 10k and 100k notification destinations:
+ * building the flat array, scanning it once per notification and dropping
+ * destinations as their peers go away.
+ *
+ * Usage: bench_fanout [subscribers...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <crystal.h>
+
+#include "notifdests.h"
+
+#define NODE_ID_LEN   52
+#define NOTIFY_ROUNDS 100
+#define DROP_ROUNDS   1000
+
+struct NotifDest {
+    char node_id[NODE_ID_LEN + 1];
+};
+
+static
+double now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static
+void bench(size_t subers)
+{
+    ChanNotifDests *cnds;
+    NotifDest *dests;
+    NotifDest **nd;
+    size_t sink = 0;
+    size_t drops;
+    double begin;
+    double build;
+    double notify;
+    double drop;
+    size_t i;
+    int r;
+
+    dests = calloc(subers, sizeof(NotifDest));
+    cnds = cnds_create();
+    if (!dests || !cnds) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    for (i = 0; i < subers; ++i)
+        snprintf(dests[i].node_id, sizeof(dests[i].node_id), "%052zu", i);
+
+    begin = now_ms();
+    for (i = 0; i < subers; ++i)
+        cnds_add(cnds, &dests[i]);
+    build = now_ms() - begin;
+
+    // every notification reads the node id it is queued for.
+    begin = now_ms();
+    for (r = 0; r < NOTIFY_ROUNDS; ++r) {
+        cnds_foreach(cnds, nd)
+            sink += strlen((*nd)->node_id);
+    }
+    notify = (now_ms() - begin) / NOTIFY_ROUNDS;
+
+    drops = subers < DROP_ROUNDS ? subers : DROP_ROUNDS;
+    begin = now_ms();
+    for (i = 0; i < drops; ++i)
+        cnds_remove(cnds, &dests[(i * 7919) % subers]);
+    drop = (now_ms() - begin) / drops;
+
+    printf("%7zu subscribers: build %8.3fms, fan-out %8.3fms (%6.2fns per destination),"
+           " drop %8.3fus per destination, array %zuKB [%zu]\n",
+           subers, build, notify, notify * 1000000.0 / subers, drop * 1000.0,
+           cvector_capacity(cnds->nds) * sizeof(NotifDest *) / 1024, sink % 10);
+
+    deref(cnds);
+    free(dests);
+}
+
+int main(int argc, char *argv[])
+{
+    int i;
+
+    if (argc < 2) {
+        bench(10000);
+        bench(100000);
+        return 0;
+    }
+
+    for (i = 1; i < argc; ++i)
+        bench(strtoul(argv[i], NULL, 10));
+
+    return 0;
+}
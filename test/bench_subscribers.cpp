@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2020 trinity-tech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Startup cost and memory of the subscriber index per million subscriptions.
+ * Each layout holds one million subscriptions on its own channels; the index
+ * of a channel is loaded from subscriptions_channel_index the first time it
+ * is asked about, so the load time here is what a restart pays.
+ *
+ * Usage: bench_subscribers [scratch.db]
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <ctime>
+#include <unistd.h>
+#include <crystal.h>
+#include <sqlite3.h>
+
+#include "db.h"
+#include "obj.h"
+
+#define SUBSCRIPTIONS 1000000
+
+UserInfo feeds_owner_info;
+
+/*
+ * Channel ids are disjoint per layout so all of them share one scratch
+ * database. Sparse user ids are spread over a hundred times as many users
+ * as there are subscriptions.
+ */
+static const struct {
+    const char *name;
+    uint64_t first_chan;
+    uint64_t chans;
+    const char *sql;
+} layouts[] = {
+    {"one channel, dense ids", 1, 1,
+     "WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM n WHERE i < 999999)"
+     " INSERT OR IGNORE INTO subscriptions(user_id, channel_id, create_at, proof, memo)"
+     " SELECT i + 1, 1, i, 'NA', 'NA' FROM n"},
+    {"100 channels, dense ids", 1001, 100,
+     "WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM n WHERE i < 999999)"
+     " INSERT OR IGNORE INTO subscriptions(user_id, channel_id, create_at, proof, memo)"
+     " SELECT i % 10000 + 1, i / 10000 + 1001, i, 'NA', 'NA' FROM n"},
+    {"10000 channels, sparse ids", 100001, 10000,
+     "WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM n WHERE i < 999999)"
+     " INSERT OR IGNORE INTO subscriptions(user_id, channel_id, create_at, proof, memo)"
+     " SELECT (i * 7919) % 100000000 + 1, i % 10000 + 100001, i, 'NA', 'NA' FROM n"},
+};
+
+static
+double now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static
+long resident_kb(void)
+{
+    long size = 0;
+    long rss = 0;
+    FILE *fp;
+
+    fp = fopen("/proc/self/statm", "r");
+    if (!fp)
+        return 0;
+
+    if (fscanf(fp, "%ld %ld", &size, &rss) != 2)
+        rss = 0;
+    fclose(fp);
+
+    return rss * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : "bench_subscribers.db";
+    sqlite3 *handle;
+    uint64_t total;
+    uint64_t subs;
+    uint64_t c;
+    double begin;
+    double load;
+    long rss;
+    size_t i;
+
+    remove(path);
+    if (SQLITE_OK != sqlite3_open(path, &handle)) {
+        printf("Opening %s failed\n", path);
+        return 1;
+    }
+
+    if (db_init(handle) < 0) {
+        printf("db_init() failed\n");
+        return 1;
+    }
+
+    for (i = 0; i < sizeof(layouts) / sizeof(layouts[0]); ++i) {
+        if (SQLITE_OK != sqlite3_exec(handle, layouts[i].sql, NULL, NULL, NULL)) {
+            printf("Loading %s failed: %s\n", layouts[i].name, sqlite3_errmsg(handle));
+            return 1;
+        }
+    }
+
+    // warm the page cache so it is not counted against the first layout.
+    sqlite3_exec(handle, "SELECT count(user_id) FROM subscriptions", NULL, NULL, NULL);
+
+    for (i = 0; i < sizeof(layouts) / sizeof(layouts[0]); ++i) {
+        total = 0;
+        rss = resident_kb();
+        begin = now_ms();
+        for (c = 0; c < layouts[i].chans; ++c) {
+            if (db_suber_count(layouts[i].first_chan + c, &subs) < 0) {
+                printf("db_suber_count() failed\n");
+                return 1;
+            }
+            total += subs;
+        }
+        load = now_ms() - begin;
+        rss = resident_kb() - rss;
+
+        printf("%-28s %7llu subscriptions: load %8.1fms, index %6ldKB"
+               " (%5.1fMB per million)\n",
+               layouts[i].name, (unsigned long long)total, load, rss,
+               rss / 1024.0 * SUBSCRIPTIONS / (total ? total : 1));
+    }
+
+    db_deinit();
+    sqlite3_close(handle);
+    remove(path);
+
+    return 0;
+}
@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) 2020 trinity-tech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Fails when a list query needs a full table scan or a temp b-tree sort.
+ * The schema comes from db_init() on a scratch database loaded with
+ * synthetic rows; every db_iter_* shape and every feedsd-ext list query is
+ * run through EXPLAIN QUERY PLAN.
+ *
+ * Usage: test_query_plans [scratch.db]
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <crystal.h>
+#include <sqlite3.h>
+
+#include "db.h"
+#include "obj.h"
+
+UserInfo feeds_owner_info;
+
+/*
+ * Shapes that scan or sort by design, matched as name prefixes. Anything
+ * added here needs a reason the scanned or sorted set stays small.
+ */
+static const struct {
+    const char *name;
+    const char *why;
+} allowed[] = {
+    {"db_iter_chan_metas", "every channel is loaded once at startup"},
+    {"db_iter_chans by none", "walks channels in rowid order until LIMIT"},
+    {"db_iter_chans by id", "walks channels in rowid order until LIMIT"},
+    {"db_iter_reported_cmts by none", "walks reports in rowid order until LIMIT"},
+    {"db_iter_sub_chans by updated_at", "sorts one user's subscriptions"},
+    {"db_iter_sub_chans by created_at", "sorts one user's subscriptions"},
+    {"db_iter_liked_posts by updated_at", "sorts one user's liked posts"},
+    {"db_iter_liked_posts by created_at", "sorts one user's liked posts"},
+    {"search", "fts5 matches are sorted by rank"},
+};
+
+/*
+ * Query shapes built by feedsd-ext, keep in step with ChannelMethod.cpp and
+ * SearchIndex.cpp. Values stand in for request params and cursors.
+ */
+static const struct {
+    const char *name;
+    const char *sql;
+} ext_queries[] = {
+    {"get_multi_comments by channel and post",
+     "SELECT channel_id, post_id, comment_id, content FROM comments"
+     " WHERE true AND channel_id = 1 AND post_id = 1 AND updated_at >= 1 AND updated_at <= 9"
+     " AND (updated_at, comment_id) < (9, 9) ORDER BY updated_at DESC, comment_id DESC LIMIT 10"},
+    {"get_multi_comments by channel",
+     "SELECT channel_id, post_id, comment_id, content FROM comments"
+     " WHERE true AND channel_id = 1"
+     " AND (created_at, post_id, comment_id) < (9, 9, 9)"
+     " ORDER BY created_at DESC, post_id DESC, comment_id DESC LIMIT 10"},
+    {"get_multi_comments all",
+     "SELECT channel_id, post_id, comment_id, content FROM comments"
+     " WHERE true AND (updated_at, channel_id, post_id, comment_id) < (9, 9, 9, 9)"
+     " ORDER BY updated_at DESC, channel_id DESC, post_id DESC, comment_id DESC LIMIT 10"},
+    {"get_multi_comments by id",
+     "SELECT channel_id, post_id, comment_id, content FROM comments"
+     " WHERE true AND channel_id = 1 AND post_id = 1"
+     " AND (comment_id) > (9) ORDER BY comment_id ASC LIMIT 10"},
+    {"get_multi_likes_and_comments_count by channel",
+     "SELECT channel_id, post_id, next_comment_id - 1 AS comments, likes FROM posts"
+     " WHERE true AND channel_id = 1 AND (updated_at, post_id) < (9, 9)"
+     " ORDER BY updated_at DESC, post_id DESC LIMIT 10"},
+    {"get_multi_likes_and_comments_count all",
+     "SELECT channel_id, post_id, next_comment_id - 1 AS comments, likes FROM posts"
+     " WHERE true AND (created_at, channel_id, post_id) < (9, 9, 9)"
+     " ORDER BY created_at DESC, channel_id DESC, post_id DESC LIMIT 10"},
+    {"get_multi_subscribers_count",
+     "SELECT channel_id FROM channels WHERE channel_id = 1"},
+    {"get_avatar",
+     "SELECT hash, avatar FROM avatars"
+     " WHERE hash = (SELECT avatar FROM users WHERE did = 'did:elastos:1')"},
+    {"get_changes_since reset",
+     "SELECT COALESCE((SELECT MIN(seq) - 1 FROM changes),"
+     " (SELECT seq FROM sqlite_sequence WHERE name = 'changes'), 0)"},
+    {"get_changes_since",
+     "SELECT seq, kind, channel_id, post_id, comment_id, created_at FROM changes"
+     " WHERE seq > 9 AND +channel_id IN (1, 2) ORDER BY seq ASC LIMIT 10"},
+    {"get_changes_since one channel",
+     "SELECT seq, kind, channel_id, post_id, comment_id, created_at FROM changes"
+     " WHERE seq > 9 AND channel_id IN (1) ORDER BY seq ASC LIMIT 10"},
+    {"search",
+     "SELECT channel_id, post_id, comment_id, search_index.rank, doc_id"
+     " FROM search_index JOIN search_docs ON doc_id = search_index.rowid"
+     " WHERE search_index MATCH 'x' AND channel_id = 1"
+     " ORDER BY search_index.rank ASC, doc_id ASC LIMIT 10"},
+    {"get_home_timeline channels",
+     "SELECT s.channel_id FROM subscriptions s LEFT JOIN timeline_channels t ON t.channel_id = s.channel_id"
+     " WHERE s.user_id = 1 AND IFNULL(t.fanout, 0) = 0"},
+    {"get_home_timeline materialized",
+     "SELECT p.channel_id, p.post_id, p.content FROM timeline t"
+     " JOIN posts p ON p.channel_id = t.channel_id AND p.post_id = t.post_id"
+     " WHERE t.user_id = 1 AND p.status = 0"
+     " AND (t.created_at, t.channel_id, t.post_id) < (9, 9, 9)"
+     " ORDER BY t.created_at DESC, t.channel_id DESC, t.post_id DESC LIMIT 10"},
+    {"get_home_timeline merged",
+     "SELECT p.channel_id, p.post_id, p.content FROM posts p"
+     " WHERE p.channel_id = 1 AND p.status = 0 AND (p.created_at, p.post_id) < (9, 9)"
+     " ORDER BY p.created_at DESC, p.post_id DESC LIMIT 10"},
+    {"get_comment_thread",
+     "SELECT channel_id, post_id, comment_id, content,"
+     " (SELECT COUNT(*) FROM comments r WHERE r.channel_id = c.channel_id AND r.post_id = c.post_id"
+     "  AND r.refcomment_id = c.comment_id) AS reply_count"
+     " FROM comments c WHERE channel_id = 1 AND post_id = 1 AND refcomment_id = 0"
+     " AND (comment_id) > (9) ORDER BY comment_id ASC LIMIT 10"},
+    {"search indexer journal",
+     "SELECT seq, kind, channel_id, post_id, comment_id FROM changes"
+     " WHERE seq > 9 ORDER BY seq ASC LIMIT 64"},
+    {"search indexer rebuild",
+     "SELECT rowid, channel_id, post_id, comment_id FROM comments"
+     " WHERE rowid > 9 ORDER BY rowid ASC LIMIT 64"},
+};
+
+static const char *const synthetic_data[] = {
+    "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 200)"
+    " INSERT INTO users(did, name, update_at) SELECT 'did:elastos:' || i, 'user' || i, i FROM n",
+    "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 50)"
+    " INSERT INTO channels(created_at, updated_at, name, intro, next_post_id, iid, tip_methods, proof, memo, avatar)"
+    " SELECT i, i, 'channel' || i, 'intro', 41, 'NA', 'NA', 'NA', 'NA', 'NA' FROM n",
+    "WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM n WHERE i < 1999)"
+    " INSERT INTO posts(channel_id, post_id, created_at, updated_at, next_comment_id, status,"
+    "   iid, hash_id, proof, origin_post_url, memo, thumbnails, content)"
+    " SELECT i / 40 + 1, i % 40 + 1, i, i, 6, 0, 'NA', 'NA', 'NA', 'NA', 'NA', X'A0', zeroblob(512) FROM n",
+    "WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM n WHERE i < 9999)"
+    " INSERT INTO comments(channel_id, post_id, comment_id, refcomment_id, user_id, created_at, updated_at,"
+    "   status, iid, hash_id, proof, memo, thumbnails, content)"
+    " SELECT i / 200 + 1, i / 5 % 40 + 1, i % 5 + 1, i % 5 / 2, i % 200 + 1, i, i,"
+    "   0, 'NA', 'NA', 'NA', 'NA', X'A0', zeroblob(128) FROM n",
+    "WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM n WHERE i < 4999)"
+    " INSERT OR IGNORE INTO likes(channel_id, post_id, comment_id, user_id, created_at, proof, memo)"
+    " SELECT i % 50 + 1, i % 40 + 1, i % 3, i % 200 + 1, i, 'NA', 'NA' FROM n",
+    "WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM n WHERE i < 4999)"
+    " INSERT OR IGNORE INTO subscriptions(user_id, channel_id, create_at, proof, memo)"
+    " SELECT i % 200 + 1, i % 50 + 1, i, 'NA', 'NA' FROM n",
+    "WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM n WHERE i < 499)"
+    " INSERT OR IGNORE INTO reported_comments(channel_id, post_id, comment_id, reporter_id, created_at)"
+    " SELECT i % 50 + 1, i % 40 + 1, i % 5 + 1, i % 200 + 1, i FROM n",
+    "WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM n WHERE i < 999)"
+    " INSERT INTO outbox(node_id, created_at, payload) SELECT 'node' || (i % 20), i, X'00' FROM n",
+    "WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM n WHERE i < 1999)"
+    " INSERT INTO changes(kind, channel_id, post_id, comment_id, created_at)"
+    " SELECT 3, i / 40 + 1, i % 40 + 1, 0, i FROM n",
+};
+
+static sqlite3 *handle;
+static int failures;
+
+static
+bool is_allowed(const std::string &name)
+{
+    for (size_t i = 0; i < sizeof(allowed) / sizeof(allowed[0]); ++i) {
+        if (!name.compare(0, strlen(allowed[i].name), allowed[i].name))
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * "SCAN <table>" without an index is a full table scan, "SCAN <table> USING
+ * [COVERING] INDEX" is an ordered index walk cut short by LIMIT, which is how
+ * unfiltered pages are served. Older sqlite says "SCAN TABLE <table>".
+ */
+static
+bool is_table_scan(const char *detail)
+{
+    if (strncmp(detail, "SCAN ", 5))
+        return false;
+
+    // sqlite_sequence holds a row per AUTOINCREMENT table.
+    if (strstr(detail, " USING ") || strstr(detail, "CONSTANT ROW") || strstr(detail, "sqlite_sequence") ||
+        strstr(detail, "VIRTUAL TABLE") || strstr(detail, "subquery") || !strncmp(detail, "SCAN (", 6))
+        return false;
+
+    return true;
+}
+
+static
+void check_plan(const std::string &name, const char *sql)
+{
+    bool allow = is_allowed(name);
+    std::string explain = std::string("EXPLAIN QUERY PLAN ") + sql;
+    std::string plan;
+    sqlite3_stmt *stmt;
+    bool bad = false;
+
+    if (SQLITE_OK != sqlite3_prepare_v2(handle, explain.c_str(), -1, &stmt, NULL)) {
+        printf("FAIL %s: %s\n  %s\n", name.c_str(), sqlite3_errmsg(handle), sql);
+        ++failures;
+        return;
+    }
+
+    while (SQLITE_ROW == sqlite3_step(stmt)) {
+        const char *detail = (const char *)sqlite3_column_text(stmt, 3);
+
+        plan += std::string("\n  ") + detail;
+        if (!allow && (is_table_scan(detail) || strstr(detail, "USE TEMP B-TREE")))
+            bad = true;
+    }
+    sqlite3_finalize(stmt);
+
+    printf("%s %s%s\n", bad ? "FAIL" : "ok  ", name.c_str(), bad ? plan.c_str() : "");
+    if (bad) {
+        printf("  %s\n", sql);
+        ++failures;
+    }
+}
+
+static
+void check_iter(const std::string &name, DBObjIt *it)
+{
+    if (!it) {
+        printf("FAIL %s: no iterator\n", name.c_str());
+        ++failures;
+        return;
+    }
+
+    check_plan(name, db_iter_sql(it));
+    deref(it);
+}
+
+static
+void check_lists(void)
+{
+    static const char *const bys[] = {"none", "id", "updated_at", "created_at"};
+
+    for (uint64_t by = NONE; by <= CREATED_AT; ++by) {
+        for (int variant = 0; variant < 4; ++variant) {
+            QryCriteria qc;
+            char suffix[64];
+
+            // bounds and cursor on or off, the SQL differs in both.
+            memset(&qc, 0, sizeof(qc));
+            qc.by = by;
+            qc.maxcnt = 10;
+            if (by && (variant & 1)) {
+                qc.lower = 1;
+                qc.upper = 9;
+            }
+            if (by && (variant & 2)) {
+                qc.after.by = by;
+                qc.after.val = 9;
+                qc.after.keys[0] = 9;
+            }
+            if (!by && variant)
+                continue;
+            if (variant == 3)
+                qc.omit = QRY_FLDS_BLOBS;
+
+            snprintf(suffix, sizeof(suffix), " by %s%s%s", bys[by],
+                     variant & 1 ? " bounded" : "", variant & 2 ? " after cursor" : "");
+
+            check_iter(std::string("db_iter_chans") + suffix, db_iter_chans(&qc));
+            check_iter(std::string("db_iter_sub_chans") + suffix, db_iter_sub_chans(1, &qc));
+            check_iter(std::string("db_iter_posts") + suffix, db_iter_posts(1, &qc));
+            check_iter(std::string("db_iter_posts_lac") + suffix, db_iter_posts_lac(1, &qc));
+            check_iter(std::string("db_iter_liked_posts") + suffix, db_iter_liked_posts(1, &qc));
+            check_iter(std::string("db_iter_cmts") + suffix, db_iter_cmts(1, 1, &qc));
+            check_iter(std::string("db_iter_cmts_likes") + suffix, db_iter_cmts_likes(1, 1, &qc));
+
+            // likes and reports have no updated_at to list by.
+            if (by == UPD_AT)
+                continue;
+            check_iter(std::string("db_iter_liked_data") + suffix, db_iter_liked_data(1, &qc));
+            check_iter(std::string("db_iter_reported_cmts") + suffix, db_iter_reported_cmts(&qc));
+        }
+    }
+
+    check_iter("db_iter_chan_metas", db_iter_chan_metas());
+    check_iter("db_iter_outbox", db_iter_outbox("node1"));
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : "test_query_plans.db";
+    size_t i;
+
+    remove(path);
+    if (SQLITE_OK != sqlite3_open(path, &handle)) {
+        printf("Opening %s failed\n", path);
+        return 1;
+    }
+
+    if (db_init(handle) < 0) {
+        printf("db_init() failed\n");
+        return 1;
+    }
+
+    for (i = 0; i < sizeof(synthetic_data) / sizeof(synthetic_data[0]); ++i) {
+        if (SQLITE_OK != sqlite3_exec(handle, synthetic_data[i], NULL, NULL, NULL)) {
+            printf("Loading synthetic data failed: %s\n", sqlite3_errmsg(handle));
+            return 1;
+        }
+    }
+
+    check_lists();
+    for (i = 0; i < sizeof(ext_queries) / sizeof(ext_queries[0]); ++i)
+        check_plan(ext_queries[i].name, ext_queries[i].sql);
+
+    db_deinit();
+    sqlite3_close(handle);
+    remove(path);
+
+    printf("%d query plan(s) with a table scan or temp b-tree\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2020 trinity-tech
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Drives the epoch bracket of CommandHandler through a suspended request:
+ * the handler's runScoped() holds the epoch and ends, the continuation's
+ * runScoped() begins and ends it again later on the same thread.
+ *
+ * Usage: test_reqepoch
+ */
+
+#include <cstdio>
+
+#include "reqepoch.h"
+
+static int failures;
+
+#define expect(cond)                                                  \
+    do {                                                              \
+        if (!(cond)) {                                                \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);    \
+            ++failures;                                               \
+        }                                                             \
+    } while (0)
+
+// received() pins the request, runScoped() runs it until it suspends.
+static
+uint64_t suspend(const char *peer)
+{
+    uint64_t epoch = reqepoch_enter(peer);
+
+    expect(reqepoch_begin(peer, epoch));
+    reqepoch_hold();
+    reqepoch_end();
+
+    return epoch;
+}
+
+// the continuation's runScoped() once the wait is over.
+static
+bool resume(const char *peer, uint64_t epoch)
+{
+    bool run = reqepoch_begin(peer, epoch);
+
+    if (run)
+        expect(!reqepoch_cancelled());
+    reqepoch_end();
+
+    return run;
+}
+
+// nothing left pinned: the peer is forgotten and starts over from epoch 0.
+static
+bool released(const char *peer)
+{
+    uint64_t epoch;
+
+    reqepoch_peer_offline(peer);
+    epoch = reqepoch_enter(peer);
+    expect(reqepoch_begin(peer, epoch));
+    reqepoch_end();
+
+    return epoch == 0;
+}
+
+static
+void test_resume()
+{
+    uint64_t epoch = suspend("resume");
+
+    expect(resume("resume", epoch));
+    expect(released("resume"));
+}
+
+static
+void test_offline_while_suspended()
+{
+    uint64_t avoided = reqepoch_avoided();
+    uint64_t epoch = suspend("offline");
+
+    reqepoch_peer_offline("offline");
+    expect(!resume("offline", epoch));
+    expect(reqepoch_avoided() == avoided + 1);
+    expect(released("offline"));
+}
+
+static
+void test_resume_after_other_request()
+{
+    uint64_t queued;
+    uint64_t epoch;
+
+    epoch = suspend("shared");
+    queued = reqepoch_enter("shared");
+    expect(queued == epoch);
+    expect(resume("shared", queued));
+
+    expect(resume("shared", epoch));
+    expect(released("shared"));
+}
+
+int main(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    test_resume();
+    test_offline_while_suspended();
+    test_resume_after_other_request();
+
+    printf("%d reqepoch check(s) failed\n", failures);
+    return failures ? 1 : 0;
+}